@@ -0,0 +1,3901 @@
+/*
+ * This file was generated automatically by ExtUtils::ParseXS version 3.45 from the
+ * contents of Fast.xs. Do not edit this file, edit Fast.xs instead.
+ *
+ *    ANY CHANGES MADE HERE WILL BE LOST!
+ *
+ */
+
+#line 1 "Fast.xs"
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+*/
+
+#define PERL_NO_GET_CONTEXT
+#include "EXTERN.h"
+#include "perl.h"
+#include "XSUB.h"
+
+#include "ppport.h"
+
+#include "src/client.h"
+#include "src/key_hash.h"
+#include "src/utf8_valid.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+#define F_STORABLE  0x1
+#define F_COMPRESS  0x2
+#define F_UTF8      0x4
+#define F_CHUNKED   0x8
+
+/* Longest "{n:hash}" tag of a chunk key, and longest manifest.  */
+#define CHUNK_TAG_LEN_MAX  (sizeof("{18446744073709551615:ffffffff}") - 1)
+#define MANIFEST_LEN_MAX  127
+
+
+/*
+  Item header, cas, flags and "\r\n" take roughly this much in a slab
+  chunk besides the key and the value.
+*/
+#define ITEM_OVERHEAD  64
+
+/*
+  memcached item header with cas on 64-bit servers, and the maximum
+  number of slab classes.
+*/
+#define ITEM_HEADER_SIZE  48
+#define SLAB_CLASSES_MAX  64
+
+
+typedef struct
+{
+  struct client *c;
+  AV *servers;
+  int compress_threshold;
+  double compress_ratio;
+  SV *compress_method;
+  SV *decompress_method;
+  SV *serialize_method;
+  SV *deserialize_method;
+  int utf8;
+  int lazy_deserialize;
+  size_t max_size;
+  size_t chunk_size;
+  unsigned int chunk_seq;
+  int compress_slab_aware;
+  size_t *slab_sizes;           /* Sorted chunk sizes of slab classes.  */
+  int slab_count;
+} Cache_Memcached_Fast;
+
+static inline
+SV**
+safe_av_fetch(pTHX_ AV *av, SSize_t key, I32 lval)
+{
+  SV ** v = av_fetch(av, key, lval);
+  if ( !v || !SvOK(*v) )
+    croak("undefined value passed to av_fetch");
+
+  return v;
+}
+
+struct server_spec
+{
+  SV *addr;
+  double weight;
+  int noreply;
+};
+
+
+/*
+  Split "host:port" at the last colon, an address without one is a
+  UNIX socket path and gets NULL port.
+*/
+static
+void
+split_address(pTHX_ SV *addr_sv, const char **host, size_t *host_len,
+              const char **port, size_t *port_len)
+{
+  STRLEN len;
+
+  *host = SvPV(addr_sv, len);
+  /*
+    NOTE: here we relay on the fact that host is zero-terminated.
+  */
+  *port = strrchr(*host, ':');
+  if (*port)
+    {
+      *host_len = (*port)++ - *host;
+      *port_len = len - *host_len - 1;
+    }
+  else
+    {
+      *host_len = len;
+      *port_len = 0;
+    }
+}
+
+
+static
+void
+add_server(pTHX_ Cache_Memcached_Fast *memd, const struct server_spec *spec)
+{
+  const char *host, *port;
+  size_t host_len, port_len;
+
+  av_push(memd->servers, newSVsv(spec->addr));
+
+  split_address(aTHX_ spec->addr, &host, &host_len, &port, &port_len);
+  if (client_add_server(memd->c, host, host_len, port, port_len,
+                        spec->weight, spec->noreply) != MEMCACHED_SUCCESS)
+    croak("Not enough memory");
+}
+
+
+static
+void
+parse_server(pTHX_ SV *sv, struct server_spec *spec)
+{
+  spec->weight = 1.0;
+  spec->noreply = 0;
+
+  if (! SvROK(sv))
+    {
+      spec->addr = sv;
+    }
+  else
+    {
+      switch (SvTYPE(SvRV(sv)))
+        {
+        case SVt_PVHV:
+          {
+            HV *hv = (HV *) SvRV(sv);
+            SV **addr_sv, **ps;
+
+            addr_sv = hv_fetchs(hv, "address", 0);
+            if (addr_sv)
+              SvGETMAGIC(*addr_sv);
+            else
+              croak("server should have { address => $addr }");
+            ps = hv_fetchs(hv, "weight", 0);
+            if (ps)
+              SvGETMAGIC(*ps);
+            if (ps && SvOK(*ps))
+              spec->weight = SvNV(*ps);
+            ps = hv_fetchs(hv, "noreply", 0);
+            if (ps)
+              spec->noreply = SvTRUE(*ps);
+            spec->addr = *addr_sv;
+          }
+          break;
+
+        case SVt_PVAV:
+          {
+            AV *av = (AV *) SvRV(sv);
+            SV **addr_sv, **weight_sv;
+
+            addr_sv = av_fetch(av, 0, 0);
+            if (addr_sv)
+              SvGETMAGIC(*addr_sv);
+            else
+              croak("server should be [$addr, $weight]");
+            weight_sv = av_fetch(av, 1, 0);
+            if (weight_sv)
+              spec->weight = SvNV(*weight_sv);
+            spec->addr = *addr_sv;
+          }
+          break;
+
+        default:
+          croak("Not a hash or array reference");
+          break;
+        }
+    }
+
+  if (spec->weight <= 0.0)
+    croak("Server weight should be positive");
+}
+
+
+/*
+  Make the servers of the client those of the list, in its order.
+  Servers with the same address, weight and noreply keep their
+  connections, the rest are removed, and new ones are added.
+*/
+static
+void
+set_servers(pTHX_ Cache_Memcached_Fast *memd, AV *list)
+{
+  struct client *c = memd->c;
+  struct server_spec *specs;
+  int *order, *kept;
+  int count = 0, old_count, kept_count, max_index, reorder, i, j;
+  AV *servers;
+
+  max_index = av_len(list);
+  Newx(specs, max_index + 2, struct server_spec);
+  SAVEFREEPV(specs);
+  for (i = 0; i <= max_index; ++i)
+    {
+      SV **ps = av_fetch(list, i, 0);
+      if (! ps)
+        continue;
+
+      SvGETMAGIC(*ps);
+      parse_server(aTHX_ *ps, &specs[count++]);
+    }
+
+  /* order[j] is the current index of the server that goes to j.  */
+  Newx(order, count + 1, int);
+  SAVEFREEPV(order);
+  old_count = av_len(memd->servers) + 1;
+  Newxz(kept, old_count + 1, int);
+  SAVEFREEPV(kept);
+  for (j = 0; j < count; ++j)
+    {
+      const char *host, *port;
+      size_t host_len, port_len;
+
+      split_address(aTHX_ specs[j].addr, &host, &host_len, &port, &port_len);
+      /* The same server may be listed more than once.  */
+      i = -1;
+      do
+        i = client_find_server(c, i + 1, host, host_len, port, port_len,
+                               specs[j].weight, specs[j].noreply);
+      while (i != -1 && kept[i]);
+      if (i != -1)
+        kept[i] = 1;
+      order[j] = i;
+    }
+
+  /* Remove from the end, so that the indexes below stay the same.  */
+  kept_count = 0;
+  for (i = old_count - 1; i >= 0; --i)
+    {
+      if (kept[i])
+        {
+          ++kept_count;
+          continue;
+        }
+
+      if (client_remove_server(c, i) != MEMCACHED_SUCCESS)
+        croak("Not enough memory");
+      for (j = 0; j < count; ++j)
+        {
+          if (order[j] > i)
+            --order[j];
+        }
+    }
+
+  reorder = 0;
+  for (j = 0; j < count; ++j)
+    {
+      if (order[j] == -1)
+        {
+          const char *host, *port;
+          size_t host_len, port_len;
+
+          split_address(aTHX_ specs[j].addr,
+                        &host, &host_len, &port, &port_len);
+          if (client_add_server(c, host, host_len, port, port_len,
+                                specs[j].weight, specs[j].noreply)
+              != MEMCACHED_SUCCESS)
+            croak("Not enough memory");
+          order[j] = kept_count++;
+        }
+      if (order[j] != j)
+        reorder = 1;
+    }
+
+  if (reorder && client_reorder_servers(c, order) != MEMCACHED_SUCCESS)
+    croak("Not enough memory");
+
+  servers = newAV();
+  for (j = 0; j < count; ++j)
+    av_push(servers, newSVsv(specs[j].addr));
+  SvREFCNT_dec(memd->servers);
+  memd->servers = servers;
+}
+
+
+static
+void
+parse_serialize(pTHX_ Cache_Memcached_Fast *memd, HV *conf)
+{
+  SV **ps;
+
+  memd->utf8 = 0;
+  memd->lazy_deserialize = 0;
+  memd->serialize_method = NULL;
+  memd->deserialize_method = NULL;
+
+  ps = hv_fetchs(conf, "utf8", 0);
+  if (ps)
+    memd->utf8 = SvTRUE(*ps);
+
+  ps = hv_fetchs(conf, "lazy_deserialize", 0);
+  if (ps)
+    memd->lazy_deserialize = SvTRUE(*ps);
+
+  ps = hv_fetchs(conf, "serialize_methods", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      AV *av = (AV *) SvRV(*ps);
+      memd->serialize_method = newSVsv(*safe_av_fetch(aTHX_ av, 0, 0));
+      memd->deserialize_method = newSVsv(*safe_av_fetch(aTHX_ av, 1, 0));
+    }
+
+  if (! memd->serialize_method)
+    croak("Serialize method is not specified");
+
+  if (! memd->deserialize_method)
+    croak("Deserialize method is not specified");
+}
+
+
+static
+void
+parse_compress(pTHX_ Cache_Memcached_Fast *memd, HV *conf)
+{
+  SV **ps;
+
+  memd->compress_threshold = -1;
+  memd->compress_ratio = 0.8;
+  memd->compress_method = NULL;
+  memd->decompress_method = NULL;
+
+  ps = hv_fetchs(conf, "compress_threshold", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    memd->compress_threshold = SvIV(*ps);
+
+  ps = hv_fetchs(conf, "compress_ratio", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    memd->compress_ratio = SvNV(*ps);
+
+  ps = hv_fetchs(conf, "compress_methods", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      AV *av = (AV *) SvRV(*ps);
+      memd->compress_method = newSVsv(*safe_av_fetch(aTHX_ av, 0, 0));
+      memd->decompress_method = newSVsv(*safe_av_fetch(aTHX_ av, 1, 0));
+    }
+  else if (memd->compress_threshold > 0)
+    {
+      warn("Compression module was not found, disabling compression");
+      memd->compress_threshold = -1;
+    }
+}
+
+
+static
+void
+parse_config(pTHX_ Cache_Memcached_Fast *memd, HV *conf)
+{
+  struct client *c = memd->c;
+  double cache_ttl = 1.0;
+  SV **ps;
+
+  memd->servers = newAV();
+
+  ps = hv_fetchs(conf, "ketama_points", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      int res = client_set_ketama_points(c, SvIV(*ps));
+      if (res != MEMCACHED_SUCCESS)
+        croak("client_set_ketama() failed");
+    }
+
+  ps = hv_fetchs(conf, "dispatch_mode", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      const char *name = SvPV_nolen(*ps);
+      enum dispatch_mode_e mode;
+
+      if (strEQ(name, "ketama"))
+        mode = DISPATCH_KETAMA;
+      else if (strEQ(name, "jump"))
+        mode = DISPATCH_JUMP;
+      else if (strEQ(name, "rendezvous"))
+        mode = DISPATCH_RENDEZVOUS;
+      else if (strEQ(name, "maglev"))
+        mode = DISPATCH_MAGLEV;
+      else if (strEQ(name, "ketama_md5"))
+        mode = DISPATCH_KETAMA_MD5;
+      else
+        croak("Unknown dispatch_mode '%s'", name);
+
+      if (client_set_dispatch_mode(c, mode) != MEMCACHED_SUCCESS)
+        croak("client_set_dispatch_mode() failed");
+    }
+
+  ps = hv_fetchs(conf, "hash_function", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      const char *name = SvPV_nolen(*ps);
+      enum dispatch_hash_e hash_function;
+
+      if (strEQ(name, "crc32"))
+        hash_function = DISPATCH_HASH_CRC32;
+      else if (strEQ(name, "xxh64"))
+        hash_function = DISPATCH_HASH_XXH64;
+      else
+        croak("Unknown hash_function '%s'", name);
+
+      if (client_set_hash_function(c, hash_function) != MEMCACHED_SUCCESS)
+        croak("client_set_hash_function() failed");
+    }
+
+  ps = hv_fetchs(conf, "hash_namespace", 0);
+  if (ps)
+    client_set_hash_namespace(c, SvTRUE(*ps));
+
+  ps = hv_fetchs(conf, "hash_tags", 0);
+  if (ps)
+    client_set_hash_tags(c, SvTRUE(*ps));
+
+  ps = hv_fetchs(conf, "servers", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      AV *a;
+      struct server_spec spec;
+      int max_index, i;
+
+      if (! SvROK(*ps) || SvTYPE(SvRV(*ps)) != SVt_PVAV)
+        croak("Not an array reference");
+      a = (AV *) SvRV(*ps);
+      max_index = av_len(a);
+      for (i = 0; i <= max_index; ++i)
+        {
+          ps = av_fetch(a, i, 0);
+          if (! ps)
+            continue;
+
+          SvGETMAGIC(*ps);
+          parse_server(aTHX_ *ps, &spec);
+          add_server(aTHX_ memd, &spec);
+        }
+    }
+
+  ps = hv_fetchs(conf, "dispatch_snapshot", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      const char *path = SvPV_nolen(*ps);
+
+      if (client_set_dispatch_snapshot(c, path) != MEMCACHED_SUCCESS)
+        croak("Can't use dispatch snapshot '%s'", path);
+    }
+
+  ps = hv_fetchs(conf, "namespace", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      const char *ns;
+      STRLEN len;
+      ns = SvPV(*ps, len);
+      if (client_set_prefix(c, ns, len) != MEMCACHED_SUCCESS)
+        croak("Not enough memory");
+    }
+
+  ps = hv_fetchs(conf, "namespace_generation_key", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      const char *key;
+      STRLEN len;
+      double ttl = 1.0;
+
+      key = SvPV(*ps, len);
+
+      ps = hv_fetchs(conf, "namespace_generation_ttl", 0);
+      if (ps)
+        SvGETMAGIC(*ps);
+      if (ps && SvOK(*ps))
+        ttl = SvNV(*ps);
+
+      if (client_set_namespace_generation(c, key, len, ttl * 1000.0)
+          != MEMCACHED_SUCCESS)
+        croak("Not enough memory");
+    }
+
+  ps = hv_fetchs(conf, "connect_timeout", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    client_set_connect_timeout(c, SvNV(*ps) * 1000.0);
+
+  ps = hv_fetchs(conf, "io_timeout", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    client_set_io_timeout(c, SvNV(*ps) * 1000.0);
+
+  /* For compatibility with Cache::Memcached.  */
+  ps = hv_fetchs(conf, "select_timeout", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    client_set_io_timeout(c, SvNV(*ps) * 1000.0);
+
+  ps = hv_fetchs(conf, "max_failures", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    client_set_max_failures(c, SvIV(*ps));
+
+  ps = hv_fetchs(conf, "failure_timeout", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    client_set_failure_timeout(c, SvIV(*ps));
+
+  ps = hv_fetchs(conf, "close_on_error", 0);
+  if (ps)
+    client_set_close_on_error(c, SvTRUE(*ps));
+
+  ps = hv_fetchs(conf, "nowait", 0);
+  if (ps)
+    client_set_nowait(c, SvTRUE(*ps));
+
+  ps = hv_fetchs(conf, "max_size", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    memd->max_size = SvUV(*ps);
+  else
+    memd->max_size = 1024 * 1024;
+
+  ps = hv_fetchs(conf, "chunk_size", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    memd->chunk_size = SvUV(*ps);
+  else
+    memd->chunk_size = 0;
+  memd->chunk_seq = 0;
+
+  ps = hv_fetchs(conf, "compress_slab_aware", 0);
+  memd->compress_slab_aware = (ps && SvTRUE(*ps));
+  memd->slab_sizes = NULL;
+  memd->slab_count = 0;
+
+  ps = hv_fetchs(conf, "near_cache_ttl", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    cache_ttl = SvNV(*ps);
+
+  ps = hv_fetchs(conf, "near_cache_size", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      if (client_set_near_cache(c, SvUV(*ps), cache_ttl * 1000.0)
+          != MEMCACHED_SUCCESS)
+        croak("Not enough memory");
+    }
+
+  ps = hv_fetchs(conf, "shared_cache_size", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      size_t size = SvUV(*ps), item_size = 4096;
+
+      ps = hv_fetchs(conf, "shared_cache_item_size", 0);
+      if (ps)
+        SvGETMAGIC(*ps);
+      if (ps && SvOK(*ps))
+        item_size = SvUV(*ps);
+
+      if (client_set_shared_cache(c, size, item_size, cache_ttl * 1000.0)
+          != MEMCACHED_SUCCESS)
+        croak("Can't create shared cache");
+    }
+
+  ps = hv_fetchs(conf, "negative_cache_ttl", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      double ttl = SvNV(*ps);
+      size_t size = 64 * 1024;
+
+      ps = hv_fetchs(conf, "negative_cache_size", 0);
+      if (ps)
+        SvGETMAGIC(*ps);
+      if (ps && SvOK(*ps))
+        size = SvUV(*ps);
+
+      if (client_set_negative_cache(c, size, ttl * 1000.0)
+          != MEMCACHED_SUCCESS)
+        croak("Not enough memory");
+    }
+
+  ps = hv_fetchs(conf, "hot_keys", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      int capacity = SvIV(*ps), sample = 100;
+
+      ps = hv_fetchs(conf, "hot_keys_sample", 0);
+      if (ps)
+        SvGETMAGIC(*ps);
+      if (ps && SvOK(*ps))
+        sample = SvIV(*ps);
+
+      if (client_set_hot_keys(c, capacity, sample) != MEMCACHED_SUCCESS)
+        croak("Not enough memory");
+    }
+
+  ps = hv_fetchs(conf, "counter_buffer_size", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      size_t max_keys = SvUV(*ps);
+      double interval = 1.0;
+
+      ps = hv_fetchs(conf, "counter_flush_interval", 0);
+      if (ps)
+        SvGETMAGIC(*ps);
+      if (ps && SvOK(*ps))
+        interval = SvNV(*ps);
+
+      if (client_set_counter_buffer(c, max_keys, interval * 1000.0)
+          != MEMCACHED_SUCCESS)
+        croak("Not enough memory");
+    }
+
+  ps = hv_fetchs(conf, "replicas", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      if (client_set_replicas(c, SvIV(*ps)) != MEMCACHED_SUCCESS)
+        croak("replicas should be between 1 and 16");
+    }
+
+  ps = hv_fetchs(conf, "bounded_load", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      if (client_set_bounded_load(c, SvNV(*ps)) != MEMCACHED_SUCCESS)
+        croak("bounded_load should not be negative");
+    }
+
+  ps = hv_fetchs(conf, "replicated_keys", 0);
+  if (ps)
+    SvGETMAGIC(*ps);
+  if (ps && SvOK(*ps))
+    {
+      AV *av;
+      int i;
+
+      if (! SvROK(*ps) || SvTYPE(SvRV(*ps)) != SVt_PVAV)
+        croak("replicated_keys should be an array reference");
+
+      av = (AV *) SvRV(*ps);
+      for (i = 0; i <= av_len(av); ++i)
+        {
+          SV **pkey = av_fetch(av, i, 0);
+          const char *key;
+          STRLEN key_len;
+
+          if (! pkey)
+            continue;
+
+          key = SvPV(*pkey, key_len);
+          if (client_replicate_key(c, key, key_len, 1) != MEMCACHED_SUCCESS)
+            croak("Not enough memory");
+        }
+    }
+
+  parse_compress(aTHX_ memd, conf);
+  parse_serialize(aTHX_ memd, conf);
+}
+
+
+/*
+  Return the index of the smallest slab class that fits an item of
+  size bytes, or slab_count if the item is larger than all classes.
+*/
+static inline
+int
+slab_class(Cache_Memcached_Fast *memd, STRLEN size)
+{
+  int lo = 0, hi = memd->slab_count;
+
+  while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+
+      if (memd->slab_sizes[mid] < size)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+
+static inline
+SV *
+compress(pTHX_ Cache_Memcached_Fast *memd, SV *sv, flags_type *flags,
+         STRLEN key_len)
+{
+  if (memd->compress_threshold > 0)
+    {
+      STRLEN len = sv_len(sv);
+      SV *csv, *bsv;
+      int count, class = -1;
+      dSP;
+
+      if (len < (STRLEN) memd->compress_threshold)
+        return sv;
+
+      /*
+        With known slab classes compression is only worth it when it
+        moves the item to a smaller class.  Items larger than all
+        classes take memory in proportion to their size.
+      */
+      if (memd->slab_count > 0)
+        {
+          size_t ns_len;
+
+          client_get_prefix(memd->c, &ns_len);
+          key_len += ns_len + ITEM_OVERHEAD;
+
+          class = slab_class(memd, len + key_len);
+          if (class == 0)
+            return sv;
+          if (class == memd->slab_count)
+            class = -1;
+        }
+
+      /*
+        Character strings reach here in their internal UTF-8 form (see
+        serialize()), but compress method wants octets.
+      */
+      if (SvUTF8(sv))
+        {
+          sv = sv_2mortal(newSVsv(sv));
+          sv_utf8_encode(sv);
+        }
+
+      csv = newSV(0);
+
+      PUSHMARK(SP);
+      mXPUSHs(newRV_inc(sv));
+      mXPUSHs(newRV_noinc(csv));
+      PUTBACK;
+
+      count = call_sv(memd->compress_method, G_SCALAR);
+
+      SPAGAIN;
+
+      if (count != 1)
+        croak("Compress method returned nothing");
+
+      bsv = POPs;
+      if (SvTRUE(bsv) && sv_len(csv) <= len * memd->compress_ratio
+          && (class == -1 || slab_class(memd, sv_len(csv) + key_len) < class))
+        {
+          sv = csv;
+          *flags |= F_COMPRESS;
+        }
+
+      PUTBACK;
+    }
+
+  return sv;
+}
+
+
+static inline
+int
+decompress(pTHX_ SV *decompress_method, SV **sv, flags_type flags)
+{
+  int res = 1;
+
+  if (flags & F_COMPRESS)
+    {
+      SV *rsv, *bsv;
+      int count;
+      dSP;
+
+      rsv = newSV(0);
+
+      PUSHMARK(SP);
+      mXPUSHs(newRV_inc(*sv));
+      mXPUSHs(newRV_inc(rsv));
+      PUTBACK;
+
+      count = call_sv(decompress_method, G_SCALAR);
+
+      SPAGAIN;
+
+      if (count != 1)
+        croak("Decompress method returned nothing");
+
+      bsv = POPs;
+      if (SvTRUE(bsv))
+        {
+          SvREFCNT_dec(*sv);
+          *sv = rsv;
+        }
+      else
+        {
+          SvREFCNT_dec(rsv);
+          res = 0;
+        }
+
+      PUTBACK;
+    }
+
+  return res;
+}
+
+
+static inline
+SV *
+serialize(pTHX_ Cache_Memcached_Fast *memd, SV *sv, flags_type *flags)
+{
+  if (SvROK(sv))
+    {
+      int count;
+      dSP;
+
+      PUSHMARK(SP);
+      XPUSHs(sv);
+      PUTBACK;
+
+      count = call_sv(memd->serialize_method, G_SCALAR);
+
+      SPAGAIN;
+
+      if (count != 1)
+        croak("Serialize method returned nothing");
+
+      sv = POPs;
+      *flags |= F_STORABLE;
+
+      PUTBACK;
+    }
+  else if (SvUTF8(sv))
+    {
+      if (memd->utf8 && ! SvGAMAGIC(sv))
+        {
+          /*
+            Internal representation of a character string is UTF-8
+            already, and that is exactly what sv_utf8_encode() would
+            produce, so we store the buffer as is.
+          */
+          *flags |= F_UTF8;
+        }
+      else
+        {
+          /* Copy the value because we will modify it in place.  */
+          sv = sv_2mortal(newSVsv(sv));
+          if (memd->utf8)
+            {
+              sv_utf8_encode(sv);
+              *flags |= F_UTF8;
+            }
+          else
+            {
+              sv_utf8_downgrade(sv, 0);
+            }
+        }
+    }
+
+  return sv;
+}
+
+
+static inline
+int
+deserialize(pTHX_ SV *deserialize_method, int utf8, SV **sv,
+            flags_type flags)
+{
+  int res = 1;
+
+  if (flags & F_STORABLE)
+    {
+      SV *rsv;
+      int count;
+      dSP;
+
+      PUSHMARK(SP);
+      XPUSHs(*sv);
+      PUTBACK;
+
+      /* FIXME: do we need G_KEPEERR here?  */
+      count = call_sv(deserialize_method, G_SCALAR | G_EVAL);
+
+      SPAGAIN;
+
+      if (count != 1)
+        croak("Deserialize method returned nothing");
+
+      rsv = POPs;
+      if (! SvTRUE(ERRSV))
+        {
+          SvREFCNT_dec(*sv);
+          *sv = SvREFCNT_inc(rsv);
+        }
+      else
+        {
+          res = 0;
+        }
+
+      PUTBACK;
+    }
+  else if ((flags & F_UTF8) && utf8)
+    {
+      /*
+        utf8_valid() is faster than sv_utf8_decode(), but it is
+        strict, so anything it rejects is handed to the latter, which
+        also accepts Perl's extended UTF-8.
+      */
+      int valid = -1;
+
+      if (SvPOK(*sv) && ! SvUTF8(*sv))
+        valid = utf8_valid(SvPVX(*sv), SvCUR(*sv));
+
+      if (valid == 1)
+        SvUTF8_on(*sv);
+      else if (valid == -1)
+        res = sv_utf8_decode(*sv);
+    }
+   
+  return res;
+}
+
+
+/*
+  Lazy values keep the raw bytes in the SV itself, and the methods
+  needed to decode them in the attached magic.  The value is decoded
+  on the first read, so values that are never looked at are never
+  decompressed or deserialized.  We keep our own references to the
+  methods because the value may outlive the client object.
+*/
+struct lazy_value
+{
+  SV *decompress_method;
+  SV *deserialize_method;
+  int utf8;
+  int done;
+  flags_type flags;
+};
+
+
+static
+int
+lazy_value_get(pTHX_ SV *sv, MAGIC *mg)
+{
+  struct lazy_value *lv = (struct lazy_value *) mg->mg_ptr;
+  SV *value_sv;
+  dSP;
+
+  if (lv->done)
+    return 0;
+
+  lv->done = 1;
+
+  /*
+    We are called from the middle of some op, so the methods are
+    called on a separate stack, and $@ is preserved.
+  */
+  PUSHSTACKi(PERLSI_MAGIC);
+  ENTER;
+  SAVETMPS;
+  save_scalar(PL_errgv);
+
+  value_sv = newSVpvn(SvPVX(sv), SvCUR(sv));
+  if (decompress(aTHX_ lv->decompress_method, &value_sv, lv->flags)
+      && deserialize(aTHX_ lv->deserialize_method, lv->utf8, &value_sv,
+                     lv->flags))
+    sv_setsv(sv, value_sv);
+  else
+    sv_setsv(sv, &PL_sv_undef);
+
+  SvREFCNT_dec(value_sv);
+
+  FREETMPS;
+  LEAVE;
+  POPSTACK;
+
+  return 0;
+}
+
+
+static
+int
+lazy_value_set(pTHX_ SV *sv PERL_UNUSED_DECL, MAGIC *mg)
+{
+  struct lazy_value *lv = (struct lazy_value *) mg->mg_ptr;
+
+  /* The value was overwritten before it was ever read.  */
+  lv->done = 1;
+
+  return 0;
+}
+
+
+static
+int
+lazy_value_free(pTHX_ SV *sv PERL_UNUSED_DECL, MAGIC *mg)
+{
+  struct lazy_value *lv = (struct lazy_value *) mg->mg_ptr;
+
+  SvREFCNT_dec(lv->decompress_method);
+  SvREFCNT_dec(lv->deserialize_method);
+  Safefree(lv);
+
+  return 0;
+}
+
+
+#ifdef USE_ITHREADS
+
+static
+int
+lazy_value_dup(pTHX_ MAGIC *mg, CLONE_PARAMS *param)
+{
+  struct lazy_value *lv;
+
+  Newx(lv, 1, struct lazy_value);
+  *lv = *(struct lazy_value *) mg->mg_ptr;
+  lv->decompress_method = sv_dup_inc(lv->decompress_method, param);
+  lv->deserialize_method = sv_dup_inc(lv->deserialize_method, param);
+  mg->mg_ptr = (char *) lv;
+
+  return 0;
+}
+
+#endif /* USE_ITHREADS */
+
+
+static MGVTBL lazy_value_vtbl = {
+  lazy_value_get, lazy_value_set, NULL, NULL, lazy_value_free, NULL,
+#ifdef USE_ITHREADS
+  lazy_value_dup,
+#else
+  NULL,
+#endif
+  NULL
+};
+
+
+static
+void
+make_lazy(pTHX_ Cache_Memcached_Fast *memd, SV *sv, flags_type flags)
+{
+  struct lazy_value *lv;
+  MAGIC *mg;
+
+  if (! (flags & (F_COMPRESS | F_STORABLE))
+      && ! ((flags & F_UTF8) && memd->utf8))
+    return;
+
+  Newx(lv, 1, struct lazy_value);
+  lv->decompress_method = SvREFCNT_inc(memd->decompress_method);
+  lv->deserialize_method = SvREFCNT_inc(memd->deserialize_method);
+  lv->utf8 = memd->utf8;
+  lv->done = 0;
+  lv->flags = flags;
+
+  mg = sv_magicext(sv, NULL, PERL_MAGIC_ext, &lazy_value_vtbl,
+                   (const char *) lv, 0);
+  mg->mg_flags |= MGf_DUP;
+}
+
+
+static
+void *
+alloc_value(value_size_type value_size, void **opaque)
+{
+  dTHX;
+  SV *sv;
+  char *res;
+
+  sv = newSVpvs("");
+  res = SvGROW(sv, value_size + 1); /* FIXME: check OOM.  */
+  res[value_size] = '\0';
+  SvCUR_set(sv, value_size);
+
+  *opaque = sv;
+
+  return (void *) res;
+}
+
+
+static
+void
+free_value(void *opaque)
+{
+  dTHX;
+  SV *sv = (SV *) opaque;
+
+  SvREFCNT_dec(sv);
+}
+
+
+static
+int
+compare_size(const void *a, const void *b)
+{
+  size_t x = *(const size_t *) a, y = *(const size_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+
+static
+void
+server_stat_store(void *arg, void *opaque, int key_index,
+                  void *meta PERL_UNUSED_DECL)
+{
+  dTHX;
+  SV **stats = av_fetch((AV *) arg, key_index, 1);
+
+  if (! SvROK(*stats))
+    {
+      SV *rv = newRV_noinc((SV *) newAV());
+      sv_setsv(*stats, rv);
+      SvREFCNT_dec(rv);
+    }
+
+  av_push((AV *) SvRV(*stats), (SV *) opaque);
+}
+
+
+/*
+  Append chunk sizes of slab classes computed the same way memcached
+  does from the settings of one server to sizes, and return their
+  count, or 0 if the settings are incomplete.  The largest class is
+  slab_chunk_max, or item_size_max on servers that don't report it.
+*/
+static
+int
+slab_classes_from_settings(pTHX_ AV *settings, size_t *sizes)
+{
+  unsigned long chunk_size = 0, size_max = 0, chunk_max = 0, size;
+  double factor = 0.0;
+  int i, count = 0;
+
+  for (i = 0; i <= av_len(settings); ++i)
+    {
+      const char *stat = SvPV_nolen(*av_fetch(settings, i, 0));
+
+      if (sscanf(stat, "chunk_size %lu", &chunk_size) != 1
+          && sscanf(stat, "growth_factor %lf", &factor) != 1
+          && sscanf(stat, "item_size_max %lu", &size_max) != 1)
+        sscanf(stat, "slab_chunk_max %lu", &chunk_max);
+    }
+
+  if (chunk_max == 0)
+    chunk_max = size_max;
+  if (chunk_size == 0 || factor <= 1.0 || chunk_max == 0)
+    return 0;
+
+  size = ITEM_HEADER_SIZE + chunk_size;
+  while (count < SLAB_CLASSES_MAX - 1 && size < chunk_max / factor)
+    {
+      if (size % 8)
+        size += 8 - size % 8;
+      sizes[count++] = size;
+      size *= factor;
+    }
+  sizes[count++] = chunk_max;
+
+  return count;
+}
+
+
+/*
+  Build the table of slab classes from "stats settings" of all
+  servers.  "stats slabs" lists only the classes that have memory
+  allocated, so it can't tell which sizes share a class.  When no
+  server reports the settings the table is empty, and compression
+  follows compress_ratio alone.  Returns the number of classes.
+*/
+static
+int
+fetch_slab_classes(pTHX_ Cache_Memcached_Fast *memd)
+{
+  struct result_object object =
+    { alloc_value, server_stat_store, free_value, NULL };
+  AV *servers;
+  int i, count = 0;
+
+  servers = (AV *) sv_2mortal((SV *) newAV());
+  object.arg = servers;
+  client_server_stats(memd->c, "settings", 8, &object);
+
+  Renew(memd->slab_sizes, (av_len(servers) + 1) * SLAB_CLASSES_MAX, size_t);
+  for (i = 0; i <= av_len(servers); ++i)
+    {
+      SV **stats = av_fetch(servers, i, 0);
+
+      if (stats && SvROK(*stats))
+        count += slab_classes_from_settings(aTHX_ (AV *) SvRV(*stats),
+                                            memd->slab_sizes + count);
+    }
+
+  qsort(memd->slab_sizes, count, sizeof(size_t), compare_size);
+
+  /* Servers with the same settings have the same classes.  */
+  memd->slab_count = 0;
+  for (i = 0; i < count; ++i)
+    {
+      if (memd->slab_count == 0
+          || memd->slab_sizes[memd->slab_count - 1] != memd->slab_sizes[i])
+        memd->slab_sizes[memd->slab_count++] = memd->slab_sizes[i];
+    }
+
+  return memd->slab_count;
+}
+
+
+struct xs_value_result
+{
+  Cache_Memcached_Fast *memd;  
+  SV *vals;
+  AV *chunked;                  /* [key_index, manifest, cas] */
+};
+
+
+static
+SV *
+make_value(pTHX_ Cache_Memcached_Fast *memd, SV *value_sv,
+           struct meta_object *m, int lazy)
+{
+  if (lazy)
+    {
+      make_lazy(aTHX_ memd, value_sv, m->flags);
+    }
+  else if (! decompress(aTHX_ memd->decompress_method, &value_sv, m->flags)
+           || ! deserialize(aTHX_ memd->deserialize_method,
+                            memd->utf8, &value_sv, m->flags))
+    {
+      free_value(value_sv);
+      return NULL;
+    }
+
+  if (m->use_cas)
+    {
+      AV *cas_val = newAV();
+      av_extend(cas_val, 1);
+      av_push(cas_val, newSVuv(m->cas));
+      av_push(cas_val, value_sv);
+      value_sv = newRV_noinc((SV *) cas_val);
+    }
+
+  return value_sv;
+}
+
+
+/*
+  A manifest is "id flags length chunk_size count", where id is the
+  flags of every chunk, and flags are those of the whole value.
+*/
+struct chunk_manifest
+{
+  flags_type id;
+  flags_type flags;
+  unsigned long length;
+  unsigned long chunk_size;
+  unsigned long count;
+};
+
+
+/*
+  The manifest comes from the server, so it is checked against
+  max_size and against itself before anything is allocated for the
+  chunks.
+*/
+static
+int
+parse_manifest(pTHX_ Cache_Memcached_Fast *memd, SV *sv,
+               struct chunk_manifest *m)
+{
+  unsigned int id, flags;
+  const char *s;
+  STRLEN len;
+  int end = 0;
+
+  s = SvPV(sv, len);
+  if (len > MANIFEST_LEN_MAX
+      || sscanf(s, "%x %u %lu %lu %lu%n", &id, &flags, &m->length,
+                &m->chunk_size, &m->count, &end) != 5
+      || (STRLEN) end != len)
+    return 0;
+
+  if (m->chunk_size == 0 || m->length == 0 || m->length > memd->max_size
+      || m->count != (m->length - 1) / m->chunk_size + 1)
+    return 0;
+
+  m->id = id;
+  m->flags = flags;
+
+  return 1;
+}
+
+
+static inline
+unsigned long
+chunk_key_hash(const char *key, STRLEN key_len)
+{
+  return (unsigned long) (key_hash("", 0, key, key_len) & 0xffffffffUL);
+}
+
+
+/*
+  Chunk n of a value is stored under "{n:hash}key", hash being
+  chunk_key_hash() of the key.  The key keeps chunks of different keys
+  apart, and the leading tag makes every chunk a hash tag of its own,
+  so the chunks of a value spread over the servers with hash_tags too.
+  buf should have room for key_len + CHUNK_TAG_LEN_MAX + 1 bytes.
+*/
+static inline
+STRLEN
+make_chunk_key(char *buf, const char *key, STRLEN key_len,
+               unsigned long hash, unsigned long n)
+{
+  int len = sprintf(buf, "{%lu:%08lx}", n, hash);
+
+  memcpy(buf + len, key, key_len);
+
+  return len + key_len;
+}
+
+
+/*
+  Manifests of chunked values are put aside, the chunks are fetched
+  by fetch_chunks() after the request completes.
+*/
+static inline
+int
+defer_chunked(pTHX_ struct xs_value_result *value_res, SV *value_sv,
+              int key_index, struct meta_object *m)
+{
+  struct chunk_manifest manifest;
+  AV *entry;
+
+  /*
+    Other clients use the flag for their own formats, so only a client
+    with chunk_size takes a valid manifest for one.
+  */
+  if (! value_res->memd->chunk_size || ! (m->flags & F_CHUNKED)
+      || ! parse_manifest(aTHX_ value_res->memd, value_sv, &manifest))
+    return 0;
+
+  if (! value_res->chunked)
+    value_res->chunked = (AV *) sv_2mortal((SV *) newAV());
+
+  entry = newAV();
+  av_push(entry, newSViv(key_index));
+  av_push(entry, value_sv);
+  av_push(entry, m->use_cas ? newSVuv(m->cas) : newSV(0));
+  av_push(value_res->chunked, newRV_noinc((SV *) entry));
+
+  return 1;
+}
+
+
+static
+void
+svalue_store(void *arg, void *opaque, int key_index, void *meta)
+{
+  dTHX;
+  SV *value_sv = (SV *) opaque;
+  struct xs_value_result *value_res = (struct xs_value_result *) arg;
+  struct meta_object *m = (struct meta_object *) meta;
+
+  if (defer_chunked(aTHX_ value_res, value_sv, key_index, m))
+    return;
+
+  value_sv = make_value(aTHX_ value_res->memd, value_sv, m, 0);
+  if (value_sv)
+    value_res->vals = value_sv;
+}
+
+
+static
+void
+mvalue_store(void *arg, void *opaque, int key_index, void *meta)
+{
+  dTHX;
+  SV *value_sv = (SV *) opaque;
+  struct xs_value_result *value_res = (struct xs_value_result *) arg;
+  struct meta_object *m = (struct meta_object *) meta;
+
+  if (defer_chunked(aTHX_ value_res, value_sv, key_index, m))
+    return;
+
+  value_sv = make_value(aTHX_ value_res->memd, value_sv, m,
+                        value_res->memd->lazy_deserialize);
+  if (value_sv)
+    av_store((AV *) value_res->vals, key_index, value_sv);
+}
+
+
+static
+void
+result_store(void *arg, void *opaque, int key_index, void *meta PERL_UNUSED_DECL)
+{
+  dTHX;
+  AV *av = (AV *) arg;
+  int res = (ptrdiff_t) opaque;
+
+  av_store(av, key_index, res ? newSViv(res) : newSVpvs(""));
+}
+
+
+static
+void
+embedded_store(void *arg, void *opaque, int key_index, void *meta PERL_UNUSED_DECL)
+{
+  dTHX;
+  AV *av = (AV *) arg;
+  SV *sv = (SV *) opaque;
+
+  av_store(av, key_index, sv);
+}
+
+
+/*
+  When SvPV() is called on a magic SV the result of mg_get() is cached
+  in PV slot.  Since we pass around pointers to this storage we have
+  to avoid value refetch and reallocation that would happen if
+  mg_get() is called again.  Because any magic SV may be put to the
+  argument list more than once we create a temporal copies of them,
+  thus braking possible ties and ensuring that every argument is
+  fetched exactly once.
+*/
+static inline
+char *
+SvPV_stable_storage(pTHX_ SV *sv, STRLEN *lp)
+{
+  if (SvGAMAGIC(sv))
+    sv = sv_2mortal(newSVsv(sv));
+
+  return SvPV(sv, *lp);
+}
+
+
+/*
+  Fetch count keys from args and dispatch them as a batch, which is
+  faster than dispatching them one by one while preparing requests.
+  Should be called after client_reset().  The arrays are freed when
+  the XSUB returns.
+*/
+static
+void
+dispatch_stack_keys(pTHX_ Cache_Memcached_Fast *memd, SV **args, int count,
+                    const char ***keys, size_t **key_lens)
+{
+  int i;
+
+  *keys = NULL;
+  *key_lens = NULL;
+  if (count <= 0)
+    return;
+
+  Newx(*keys, count, const char *);
+  SAVEFREEPV(*keys);
+  Newx(*key_lens, count, size_t);
+  SAVEFREEPV(*key_lens);
+
+  for (i = 0; i < count; ++i)
+    {
+      STRLEN key_len;
+
+      (*keys)[i] = SvPV_stable_storage(aTHX_ args[i], &key_len);
+      (*key_lens)[i] = key_len;
+    }
+
+  client_dispatch_batch(memd->c, *keys, *key_lens, count);
+}
+
+
+/*
+  Build the prepared block for the keys of av into blob.  av is
+  private to the prepared object, so its elements are plain strings.
+*/
+static
+void
+prepare_keys(pTHX_ Cache_Memcached_Fast *memd, AV *av, SV *blob)
+{
+  int i, key_count = av_len(av) + 1;
+  const char **keys;
+  size_t *key_lens, size;
+  void *prepared;
+
+  Newx(keys, key_count > 0 ? key_count : 1, const char *);
+  SAVEFREEPV(keys);
+  Newx(key_lens, key_count > 0 ? key_count : 1, size_t);
+  SAVEFREEPV(key_lens);
+
+  for (i = 0; i < key_count; ++i)
+    {
+      STRLEN key_len;
+
+      keys[i] = SvPV(*safe_av_fetch(aTHX_ av, i, 0), key_len);
+      key_lens[i] = key_len;
+    }
+
+  prepared = client_prepare_keys(memd->c, keys, key_lens, key_count, &size);
+  if (! prepared)
+    croak("Not enough memory");
+
+  sv_setpvn(blob, (const char *) prepared, size);
+  free(prepared);
+}
+
+
+/*
+  Values larger than chunk_size are split into chunks stored under
+  keys made by make_chunk_key(), and the key holds the manifest with
+  F_CHUNKED flag.  Chunk keys don't depend on the value, so a new value
+  replaces the chunks of the old one.  The id in the manifest is the
+  flags of every chunk of the value, so a reader never mixes chunks of
+  different values.
+*/
+struct chunk_write
+{
+  int key_index;                /* Of the manifest.  */
+  const char *key;
+  STRLEN key_len;
+  const char *buf;
+  STRLEN buf_len;
+  exptime_type exptime;
+  flags_type id;
+  int first;                    /* key_index of the first chunk.  */
+  unsigned long count;
+};
+
+
+struct chunk_writes
+{
+  struct chunk_write *writes;
+  int count;
+  int next_index;               /* key_index of the next chunk.  */
+};
+
+
+/*
+  prepare_manifest() returns the manifest to be stored under the key,
+  or NULL when chunk keys would exceed the key length limit, and the
+  value is stored whole.  Chunks get key indexes after those of the
+  request, see prepare_chunks().
+*/
+static
+SV *
+prepare_manifest(pTHX_ Cache_Memcached_Fast *memd, struct chunk_writes *cw,
+                 int key_index, const char *key, STRLEN key_len,
+                 const char *buf, STRLEN buf_len,
+                 flags_type *flags, exptime_type exptime)
+{
+  struct chunk_write *w;
+  unsigned long count = (buf_len - 1) / memd->chunk_size + 1;
+  char tag[CHUNK_TAG_LEN_MAX + 1], id[64];
+  int id_len;
+  SV *manifest;
+
+  if (key_len + sprintf(tag, "{%lu:%08lx}", count - 1, 0UL)
+      > client_get_key_len_max(memd->c))
+    return NULL;
+
+  w = &cw->writes[cw->count++];
+  w->key_index = key_index;
+  w->key = key;
+  w->key_len = key_len;
+  w->buf = buf;
+  w->buf_len = buf_len;
+  w->exptime = exptime;
+  w->first = cw->next_index;
+  w->count = count;
+  cw->next_index += count;
+
+  id_len = sprintf(id, "%lx.%lx.%x", (unsigned long) time(NULL),
+                   (unsigned long) PerlProc_getpid(), ++memd->chunk_seq);
+  w->id = (flags_type) key_hash("", 0, id, id_len);
+
+  manifest = sv_2mortal(newSVpvf("%x %u %lu %lu %lu", (unsigned int) w->id,
+                                 (unsigned int) *flags,
+                                 (unsigned long) buf_len,
+                                 (unsigned long) memd->chunk_size, count));
+  *flags = F_CHUNKED;
+
+  return manifest;
+}
+
+
+/*
+  Prepare the chunks of the values in cw.  With results only the
+  values whose manifest was stored get their chunks, as add, replace
+  and cas store the manifest first.  Chunk keys must stay valid until
+  the request is executed.
+*/
+static
+void
+prepare_chunks(pTHX_ Cache_Memcached_Fast *memd, struct chunk_writes *cw,
+               AV *results)
+{
+  int i;
+
+  for (i = 0; i < cw->count; ++i)
+    {
+      struct chunk_write *w = &cw->writes[i];
+      unsigned long hash, j;
+      char *p;
+
+      if (results)
+        {
+          SV **res = av_fetch(results, w->key_index, 0);
+          if (! res || ! SvTRUE(*res))
+            continue;
+        }
+
+      hash = chunk_key_hash(w->key, w->key_len);
+      p = SvPVX(sv_2mortal(newSV(w->count
+                                 * (w->key_len + CHUNK_TAG_LEN_MAX) + 1)));
+      for (j = 0; j < w->count; ++j)
+        {
+          STRLEN offset = j * memd->chunk_size;
+          STRLEN size = w->buf_len - offset;
+          STRLEN len;
+
+          if (size > memd->chunk_size)
+            size = memd->chunk_size;
+
+          len = make_chunk_key(p, w->key, w->key_len, hash, j);
+          client_prepare_set(memd->c, CMD_SET, w->first + j, p, len, w->id,
+                             w->exptime, w->buf + offset, size);
+          p += len;
+        }
+    }
+}
+
+
+/*
+  A value is stored only when all its chunks are, otherwise it gets
+  the result of the failed chunk.  Results of the chunks are dropped.
+*/
+static
+void
+merge_chunk_results(pTHX_ struct chunk_writes *cw, AV *results,
+                    int key_count)
+{
+  int i;
+
+  for (i = 0; i < cw->count; ++i)
+    {
+      struct chunk_write *w = &cw->writes[i];
+      SV **res = av_fetch(results, w->key_index, 0);
+      unsigned long j;
+
+      if (! res || ! SvTRUE(*res))
+        continue;
+
+      for (j = 0; j < w->count; ++j)
+        {
+          SV **chunk_res = av_fetch(results, w->first + j, 0);
+
+          if (chunk_res && SvTRUE(*chunk_res))
+            continue;
+
+          if (chunk_res)
+            av_store(results, w->key_index, SvREFCNT_inc(*chunk_res));
+          else
+            av_delete(results, w->key_index, G_DISCARD);
+          break;
+        }
+    }
+
+  if (av_len(results) >= key_count)
+    av_fill(results, key_count - 1);
+}
+
+
+struct chunk_target
+{
+  int value;                    /* Index in chunk_result.values.  */
+  STRLEN offset;
+  STRLEN size;
+};
+
+
+struct chunked_value
+{
+  SV *value;
+  flags_type id;
+  unsigned long missing;
+};
+
+
+struct chunk_result
+{
+  struct chunk_target *targets;
+  struct chunked_value *values;
+};
+
+
+static
+void
+chunk_store(void *arg, void *opaque, int key_index, void *meta)
+{
+  dTHX;
+  struct chunk_result *res = (struct chunk_result *) arg;
+  struct chunk_target *t = &res->targets[key_index];
+  struct chunked_value *v = &res->values[t->value];
+  struct meta_object *m = (struct meta_object *) meta;
+  SV *sv = (SV *) opaque;
+
+  /* A chunk of another value has another id.  */
+  if (SvCUR(sv) == t->size && m->flags == v->id)
+    {
+      Copy(SvPVX(sv), SvPVX(v->value) + t->offset, t->size, char);
+      --v->missing;
+    }
+
+  SvREFCNT_dec(sv);
+}
+
+
+/*
+  Fetch the chunks of all deferred manifests in one request, and
+  reassemble each value in a preallocated SV.  Values with a missing
+  chunk are treated as missing.  keys[key_index] is the key of the
+  manifest.  With exptime the chunks are fetched with gat.
+*/
+static
+void
+fetch_chunks(pTHX_ struct xs_value_result *value_res, SV **keys, int multi,
+             const char *exptime, STRLEN exptime_len)
+{
+  Cache_Memcached_Fast *memd = value_res->memd;
+  struct result_object object = { alloc_value, chunk_store, free_value, NULL };
+  struct chunk_result res;
+  int value_count = av_len(value_res->chunked) + 1, chunk_count = 0, i;
+  STRLEN *key_offsets = NULL;
+  SV *chunk_keys;
+
+  Newxz(res.values, value_count, struct chunked_value);
+  SAVEFREEPV(res.values);
+
+  chunk_keys = sv_2mortal(newSVpvs(""));
+
+  /* First build all chunk keys, as the buffer may be reallocated.  */
+  res.targets = NULL;
+  for (i = 0; i < value_count; ++i)
+    {
+      AV *entry = (AV *) SvRV(*av_fetch(value_res->chunked, i, 0));
+      SV *manifest = *av_fetch(entry, 1, 0);
+      int key_index = SvIV(*av_fetch(entry, 0, 0));
+      struct chunk_manifest m;
+      unsigned long hash, j;
+      char *p;
+      const char *key;
+      STRLEN key_len;
+
+      if (! parse_manifest(aTHX_ memd, manifest, &m))
+        continue;
+
+      res.values[i].value = newSV(m.length + 1);
+      sv_2mortal(res.values[i].value);
+      SvPOK_only(res.values[i].value);
+      SvCUR_set(res.values[i].value, m.length);
+      SvPVX(res.values[i].value)[m.length] = '\0';
+      res.values[i].id = m.id;
+      res.values[i].missing = m.count;
+
+      key = SvPV(keys[key_index], key_len);
+      hash = chunk_key_hash(key, key_len);
+
+      Renew(res.targets, chunk_count + m.count, struct chunk_target);
+      Renew(key_offsets, chunk_count + m.count + 1, STRLEN);
+      for (j = 0; j < m.count; ++j)
+        {
+          struct chunk_target *t = &res.targets[chunk_count];
+
+          t->value = i;
+          t->offset = j * m.chunk_size;
+          t->size = (m.length - t->offset < m.chunk_size
+                     ? m.length - t->offset : m.chunk_size);
+
+          key_offsets[chunk_count] = SvCUR(chunk_keys);
+          p = SvGROW(chunk_keys, SvCUR(chunk_keys)
+                     + key_len + CHUNK_TAG_LEN_MAX + 1);
+          SvCUR_set(chunk_keys, SvCUR(chunk_keys)
+                    + make_chunk_key(p + SvCUR(chunk_keys), key, key_len,
+                                     hash, j));
+          ++chunk_count;
+        }
+      key_offsets[chunk_count] = SvCUR(chunk_keys);
+    }
+  SAVEFREEPV(res.targets);
+  SAVEFREEPV(key_offsets);
+
+  if (chunk_count > 0)
+    {
+      char *beg = SvPVX(chunk_keys);
+
+      object.arg = &res;
+      client_reset(memd->c, &object, 0);
+      for (i = 0; i < chunk_count; ++i)
+        {
+          const char *key = beg + key_offsets[i];
+          STRLEN key_len = key_offsets[i + 1] - key_offsets[i];
+
+          if (exptime)
+            client_prepare_gat(memd->c, CMD_GAT, i, key, key_len,
+                               exptime, exptime_len);
+          else
+            client_prepare_get(memd->c, CMD_GET, i, key, key_len);
+        }
+      client_execute(memd->c, exptime ? 4 : 2);
+    }
+
+  for (i = 0; i < value_count; ++i)
+    {
+      AV *entry = (AV *) SvRV(*av_fetch(value_res->chunked, i, 0));
+      SV *cas = *av_fetch(entry, 2, 0);
+      struct chunk_manifest manifest;
+      struct meta_object m;
+      SV *value_sv;
+
+      if (! res.values[i].value || res.values[i].missing != 0)
+        continue;
+
+      parse_manifest(aTHX_ memd, *av_fetch(entry, 1, 0), &manifest);
+      m.flags = manifest.flags;
+      m.use_cas = SvOK(cas);
+      m.cas = (m.use_cas ? SvUV(cas) : 0);
+
+      value_sv = make_value(aTHX_ memd, SvREFCNT_inc(res.values[i].value),
+                            &m, multi && memd->lazy_deserialize);
+      if (! value_sv)
+        continue;
+
+      if (multi)
+        av_store((AV *) value_res->vals, SvIV(*av_fetch(entry, 0, 0)),
+                 value_sv);
+      else
+        value_res->vals = value_sv;
+    }
+}
+
+
+static
+void
+manifest_store(void *arg, void *opaque, int key_index, void *meta)
+{
+  dTHX;
+  struct meta_object *m = (struct meta_object *) meta;
+  SV *sv = (SV *) opaque;
+
+  if (m->flags & F_CHUNKED)
+    av_store((AV *) arg, key_index, sv);
+  else
+    SvREFCNT_dec(sv);
+}
+
+
+/*
+  With chunk_size delete removes the chunks of the values too.  The
+  manifests are read with an extra request first, and
+  prepare_delete_chunks() adds deletes of their chunks to the delete
+  request.
+*/
+static
+AV *
+fetch_manifests(pTHX_ Cache_Memcached_Fast *memd,
+                const char *const *keys, const size_t *key_lens, int count)
+{
+  struct result_object object =
+    { alloc_value, manifest_store, free_value, NULL };
+  AV *manifests = (AV *) sv_2mortal((SV *) newAV());
+  int i;
+
+  object.arg = manifests;
+  client_reset(memd->c, &object, 0);
+  for (i = 0; i < count; ++i)
+    client_prepare_get(memd->c, CMD_GET, i, keys[i], key_lens[i]);
+  client_execute(memd->c, 2);
+
+  return manifests;
+}
+
+
+static
+void
+prepare_delete_chunks(pTHX_ Cache_Memcached_Fast *memd, AV *manifests,
+                      const char *const *keys, const size_t *key_lens)
+{
+  int i;
+
+  for (i = 0; i <= av_len(manifests); ++i)
+    {
+      SV **sv = av_fetch(manifests, i, 0);
+      struct chunk_manifest m;
+      unsigned long hash, j;
+      char *p;
+
+      if (! sv || ! parse_manifest(aTHX_ memd, *sv, &m))
+        continue;
+
+      hash = chunk_key_hash(keys[i], key_lens[i]);
+      p = SvPVX(sv_2mortal(newSV(m.count
+                                 * (key_lens[i] + CHUNK_TAG_LEN_MAX) + 1)));
+      for (j = 0; j < m.count; ++j)
+        {
+          STRLEN len = make_chunk_key(p, keys[i], key_lens[i], hash, j);
+
+          client_prepare_delete(memd->c, -1, p, len);
+          p += len;
+        }
+    }
+}
+
+
+#line 1974 "Fast.c"
+#ifndef PERL_UNUSED_VAR
+#  define PERL_UNUSED_VAR(var) if (0) var = var
+#endif
+
+#ifndef dVAR
+#  define dVAR		dNOOP
+#endif
+
+
+/* This stuff is not part of the API! You have been warned. */
+#ifndef PERL_VERSION_DECIMAL
+#  define PERL_VERSION_DECIMAL(r,v,s) (r*1000000 + v*1000 + s)
+#endif
+#ifndef PERL_DECIMAL_VERSION
+#  define PERL_DECIMAL_VERSION \
+	  PERL_VERSION_DECIMAL(PERL_REVISION,PERL_VERSION,PERL_SUBVERSION)
+#endif
+#ifndef PERL_VERSION_GE
+#  define PERL_VERSION_GE(r,v,s) \
+	  (PERL_DECIMAL_VERSION >= PERL_VERSION_DECIMAL(r,v,s))
+#endif
+#ifndef PERL_VERSION_LE
+#  define PERL_VERSION_LE(r,v,s) \
+	  (PERL_DECIMAL_VERSION <= PERL_VERSION_DECIMAL(r,v,s))
+#endif
+
+/* XS_INTERNAL is the explicit static-linkage variant of the default
+ * XS macro.
+ *
+ * XS_EXTERNAL is the same as XS_INTERNAL except it does not include
+ * "STATIC", ie. it exports XSUB symbols. You probably don't want that
+ * for anything but the BOOT XSUB.
+ *
+ * See XSUB.h in core!
+ */
+
+
+/* TODO: This might be compatible further back than 5.10.0. */
+#if PERL_VERSION_GE(5, 10, 0) && PERL_VERSION_LE(5, 15, 1)
+#  undef XS_EXTERNAL
+#  undef XS_INTERNAL
+#  if defined(__CYGWIN__) && defined(USE_DYNAMIC_LOADING)
+#    define XS_EXTERNAL(name) __declspec(dllexport) XSPROTO(name)
+#    define XS_INTERNAL(name) STATIC XSPROTO(name)
+#  endif
+#  if defined(__SYMBIAN32__)
+#    define XS_EXTERNAL(name) EXPORT_C XSPROTO(name)
+#    define XS_INTERNAL(name) EXPORT_C STATIC XSPROTO(name)
+#  endif
+#  ifndef XS_EXTERNAL
+#    if defined(HASATTRIBUTE_UNUSED) && !defined(__cplusplus)
+#      define XS_EXTERNAL(name) void name(pTHX_ CV* cv __attribute__unused__)
+#      define XS_INTERNAL(name) STATIC void name(pTHX_ CV* cv __attribute__unused__)
+#    else
+#      ifdef __cplusplus
+#        define XS_EXTERNAL(name) extern "C" XSPROTO(name)
+#        define XS_INTERNAL(name) static XSPROTO(name)
+#      else
+#        define XS_EXTERNAL(name) XSPROTO(name)
+#        define XS_INTERNAL(name) STATIC XSPROTO(name)
+#      endif
+#    endif
+#  endif
+#endif
+
+/* perl >= 5.10.0 && perl <= 5.15.1 */
+
+
+/* The XS_EXTERNAL macro is used for functions that must not be static
+ * like the boot XSUB of a module. If perl didn't have an XS_EXTERNAL
+ * macro defined, the best we can do is assume XS is the same.
+ * Dito for XS_INTERNAL.
+ */
+#ifndef XS_EXTERNAL
+#  define XS_EXTERNAL(name) XS(name)
+#endif
+#ifndef XS_INTERNAL
+#  define XS_INTERNAL(name) XS(name)
+#endif
+
+/* Now, finally, after all this mess, we want an ExtUtils::ParseXS
+ * internal macro that we're free to redefine for varying linkage due
+ * to the EXPORT_XSUB_SYMBOLS XS keyword. This is internal, use
+ * XS_EXTERNAL(name) or XS_INTERNAL(name) in your code if you need to!
+ */
+
+#undef XS_EUPXS
+#if defined(PERL_EUPXS_ALWAYS_EXPORT)
+#  define XS_EUPXS(name) XS_EXTERNAL(name)
+#else
+   /* default to internal */
+#  define XS_EUPXS(name) XS_INTERNAL(name)
+#endif
+
+#ifndef PERL_ARGS_ASSERT_CROAK_XS_USAGE
+#define PERL_ARGS_ASSERT_CROAK_XS_USAGE assert(cv); assert(params)
+
+/* prototype to pass -Wmissing-prototypes */
+STATIC void
+S_croak_xs_usage(const CV *const cv, const char *const params);
+
+STATIC void
+S_croak_xs_usage(const CV *const cv, const char *const params)
+{
+    const GV *const gv = CvGV(cv);
+
+    PERL_ARGS_ASSERT_CROAK_XS_USAGE;
+
+    if (gv) {
+        const char *const gvname = GvNAME(gv);
+        const HV *const stash = GvSTASH(gv);
+        const char *const hvname = stash ? HvNAME(stash) : NULL;
+
+        if (hvname)
+	    Perl_croak_nocontext("Usage: %s::%s(%s)", hvname, gvname, params);
+        else
+	    Perl_croak_nocontext("Usage: %s(%s)", gvname, params);
+    } else {
+        /* Pants. I don't think that it should be possible to get here. */
+	Perl_croak_nocontext("Usage: CODE(0x%" UVxf ")(%s)", PTR2UV(cv), params);
+    }
+}
+#undef  PERL_ARGS_ASSERT_CROAK_XS_USAGE
+
+#define croak_xs_usage        S_croak_xs_usage
+
+#endif
+
+/* NOTE: the prototype of newXSproto() is different in versions of perls,
+ * so we define a portable version of newXSproto()
+ */
+#ifdef newXS_flags
+#define newXSproto_portable(name, c_impl, file, proto) newXS_flags(name, c_impl, file, proto, 0)
+#else
+#define newXSproto_portable(name, c_impl, file, proto) (PL_Sv=(SV*)newXS(name, c_impl, file), sv_setpv(PL_Sv, proto), (CV*)PL_Sv)
+#endif /* !defined(newXS_flags) */
+
+#if PERL_VERSION_LE(5, 21, 5)
+#  define newXS_deffile(a,b) Perl_newXS(aTHX_ a,b,file)
+#else
+#  define newXS_deffile(a,b) Perl_newXS_deffile(aTHX_ a,b)
+#endif
+
+#line 2118 "Fast.c"
+
+XS_EUPXS(XS_Cache__Memcached__Fast__new); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast__new)
+{
+    dVAR; dXSARGS;
+    if (items != 2)
+       croak_xs_usage(cv,  "class, conf");
+    {
+#line 1985 "Fast.xs"
+        Cache_Memcached_Fast *memd;
+#line 2129 "Fast.c"
+	Cache_Memcached_Fast *	RETVAL;
+	char *	class = (char *)SvPV_nolen(ST(0))
+;
+	SV *	conf = ST(1)
+;
+#line 1987 "Fast.xs"
+        Newx(memd, 1, Cache_Memcached_Fast);
+        memd->c = client_init();
+        if (! memd->c)
+          croak("Not enough memory");
+        if (! SvROK(conf) || SvTYPE(SvRV(conf)) != SVt_PVHV)
+          croak("Not a hash reference");
+        parse_config(aTHX_ memd, (HV *) SvRV(conf));
+        RETVAL = memd;
+#line 2144 "Fast.c"
+	{
+	    SV * RETVALSV;
+	    RETVALSV = sv_newmortal();
+  sv_setref_pv(RETVALSV, class, (void *) RETVAL);
+	    ST(0) = RETVALSV;
+	}
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast__destroy); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast__destroy)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2003 "Fast.xs"
+        client_destroy(memd->c);
+        Safefree(memd->slab_sizes);
+        if (memd->compress_method)
+          {
+            SvREFCNT_dec(memd->compress_method);
+            SvREFCNT_dec(memd->decompress_method);
+          }
+        if (memd->serialize_method)
+          {
+            SvREFCNT_dec(memd->serialize_method);
+            SvREFCNT_dec(memd->deserialize_method);
+          }
+        SvREFCNT_dec(memd->servers);
+        Safefree(memd);
+#line 2180 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast__weaken); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast__weaken)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "sv");
+    {
+	SV *	sv = ST(0)
+;
+#line 2023 "Fast.xs"
+        sv_rvweaken(sv);
+#line 2197 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast__set_servers); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast__set_servers)
+{
+    dVAR; dXSARGS;
+    if (items != 2)
+       croak_xs_usage(cv,  "memd, servers");
+    {
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+	AV *	servers;
+
+	STMT_START {
+		SV* const xsub_tmp_sv = ST(1);
+		SvGETMAGIC(xsub_tmp_sv);
+		if (SvROK(xsub_tmp_sv) && SvTYPE(SvRV(xsub_tmp_sv)) == SVt_PVAV){
+		    servers = (AV*)SvRV(xsub_tmp_sv);
+		}
+		else{
+		    Perl_croak_nocontext("%s: %s is not an ARRAY reference",
+				"Cache::Memcached::Fast::_set_servers",
+				"servers");
+		}
+	} STMT_END
+;
+#line 2030 "Fast.xs"
+        set_servers(aTHX_ memd, servers);
+#line 2229 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_servers_for_keys); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_servers_for_keys)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items != 2)
+       croak_xs_usage(cv,  "memd, keys_ref");
+    {
+#line 2039 "Fast.xs"
+        AV *av;
+        int i, key_count;
+        const char **keys;
+        size_t *key_lens;
+        int *servers;
+#line 2249 "Fast.c"
+	SV *	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+	SV *	keys_ref = ST(1)
+;
+#line 2045 "Fast.xs"
+        SvGETMAGIC(keys_ref);
+        if (! (SvROK(keys_ref) && SvTYPE(SvRV(keys_ref)) == SVt_PVAV))
+          croak("Not an array reference");
+        av = (AV *) SvRV(keys_ref);
+        key_count = av_len(av) + 1;
+        Newx(keys, key_count, const char *);
+        SAVEFREEPV(keys);
+        Newx(key_lens, key_count, size_t);
+        SAVEFREEPV(key_lens);
+        Newx(servers, key_count, int);
+        SAVEFREEPV(servers);
+        for (i = 0; i < key_count; ++i)
+          {
+            STRLEN key_len;
+
+            keys[i] = SvPV_stable_storage(aTHX_ *safe_av_fetch(aTHX_ av, i, 0),
+                                          &key_len);
+            key_lens[i] = key_len;
+          }
+        client_dispatch_keys(memd->c, keys, key_lens, key_count, servers);
+        if (ix == 0)
+          {
+            AV *res = newAV();
+
+            av_extend(res, key_count - 1);
+            for (i = 0; i < key_count; ++i)
+              {
+                if (servers[i] != -1)
+                  av_push(res, newSViv(servers[i]));
+                else
+                  av_push(res, newSV(0));
+              }
+            RETVAL = newRV_noinc((SV *) res);
+          }
+        else
+          {
+            HV *res = newHV();
+
+            for (i = 0; i < key_count; ++i)
+              {
+                SV **server;
+                HE *he;
+                AV *group;
+
+                if (servers[i] == -1)
+                  continue;
+
+                server = av_fetch(memd->servers, servers[i], 0);
+                if (! server)
+                  continue;
+
+                he = hv_fetch_ent(res, *server, 0, 0);
+                if (he)
+                  {
+                    group = (AV *) SvRV(HeVAL(he));
+                  }
+                else
+                  {
+                    group = newAV();
+                    hv_store_ent(res, *server, newRV_noinc((SV *) group), 0);
+                  }
+                av_push(group, newSVsv(*av_fetch(av, i, 0)));
+              }
+            RETVAL = newRV_noinc((SV *) res);
+          }
+#line 2321 "Fast.c"
+	RETVAL = sv_2mortal(RETVAL);
+	ST(0) = RETVAL;
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_enable_compress); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_enable_compress)
+{
+    dVAR; dXSARGS;
+    if (items != 2)
+       croak_xs_usage(cv,  "memd, enable");
+    {
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+	bool	enable = (bool)SvTRUE(ST(1))
+;
+#line 2118 "Fast.xs"
+        if (enable && ! memd->compress_method)
+          warn("Compression module was not found, can't enable compression");
+        else if ((memd->compress_threshold > 0) != enable)
+          memd->compress_threshold = -memd->compress_threshold;
+#line 2345 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_set); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_set)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2134 "Fast.xs"
+        int noreply;
+        struct result_object object =
+            { NULL, result_store, NULL, NULL };
+        const char *key;
+        STRLEN key_len;
+        cas_type cas = 0;
+        const void *buf;
+        STRLEN buf_len;
+        flags_type flags = 0;
+        exptime_type exptime = 0;
+        int arg = 1;
+        SV *sv;
+        struct chunk_write write;
+        struct chunk_writes cw = { &write, 0, 1 };
+#line 2376 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2149 "Fast.xs"
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        key = SvPV_stable_storage(aTHX_ ST(arg), &key_len);
+        ++arg;
+        if (ix == CMD_CAS)
+          {
+            cas = SvUV(ST(arg));
+            ++arg;
+          }
+        sv = ST(arg);
+        ++arg;
+        sv = serialize(aTHX_ memd, sv, &flags);
+        sv = compress(aTHX_ memd, sv, &flags, key_len);
+        buf = (void *) SvPV_stable_storage(aTHX_ sv, &buf_len);
+        if (buf_len > memd->max_size)
+          XSRETURN_EMPTY;
+        if (items > arg)
+          {
+            /* exptime doesn't have to be defined.  */
+            sv = ST(arg);
+            SvGETMAGIC(sv);
+            if (SvOK(sv))
+              exptime = SvIV(sv);
+          }
+        if (memd->chunk_size && buf_len > memd->chunk_size
+            && ix != CMD_APPEND && ix != CMD_PREPEND)
+          {
+            sv = prepare_manifest(aTHX_ memd, &cw, 0, key, key_len,
+                                  buf, buf_len, &flags, exptime);
+            if (sv)
+              buf = SvPV(sv, buf_len);
+          }
+        /* Conditional commands need the reply before the chunks.  */
+        client_reset(memd->c, &object,
+                     noreply && (cw.count == 0 || ix == CMD_SET));
+        if (ix == CMD_SET)
+          prepare_chunks(aTHX_ memd, &cw, NULL);
+        if (ix != CMD_CAS)
+          {
+            client_prepare_set(memd->c, ix, 0, key, key_len, flags,
+                               exptime, buf, buf_len);
+          }
+        else
+          {
+            client_prepare_cas(memd->c, 0, key, key_len, cas, flags,
+                               exptime, buf, buf_len);
+          }
+        client_execute(memd->c, 2);
+        if (cw.count > 0 && ix != CMD_SET)
+          {
+            client_reset(memd->c, &object, noreply);
+            prepare_chunks(aTHX_ memd, &cw, object.arg);
+            client_execute(memd->c, 2);
+          }
+        merge_chunk_results(aTHX_ &cw, object.arg, 1);
+        if (! noreply)
+          {
+            SV **val = av_fetch(object.arg, 0, 0);
+            if (val)
+              {
+                PUSHs(*val);
+                XSRETURN(1);
+              }
+            XSRETURN_EMPTY;
+          }
+#line 2446 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_set_multi); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_set_multi)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2227 "Fast.xs"
+        int i, noreply;
+        struct result_object object =
+            { NULL, result_store, NULL, NULL };
+        struct chunk_writes cw = { NULL, 0, 0 };
+#line 2468 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2232 "Fast.xs"
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        if (memd->chunk_size)
+          {
+            Newx(cw.writes, items, struct chunk_write);
+            SAVEFREEPV(cw.writes);
+            cw.next_index = items - 1;
+          }
+        /* Conditional commands need the replies before the chunks.  */
+        client_reset(memd->c, &object,
+                     noreply && (! memd->chunk_size || ix == CMD_SET
+                                 || ix == CMD_APPEND || ix == CMD_PREPEND));
+        for (i = 1; i < items; ++i)
+          {
+            SV *sv;
+            AV *av;
+            const char *key;
+            STRLEN key_len;
+            /*
+              gcc-3.4.2 gives a warning about possibly uninitialized
+              cas, so we set it to zero.
+            */
+            cas_type cas = 0;
+            const void *buf;
+            STRLEN buf_len;
+            flags_type flags = 0;
+            exptime_type exptime = 0;
+            int arg = 0;
+
+            sv = ST(i);
+            if (! (SvROK(sv) && SvTYPE(SvRV(sv)) == SVt_PVAV))
+              croak("Not an array reference");
+
+            av = (AV *) SvRV(sv);
+            key = SvPV_stable_storage(aTHX_ *safe_av_fetch(aTHX_ av, arg, 0), &key_len);
+            ++arg;
+            if (ix == CMD_CAS)
+              {
+                cas = SvUV(*safe_av_fetch(aTHX_ av, arg, 0));
+                ++arg;
+              }
+            sv = *safe_av_fetch(aTHX_ av, arg, 0);
+            ++arg;
+            sv = serialize(aTHX_ memd, sv, &flags);
+            sv = compress(aTHX_ memd, sv, &flags, key_len);
+            buf = (void *) SvPV_stable_storage(aTHX_ sv, &buf_len);
+            if (buf_len > memd->max_size)
+              continue;
+            if (av_len(av) >= arg)
+              {
+                /* exptime doesn't have to be defined.  */
+                SV **ps = av_fetch(av, arg, 0);
+                if (ps)
+                  SvGETMAGIC(*ps);
+                if (ps && SvOK(*ps))
+                  exptime = SvIV(*ps);
+              }
+
+            if (memd->chunk_size && buf_len > memd->chunk_size
+                && ix != CMD_APPEND && ix != CMD_PREPEND)
+              {
+                sv = prepare_manifest(aTHX_ memd, &cw, i - 1, key, key_len,
+                                      buf, buf_len, &flags, exptime);
+                if (sv)
+                  buf = SvPV(sv, buf_len);
+              }
+
+            if (ix != CMD_CAS)
+              {
+                client_prepare_set(memd->c, ix, i - 1, key, key_len, flags,
+                                   exptime, buf, buf_len);
+              }
+            else
+              {
+                client_prepare_cas(memd->c, i - 1, key, key_len, cas, flags,
+                                   exptime, buf, buf_len);
+              }
+          }
+        if (ix == CMD_SET)
+          prepare_chunks(aTHX_ memd, &cw, NULL);
+        client_execute(memd->c, 2);
+        if (cw.count > 0 && ix != CMD_SET)
+          {
+            client_reset(memd->c, &object, noreply);
+            prepare_chunks(aTHX_ memd, &cw, object.arg);
+            client_execute(memd->c, 2);
+          }
+        merge_chunk_results(aTHX_ &cw, object.arg, items - 1);
+        if (! noreply)
+          {
+            if (GIMME_V == G_SCALAR)
+              {
+                HV *hv = newHV();
+                for (i = 0; i <= av_len(object.arg); ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val && SvOK(*val))
+                      {
+                        SV *key = *av_fetch((AV *) SvRV(ST(i + 1)), 0, 0);
+                        HE *he = hv_store_ent(hv, key,
+                                              SvREFCNT_inc(*val), 0);
+                        if (! he)
+                          SvREFCNT_dec(*val);
+                      }
+                  }
+                mPUSHs(newRV_noinc((SV *) hv));
+                XSRETURN(1);
+              }
+            else
+              {
+                I32 max_index = av_len(object.arg);
+                EXTEND(SP, max_index + 1);
+                for (i = 0; i <= max_index; ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val)
+                      PUSHs(*val);
+                    else
+                      PUSHs(&PL_sv_undef);
+                  }
+                XSRETURN(max_index + 1);
+              }
+          }
+#line 2596 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_get); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_get)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2364 "Fast.xs"
+        struct xs_value_result value_res;
+        struct result_object object =
+            { alloc_value, svalue_store, free_value, &value_res };
+        const char *key;
+        STRLEN key_len;
+#line 2619 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2370 "Fast.xs"
+        value_res.memd = memd;
+        value_res.vals = NULL;
+        value_res.chunked = NULL;
+        client_reset(memd->c, &object, 0);
+        key = SvPV(ST(1), key_len);
+        client_prepare_get(memd->c, ix, 0, key, key_len);
+        client_execute(memd->c, 2);
+        if (value_res.chunked)
+          fetch_chunks(aTHX_ &value_res, &ST(1), 0, NULL, 0);
+        if (value_res.vals)
+          {
+            mPUSHs(value_res.vals);
+            XSRETURN(1);
+          }
+        XSRETURN_EMPTY;
+#line 2638 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_get_multi); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_get_multi)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2393 "Fast.xs"
+        struct xs_value_result value_res;
+        struct result_object object =
+            { alloc_value, mvalue_store, free_value, &value_res };
+        int i, key_count;
+        const char **keys;
+        size_t *key_lens;
+        HV *hv;
+#line 2663 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2401 "Fast.xs"
+        key_count = items - 1;
+        value_res.memd = memd;
+        value_res.chunked = NULL;
+        value_res.vals = (SV *) newAV();
+        sv_2mortal(value_res.vals);
+        av_extend((AV *) value_res.vals, key_count - 1);
+        client_reset(memd->c, &object, 0);
+        dispatch_stack_keys(aTHX_ memd, &ST(1), key_count, &keys, &key_lens);
+        for (i = 0; i < key_count; ++i)
+          client_prepare_get(memd->c, ix, i, keys[i], key_lens[i]);
+        client_execute(memd->c, 2);
+        if (value_res.chunked)
+          fetch_chunks(aTHX_ &value_res, &ST(1), 1, NULL, 0);
+        hv = newHV();
+        for (i = 0; i <= av_len((AV *) value_res.vals); ++i)
+          {
+            SV **val = av_fetch((AV *) value_res.vals, i, 0);
+            if (val && SvOK(*val))
+              {
+                SV *key = ST(i + 1);
+                HE *he = hv_store_ent(hv, key,
+                                      SvREFCNT_inc(*val), 0);
+                if (! he)
+                  SvREFCNT_dec(*val);
+              }
+          }
+        mPUSHs(newRV_noinc((SV *) hv));
+        XSRETURN(1);
+#line 2695 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast__prepare_keys); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast__prepare_keys)
+{
+    dVAR; dXSARGS;
+    if (items != 3)
+       croak_xs_usage(cv,  "memd, keys, blob");
+    {
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+	AV *	keys;
+	SV *	blob = ST(2)
+;
+
+	STMT_START {
+		SV* const xsub_tmp_sv = ST(1);
+		SvGETMAGIC(xsub_tmp_sv);
+		if (SvROK(xsub_tmp_sv) && SvTYPE(SvRV(xsub_tmp_sv)) == SVt_PVAV){
+		    keys = (AV*)SvRV(xsub_tmp_sv);
+		}
+		else{
+		    Perl_croak_nocontext("%s: %s is not an ARRAY reference",
+				"Cache::Memcached::Fast::_prepare_keys",
+				"keys");
+		}
+	} STMT_END
+;
+#line 2435 "Fast.xs"
+        prepare_keys(aTHX_ memd, keys, blob);
+#line 2730 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast__get_prepared); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast__get_prepared)
+{
+    dVAR; dXSARGS;
+    if (items != 3)
+       croak_xs_usage(cv,  "memd, keys, blob");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2442 "Fast.xs"
+        struct xs_value_result value_res;
+        struct result_object object =
+            { alloc_value, mvalue_store, free_value, &value_res };
+        int i;
+        HV *hv;
+#line 2751 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+	AV *	keys;
+	SV *	blob = ST(2)
+;
+
+	STMT_START {
+		SV* const xsub_tmp_sv = ST(1);
+		SvGETMAGIC(xsub_tmp_sv);
+		if (SvROK(xsub_tmp_sv) && SvTYPE(SvRV(xsub_tmp_sv)) == SVt_PVAV){
+		    keys = (AV*)SvRV(xsub_tmp_sv);
+		}
+		else{
+		    Perl_croak_nocontext("%s: %s is not an ARRAY reference",
+				"Cache::Memcached::Fast::_get_prepared",
+				"keys");
+		}
+	} STMT_END
+;
+#line 2448 "Fast.xs"
+        value_res.memd = memd;
+        value_res.chunked = NULL;
+        value_res.vals = (SV *) newAV();
+        sv_2mortal(value_res.vals);
+        av_extend((AV *) value_res.vals, av_len(keys));
+        client_reset(memd->c, &object, 0);
+        /* Made for other servers, namespace or thread.  */
+        if (! SvPOK(blob)
+            || ! client_prepared_keys_valid(memd->c, SvPVX(blob), SvCUR(blob)))
+          prepare_keys(aTHX_ memd, keys, blob);
+        client_prepare_get_keys(memd->c, SvPVX(blob));
+        client_execute(memd->c, 2);
+        if (value_res.chunked)
+          fetch_chunks(aTHX_ &value_res, AvARRAY(keys), 1, NULL, 0);
+        hv = newHV();
+        for (i = 0; i <= av_len((AV *) value_res.vals); ++i)
+          {
+            SV **val = av_fetch((AV *) value_res.vals, i, 0);
+            if (val && SvOK(*val))
+              {
+                SV *key = AvARRAY(keys)[i];
+                HE *he = hv_store_ent(hv, key,
+                                      SvREFCNT_inc(*val), 0);
+                if (! he)
+                  SvREFCNT_dec(*val);
+              }
+          }
+        mPUSHs(newRV_noinc((SV *) hv));
+        XSRETURN(1);
+#line 2801 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_gat); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_gat)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2485 "Fast.xs"
+        struct xs_value_result value_res;
+        struct result_object object =
+            { alloc_value, svalue_store, free_value, &value_res };
+        const char *key;
+        STRLEN key_len;
+        const char *exptime = "0";
+        STRLEN exptime_len = 1;
+        SV *sv;
+#line 2827 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2494 "Fast.xs"
+        value_res.memd = memd;
+        value_res.vals = NULL;
+        value_res.chunked = NULL;
+        client_reset(memd->c, &object, 0);
+        sv = ST(1);
+        SvGETMAGIC(sv);
+        if (SvOK(sv))
+          exptime = SvPV(sv, exptime_len);
+        key = SvPV(ST(2), key_len);
+        client_prepare_gat(memd->c, ix, 0, key, key_len, exptime, exptime_len);
+        client_execute(memd->c, 4);
+        if (value_res.chunked)
+          fetch_chunks(aTHX_ &value_res, &ST(2), 0, exptime, exptime_len);
+        if (value_res.vals)
+          {
+            mPUSHs(value_res.vals);
+            XSRETURN(1);
+          }
+        XSRETURN_EMPTY;
+#line 2850 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_gat_multi); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_gat_multi)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2520 "Fast.xs"
+        struct xs_value_result value_res;
+        struct result_object object =
+            { alloc_value, mvalue_store, free_value, &value_res };
+        int i, key_count;
+        const char **keys;
+        size_t *key_lens;
+        HV *hv;
+        SV *sv;
+        const char *exptime = "0";
+        STRLEN exptime_len = 1;
+#line 2878 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2531 "Fast.xs"
+        key_count = items - 2;
+        value_res.memd = memd;
+        value_res.chunked = NULL;
+        value_res.vals = (SV *) newAV();
+        sv_2mortal(value_res.vals);
+        if (key_count > 1)
+          av_extend((AV *) value_res.vals, key_count - 1);
+        client_reset(memd->c, &object, 0);
+        sv = ST(1);
+        SvGETMAGIC(sv);
+        if (SvOK(sv))
+          exptime = SvPV(sv, exptime_len);
+        dispatch_stack_keys(aTHX_ memd, &ST(2), key_count, &keys, &key_lens);
+        for (i = 0; i < key_count; ++i)
+          client_prepare_gat(memd->c, ix, i, keys[i], key_lens[i],
+                             exptime, exptime_len);
+        client_execute(memd->c, 4);
+        if (value_res.chunked)
+          fetch_chunks(aTHX_ &value_res, &ST(2), 1, exptime, exptime_len);
+        hv = newHV();
+        for (i = 0; i <= av_len((AV *) value_res.vals); ++i)
+          {
+            SV **val = av_fetch((AV *) value_res.vals, i, 0);
+            if (val && SvOK(*val))
+              {
+                SV *key = ST(i + 2);
+                HE *he = hv_store_ent(hv, key,
+                                      SvREFCNT_inc(*val), 0);
+                if (! he)
+                  SvREFCNT_dec(*val);
+              }
+          }
+        mPUSHs(newRV_noinc((SV *) hv));
+        XSRETURN(1);
+#line 2916 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_incr); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_incr)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2573 "Fast.xs"
+        struct result_object object =
+            { alloc_value, embedded_store, NULL, NULL };
+        int noreply;
+        const char *key;
+        STRLEN key_len;
+        arith_type arg = 1;
+#line 2940 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2580 "Fast.xs"
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        client_reset(memd->c, &object, noreply);
+        key = SvPV_stable_storage(aTHX_ ST(1), &key_len);
+        if (items > 2)
+          {
+            /* increment doesn't have to be defined.  */
+            SV *sv = ST(2);
+            SvGETMAGIC(sv);
+            if (SvOK(sv))
+              arg = SvUV(sv);
+          }
+        if (! noreply
+            || client_buffer_incr(memd->c, ix, key, key_len, arg)
+               != MEMCACHED_SUCCESS)
+          client_prepare_incr(memd->c, ix, 0, key, key_len, arg);
+        client_execute(memd->c, 2);
+        if (! noreply)
+          {
+            SV **val = av_fetch(object.arg, 0, 0);
+            if (val)
+              {
+                PUSHs(*val);
+                XSRETURN(1);
+              }
+            XSRETURN_EMPTY;
+          }
+#line 2972 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_incr_multi); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_incr_multi)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2616 "Fast.xs"
+        struct result_object object =
+            { alloc_value, embedded_store, NULL, NULL };
+        int i, noreply;
+#line 2993 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2620 "Fast.xs"
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        client_reset(memd->c, &object, noreply);
+        for (i = 1; i < items; ++i)
+          {
+            SV *sv;
+            AV *av;
+            const char *key;
+            STRLEN key_len;
+            arith_type arg = 1;
+
+            sv = ST(i);
+            if (! SvROK(sv))
+              {
+                key = SvPV_stable_storage(aTHX_ sv, &key_len);
+              }
+            else
+              {
+                if (SvTYPE(SvRV(sv)) != SVt_PVAV)
+                  croak("Not an array reference");
+
+                av = (AV *) SvRV(sv);
+                key = SvPV_stable_storage(aTHX_ *safe_av_fetch(aTHX_ av, 0, 0), &key_len);
+                if (av_len(av) >= 1)
+                  {
+                    /* increment doesn't have to be defined.  */
+                    SV **ps = av_fetch(av, 1, 0);
+                    if (ps)
+                      SvGETMAGIC(*ps);
+                    if (ps && SvOK(*ps))
+                      arg = SvUV(*ps);
+                  }
+              }
+
+            if (! noreply
+                || client_buffer_incr(memd->c, ix, key, key_len, arg)
+                   != MEMCACHED_SUCCESS)
+              client_prepare_incr(memd->c, ix, i - 1, key, key_len, arg);
+          }
+        client_execute(memd->c, 2);
+        if (! noreply)
+          {
+            if (GIMME_V == G_SCALAR)
+              {
+                HV *hv = newHV();
+                for (i = 0; i <= av_len(object.arg); ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val && SvOK(*val))
+                      {
+                        SV *key;
+                        HE *he;
+
+                        key = ST(i + 1);
+                        if (SvROK(key))
+                          key = *av_fetch((AV *) SvRV(key), 0, 0);
+
+                        he = hv_store_ent(hv, key, SvREFCNT_inc(*val), 0);
+                        if (! he)
+                          SvREFCNT_dec(*val);
+                      }
+                  }
+                mPUSHs(newRV_noinc((SV *) hv));
+                XSRETURN(1);
+              }
+            else
+              {
+                I32 max_index = av_len(object.arg);
+                EXTEND(SP, max_index + 1);
+                for (i = 0; i <= max_index; ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val)
+                      PUSHs(*val);
+                    else
+                      PUSHs(&PL_sv_undef);
+                  }
+                XSRETURN(max_index + 1);
+              }
+          }
+#line 3078 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_delete); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_delete)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2709 "Fast.xs"
+        struct result_object object =
+            { NULL, result_store, NULL, NULL };
+        int noreply;
+        const char *key;
+        STRLEN key_len;
+        size_t len;
+        AV *manifests = NULL;
+#line 3103 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2717 "Fast.xs"
+        PERL_UNUSED_ARG(ix);
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        key = SvPV_stable_storage(aTHX_ ST(1), &key_len);
+        if (items > 2)
+          {
+            /* Compatibility with old (key, delay) syntax.  */
+
+            /* delay doesn't have to be defined.  */
+            SV *sv = ST(2);
+            SvGETMAGIC(sv);
+            if (SvOK(sv) && SvUV(sv) != 0)
+              warn("non-zero delete expiration time is ignored");
+          }
+        len = key_len;
+        if (memd->chunk_size)
+          manifests = fetch_manifests(aTHX_ memd, &key, &len, 1);
+        client_reset(memd->c, &object, noreply);
+        client_prepare_delete(memd->c, 0, key, key_len);
+        if (manifests)
+          prepare_delete_chunks(aTHX_ memd, manifests, &key, &len);
+        client_execute(memd->c, 2);
+        if (! noreply)
+          {
+            SV **val = av_fetch(object.arg, 0, 0);
+            if (val)
+              {
+                PUSHs(*val);
+                XSRETURN(1);
+              }
+            XSRETURN_EMPTY;
+          }
+#line 3140 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_delete_multi); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_delete_multi)
+{
+    dVAR; dXSARGS;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2756 "Fast.xs"
+        struct result_object object =
+            { NULL, result_store, NULL, NULL };
+        int i, noreply;
+        const char **keys;
+        size_t *key_lens;
+        AV *manifests = NULL;
+#line 3163 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2763 "Fast.xs"
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        Newx(keys, items, const char *);
+        SAVEFREEPV(keys);
+        Newx(key_lens, items, size_t);
+        SAVEFREEPV(key_lens);
+        for (i = 1; i < items; ++i)
+          {
+            SV *sv;
+            const char *key;
+            STRLEN key_len;
+
+            sv = ST(i);
+            if (! SvROK(sv))
+              {
+                key = SvPV_stable_storage(aTHX_ sv, &key_len);
+              }
+            else
+              {
+                /* Compatibility with old [key, delay] syntax.  */
+
+                AV *av;
+
+                if (SvTYPE(SvRV(sv)) != SVt_PVAV)
+                  croak("Not an array reference");
+
+                av = (AV *) SvRV(sv);
+                key = SvPV_stable_storage(aTHX_ *safe_av_fetch(aTHX_ av, 0, 0), &key_len);
+                if (av_len(av) >= 1)
+                  {
+                    /* delay doesn't have to be defined.  */
+                    SV **ps = av_fetch(av, 1, 0);
+                    if (ps)
+                      SvGETMAGIC(*ps);
+                    if (ps && SvOK(*ps) && SvUV(*ps) != 0)
+                      warn("non-zero delete expiration time is ignored");
+                  }
+              }
+
+            keys[i - 1] = key;
+            key_lens[i - 1] = key_len;
+          }
+        if (memd->chunk_size)
+          manifests = fetch_manifests(aTHX_ memd, keys, key_lens, items - 1);
+        client_reset(memd->c, &object, noreply);
+        client_dispatch_batch(memd->c, keys, key_lens, items - 1);
+        for (i = 0; i < items - 1; ++i)
+          client_prepare_delete(memd->c, i, keys[i], key_lens[i]);
+        if (manifests)
+          prepare_delete_chunks(aTHX_ memd, manifests, keys, key_lens);
+        client_execute(memd->c, 2);
+        if (! noreply)
+          {
+            if (GIMME_V == G_SCALAR)
+              {
+                HV *hv = newHV();
+                for (i = 0; i <= av_len(object.arg); ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val && SvOK(*val))
+                      {
+                        SV *key;
+                        HE *he;
+
+                        key = ST(i + 1);
+                        if (SvROK(key))
+                          key = *av_fetch((AV *) SvRV(key), 0, 0);
+
+                        he = hv_store_ent(hv, key, SvREFCNT_inc(*val), 0);
+                        if (! he)
+                          SvREFCNT_dec(*val);
+                      }
+                  }
+                mPUSHs(newRV_noinc((SV *) hv));
+                XSRETURN(1);
+              }
+            else
+              {
+                I32 max_index = av_len(object.arg);
+                EXTEND(SP, max_index + 1);
+                for (i = 0; i <= max_index; ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val)
+                      PUSHs(*val);
+                    else
+                      PUSHs(&PL_sv_undef);
+                  }
+                XSRETURN(max_index + 1);
+              }
+          }
+#line 3259 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_touch); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_touch)
+{
+    dVAR; dXSARGS;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2861 "Fast.xs"
+        struct result_object object =
+            { NULL, result_store, NULL, NULL };
+        int noreply;
+        const char *key;
+        STRLEN key_len;
+        exptime_type exptime = 0;
+        SV *sv;
+#line 3283 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2869 "Fast.xs"
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        client_reset(memd->c, &object, noreply);
+        key = SvPV_stable_storage(aTHX_ ST(1), &key_len);
+        if (items > 2)
+          {
+            /* exptime doesn't have to be defined.  */
+            sv = ST(2);
+            SvGETMAGIC(sv);
+            if (SvOK(sv))
+              exptime = SvIV(sv);
+          }
+        client_prepare_touch(memd->c, 0, key, key_len, exptime);
+        client_execute(memd->c, 2);
+        if (! noreply)
+          {
+            SV **val = av_fetch(object.arg, 0, 0);
+            if (val)
+              {
+                PUSHs(*val);
+                XSRETURN(1);
+              }
+            XSRETURN_EMPTY;
+          }
+#line 3312 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_touch_multi); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_touch_multi)
+{
+    dVAR; dXSARGS;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    PERL_UNUSED_VAR(ax); /* -Wall */
+    SP -= items;
+    {
+#line 2900 "Fast.xs"
+        struct result_object object =
+            { NULL, result_store, NULL, NULL };
+        int i, noreply;
+        const char **keys;
+        size_t *key_lens;
+        exptime_type *exptimes;
+#line 3335 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 2907 "Fast.xs"
+        object.arg = newAV();
+        sv_2mortal((SV *) object.arg);
+        noreply = (GIMME_V == G_VOID);
+        Newx(keys, items, const char *);
+        SAVEFREEPV(keys);
+        Newx(key_lens, items, size_t);
+        SAVEFREEPV(key_lens);
+        Newx(exptimes, items, exptime_type);
+        SAVEFREEPV(exptimes);
+        for (i = 1; i < items; ++i)
+          {
+            SV *sv;
+            AV *av;
+            const char *key;
+            STRLEN key_len;
+            exptime_type exptime = 0;
+            int arg = 0;
+
+            sv = ST(i);
+            if (! (SvROK(sv) && SvTYPE(SvRV(sv)) == SVt_PVAV))
+              croak("Not an array reference");
+
+            av = (AV *) SvRV(sv);
+            key = SvPV_stable_storage(aTHX_ *safe_av_fetch(aTHX_ av, arg, 0), &key_len);
+            ++arg;
+
+            if (av_len(av) >= 1)
+              {
+                /* exptime doesn't have to be defined.  */
+                SV **ps = av_fetch(av, arg, 0);
+                if (ps)
+                  SvGETMAGIC(*ps);
+                if (ps && SvOK(*ps))
+                  exptime = SvIV(*ps);
+              }
+
+            keys[i - 1] = key;
+            key_lens[i - 1] = key_len;
+            exptimes[i - 1] = exptime;
+          }
+        client_reset(memd->c, &object, noreply);
+        client_dispatch_batch(memd->c, keys, key_lens, items - 1);
+        for (i = 0; i < items - 1; ++i)
+          client_prepare_touch(memd->c, i, keys[i], key_lens[i], exptimes[i]);
+        client_execute(memd->c, 2);
+        if (! noreply)
+          {
+            if (GIMME_V == G_SCALAR)
+              {
+                HV *hv = newHV();
+                for (i = 0; i <= av_len(object.arg); ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val && SvOK(*val))
+                      {
+                        SV *key;
+                        HE *he;
+
+                        key = ST(i + 1);
+                        if (SvROK(key))
+                          key = *av_fetch((AV *) SvRV(key), 0, 0);
+
+                        he = hv_store_ent(hv, key, SvREFCNT_inc(*val), 0);
+                        if (! he)
+                          SvREFCNT_dec(*val);
+                      }
+                  }
+                mPUSHs(newRV_noinc((SV *) hv));
+                XSRETURN(1);
+              }
+            else
+              {
+                I32 max_index = av_len(object.arg);
+                EXTEND(SP, max_index + 1);
+                for (i = 0; i <= max_index; ++i)
+                  {
+                    SV **val = av_fetch(object.arg, i, 0);
+                    if (val)
+                      PUSHs(*val);
+                    else
+                      PUSHs(&PL_sv_undef);
+                  }
+                XSRETURN(max_index + 1);
+              }
+          }
+#line 3424 "Fast.c"
+	PUTBACK;
+	return;
+    }
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_flush_all); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_flush_all)
+{
+    dVAR; dXSARGS;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    {
+#line 2998 "Fast.xs"
+        delay_type delay = 0;
+        struct result_object object =
+            { NULL, result_store, NULL, NULL };
+        int noreply;
+#line 3443 "Fast.c"
+	HV *	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3003 "Fast.xs"
+        RETVAL = newHV();
+        /* Why sv_2mortal() is needed is explained in perlxs.  */
+        sv_2mortal((SV *) RETVAL);
+        object.arg = sv_2mortal((SV *) newAV());
+        if (items > 1)
+          {
+            SV *sv = ST(1);
+            SvGETMAGIC(sv);
+            if (SvOK(sv))
+              delay = SvUV(sv);
+          }
+        noreply = (GIMME_V == G_VOID);
+        client_flush_all(memd->c, delay, &object, noreply);
+        if (! noreply)
+          {
+            int i;
+            for (i = 0; i <= av_len(object.arg); ++i)
+              {
+                SV **server = av_fetch(memd->servers, i, 0);
+                SV **version = av_fetch(object.arg, i, 0);
+                if (version && SvOK(*version))
+                  {
+                    HE *he = hv_store_ent(RETVAL, *server,
+                                          SvREFCNT_inc(*version), 0);
+                    if (! he)
+                      SvREFCNT_dec(*version);
+                  }
+              }
+          }
+#line 3477 "Fast.c"
+	{
+	    SV * RETVALSV;
+	    RETVALSV = newRV((SV*)RETVAL);
+	    RETVALSV = sv_2mortal(RETVALSV);
+	    ST(0) = RETVALSV;
+	}
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_nowait_push); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_nowait_push)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3040 "Fast.xs"
+        client_flush_counters(memd->c);
+        client_nowait_push(memd->c);
+#line 3501 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_invalidate_namespace); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_invalidate_namespace)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+	bool	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3048 "Fast.xs"
+        RETVAL = (client_bump_namespace_generation(memd->c)
+                  == MEMCACHED_SUCCESS);
+#line 3520 "Fast.c"
+	ST(0) = boolSV(RETVAL);
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_flush_counters); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_flush_counters)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3058 "Fast.xs"
+        client_flush_counters(memd->c);
+#line 3538 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_update_slab_classes); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_update_slab_classes)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+	bool	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3065 "Fast.xs"
+        RETVAL = (memd->compress_slab_aware
+                  && fetch_slab_classes(aTHX_ memd) > 0);
+#line 3557 "Fast.c"
+	ST(0) = boolSV(RETVAL);
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_server_versions); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_server_versions)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+#line 3075 "Fast.xs"
+        struct result_object object =
+            { alloc_value, embedded_store, NULL, NULL };
+        int i;
+#line 3575 "Fast.c"
+	HV *	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3079 "Fast.xs"
+        RETVAL = newHV();
+        /* Why sv_2mortal() is needed is explained in perlxs.  */
+        sv_2mortal((SV *) RETVAL);
+        object.arg = sv_2mortal((SV *) newAV());
+        client_server_versions(memd->c, &object);
+        for (i = 0; i <= av_len(object.arg); ++i)
+          {
+            SV **server = av_fetch(memd->servers, i, 0);
+            SV **version = av_fetch(object.arg, i, 0);
+            if (version && SvOK(*version))
+              {
+                HE *he = hv_store_ent(RETVAL, *server,
+                                      SvREFCNT_inc(*version), 0);
+                if (! he)
+                  SvREFCNT_dec(*version);
+              }
+          }
+#line 3597 "Fast.c"
+	{
+	    SV * RETVALSV;
+	    RETVALSV = newRV((SV*)RETVAL);
+	    RETVALSV = sv_2mortal(RETVALSV);
+	    ST(0) = RETVALSV;
+	}
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_namespace); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_namespace)
+{
+    dVAR; dXSARGS;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    {
+#line 3104 "Fast.xs"
+        const char *ns;
+        size_t len;
+#line 3619 "Fast.c"
+	SV *	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3107 "Fast.xs"
+        ns = client_get_prefix(memd->c, &len);
+        RETVAL = newSVpv(ns, len);
+        if (items > 1)
+          {
+            ns = SvPV(ST(1), len);
+            if (client_set_prefix(memd->c, ns, len) != MEMCACHED_SUCCESS)
+              croak("Not enough memory");
+          }
+#line 3632 "Fast.c"
+	RETVAL = sv_2mortal(RETVAL);
+	ST(0) = RETVAL;
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_near_cache_stats); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_near_cache_stats)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+#line 3123 "Fast.xs"
+        struct near_cache_stats stats;
+        struct shared_cache_stats shared;
+        struct negative_cache_stats negative;
+#line 3651 "Fast.c"
+	HV *	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3127 "Fast.xs"
+        RETVAL = newHV();
+        /* Why sv_2mortal() is needed is explained in perlxs.  */
+        sv_2mortal((SV *) RETVAL);
+        client_get_near_cache_stats(memd->c, &stats);
+        hv_stores(RETVAL, "hits", newSVuv(stats.hits));
+        hv_stores(RETVAL, "misses", newSVuv(stats.misses));
+        hv_stores(RETVAL, "evictions", newSVuv(stats.evictions));
+        hv_stores(RETVAL, "entries", newSVuv(stats.entries));
+        hv_stores(RETVAL, "bytes", newSVuv(stats.bytes));
+        client_get_shared_cache_stats(memd->c, &shared);
+        hv_stores(RETVAL, "shared_hits", newSVuv(shared.hits));
+        hv_stores(RETVAL, "shared_misses", newSVuv(shared.misses));
+        hv_stores(RETVAL, "shared_stores", newSVuv(shared.stores));
+        hv_stores(RETVAL, "shared_evictions", newSVuv(shared.evictions));
+        client_get_negative_cache_stats(memd->c, &negative);
+        hv_stores(RETVAL, "negative_hits", newSVuv(negative.hits));
+        hv_stores(RETVAL, "negative_stores", newSVuv(negative.stores));
+#line 3673 "Fast.c"
+	{
+	    SV * RETVALSV;
+	    RETVALSV = newRV((SV*)RETVAL);
+	    RETVALSV = sv_2mortal(RETVALSV);
+	    ST(0) = RETVALSV;
+	}
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_hot_keys); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_hot_keys)
+{
+    dVAR; dXSARGS;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    {
+#line 3152 "Fast.xs"
+        const struct hot_key_stat *stats;
+        int i, count;
+#line 3695 "Fast.c"
+	AV *	RETVAL;
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3155 "Fast.xs"
+        RETVAL = newAV();
+        /* Why sv_2mortal() is needed is explained in perlxs.  */
+        sv_2mortal((SV *) RETVAL);
+        count = client_get_hot_keys(memd->c, &stats);
+        if (items > 1)
+          {
+            SV *sv = ST(1);
+            SvGETMAGIC(sv);
+            if (SvOK(sv) && SvIV(sv) < count)
+              count = SvIV(sv);
+          }
+        for (i = 0; i < count; ++i)
+          {
+            HV *hv = newHV();
+            SV **server = (stats[i].server != -1
+                           ? av_fetch(memd->servers, stats[i].server, 0)
+                           : NULL);
+
+            hv_stores(hv, "key", newSVpvn(stats[i].key, stats[i].key_len));
+            hv_stores(hv, "count", newSVuv(stats[i].count));
+            hv_stores(hv, "error", newSVuv(stats[i].error));
+            hv_stores(hv, "rate", newSVnv(stats[i].rate));
+            hv_stores(hv, "server",
+                      server ? newSVsv(*server) : newSV(0));
+            av_push(RETVAL, newRV_noinc((SV *) hv));
+          }
+#line 3726 "Fast.c"
+	{
+	    SV * RETVALSV;
+	    RETVALSV = newRV((SV*)RETVAL);
+	    RETVALSV = sv_2mortal(RETVALSV);
+	    ST(0) = RETVALSV;
+	}
+    }
+    XSRETURN(1);
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_replicate_keys); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_replicate_keys)
+{
+    dVAR; dXSARGS;
+    dXSI32;
+    if (items < 1)
+       croak_xs_usage(cv,  "memd, ...");
+    {
+#line 3191 "Fast.xs"
+        int i;
+#line 3748 "Fast.c"
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3193 "Fast.xs"
+        for (i = 1; i < items; ++i)
+          {
+            const char *key;
+            STRLEN key_len;
+
+            key = SvPV(ST(i), key_len);
+            if (client_replicate_key(memd->c, key, key_len, ! ix)
+                != MEMCACHED_SUCCESS)
+              croak("Not enough memory");
+          }
+#line 3762 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+
+XS_EUPXS(XS_Cache__Memcached__Fast_disconnect_all); /* prototype to pass -Wmissing-prototypes */
+XS_EUPXS(XS_Cache__Memcached__Fast_disconnect_all)
+{
+    dVAR; dXSARGS;
+    if (items != 1)
+       croak_xs_usage(cv,  "memd");
+    {
+	Cache_Memcached_Fast *  memd = INT2PTR(Cache_Memcached_Fast *, SvIVX(SvRV(ST(0))))
+;
+#line 3209 "Fast.xs"
+        client_reinit(memd->c);
+#line 3779 "Fast.c"
+    }
+    XSRETURN_EMPTY;
+}
+
+#ifdef __cplusplus
+extern "C"
+#endif
+XS_EXTERNAL(boot_Cache__Memcached__Fast); /* prototype to pass -Wmissing-prototypes */
+XS_EXTERNAL(boot_Cache__Memcached__Fast)
+{
+#if PERL_VERSION_LE(5, 21, 5)
+    dVAR; dXSARGS;
+#else
+    dVAR; dXSBOOTARGSXSAPIVERCHK;
+#endif
+#if PERL_VERSION_LE(5, 8, 999) /* PERL_VERSION_LT is 5.33+ */
+    char* file = __FILE__;
+#else
+    const char* file = __FILE__;
+#endif
+
+    PERL_UNUSED_VAR(file);
+
+    PERL_UNUSED_VAR(cv); /* -W */
+    PERL_UNUSED_VAR(items); /* -W */
+#if PERL_VERSION_LE(5, 21, 5)
+    XS_VERSION_BOOTCHECK;
+#  ifdef XS_APIVERSION_BOOTCHECK
+    XS_APIVERSION_BOOTCHECK;
+#  endif
+#endif
+
+        (void)newXSproto_portable("Cache::Memcached::Fast::_new", XS_Cache__Memcached__Fast__new, file, "$$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::_destroy", XS_Cache__Memcached__Fast__destroy, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::_weaken", XS_Cache__Memcached__Fast__weaken, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::_set_servers", XS_Cache__Memcached__Fast__set_servers, file, "$$");
+        cv = newXSproto_portable("Cache::Memcached::Fast::keys_by_server", XS_Cache__Memcached__Fast_servers_for_keys, file, "$$");
+        XSANY.any_i32 = 1;
+        cv = newXSproto_portable("Cache::Memcached::Fast::servers_for_keys", XS_Cache__Memcached__Fast_servers_for_keys, file, "$$");
+        XSANY.any_i32 = 0;
+        (void)newXSproto_portable("Cache::Memcached::Fast::enable_compress", XS_Cache__Memcached__Fast_enable_compress, file, "$$");
+        cv = newXSproto_portable("Cache::Memcached::Fast::add", XS_Cache__Memcached__Fast_set, file, "$@");
+        XSANY.any_i32 = CMD_ADD;
+        cv = newXSproto_portable("Cache::Memcached::Fast::append", XS_Cache__Memcached__Fast_set, file, "$@");
+        XSANY.any_i32 = CMD_APPEND;
+        cv = newXSproto_portable("Cache::Memcached::Fast::cas", XS_Cache__Memcached__Fast_set, file, "$@");
+        XSANY.any_i32 = CMD_CAS;
+        cv = newXSproto_portable("Cache::Memcached::Fast::prepend", XS_Cache__Memcached__Fast_set, file, "$@");
+        XSANY.any_i32 = CMD_PREPEND;
+        cv = newXSproto_portable("Cache::Memcached::Fast::replace", XS_Cache__Memcached__Fast_set, file, "$@");
+        XSANY.any_i32 = CMD_REPLACE;
+        cv = newXSproto_portable("Cache::Memcached::Fast::set", XS_Cache__Memcached__Fast_set, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::add_multi", XS_Cache__Memcached__Fast_set_multi, file, "$@");
+        XSANY.any_i32 = CMD_ADD;
+        cv = newXSproto_portable("Cache::Memcached::Fast::append_multi", XS_Cache__Memcached__Fast_set_multi, file, "$@");
+        XSANY.any_i32 = CMD_APPEND;
+        cv = newXSproto_portable("Cache::Memcached::Fast::cas_multi", XS_Cache__Memcached__Fast_set_multi, file, "$@");
+        XSANY.any_i32 = CMD_CAS;
+        cv = newXSproto_portable("Cache::Memcached::Fast::prepend_multi", XS_Cache__Memcached__Fast_set_multi, file, "$@");
+        XSANY.any_i32 = CMD_PREPEND;
+        cv = newXSproto_portable("Cache::Memcached::Fast::replace_multi", XS_Cache__Memcached__Fast_set_multi, file, "$@");
+        XSANY.any_i32 = CMD_REPLACE;
+        cv = newXSproto_portable("Cache::Memcached::Fast::set_multi", XS_Cache__Memcached__Fast_set_multi, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::get", XS_Cache__Memcached__Fast_get, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::gets", XS_Cache__Memcached__Fast_get, file, "$@");
+        XSANY.any_i32 = CMD_GETS;
+        cv = newXSproto_portable("Cache::Memcached::Fast::get_multi", XS_Cache__Memcached__Fast_get_multi, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::gets_multi", XS_Cache__Memcached__Fast_get_multi, file, "$@");
+        XSANY.any_i32 = CMD_GETS;
+        (void)newXSproto_portable("Cache::Memcached::Fast::_prepare_keys", XS_Cache__Memcached__Fast__prepare_keys, file, "$$$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::_get_prepared", XS_Cache__Memcached__Fast__get_prepared, file, "$$$");
+        cv = newXSproto_portable("Cache::Memcached::Fast::gat", XS_Cache__Memcached__Fast_gat, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::gats", XS_Cache__Memcached__Fast_gat, file, "$@");
+        XSANY.any_i32 = CMD_GATS;
+        cv = newXSproto_portable("Cache::Memcached::Fast::gat_multi", XS_Cache__Memcached__Fast_gat_multi, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::gats_multi", XS_Cache__Memcached__Fast_gat_multi, file, "$@");
+        XSANY.any_i32 = CMD_GATS;
+        cv = newXSproto_portable("Cache::Memcached::Fast::decr", XS_Cache__Memcached__Fast_incr, file, "$@");
+        XSANY.any_i32 = CMD_DECR;
+        cv = newXSproto_portable("Cache::Memcached::Fast::incr", XS_Cache__Memcached__Fast_incr, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::decr_multi", XS_Cache__Memcached__Fast_incr_multi, file, "$@");
+        XSANY.any_i32 = CMD_DECR;
+        cv = newXSproto_portable("Cache::Memcached::Fast::incr_multi", XS_Cache__Memcached__Fast_incr_multi, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::delete", XS_Cache__Memcached__Fast_delete, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::remove", XS_Cache__Memcached__Fast_delete, file, "$@");
+        XSANY.any_i32 = CMD_REMOVE;
+        (void)newXSproto_portable("Cache::Memcached::Fast::delete_multi", XS_Cache__Memcached__Fast_delete_multi, file, "$@");
+        (void)newXSproto_portable("Cache::Memcached::Fast::touch", XS_Cache__Memcached__Fast_touch, file, "$@");
+        (void)newXSproto_portable("Cache::Memcached::Fast::touch_multi", XS_Cache__Memcached__Fast_touch_multi, file, "$@");
+        (void)newXSproto_portable("Cache::Memcached::Fast::flush_all", XS_Cache__Memcached__Fast_flush_all, file, "$;$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::nowait_push", XS_Cache__Memcached__Fast_nowait_push, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::invalidate_namespace", XS_Cache__Memcached__Fast_invalidate_namespace, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::flush_counters", XS_Cache__Memcached__Fast_flush_counters, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::update_slab_classes", XS_Cache__Memcached__Fast_update_slab_classes, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::server_versions", XS_Cache__Memcached__Fast_server_versions, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::namespace", XS_Cache__Memcached__Fast_namespace, file, "$;$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::near_cache_stats", XS_Cache__Memcached__Fast_near_cache_stats, file, "$");
+        (void)newXSproto_portable("Cache::Memcached::Fast::hot_keys", XS_Cache__Memcached__Fast_hot_keys, file, "$;$");
+        cv = newXSproto_portable("Cache::Memcached::Fast::replicate_keys", XS_Cache__Memcached__Fast_replicate_keys, file, "$@");
+        XSANY.any_i32 = 0;
+        cv = newXSproto_portable("Cache::Memcached::Fast::unreplicate_keys", XS_Cache__Memcached__Fast_replicate_keys, file, "$@");
+        XSANY.any_i32 = 1;
+        (void)newXSproto_portable("Cache::Memcached::Fast::disconnect_all", XS_Cache__Memcached__Fast_disconnect_all, file, "$");
+#if PERL_VERSION_LE(5, 21, 5)
+#  if PERL_VERSION_GE(5, 9, 0)
+    if (PL_unitcheckav)
+        call_list(PL_scopestack_ix, PL_unitcheckav);
+#  endif
+    XSRETURN_YES;
+#else
+    Perl_xs_boot_epilog(aTHX_ ax);
+#endif
+}
+
@@ -0,0 +1,1972 @@
+package Cache::Memcached::Fast 0.28;
+
+use v5.12;
+use warnings;
+
+use Carp           ();
+use Compress::Zlib ();
+use Storable;
+use XSLoader;
+
+my %instance;
+my %known_args = map { $_ => 1 } qw(
+    bounded_load check_args chunk_size close_on_error compress_algo
+    compress_methods compress_ratio compress_slab_aware compress_threshold
+    connect_timeout counter_buffer_size counter_flush_interval dispatch_mode
+    dispatch_snapshot failure_timeout hash_function hash_namespace hash_tags
+    hot_keys hot_keys_sample io_timeout ketama_points lazy_deserialize
+    max_failures max_size namespace namespace_generation_key
+    namespace_generation_ttl near_cache_size near_cache_ttl
+    negative_cache_size negative_cache_ttl nowait replicas replicated_keys
+    select_timeout serialize_methods servers shared_cache_item_size
+    shared_cache_size utf8
+);
+
+sub new {
+    my ( $class, $conf ) = @_;
+
+    unless ( lc( $conf->{check_args} // '' ) eq 'skip' ) {
+        Carp::carp 'compress_algo was removed in 0.08, use compress_methods'
+            if exists $conf->{compress_algo};
+
+        if ( my @unknown = grep !$known_args{$_}, sort keys %$conf ) {
+            Carp::carp do { local $" = ', '; "Unknown arguments: @unknown" };
+        }
+    }
+
+    # Note that the functions below can't return false when operation succeed.
+    # This is because "" and "0" compress to a longer values (because of
+    # additional format data), and compress_ratio will force them to be stored
+    # uncompressed, thus decompression will never return them.
+    $conf->{compress_methods} //= [
+        sub { ${ $_[1] } = Compress::Zlib::memGzip( ${ $_[0] } ) },
+        sub { ${ $_[1] } = Compress::Zlib::memGunzip( ${ $_[0] } ) },
+    ];
+
+    $conf->{serialize_methods} //= [ \&Storable::nfreeze, \&Storable::thaw ];
+
+    my $memd = $class->_new($conf);
+
+    my $context = [ $memd, $conf ];
+    _weaken( $context->[0] );
+    $instance{$$memd} = $context;
+
+    return $memd;
+}
+
+sub CLONE {
+    my $class = shift;
+
+    # Empty %instance and loop over the values.
+    for my $context ( delete @instance{ keys %instance } ) {
+        my ( $memd, $conf ) = @$context;
+
+        my $memd2 = $class->_new($conf);
+
+        $instance{ $$memd = $$memd2 } = $context;
+
+        $$memd2 = 0;    # Prevent destruction in DESTROY.
+    }
+}
+
+sub DESTROY {
+    my $memd = shift;
+
+    return unless $$memd;
+
+    delete $instance{$$memd};
+
+    _destroy($memd);
+}
+
+sub set_servers {
+    my ( $memd, $servers ) = @_;
+
+    _set_servers( $memd, $servers );
+
+    # Threads started later build their clients with the new list.
+    my $context = $instance{$$memd};
+    $context->[1] = { %{ $context->[1] }, servers => [@$servers] };
+
+    return;
+}
+
+sub add_server {
+    my ( $memd, $server ) = @_;
+
+    my $servers = $instance{$$memd}[1]{servers} // [];
+    $memd->set_servers( [ @$servers, $server ] );
+
+    return;
+}
+
+sub remove_server {
+    my ( $memd, $address ) = @_;
+
+    my $servers = $instance{$$memd}[1]{servers} // [];
+    my @rest    = grep {
+        my $addr
+            = ref eq 'HASH'  ? $_->{address}
+            : ref eq 'ARRAY' ? $_->[0]
+            :                  $_;
+        ( $addr // '' ) ne $address;
+    } @$servers;
+    return 0 if @rest == @$servers;
+
+    $memd->set_servers( \@rest );
+
+    return 1;
+}
+
+sub prepare_keys {
+    my ( $memd, $keys ) = @_;
+
+    my %seen;
+    my $prepared = [ $memd, [ grep !$seen{$_}++, @$keys ], '' ];
+    _prepare_keys(@$prepared);
+
+    return bless $prepared, 'Cache::Memcached::Fast::PreparedKeys';
+}
+
+{
+    package Cache::Memcached::Fast::PreparedKeys;
+
+    # [ $memd, \@keys, $block ], the block is rebuilt when it is stale.
+    sub get_multi {
+        my $prepared = shift;
+
+        return Cache::Memcached::Fast::_get_prepared(@$prepared);
+    }
+}
+
+XSLoader::load;
+
+__END__
+
+=encoding UTF-8
+
+=head1 NAME
+
+Cache::Memcached::Fast - Perl client for B<memcached>, in C language
+
+=head1 SYNOPSIS
+
+  use Cache::Memcached::Fast;
+
+  my $memd = Cache::Memcached::Fast->new({
+      servers => [ { address => 'localhost:11211', weight => 2.5 },
+                   '192.168.254.2:11211',
+                   { address => '/path/to/unix.sock', noreply => 1 } ],
+      namespace => 'my:',
+      namespace_generation_key => 'generation',
+      connect_timeout => 0.2,
+      io_timeout => 0.5,
+      close_on_error => 1,
+      compress_threshold => 100_000,
+      chunk_size => 512 * 1024,
+      compress_ratio => 0.9,
+      compress_slab_aware => 1,
+      compress_methods => [ \&IO::Compress::Gzip::gzip,
+                            \&IO::Uncompress::Gunzip::gunzip ],
+      max_failures => 3,
+      failure_timeout => 2,
+      ketama_points => 150,
+      dispatch_mode => 'ketama',
+      dispatch_snapshot => '/dev/shm/memcached-ring',
+      hash_function => 'crc32',
+      nowait => 1,
+      hash_namespace => 1,
+      hash_tags => 1,
+      serialize_methods => [ \&Storable::freeze, \&Storable::thaw ],
+      utf8 => 1,
+      lazy_deserialize => 1,
+      max_size => 512 * 1024,
+      near_cache_size => 4 * 1024 * 1024,
+      near_cache_ttl => 0.5,
+      shared_cache_size => 64 * 1024 * 1024,
+      shared_cache_item_size => 8 * 1024,
+      negative_cache_ttl => 2,
+      hot_keys => 100,
+      hot_keys_sample => 100,
+      replicas => 2,
+      replicated_keys => ['front_page', 'config'],
+      bounded_load => 0.25,
+      counter_buffer_size => 1000,
+      counter_flush_interval => 0.5,
+  });
+
+  # Compute slab classes for compress_slab_aware.
+  $memd->update_slab_classes;
+
+  # Get server versions.
+  my $versions = $memd->server_versions;
+  while (my ($server, $version) = each %$versions) {
+      #...
+  }
+
+  # Store scalars.
+  $memd->add('skey', 'text');
+  $memd->add_multi(['skey2', 'text2'], ['skey3', 'text3', 10]);
+
+  $memd->replace('skey', 'val');
+  $memd->replace_multi(['skey2', 'val2'], ['skey3', 'val3']);
+
+  $memd->set('nkey', 5);
+  $memd->set_multi(['nkey2', 10], ['skey3', 'text', 5]);
+
+  # Store arbitrary Perl data structures.
+  my %hash = (a => 1, b => 2);
+  my @list = (1, 2);
+  $memd->set('hash', \%hash);
+  $memd->set_multi(['scalar', 1], ['list', \@list]);
+
+  # Add to strings.
+  $memd->prepend('skey', 'This is a ');
+  $memd->prepend_multi(['skey2', 'This is a '], ['skey3', 'prefix ']);
+  $memd->append('skey', 'ue.');
+  $memd->append_multi(['skey2', 'ue.'], ['skey3', ' suffix']);
+
+  # Do arithmetic.
+  $memd->incr('nkey', 10);
+  print "OK\n" if $memd->decr('nkey', 3) == 12;
+
+  my @counters = qw(c1 c2);
+  $memd->set_multi(map { [$_, 0] } @counters, 'c3', 'c4');
+  $memd->incr_multi(['c3', 2], @counters, ['c4', 10]);
+
+  # Retrieve values.
+  my $val = $memd->get('skey');
+  print "OK\n" if $val eq 'This is a value.';
+  my $href = $memd->get_multi('hash', 'nkey');
+  print "OK\n" if $href->{hash}->{b} == 2 and $href->{nkey} == 12;
+
+  # Do atomic test-and-set operations.
+  my $cas_val = $memd->gets('nkey');
+  $$cas_val[1] = 0 if $$cas_val[1] == 12;
+  if ($memd->cas('nkey', @$cas_val)) {
+      print "OK, value updated\n";
+  } else {
+      print "Update failed, probably another client"
+          . " has updated the value\n";
+  }
+
+  # Delete some data.
+  $memd->delete('skey');
+
+  my @keys = qw(k1 k2 k3);
+  $memd->delete_multi(@keys);
+
+  # Wait for all commands that were executed in nowait mode.
+  $memd->nowait_push;
+
+  # Wipe out all cached data.
+  $memd->flush_all;
+
+
+=head1 DESCRIPTION
+
+B<Cache::Memcached::Fast> is a Perl client for B<memcached>, a memory
+cache daemon (L<http://www.memcached.org/>).  Module core is
+implemented in C and tries hard to minimize number of system calls and
+to avoid any key/value copying for speed.  As a result, it has very
+low CPU consumption.
+
+API is largely compatible with L<Cache::Memcached|Cache::Memcached>,
+original pure Perl client, most users of the original module may start
+using this module by installing it and adding I<"::Fast"> to the old
+name in their scripts (see L</"Compatibility with Cache::Memcached">
+below for full details).
+
+=head1 CONSTRUCTOR
+
+=over
+
+=item C<new>
+
+  my $memd = Cache::Memcached::Fast->new($params);
+
+Create new client object.  I<$params> is a reference to a hash with
+client parameters.  Currently recognized keys are:
+
+=over
+
+=item I<servers>
+
+  servers => [ { address => 'localhost:11211', weight => 2.5 },
+               '192.168.254.2:11211',
+               { address => '/path/to/unix.sock', noreply => 1 } ],
+  (default: none)
+
+The value is a reference to an array of server addresses.  Each
+address is either a scalar, a hash reference, or an array reference
+(for compatibility with Cache::Memcached, deprecated).  If hash
+reference, the keys are I<address> (scalar), I<weight> (positive
+rational number), and I<noreply> (boolean flag).  The server address
+is in the form I<host:port> for network TCP connections, or
+F</path/to/unix.sock> for local Unix socket connections.  When weight
+is not given, 1 is assumed.  Client will distribute keys across
+servers proportionally to server weights.  The list may be changed
+later with L</set_servers>.
+
+If you want to get key distribution compatible with Cache::Memcached,
+all server weights should be integer, and their sum should be less
+than 32768.
+
+When I<noreply> is enabled, commands executed in a void context will
+instruct the server to not send the reply.  Compare with L</nowait>
+below.  B<memcached> server implements I<noreply> starting with
+version 1.2.5.  If you enable I<noreply> for earlier server versions,
+things will go wrongly, and the client will eventually block.  Use
+with care.
+
+=item I<namespace>
+
+  namespace => 'my::'
+  (default: '')
+
+The value is a scalar that will be prepended to all key names passed
+to the B<memcached> server.  By using different namespaces clients
+avoid interference with each other.
+
+=item I<hash_namespace>
+
+  hash_namespace => 1
+  (default: disabled)
+
+The value is a boolean which enables (true) or disables (false) the
+hashing of the namespace key prefix.  By default for compatibility
+with B<Cache::Memcached> namespace prefix is not hashed along with the
+key.  Thus
+
+  namespace => 'prefix/',
+  ...
+  $memd->set('key', $val);
+
+may use different B<memcached> server than
+
+  namespace => '',
+  ...
+  $memd->set('prefix/key', $val);
+
+because hash values of I<'key'> and I<'prefix/key'> may be different.
+
+However sometimes is it necessary to hash the namespace prefix, for
+instance for interoperability with other clients that do not have the
+notion of the namespace.  When I<hash_namespace> is enabled, both
+examples above will use the same server, the one that I<'prefix/key'>
+is mapped to.  Note that there's no performance penalty then, as
+namespace prefix is hashed only once.  See L</namespace>.
+
+=item I<hash_tags>
+
+  hash_tags => 1
+  (default: disabled)
+
+The value is a boolean which enables (true) or disables (false) hash
+tags.  When enabled and a key contains I<'{'> followed by I<'}'>, only
+the part between the first I<'{'> and the first I<'}'> after it is
+hashed to select the server, like in Redis Cluster.  Thus
+
+  $memd->get_multi('user:{123}:profile', 'user:{123}:prefs');
+
+reads both keys from one server in a single round trip.  A key
+without a tag, or with an empty one like I<'{}'>, is hashed as a
+whole.  With L</hash_namespace> the namespace is hashed before the
+tag.  Keys that share a tag are never spread across servers, so a
+tag as hot as a whole server can't hold should be split.  Enabling
+hash tags moves tagged keys to other servers.
+
+=item I<namespace_generation_key>
+
+  namespace_generation_key => 'generation'
+  (default: disabled)
+
+The value is a key (within L</namespace>) that holds the generation
+number of the namespace.  When set, the generation followed by I<':'>
+is appended to the namespace prefix of all other keys, and
+L</invalidate_namespace> increments it, which makes all keys of the
+namespace unreachable with one command.  Old values are not deleted,
+they expire or get evicted by B<memcached> as usual.
+
+The generation is fetched when the client is first used and then
+every L</namespace_generation_ttl>.  If the key is missing, it is
+created with the current time (or the generation the client has seen
+last, if greater) as the initial generation, so that an evicted
+generation doesn't revive the keys of an old one.  Clients
+sharing a namespace should use the same key.  Since the generation
+isn't hashed (see L</hash_namespace>), keys stay on their servers.
+
+=item I<namespace_generation_ttl>
+
+  namespace_generation_ttl => 5
+  (default: 1 second)
+
+The value is a non-negative rational number of seconds to cache the
+namespace generation in the client.  Other clients see
+L</invalidate_namespace> at most this much later.
+
+=item I<nowait>
+
+  nowait => 1
+  (default: disabled)
+
+The value is a boolean which enables (true) or disables (false)
+I<nowait> mode.  If enabled, when you call a method that only returns
+its success status (like L</set>), B<I<in a void context>>, it sends
+the request to the server and returns immediately, not waiting the
+reply.  This avoids the round-trip latency at a cost of uncertain
+command outcome.
+
+Internally there is a counter of how many outstanding replies there
+should be, and on any command the client reads and discards any
+replies that have already arrived.  When you later execute some method
+in a non-void context, all outstanding replies will be waited for, and
+then the reply for this command will be read and returned.
+
+=item I<connect_timeout>
+
+  connect_timeout => 0.7
+  (default: 0.25 seconds)
+
+The value is a non-negative rational number of seconds to wait for
+connection to establish.  Applies only to network connections.  Zero
+disables timeout, but keep in mind that operating systems have their
+own heuristic connect timeout.
+
+Note that network connect process consists of several steps:
+destination host address lookup, which may return several addresses in
+general case (especially for IPv6, see
+L<http://people.redhat.com/drepper/linux-rfc3484.html> and
+L<http://people.redhat.com/drepper/userapi-ipv6.html>), then the
+attempt to connect to one of those addresses.  I<connect_timeout>
+applies only to one such connect, i.e. to one I<connect(2)>
+call.  Thus overall connect process may take longer than
+I<connect_timeout> seconds, but this is unavoidable.
+
+=item I<io_timeout> (or deprecated I<select_timeout>)
+
+  io_timeout => 0.5
+  (default: 1.0 seconds)
+
+The value is a non-negative rational number of seconds to wait before
+giving up on communicating with the server(s).  Zero disables timeout.
+
+Note that for commands that communicate with more than one server
+(like L</get_multi>) the timeout applies per server set, not per each
+server.  Thus it won't expire if one server is quick enough to
+communicate, even if others are silent.  But if some servers are dead
+those alive will finish communication, and then dead servers would
+timeout.
+
+=item I<close_on_error>
+
+  close_on_error => 0
+  (default: enabled)
+
+The value is a boolean which enables (true) or disables (false)
+I<close_on_error> mode.  When enabled, any error response from the
+B<memcached> server would make client close the connection.  Note that
+such "error response" is different from "negative response".  The
+latter means the server processed the command and yield negative
+result.  The former means the server failed to process the command for
+some reason.  I<close_on_error> is enabled by default for safety.
+Consider the following scenario:
+
+=over
+
+=item 1 Client want to set some value, but mistakenly sends malformed
+        command (this can't happen with current module of course ;)):
+
+  set key 10\r\n
+  value_data\r\n
+
+=item 2 Memcached server reads first line, 'set key 10', and can't
+        parse it, because there's wrong number of tokens in it.  So it
+        sends
+
+  ERROR\r\n
+
+=item 3 Then the server reads 'value_data' while it is in
+        accept-command state!  It can't parse it either (hopefully),
+        and sends another
+
+  ERROR\r\n
+
+=back
+
+But the client expects one reply per command, so after sending the
+next command it will think that the second 'ERROR' is a reply for this
+new command.  This means that all replies will shift, including
+replies for L</get> commands!  By closing the connection we eliminate
+such possibility.
+
+When connection dies, or the client receives the reply that it can't
+understand, it closes the socket regardless the I<close_on_error>
+setting.
+
+=item I<compress_threshold>
+
+  compress_threshold => 10_000
+  (default: -1)
+
+The value is an integer.  When positive it denotes the threshold size
+in bytes: data with the size equal or larger than this should be
+compressed.  See L</compress_ratio> and L</compress_methods> below.
+
+Negative value disables compression.
+
+=item I<compress_ratio>
+
+  compress_ratio => 0.9
+  (default: 0.8)
+
+The value is a fractional number between 0 and 1.  When
+L</compress_threshold> triggers the compression, compressed size
+should be less or equal to S<(original-size * I<compress_ratio>)>.
+Otherwise the data will be stored uncompressed.
+
+=item I<compress_slab_aware>
+
+  compress_slab_aware => 1
+  (default: disabled)
+
+The value is a boolean.  memcached stores an item in a chunk of the
+smallest slab class that fits it, so compression that keeps the item
+in the same class saves no server memory but still costs CPU on every
+L</set> and L</get>.  When enabled, and once L</update_slab_classes>
+has computed the slab classes, the client skips compression for items
+that already fit the smallest class, and keeps the compressed result
+only when it moves the item to a smaller class, in addition to the
+L</compress_ratio> rule.  Items larger than all classes are handled as
+usual.
+
+The classes are computed from C<chunk_size>, C<growth_factor> and
+C<slab_chunk_max> (or C<item_size_max>) in C<stats settings> the same
+way memcached computes them, assuming the 48 byte item header of
+64-bit servers.  Servers started with custom C<slab_sizes> are not
+supported.  Until the classes are known, compression works as if this
+option was disabled.
+
+=item I<compress_methods>
+
+  compress_methods => [ \&IO::Compress::Gzip::gzip,
+                        \&IO::Uncompress::Gunzip::gunzip ]
+  (default: [ sub { ${$_[1]} = Compress::Zlib::memGzip(${$_[0]}) },
+              sub { ${$_[1]} = Compress::Zlib::memGunzip(${$_[0]}) } ]
+   when Compress::Zlib is available)
+
+The value is a reference to an array holding two code references for
+compression and decompression routines respectively.
+
+Compression routine is called when the size of the I<$value> passed to
+L</set> method family is greater than or equal to
+L</compress_threshold> (also see L</compress_ratio>).  The fact that
+compression was performed is remembered along with the data, and
+decompression routine is called on data retrieval with L</get> method
+family.  The interface of these routines should be the same as for
+B<IO::Compress> family (for instance see
+L<IO::Compress::Gzip::gzip|IO::Compress::Gzip/gzip> and
+L<IO::Uncompress::Gunzip::gunzip|IO::Uncompress::Gunzip/gunzip>).
+I.e. compression routine takes a reference to scalar value and a
+reference to scalar where compressed result will be stored.
+Decompression routine takes a reference to scalar with compressed data
+and a reference to scalar where uncompressed result will be stored.
+Both routines should return true on success, and false on error.
+
+By default we use L<Compress::Zlib|Compress::Zlib> because as of this
+writing it appears to be much faster than
+L<IO::Uncompress::Gunzip|IO::Uncompress::Gunzip>.
+
+=item I<max_failures>
+
+  max_failures => 3
+  (default: 0)
+
+The value is a non-negative integer.  When positive, if there happened
+I<max_failures> in I<failure_timeout> seconds, the client does not try
+to connect to this particular server for another I<failure_timeout>
+seconds.  Value of zero disables this behaviour.
+
+=item I<failure_timeout>
+
+  failure_timeout => 30
+  (default: 10 seconds)
+
+The value is a positive integer number of seconds.  See
+L</max_failures>.
+
+=item I<ketama_points>
+
+  ketama_points => 150
+  (default: 0)
+
+The value is a non-negative integer.  When positive, enables the
+B<Ketama> consistent hashing algorithm
+(L<http://www.last.fm/user/RJ/journal/2007/04/10/392555/>), and
+specifies the number of points the server with weight 1 will be mapped
+to.  Thus each server will be mapped to S<I<ketama_points> *
+I<weight>> points in continuum.  Larger value will result in more
+uniform distribution.  Note that the number of internal bucket
+structures, and hence memory consumption, will be proportional to sum
+of such products.  But bucket structures themselves are small (two
+integers each), so you probably shouldn't worry.
+
+Zero value disables the Ketama algorithm.  See also server weight in
+L</servers> above.
+
+=item I<dispatch_mode>
+
+  dispatch_mode => 'maglev'
+  (default: 'ketama')
+
+The value is the name of the algorithm that maps keys to servers:
+
+=over
+
+=item C<ketama>
+
+Ketama continuum when L</ketama_points> is positive, and
+B<Cache::Memcached> compatible dispatch otherwise.  It maps keys the
+same way as the earlier versions of this module; to share servers
+with B<libmemcached> based clients use C<ketama_md5>.
+
+=item C<jump>
+
+Jump consistent hash (L<http://arxiv.org/abs/1406.2294>).  Almost
+perfect balance and a small table.  A server of weight I<W> takes I<W>
+(rounded) buckets, and buckets are only ever appended, so servers
+should be added at the end of L</servers>: removing one from the
+middle remaps the keys of all servers after it.
+
+=item C<rendezvous>
+
+Weighted rendezvous (highest random weight) hashing.  Adding or
+removing a server only moves the keys that it gains or loses,
+wherever it is in the list, but a lookup costs time proportional to
+the number of servers.
+
+=item C<maglev>
+
+Maglev lookup table (65537 entries or 100 per server, whichever is
+larger).  Lookup is a single table read, and the balance is almost
+perfect, but changing the server list moves slightly more keys than
+the minimum.
+
+=item C<ketama_md5>
+
+The weighted MD5 Ketama continuum of B<libmemcached>
+(C<MEMCACHED_BEHAVIOR_KETAMA_WEIGHTED>), as used by PHP memcached,
+pylibmc and other clients built on it.  With the same server list,
+weights and port numbers, keys are mapped to the same servers, so
+clients in different languages share one cache.  Keys are always
+hashed with MD5, and L</hash_function> is ignored.  With
+L</hash_namespace> enabled the namespace is hashed together with the
+key, which matches C<MEMCACHED_BEHAVIOR_HASH_WITH_PREFIX_KEY>.
+Because every server gets points in proportion to its share of the
+total weight, adding a server moves a few keys between the other
+servers too.
+
+=back
+
+B<jump>, B<rendezvous>, B<maglev> and B<ketama_md5> ignore
+L</ketama_points>.  Use
+F<script/ketama-distr.pl> to compare key distribution and lookup
+speed of the modes for your server list.
+
+=item I<hash_function>
+
+  hash_function => 'xxh64'
+  (default: 'crc32')
+
+The value is the name of the function that hashes keys for
+L</dispatch_mode>, either C<crc32> or C<xxh64>
+(L<http://cyan4973.github.io/xxHash/>).  B<xxh64> hashes typical keys
+several times faster and has better distribution, but maps keys to
+different servers than B<crc32>, so other clients sharing the servers
+(including Cache::Memcached and older versions of this module) would
+look for the keys elsewhere.  Switching an existing deployment
+effectively starts with an empty cache.
+
+=item I<dispatch_snapshot>
+
+  dispatch_snapshot => '/dev/shm/memcached-ring'
+  (default: disabled)
+
+The value is a path to a file with the built continuum or table of
+L</dispatch_mode>.  If the file was made for the same L</servers>,
+weights, L</dispatch_mode> and L</ketama_points>, the constructor maps
+it read-only instead of building the tables.  Otherwise the tables are
+built and the file is replaced atomically.  Large rings then cost
+startup time once, and their memory is shared by all processes that
+use the file.  For preforking servers create the object in the parent
+before fork, or let the first worker write the file.  Use a path on a
+memory file system, like F</dev/shm>, and a separate path for every
+different server list, or the clients would rewrite the file in turn.
+The file is not used after the servers are changed with
+L</set_servers>.  Not supported on Win32.
+
+=item I<serialize_methods>
+
+  serialize_methods => [ \&Storable::freeze, \&Storable::thaw ],
+  (default: [ \&Storable::nfreeze, \&Storable::thaw ])
+
+The value is a reference to an array holding two code references for
+serialization and deserialization routines respectively.
+
+Serialization routine is called when the I<$value> passed to L</set>
+method family is a reference.  The fact that serialization was
+performed is remembered along with the data, and deserialization
+routine is called on data retrieval with L</get> method family.  The
+interface of these routines should be the same as for
+L<Storable::nfreeze|Storable/nfreeze> and
+L<Storable::thaw|Storable/thaw>.  I.e. serialization routine takes a
+reference and returns a scalar string; it should not fail.
+Deserialization routine takes scalar string and returns a reference;
+if deserialization fails (say, wrong data format) it should throw an
+exception (call I<die>).  The exception will be caught by the module
+and L</get> will then pretend that the key hasn't been found.
+
+=item I<utf8>
+
+  utf8 => 1
+  (default: disabled)
+
+The value is a boolean which enables (true) or disables (false) the
+conversion of Perl character strings to octet sequences in UTF-8
+encoding on store, and the reverse conversion on fetch (when the
+retrieved data is marked as being UTF-8 octet sequence).  See
+L<perlunicode|perlunicode>.
+
+=item I<lazy_deserialize>
+
+  lazy_deserialize => 1
+  (default: disabled)
+
+The value is a boolean which enables (true) or disables (false) lazy
+decoding of values returned by L</get_multi> method family.  When
+enabled, values that need decompression, deserialization or UTF-8
+decoding are returned as is, with the decoding postponed until the
+value is first read.  Values that are never read are then never
+decoded, which saves CPU when only a few of many fetched values are
+used.
+
+Lazy values are ordinary scalars with attached magic, the decoding
+happens transparently on first access (including copying the value).
+Note that a value that fails to decode (see L</serialize_methods>) is
+still present in the result hash, and reads as I<undef>.
+
+=item I<max_size>
+
+  max_size => 512 * 1024
+  (default: 1024 * 1024)
+
+The value is a maximum size of an item to be stored in memcached.
+When trying to set a key to a value longer than I<max_size> bytes
+(after serialization and compression) nothing is sent to the server,
+and I<set> methods return I<undef>.
+
+Note that the real maximum on the server is less than 1MB, and depends
+on key length among other things.  So some values in the range
+S<I<[1MB - N bytes, 1MB]>>, where N is several hundreds, will still be
+sent to the server, and rejected there.  You may set I<max_size> to a
+smaller value to avoid this.
+
+=item I<chunk_size>
+
+  chunk_size => 512 * 1024
+  (default: disabled)
+
+The value is a number of bytes.  When set, values longer than
+I<chunk_size> (after serialization and compression) are split into
+chunks of this size, stored under separate keys, and the key itself
+holds a short manifest that lists them.  Chunk keys hash to different
+servers, so a large value is read from several servers in parallel.
+Use it together with a larger L</max_size>, which still limits the
+whole value, to store values over the B<memcached> item size limit.
+
+L</get>, L</gets>, L</gat>, L</gats> and their I<_multi> variants read
+the manifests first, then fetch the chunks of all of them with one
+request, and return the value reassembled.  Only clients with
+I<chunk_size> read chunked values, as other clients use the same flag
+bit for their own formats: without it, and for a manifest that is
+malformed or longer than L</max_size>, the stored text is returned as
+is.  A value with a missing chunk is returned as missing.
+
+A value is stored only if all its chunks are; when a chunk fails, the
+key gets the result of that chunk.  L</add>, L</replace> and L</cas>
+store the manifest first, and the chunks only once it is stored, so
+these commands wait for the reply even in a void context.  I<cas>
+applies to the manifest, and works as usual.  L</append> and
+L</prepend> never split values.  L</touch> applies only to the
+manifest.
+
+Chunk N of a value is stored under the key preceded by
+I<"{N:hash}">, where I<hash> is computed from the key.  Thus a new
+value replaces the chunks of the old one, and with L</hash_tags> the
+chunks of a tagged key still spread over the servers.  The chunks of a
+value that had more chunks than its replacement are left to be
+evicted.  A value whose chunk keys, with the namespace, would exceed
+the 250 byte B<memcached> key length limit is stored whole, as without
+I<chunk_size>, so it still has to fit the item size limit.  L</delete> and L</delete_multi> read the
+manifests of the keys with an extra request, and delete their chunks
+too.
+
+=item I<near_cache_size>
+
+  near_cache_size => 4 * 1024 * 1024
+  (default: disabled)
+
+The value is a maximum size in bytes of the in-process cache of
+L</get> and L</get_multi> results.  When set, values fetched with
+these methods are remembered in the client, and repeated fetches of
+the same keys are answered locally, without a round trip to the
+server, until the entry expires after L</near_cache_ttl>.  When the
+cache is full, least recently used entries are evicted.  Values are
+cached as received from the server, so they are still decompressed
+and deserialized on every fetch.
+
+Local L</set>, L</cas>, L</incr>, L</delete> and other updating
+methods drop the key from the cache, and L</flush_all> clears it.
+Updates made by other clients are not seen until the entry expires,
+so only enable the cache for data that may be slightly stale.
+L</gets> and L</gat> methods always go to the server.
+
+=item I<near_cache_ttl>
+
+  near_cache_ttl => 0.5
+  (default: 1)
+
+The value is a maximum time in seconds (fractional) an entry stays in
+the cache enabled with L</near_cache_size> or L</shared_cache_size>,
+i.e. the maximum staleness of the returned values.  B<get> replies
+don't carry the expiration time of the item, so every entry stays for
+the full I<near_cache_ttl>, even if the item expires on the server
+earlier.  Keep I<near_cache_ttl> below the shortest expiration time of
+the cached keys, or a value may be returned for up to
+I<near_cache_ttl> after it has expired.
+
+=item I<shared_cache_size>
+
+  shared_cache_size => 64 * 1024 * 1024
+  (default: disabled)
+
+The value is a size in bytes of the cache of L</get> and
+L</get_multi> results kept in anonymous shared memory.  The memory is
+mapped by L</new>, and is shared with all processes forked afterwards,
+so preforked workers created from one parent share a single copy of
+the hot values.  The cache is checked after the one enabled with
+L</near_cache_size>, and before going to the server.  Entries expire
+after L</near_cache_ttl>, and are invalidated and cleared the same way
+as in near cache, except that updates from the sibling processes are
+seen immediately.
+
+Readers never lock the memory, so a crashed or stopped process can't
+block others.  Only available on POSIX systems, L</new> croaks
+elsewhere.  Threads created with L<threads> get a new cache.
+
+=item I<shared_cache_item_size>
+
+  shared_cache_item_size => 8 * 1024
+  (default: 4096)
+
+The value is a maximum size in bytes of the value, the key and the
+L</namespace> together, that may be stored in the cache enabled with
+L</shared_cache_size>.  Every entry occupies this much memory, so
+larger values mean fewer entries.
+
+=item I<negative_cache_ttl>
+
+  negative_cache_ttl => 2
+  (default: disabled)
+
+The value is a time in seconds (fractional) to remember that a key was
+missing on the server.  When set, keys not found by L</get> and
+L</get_multi> are remembered, and are reported missing again without
+a round trip to the server until the time passes.  This helps when
+the same nonexistent keys are asked for over and over.
+
+Local L</set>, L</add>, L</cas> and other updating methods forget the
+key immediately, but keys stored by other clients are only seen after
+I<negative_cache_ttl>.  L</gets> and L</gat> methods always go to the
+server.
+
+=item I<negative_cache_size>
+
+  negative_cache_size => 1024 * 1024
+  (default: 65536)
+
+The value is a number of missing keys remembered by the cache enabled
+with L</negative_cache_ttl>.  Each key takes 16 bytes.  When the
+cache is full, the keys that expire first are forgotten.
+
+=item I<hot_keys>
+
+  hot_keys => 100
+  (default: disabled)
+
+The value is a number of the most frequent keys to track.  When set,
+the client samples keys sent to the servers by all methods, and
+maintains a fixed size summary of the most frequent ones, available
+with L</hot_keys> method.  Keys answered by the local caches (see
+L</near_cache_size>) are not counted, as they never reach a server.
+
+Tracking uses the I<SpaceSaving> algorithm: any key that makes more
+than 1/I<hot_keys> of the sampled traffic is guaranteed to be
+reported.  Counts are halved every minute, so the summary follows the
+recent traffic.
+
+=item I<hot_keys_sample>
+
+  hot_keys_sample => 10
+  (default: 100)
+
+The value is an average number of keys per one sampled key for
+L</hot_keys> tracking.  Keys are sampled at random intervals, so that
+regular access patterns do not bias the result.  Lower values give
+more precise counts at a higher cost, I<1> samples every key.
+
+=item I<replicated_keys>
+
+  replicated_keys => ['front_page', 'config']
+  (default: none)
+
+The value is a reference to an array of keys (without L</namespace>)
+that are stored on several servers, see L</replicas>.  Writes of such
+keys (including L</delete>, L</incr>, L</decr> and L</touch>) go to
+every replica, and L</get> reads from a random one, which spreads the
+load of a very hot key.  L</gets>, L</gat> and L</cas> always use the
+first replica, the server the key would map to without replication.
+As the outcome of L</cas> isn't known when the request is sent, it
+deletes the key on the other replicas, so that L</get> never reads the
+value it replaced.
+Use L</replicate_keys> to change the set at run time.
+
+The set of replicated keys is not promoted automatically from
+L</hot_keys>: all clients that write a key have to agree that it is
+replicated, or the replicas they don't update will serve stale
+values.
+
+=item I<replicas>
+
+  replicas => 3
+  (default: 2)
+
+The value is a number of servers that L</replicated_keys> are stored
+on, from I<1> to I<16>.  Replicas are the servers that follow the
+key's server on the continuum (see L</ketama_points>), so adding or
+removing a server moves few replicas.  When there are fewer servers,
+the keys are stored on all of them.
+
+=item I<bounded_load>
+
+  bounded_load => 0.25
+  (default: disabled)
+
+The value is a non-negative rational number.  When set, L</get> and
+L</get_multi> of a key in L</replicated_keys> skip a replica that got
+more than S<(1 + I<bounded_load>)> times its weighted share of the
+recent requests of this client in favour of another replica of the
+key.  This is consistent hashing with bounded loads: a skewed key
+distribution does not overload one server, and a small value spreads
+the load more evenly.  The loads are local to the client and decay
+over the last thousand or so requests.
+
+Reads are only moved between the replicas, which all hold the value,
+so bounded loads never turn a hit into a miss.  Keys that are not
+replicated are always read from their own server, and writes,
+L</gets>, L</gat> and L</cas> are never moved.  When all replicas
+are full, the key is read from a random one as without this option.
+
+=item I<counter_buffer_size>
+
+  counter_buffer_size => 1000
+  (default: disabled)
+
+The value is a number of keys.  When set, L</incr> and L</decr> (and
+their I<_multi> variants) called B<I<in a void context>> don't send
+anything, but add the delta to a per-key sum in the client.  The sums
+are sent as one batch of I<incr>/I<decr> commands with the next
+request after this number of different keys has accumulated, or after
+L</counter_flush_interval>, and also by L</flush_counters>,
+L</nowait_push> and the destructor.  A high-rate counter then costs
+one command per flush instead of one per call.
+
+Until they are flushed, buffered deltas are not visible to other
+clients, and to L</get> of this client.  Calling L</incr> or
+L</decr> in a non-void context sends the buffered delta of the key
+along with the command, so the returned value accounts for it.  An
+increment and a decrement of the same key are summed, so a decrement
+that memcached would have stopped at zero may be applied differently.
+Deltas are lost if the process exits without destroying the client,
+or if the flush fails.
+
+Each delta is sent with the L</namespace> it was buffered under, and
+changing the namespace flushes the buffer.  A child process started
+with L<fork|perlfunc/fork> drops the deltas buffered by its parent,
+which are left for the parent to flush.
+
+=item I<counter_flush_interval>
+
+  counter_flush_interval => 0.5
+  (default: 1 second)
+
+The value is a non-negative rational number of seconds that the first
+buffered delta may wait before the buffer is flushed, see
+L</counter_buffer_size>.  The buffer is checked when the client
+executes a request, there are no background timers.
+
+=item I<check_args>
+
+  check_args => 'skip'
+  (default: not 'skip')
+
+The value is a string.  Currently the only recognized string is
+I<'skip'>.
+
+By default all constructor parameter names are checked to be
+recognized, and a warning is given for unknown parameter.  This will
+catch spelling errors that otherwise might go unnoticed.
+
+When set to I<'skip'>, the check will be bypassed.  This may be
+desired when you share the same argument hash among different client
+versions, or among different clients.
+
+=back
+
+=back
+
+=head1 METHODS
+
+=over
+
+=item C<enable_compress>
+
+  $memd->enable_compress($enable);
+
+Enable compression when boolean I<$enable> is true, disable when
+false.
+
+Note that you can enable compression only when you set
+L</compress_threshold> to some positive value and L</compress_methods>
+is set.
+
+I<Return:> none.
+
+=item C<namespace>
+
+  $memd->namespace;
+  $memd->namespace($string);
+
+Without the argument return the current namespace prefix.  With the
+argument set the namespace prefix to I<$string>, and return the old
+prefix.
+
+I<Return:> scalar, the namespace prefix that was in effect before the
+call.  The prefix doesn't include the L</namespace_generation_key>
+generation.
+
+=item C<invalidate_namespace>
+
+  $memd->invalidate_namespace;
+
+Increment the namespace generation stored under
+L</namespace_generation_key>, so that all keys of the current
+L</namespace> are no longer found.
+
+I<Return:> boolean, true for success, false for failure (including
+when I<namespace_generation_key> is not set).
+
+=item C<set>
+
+  $memd->set($key, $value);
+  $memd->set($key, $value, $expiration_time);
+
+Store the I<$value> on the server under the I<$key>.  I<$key> should
+be a scalar.  I<$value> should be defined and may be of any Perl data
+type.  When it is a reference, the referenced Perl data structure will
+be transparently serialized by routines specified with
+L</serialize_methods>, which see.
+
+Optional I<$expiration_time> is a positive integer number of seconds
+after which the value will expire and wouldn't be accessible any
+longer.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.
+
+=item C<set_multi>
+
+  $memd->set_multi(
+      [$key, $value],
+      [$key, $value, $expiration_time],
+      ...
+  );
+
+Like L</set>, but operates on more than one key.  Takes the list of
+references to arrays each holding I<$key>, I<$value> and optional
+I<$expiration_time>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</set> to
+learn what the result value is.
+
+=item C<cas>
+
+  $memd->cas($key, $cas, $value);
+  $memd->cas($key, $cas, $value, $expiration_time);
+
+Store the I<$value> on the server under the I<$key>, but only if CAS
+(I<Consistent Access Storage>) value associated with this key is equal
+to I<$cas>.  I<$cas> is an opaque object returned with L</gets> or
+L</gets_multi> or L</gats> or L</gats_multi>.
+
+See L</set> for I<$key>, I<$value>, I<$expiration_time> parameters
+description.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.  Thus if the key
+exists on the server, false would mean that some other client has
+updated the value, and L</gets>, L</gats>, L</cas> command sequence should be
+repeated.
+
+B<cas> command first appeared in B<memcached> 1.2.4.
+
+=item C<cas_multi>
+
+  $memd->cas_multi(
+      [$key, $cas, $value],
+      [$key, $cas, $value, $expiration_time],
+      ...
+  );
+
+Like L</cas>, but operates on more than one key.  Takes the list of
+references to arrays each holding I<$key>, I<$cas>, I<$value> and
+optional I<$expiration_time>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</cas> to
+learn what the result value is.
+
+B<cas> command first appeared in B<memcached> 1.2.4.
+
+=item C<add>
+
+  $memd->add($key, $value);
+  $memd->add($key, $value, $expiration_time);
+
+Store the I<$value> on the server under the I<$key>, but only if the
+key B<doesn't> exists on the server.
+
+See L</set> for I<$key>, I<$value>, I<$expiration_time> parameters
+description.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.
+
+=item C<add_multi>
+
+  $memd->add_multi(
+      [$key, $value],
+      [$key, $value, $expiration_time],
+      ...
+  );
+
+Like L</add>, but operates on more than one key.  Takes the list of
+references to arrays each holding I<$key>, I<$value> and optional
+I<$expiration_time>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</add> to
+learn what the result value is.
+
+=item C<replace>
+
+ $memd->replace($key, $value);
+ $memd->replace($key, $value, $expiration_time);
+
+Store the I<$value> on the server under the I<$key>, but only if the
+key B<does> exists on the server.
+
+See L</set> for I<$key>, I<$value>, I<$expiration_time> parameters
+description.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.
+
+=item C<replace_multi>
+
+  $memd->replace_multi(
+      [$key, $value],
+      [$key, $value, $expiration_time],
+      ...
+  );
+
+Like L</replace>, but operates on more than one key.  Takes the list
+of references to arrays each holding I<$key>, I<$value> and optional
+I<$expiration_time>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</replace> to
+learn what the result value is.
+
+=item C<append>
+
+  $memd->append($key, $value);
+
+B<Append> the I<$value> to the current value on the server under the
+I<$key>.
+
+I<$key> and I<$value> should be scalars, as well as current value on
+the server.  C<append> doesn't affect expiration time of the value.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.
+
+B<append> command first appeared in B<memcached> 1.2.4.
+
+=item C<append_multi>
+
+  $memd->append_multi(
+      [$key, $value],
+      ...
+  );
+
+Like L</append>, but operates on more than one key.  Takes the list of
+references to arrays each holding I<$key>, I<$value>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</append> to
+learn what the result value is.
+
+B<append> command first appeared in B<memcached> 1.2.4.
+
+=item C<prepend>
+
+  $memd->prepend($key, $value);
+
+B<Prepend> the I<$value> to the current value on the server under the
+I<$key>.
+
+I<$key> and I<$value> should be scalars, as well as current value on
+the server.  C<prepend> doesn't affect expiration time of the value.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.
+
+B<prepend> command first appeared in B<memcached> 1.2.4.
+
+=item C<prepend_multi>
+
+  $memd->prepend_multi(
+      [$key, $value],
+      ...
+  );
+
+Like L</prepend>, but operates on more than one key.  Takes the list
+of references to arrays each holding I<$key>, I<$value>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</prepend> to
+learn what the result value is.
+
+B<prepend> command first appeared in B<memcached> 1.2.4.
+
+=item C<get>
+
+  $memd->get($key);
+
+Retrieve the value for a I<$key>.  I<$key> should be a scalar.
+
+I<Return:> value associated with the I<$key>, or nothing.
+
+=item C<get_multi>
+
+  $memd->get_multi(@keys);
+
+Retrieve several values associated with I<@keys>.  I<@keys> should be
+an array of scalars.  A key repeated in I<@keys> is requested from the
+server only once.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$key}> holds
+corresponding value.
+
+=item C<gets>
+
+  $memd->gets($key);
+
+Retrieve the value and its CAS for a I<$key>.  I<$key> should be a
+scalar.
+
+I<Return:> reference to an array I<[$cas, $value]>, or nothing.  You
+may conveniently pass it back to L</cas> with I<@$res>:
+
+  my $cas_val = $memd->gets($key);
+  # Update value.
+  if (defined $cas_val) {
+      $$cas_val[1] = 3;
+      $memd->cas($key, @$cas_val);
+  }
+
+B<gets> command first appeared in B<memcached> 1.2.4.
+
+=item C<gets_multi>
+
+  $memd->gets_multi(@keys);
+
+Retrieve several values and their CASs associated with I<@keys>.
+I<@keys> should be an array of scalars.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$key}> holds a
+reference to an array I<[$cas, $value]>.  Compare with L</gets>.
+
+B<gets> command first appeared in B<memcached> 1.2.4.
+
+=item C<incr>
+
+  $memd->incr($key);
+  $memd->incr($key, $increment);
+
+Increment the value for the I<$key>.  Starting with B<memcached> 1.3.3
+I<$key> should be set to a number or the command will fail.  An
+optional I<$increment> should be a positive integer, when not given 1
+is assumed.  Note that the server doesn't check for overflow.
+
+I<Return:> unsigned integer, new value for the I<$key>, or false for
+negative server reply, or I<undef> in case of some error.
+
+=item C<incr_multi>
+
+  $memd->incr_multi(
+      @keys,
+      [$key],
+      [$key, $increment],
+      ...
+  );
+
+Like L</incr>, but operates on more than one key.  Takes the list of
+keys and references to arrays each holding I<$key> and optional
+I<$increment>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</incr> to
+learn what the result value is.
+
+=item C<decr>
+
+  $memd->decr($key);
+  $memd->decr($key, $decrement);
+
+Decrement the value for the I<$key>.  Starting with B<memcached> 1.3.3
+I<$key> should be set to a number or the command will fail.  An
+optional I<$decrement> should be a positive integer, when not given 1
+is assumed.  Note that the server I<does> check for underflow, attempt
+to decrement the value below zero would set the value to zero.
+Similar to L<DBI|DBI>, zero is returned as I<"0E0">, and evaluates to
+true in a boolean context.
+
+I<Return:> unsigned integer, new value for the I<$key>, or false for
+negative server reply, or I<undef> in case of some error.
+
+=item C<decr_multi>
+
+  $memd->decr_multi(
+      @keys,
+      [$key],
+      [$key, $decrement],
+      ...
+  );
+
+Like L</decr>, but operates on more than one key.  Takes the list of
+keys and references to arrays each holding I<$key> and optional
+I<$decrement>.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</decr> to
+learn what the result value is.
+
+=item C<delete>
+
+  $memd->delete($key);
+
+Delete I<$key> and its value from the cache.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.
+
+=item C<remove> (B<deprecated>)
+
+Alias for L</delete>, for compatibility with B<Cache::Memcached>.
+
+=item C<delete_multi>
+
+  $memd->delete_multi(@keys);
+
+Like L</delete>, but operates on more than one key.  Takes the list of
+keys.  A repeated key is deleted once, and its result is returned for
+every occurrence: a key that existed reports true for all of its
+occurrences.  Version 0.28 and earlier deleted each occurrence in
+turn, so only the first one reported true.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</delete> to
+learn what the result value is.
+
+=item C<touch>
+
+  $memd->touch($key, $expiration_time);
+
+Update the expiration time of I<$key> without fetching it.
+
+Optional I<$expiration_time> is a positive integer number of seconds
+after which the value will expire and wouldn't be accessible any
+longer.
+
+I<Return:> boolean, true for positive server reply, false for negative
+server reply, or I<undef> in case of some error.
+
+B<touch> command first appeared in B<memcached> 1.4.8.
+
+=item C<touch_multi>
+
+  $memd->touch_multi(
+      [$key],
+      [$key, $expiration_time],
+      ...
+  );
+
+Like L</touch>, but operates on more than one key.  Takes the list of
+references to arrays each holding I<$key> and optional I<$expiration_time>.
+A repeated key is touched once, with the first I<$expiration_time>
+given for it, and its result is returned for every occurrence.
+
+Note that multi commands are not all-or-nothing, some operations may
+succeed, while others may fail.
+
+I<Return:> in list context returns the list of results, each
+I<$list[$index]> is the result value corresponding to the argument at
+position I<$index>.  In scalar context, hash reference is returned,
+where I<$href-E<gt>{$key}> holds the result value.  See L</touch> to
+learn what the result value is.
+
+B<touch> command first appeared in B<memcached> 1.4.8.
+
+=item C<gat>
+
+  $memd->gat($expiration_time, $key);
+
+Update the expiration time and retrieve the value for a I<$key>.
+
+I<$key> should be a scalar. I<$expiration_time> is a positive integer number
+of seconds after which the value will expire and wouldn't be accessible any
+longer.
+
+I<Return:> value associated with the I<$key>, or nothing.
+
+B<gat> command first appeared in B<memcached> 1.5.3.
+
+=item C<gat_multi>
+
+  $memd->gat_multi($expiration_time, @keys);
+
+Update the expiration time of the I<@keys> and get the associated values.
+I<@keys> should be an array of scalars.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$key}> holds
+corresponding value.
+
+B<gat> command first appeared in B<memcached> 1.5.3.
+
+=item C<gats>
+
+  $memd->gats($expiration_time, $key);
+
+Update the expiration time and Retrieve the value and its CAS for a I<$key>.
+
+I<Return:> reference to an array I<[$cas, $value]>, or nothing.  You
+may conveniently pass it back to L</cas> with I<@$res>:
+
+  my $cas_val = $memd->gats($expiration_time, $key);
+  # Update value.
+  if (defined $cas_val) {
+      $$cas_val[1] = 3;
+      $memd->cas($key, @$cas_val);
+  }
+
+B<gat> command first appeared in B<memcached> 1.5.3.
+
+=item C<gats_multi>
+
+  $memd->gats_multi($expiration_time, @keys);
+
+Update the expiration time and retrieve several values and their CASs
+associated with I<@keys>.
+I<@keys> should be an array of scalars.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$key}> holds a
+reference to an array I<[$cas, $value]>.  Compare with L</gats>.
+
+B<gat> command first appeared in B<memcached> 1.5.3.
+
+=item C<flush_all>
+
+  $memd->flush_all;
+  $memd->flush_all($delay);
+
+Flush all caches the client knows about.  This command invalidates all
+items in the caches, none of them will be returned on subsequent
+retrieval command.  I<$delay> is an optional non-negative integer
+number of seconds to delay the operation.  The delay will be
+distributed across the servers.  For instance, when you have three
+servers, and call C<flush_all(30)>, the servers would get 30, 15, 0
+seconds delays respectively.  When omitted, zero is assumed,
+i.e. flush immediately.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$server}> holds
+corresponding result value.  I<$server> is either I<host:port> or
+F</path/to/unix.sock>, as described in L</servers>.  Result value is a
+boolean, true for positive server reply, false for negative server
+reply, or I<undef> in case of some error.
+
+=item C<nowait_push>
+
+  $memd->nowait_push;
+
+Push all pending requests to the server(s), and wait for all replies.
+When L</nowait> mode is enabled, the requests issued in a void context
+may not reach the server(s) immediately (because the reply is not
+waited for).  Instead they may stay in the send queue on the local
+host, or in the receive queue on the remote host(s), for quite a long
+time.  This method ensures that they are delivered to the server(s),
+processed there, and the replies have arrived (or some error has
+happened that caused some connection(s) to be closed).
+
+Buffered counters (see L</counter_buffer_size>) are flushed first.
+
+Destructor will call this method to ensure that all requests are
+processed before the connection is closed.
+
+I<Return:> nothing.
+
+=item C<flush_counters>
+
+  $memd->flush_counters;
+
+Send the deltas buffered with L</counter_buffer_size> to the servers
+now.
+
+I<Return:> nothing.
+
+=item C<update_slab_classes>
+
+  $memd->update_slab_classes;
+
+Fetch C<stats settings> from all servers, and compute chunk sizes of
+their slab classes for L</compress_slab_aware>.  Call it after the
+client is created, and again when the server settings or the server
+list change; L</set> and friends never fetch the settings themselves.
+
+I<Return:> boolean, true when the classes are known.  False without
+L</compress_slab_aware>, or when no server reported the settings.
+
+=item C<server_versions>
+
+  $memd->server_versions;
+
+Get server versions.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$server}> holds
+corresponding server version.  I<$server> is either I<host:port> or
+F</path/to/unix.sock>, as described in L</servers>.
+
+=item C<servers_for_keys>
+
+  my $indexes = $memd->servers_for_keys(\@keys);
+
+Find the servers the keys are dispatched to, without sending any
+request.  The result accounts for L</dispatch_mode>,
+L</hash_function>, L</hash_namespace> and L</hash_tags>, and is the
+server that L</set> would write the key to: reads spread over
+L</replicas>, with or without L</bounded_load>, may go elsewhere.
+
+I<Return:> reference to array, where I<$aref-E<gt>[$i]> is the
+position in L</servers> of the server for I<$keys[$i]>, or I<undef>
+if there are no servers.
+
+=item C<keys_by_server>
+
+  my $groups = $memd->keys_by_server(\@keys);
+  while (my ($server, $keys) = each %$groups) {
+      ...
+  }
+
+Group the keys by the server they are dispatched to, the same as
+L</servers_for_keys>, for instance to schedule the work of a batch
+job per server.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$server}> holds a
+reference to the array of keys that are dispatched to I<$server>, in
+their original order.  I<$server> is either I<host:port> or
+F</path/to/unix.sock>, as described in L</servers>.
+
+=item C<set_servers>
+
+  $memd->set_servers([ 'host1:11211', { address => 'host2:11211',
+                                        weight => 2 } ]);
+
+Replace the list of servers without creating a new client.  The
+argument is the same as for L</servers>.  Connections to the servers
+that stay in the list with the same address, weight and I<noreply> are
+kept, so that changing one server doesn't make every process
+reconnect to all of them.  Keys are dispatched the same as by a new
+client with this list, so all processes that apply the same change
+agree on where the keys are.  Threads created afterwards start with
+the new list.
+
+I<Return:> nothing.
+
+=item C<add_server>
+
+  $memd->add_server('host3:11211');
+  $memd->add_server({ address => 'host3:11211', weight => 2 });
+
+Add a server to the end of the list, the same as L</set_servers> with
+the server appended.
+
+I<Return:> nothing.
+
+=item C<remove_server>
+
+  $memd->remove_server('host3:11211');
+
+Remove all servers with the address from the list, the same as
+L</set_servers> without them.
+
+I<Return:> boolean, true if the server was in the list.
+
+=item C<prepare_keys>
+
+  my $prepared = $memd->prepare_keys(\@keys);
+  while (...) {
+      my $href = $prepared->get_multi;
+      ...
+  }
+
+Prepare a set of keys that is fetched over and over again.  The keys
+are dispatched and the B<get> requests for every server, with the
+L</namespace> applied, are built once, so I<$prepared-E<gt>get_multi>
+only sends the prebuilt requests and parses the replies.  It returns
+the same as L</get_multi> with I<@keys>.  The keys are prepared again
+when the servers or the namespace generation (see
+L</namespace_generation_key>) change, and in a new thread.  With
+L</near_cache_size>, L</shared_cache_size>, L</negative_cache_ttl>,
+L</hot_keys>, L</replicated_keys> or L</bounded_load> the keys are
+requested one by one as with L</get_multi>.
+
+The prepared object holds a reference to I<$memd>.
+
+I<Return:> the prepared object.
+
+=item C<near_cache_stats>
+
+  my $stats = $memd->near_cache_stats;
+
+Get statistics of the cache enabled with L</near_cache_size>.
+
+I<Return:> reference to hash with the keys I<hits>, I<misses>,
+I<evictions> (counted since the client was created), and I<entries>
+and I<bytes> (current number and size of cached entries).  Statistics
+of the cache enabled with L</shared_cache_size> are returned under
+the keys I<shared_hits>, I<shared_misses>, I<shared_stores> and
+I<shared_evictions>, and are counted by the calling process only.
+Statistics of the cache enabled with L</negative_cache_ttl> are
+returned under the keys I<negative_hits> (keys reported missing
+locally) and I<negative_stores> (keys remembered).  All values are
+zero when the respective cache is disabled.
+
+=item C<hot_keys>
+
+  my $top = $memd->hot_keys;
+  my $top10 = $memd->hot_keys(10);
+
+Get the most frequent keys tracked with L</hot_keys> constructor
+parameter.  The optional argument limits the number of returned keys.
+
+I<Return:> reference to array of hashes in the order of decreasing
+I<count>, every hash having the keys I<key> (without L</namespace>),
+I<count> (estimated number of requests), I<error> (upper bound of the
+overestimation of I<count>), I<rate> (estimated requests per second)
+and I<server> (the server the key maps to, as described in
+L</servers>, or C<undef> when it was removed since).  The array is
+empty when tracking is disabled.
+
+=item C<replicate_keys>
+
+  $memd->replicate_keys('front_page', 'config');
+
+Add keys to the set of L</replicated_keys>.  This affects only the
+current client object, see the note in L</replicated_keys>.
+
+I<Return:> nothing.
+
+=item C<unreplicate_keys>
+
+  $memd->unreplicate_keys('config');
+
+Remove keys from the set of L</replicated_keys>, so that they are
+stored on and read from their single server again.  The copies on the
+other replicas are left in place until they expire.  Like
+L</replicate_keys>, this affects only the current client object.
+
+I<Return:> nothing.
+
+=item C<disconnect_all>
+
+  $memd->disconnect_all;
+
+Closes all open sockets to memcached servers.  Must be called after
+L<perlfunc/fork> if the parent process has open sockets to memcacheds (as the
+child process inherits the socket and thus two processes end up using the same
+socket which leads to protocol errors.)
+
+I<Return:> nothing.
+
+=back
+
+=head1 Compatibility with Cache::Memcached
+
+This module is designed to be a drop in replacement for
+L<Cache::Memcached|Cache::Memcached>.  Where constructor parameters
+are the same as in Cache::Memcached, the default values are also the
+same, and new parameters are disabled by default (the exception is
+L</close_on_error>, which is absent in Cache::Memcached and enabled by
+default in this module, and L</check_args>, which see).  Internally
+Cache::Memcached::Fast uses the same hash function as
+Cache::Memcached, and thus should distribute the keys across several
+servers the same way.  So both modules may be used interchangeably.
+Most users of the original module should be able to use this module
+after replacing I<"Cache::Memcached"> with
+I<"Cache::Memcached::Fast">, without further code modifications.
+However, as of this release, the following features of
+Cache::Memcached are not supported by Cache::Memcached::Fast (and some
+of them will never be):
+
+=head2 Constructor parameters
+
+=over
+
+=item I<no_rehash>
+
+Current implementation never rehashes keys, instead L</max_failures>
+and L</failure_timeout> are used.
+
+If the client would rehash the keys, a consistency problem would
+arise: when the failure occurs the client can't tell whether the
+server is down, or there's a (transient) network failure.  While some
+clients might fail to reach a particular server, others may still
+reach it, so some clients will start rehashing, while others will not,
+and they will no longer agree which key goes where.
+
+=item I<readonly>
+
+Not supported.  Easy to add.  However I'm not sure about the demand
+for it, and it will slow down things a bit (because from design point
+of view it's better to add it on Perl side rather than on XS side).
+
+=item I<debug>
+
+Not supported.  Since the implementation is different, there can't be
+any compatibility on I<debug> level.
+
+=back
+
+=head2 Methods
+
+=over
+
+=item Passing keys
+
+Every key should be a scalar.  The syntax when key is a reference to
+an array I<[$precomputed_hash, $key]> is not supported.
+
+=item C<set_servers>
+
+Not supported.  Server set should not change after client object
+construction.
+
+=item C<set_debug>
+
+Not supported.  See L</debug>.
+
+=item C<set_readonly>
+
+Not supported.  See L</readonly>.
+
+=item C<set_norehash>
+
+Not supported.  See L</no_rehash>.
+
+=item C<set_compress_threshold>
+
+Not supported.  Easy to add.  Currently you specify
+I<compress_threshold> during client object construction.
+
+=item C<stats>
+
+Not supported.  Perhaps will appear in the future releases.
+
+=back
+
+=head1 Tainted data
+
+In current implementation tainted flag is neither tested nor
+preserved, storing tainted data and retrieving it back would clear
+tainted flag.  See L<perlsec|perlsec>.
+
+=head1 Threads
+
+This module is thread-safe when used with Perl >= 5.7.2.  As with
+other Perl data each thread gets its own copy of
+Cache::Memcached::Fast object that is in scope when the thread is
+created.  Such copies share no state, and may be used concurrently.
+For example:
+
+  use threads;
+
+  my $memd = Cache::Memcached::Fast->new({...});
+
+  sub thread_job {
+    $memd->set("key", "thread value");
+  }
+
+  threads->new(\&thread_job);
+  $memd->set("key", "main value");
+
+Here both C<set>s will be executed concurrently, and the value of
+I<key> will be either I<main value> or I<thread value>, depending on
+the timing of operations.  Note that C<$memd> inside C<thread_job>
+internally refers to a different Cache::Memcached::Fast object than
+C<$memd> from the outer scope.  Each object has its own connections to
+servers, its own counter of outstanding replies for L</nowait> mode,
+etc.
+
+New object copy is created with the same constructor arguments, but
+initially is not connected to any server (even when master copy has
+open connections).  No file descriptor is allocated until the command
+is executed through this new object.
+
+You may safely create Cache::Memcached::Fast object from threads other
+than main thread, and/or pass them as parameters to threads::new().
+However you can't return the object from top-level thread function.
+I.e., the following won't work:
+
+  use threads;
+
+  sub thread_job {
+    return Cache::Memcached::Fast->new({...});
+  }
+
+  my $thread = threads->new(\&thread_job);
+
+  my $memd = $thread->join;  # The object will be destroyed here.
+
+This is a Perl limitation (see L<threads/"BUGS AND LIMITATIONS">).
+
+=head1 SUPPORT
+
+The code repository is available for public review and contribution at
+L<https://github.com/JRaspass/Cache-Memcached-Fast>.
+
+Please report any bugs or feature requests through the issue tracker at
+L<https://github.com/JRaspass/Cache-Memcached-Fast/issues>.
+
+=head1 SEE ALSO
+
+=over
+
+=item *
+
+L<Cache::Memcached> - original pure Perl B<memcached> client.
+
+=item *
+
+L<https://memcached.org> - B<memcached> website.
+
+=back
+
+=head1 AUTHORS
+
+=over
+
+=item *
+
+Tomash Brechko <tomash.brechko@gmail.com> - design and implementation.
+
+=item *
+
+Michael Monashev <postmaster@softsearch.ru> - project management, design
+suggestions, testing.
+
+=item *
+
+James Raspass <jraspass@gmail.com> - recent additions and current maintenance.
+
+=back
+
+=head1 ACKNOWLEDGEMENTS
+
+Development of this module was sponsored by Monashev Co. Ltd.
+
+Thanks to Peter J. Holzer for enlightening on UTF-8 support.
+
+Thanks to Yasuhiro Matsumoto for the initial Win32 patch.
+
+=head1 COPYRIGHT AND LICENSE
+
+Copyright © 2007-2010 Tomash Brechko. All rights reserved. This program is
+free software; you can redistribute it and/or modify it under the same terms
+as Perl itself.
@@ -10,10 +10,16 @@ use XSLoader;
 
 my %instance;
 my %known_args = map { $_ => 1 } qw(
-    check_args close_on_error compress_algo compress_methods compress_ratio
-    compress_threshold connect_timeout failure_timeout hash_namespace
-    io_timeout ketama_points max_failures max_size namespace nowait
-    select_timeout serialize_methods servers utf8
+    bounded_load check_args chunk_size close_on_error compress_algo
+    compress_methods compress_ratio compress_slab_aware compress_threshold
+    connect_timeout counter_buffer_size counter_flush_interval dispatch_mode
+    dispatch_snapshot failure_timeout hash_function hash_namespace hash_tags
+    hot_keys hot_keys_sample io_timeout ketama_points lazy_deserialize
+    max_failures max_size namespace namespace_generation_key
+    namespace_generation_ttl near_cache_size near_cache_ttl
+    negative_cache_size negative_cache_ttl nowait replicas replicated_keys
+    select_timeout serialize_methods servers shared_cache_item_size
+    shared_cache_size utf8
 );
 
 sub new {
@@ -73,6 +79,66 @@ sub DESTROY {
     _destroy($memd);
 }
 
+sub set_servers {
+    my ( $memd, $servers ) = @_;
+
+    _set_servers( $memd, $servers );
+
+    # Threads started later build their clients with the new list.
+    my $context = $instance{$$memd};
+    $context->[1] = { %{ $context->[1] }, servers => [@$servers] };
+
+    return;
+}
+
+sub add_server {
+    my ( $memd, $server ) = @_;
+
+    my $servers = $instance{$$memd}[1]{servers} // [];
+    $memd->set_servers( [ @$servers, $server ] );
+
+    return;
+}
+
+sub remove_server {
+    my ( $memd, $address ) = @_;
+
+    my $servers = $instance{$$memd}[1]{servers} // [];
+    my @rest    = grep {
+        my $addr
+            = ref eq 'HASH'  ? $_->{address}
+            : ref eq 'ARRAY' ? $_->[0]
+            :                  $_;
+        ( $addr // '' ) ne $address;
+    } @$servers;
+    return 0 if @rest == @$servers;
+
+    $memd->set_servers( \@rest );
+
+    return 1;
+}
+
+sub prepare_keys {
+    my ( $memd, $keys ) = @_;
+
+    my %seen;
+    my $prepared = [ $memd, [ grep !$seen{$_}++, @$keys ], '' ];
+    _prepare_keys(@$prepared);
+
+    return bless $prepared, 'Cache::Memcached::Fast::PreparedKeys';
+}
+
+{
+    package Cache::Memcached::Fast::PreparedKeys;
+
+    # [ $memd, \@keys, $block ], the block is rebuilt when it is stale.
+    sub get_multi {
+        my $prepared = shift;
+
+        return Cache::Memcached::Fast::_get_prepared(@$prepared);
+    }
+}
+
 XSLoader::load;
 
 __END__
@@ -92,23 +158,46 @@ Cache::Memcached::Fast - Perl client for B<memcached>, in C language
                    '192.168.254.2:11211',
                    { address => '/path/to/unix.sock', noreply => 1 } ],
       namespace => 'my:',
+      namespace_generation_key => 'generation',
       connect_timeout => 0.2,
       io_timeout => 0.5,
       close_on_error => 1,
       compress_threshold => 100_000,
+      chunk_size => 512 * 1024,
       compress_ratio => 0.9,
+      compress_slab_aware => 1,
       compress_methods => [ \&IO::Compress::Gzip::gzip,
                             \&IO::Uncompress::Gunzip::gunzip ],
       max_failures => 3,
       failure_timeout => 2,
       ketama_points => 150,
+      dispatch_mode => 'ketama',
+      dispatch_snapshot => '/dev/shm/memcached-ring',
+      hash_function => 'crc32',
       nowait => 1,
       hash_namespace => 1,
+      hash_tags => 1,
       serialize_methods => [ \&Storable::freeze, \&Storable::thaw ],
       utf8 => 1,
+      lazy_deserialize => 1,
       max_size => 512 * 1024,
+      near_cache_size => 4 * 1024 * 1024,
+      near_cache_ttl => 0.5,
+      shared_cache_size => 64 * 1024 * 1024,
+      shared_cache_item_size => 8 * 1024,
+      negative_cache_ttl => 2,
+      hot_keys => 100,
+      hot_keys_sample => 100,
+      replicas => 2,
+      replicated_keys => ['front_page', 'config'],
+      bounded_load => 0.25,
+      counter_buffer_size => 1000,
+      counter_flush_interval => 0.5,
   });
 
+  # Compute slab classes for compress_slab_aware.
+  $memd->update_slab_classes;
+
   # Get server versions.
   my $versions = $memd->server_versions;
   while (my ($server, $version) = each %$versions) {
@@ -216,7 +305,8 @@ rational number), and I<noreply> (boolean flag).  The server address
 is in the form I<host:port> for network TCP connections, or
 F</path/to/unix.sock> for local Unix socket connections.  When weight
 is not given, 1 is assumed.  Client will distribute keys across
-servers proportionally to server weights.
+servers proportionally to server weights.  The list may be changed
+later with L</set_servers>.
 
 If you want to get key distribution compatible with Cache::Memcached,
 all server weights should be integer, and their sum should be less
@@ -267,6 +357,54 @@ examples above will use the same server, the one that I<'prefix/key'>
 is mapped to.  Note that there's no performance penalty then, as
 namespace prefix is hashed only once.  See L</namespace>.
 
+=item I<hash_tags>
+
+  hash_tags => 1
+  (default: disabled)
+
+The value is a boolean which enables (true) or disables (false) hash
+tags.  When enabled and a key contains I<'{'> followed by I<'}'>, only
+the part between the first I<'{'> and the first I<'}'> after it is
+hashed to select the server, like in Redis Cluster.  Thus
+
+  $memd->get_multi('user:{123}:profile', 'user:{123}:prefs');
+
+reads both keys from one server in a single round trip.  A key
+without a tag, or with an empty one like I<'{}'>, is hashed as a
+whole.  With L</hash_namespace> the namespace is hashed before the
+tag.  Keys that share a tag are never spread across servers, so a
+tag as hot as a whole server can't hold should be split.  Enabling
+hash tags moves tagged keys to other servers.
+
+=item I<namespace_generation_key>
+
+  namespace_generation_key => 'generation'
+  (default: disabled)
+
+The value is a key (within L</namespace>) that holds the generation
+number of the namespace.  When set, the generation followed by I<':'>
+is appended to the namespace prefix of all other keys, and
+L</invalidate_namespace> increments it, which makes all keys of the
+namespace unreachable with one command.  Old values are not deleted,
+they expire or get evicted by B<memcached> as usual.
+
+The generation is fetched when the client is first used and then
+every L</namespace_generation_ttl>.  If the key is missing, it is
+created with the current time (or the generation the client has seen
+last, if greater) as the initial generation, so that an evicted
+generation doesn't revive the keys of an old one.  Clients
+sharing a namespace should use the same key.  Since the generation
+isn't hashed (see L</hash_namespace>), keys stay on their servers.
+
+=item I<namespace_generation_ttl>
+
+  namespace_generation_ttl => 5
+  (default: 1 second)
+
+The value is a non-negative rational number of seconds to cache the
+namespace generation in the client.  Other clients see
+L</invalidate_namespace> at most this much later.
+
 =item I<nowait>
 
   nowait => 1
@@ -387,6 +525,28 @@ L</compress_threshold> triggers the compression, compressed size
 should be less or equal to S<(original-size * I<compress_ratio>)>.
 Otherwise the data will be stored uncompressed.
 
+=item I<compress_slab_aware>
+
+  compress_slab_aware => 1
+  (default: disabled)
+
+The value is a boolean.  memcached stores an item in a chunk of the
+smallest slab class that fits it, so compression that keeps the item
+in the same class saves no server memory but still costs CPU on every
+L</set> and L</get>.  When enabled, and once L</update_slab_classes>
+has computed the slab classes, the client skips compression for items
+that already fit the smallest class, and keeps the compressed result
+only when it moves the item to a smaller class, in addition to the
+L</compress_ratio> rule.  Items larger than all classes are handled as
+usual.
+
+The classes are computed from C<chunk_size>, C<growth_factor> and
+C<slab_chunk_max> (or C<item_size_max>) in C<stats settings> the same
+way memcached computes them, assuming the 48 byte item header of
+64-bit servers.  Servers started with custom C<slab_sizes> are not
+supported.  Until the classes are known, compression works as if this
+option was disabled.
+
 =item I<compress_methods>
 
   compress_methods => [ \&IO::Compress::Gzip::gzip,
@@ -454,6 +614,97 @@ integers each), so you probably shouldn't worry.
 Zero value disables the Ketama algorithm.  See also server weight in
 L</servers> above.
 
+=item I<dispatch_mode>
+
+  dispatch_mode => 'maglev'
+  (default: 'ketama')
+
+The value is the name of the algorithm that maps keys to servers:
+
+=over
+
+=item C<ketama>
+
+Ketama continuum when L</ketama_points> is positive, and
+B<Cache::Memcached> compatible dispatch otherwise.  It maps keys the
+same way as the earlier versions of this module; to share servers
+with B<libmemcached> based clients use C<ketama_md5>.
+
+=item C<jump>
+
+Jump consistent hash (L<http://arxiv.org/abs/1406.2294>).  Almost
+perfect balance and a small table.  A server of weight I<W> takes I<W>
+(rounded) buckets, and buckets are only ever appended, so servers
+should be added at the end of L</servers>: removing one from the
+middle remaps the keys of all servers after it.
+
+=item C<rendezvous>
+
+Weighted rendezvous (highest random weight) hashing.  Adding or
+removing a server only moves the keys that it gains or loses,
+wherever it is in the list, but a lookup costs time proportional to
+the number of servers.
+
+=item C<maglev>
+
+Maglev lookup table (65537 entries or 100 per server, whichever is
+larger).  Lookup is a single table read, and the balance is almost
+perfect, but changing the server list moves slightly more keys than
+the minimum.
+
+=item C<ketama_md5>
+
+The weighted MD5 Ketama continuum of B<libmemcached>
+(C<MEMCACHED_BEHAVIOR_KETAMA_WEIGHTED>), as used by PHP memcached,
+pylibmc and other clients built on it.  With the same server list,
+weights and port numbers, keys are mapped to the same servers, so
+clients in different languages share one cache.  Keys are always
+hashed with MD5, and L</hash_function> is ignored.  With
+L</hash_namespace> enabled the namespace is hashed together with the
+key, which matches C<MEMCACHED_BEHAVIOR_HASH_WITH_PREFIX_KEY>.
+Because every server gets points in proportion to its share of the
+total weight, adding a server moves a few keys between the other
+servers too.
+
+=back
+
+B<jump>, B<rendezvous>, B<maglev> and B<ketama_md5> ignore
+L</ketama_points>.  Use
+F<script/ketama-distr.pl> to compare key distribution and lookup
+speed of the modes for your server list.
+
+=item I<hash_function>
+
+  hash_function => 'xxh64'
+  (default: 'crc32')
+
+The value is the name of the function that hashes keys for
+L</dispatch_mode>, either C<crc32> or C<xxh64>
+(L<http://cyan4973.github.io/xxHash/>).  B<xxh64> hashes typical keys
+several times faster and has better distribution, but maps keys to
+different servers than B<crc32>, so other clients sharing the servers
+(including Cache::Memcached and older versions of this module) would
+look for the keys elsewhere.  Switching an existing deployment
+effectively starts with an empty cache.
+
+=item I<dispatch_snapshot>
+
+  dispatch_snapshot => '/dev/shm/memcached-ring'
+  (default: disabled)
+
+The value is a path to a file with the built continuum or table of
+L</dispatch_mode>.  If the file was made for the same L</servers>,
+weights, L</dispatch_mode> and L</ketama_points>, the constructor maps
+it read-only instead of building the tables.  Otherwise the tables are
+built and the file is replaced atomically.  Large rings then cost
+startup time once, and their memory is shared by all processes that
+use the file.  For preforking servers create the object in the parent
+before fork, or let the first worker write the file.  Use a path on a
+memory file system, like F</dev/shm>, and a separate path for every
+different server list, or the clients would rewrite the file in turn.
+The file is not used after the servers are changed with
+L</set_servers>.  Not supported on Win32.
+
 =item I<serialize_methods>
 
   serialize_methods => [ \&Storable::freeze, \&Storable::thaw ],
@@ -486,6 +737,24 @@ encoding on store, and the reverse conversion on fetch (when the
 retrieved data is marked as being UTF-8 octet sequence).  See
 L<perlunicode|perlunicode>.
 
+=item I<lazy_deserialize>
+
+  lazy_deserialize => 1
+  (default: disabled)
+
+The value is a boolean which enables (true) or disables (false) lazy
+decoding of values returned by L</get_multi> method family.  When
+enabled, values that need decompression, deserialization or UTF-8
+decoding are returned as is, with the decoding postponed until the
+value is first read.  Values that are never read are then never
+decoded, which saves CPU when only a few of many fetched values are
+used.
+
+Lazy values are ordinary scalars with attached magic, the decoding
+happens transparently on first access (including copying the value).
+Note that a value that fails to decode (see L</serialize_methods>) is
+still present in the result hash, and reads as I<undef>.
+
 =item I<max_size>
 
   max_size => 512 * 1024
@@ -502,6 +771,250 @@ S<I<[1MB - N bytes, 1MB]>>, where N is several hundreds, will still be
 sent to the server, and rejected there.  You may set I<max_size> to a
 smaller value to avoid this.
 
+=item I<chunk_size>
+
+  chunk_size => 512 * 1024
+  (default: disabled)
+
+The value is a number of bytes.  When set, values longer than
+I<chunk_size> (after serialization and compression) are split into
+chunks of this size, stored under separate keys, and the key itself
+holds a short manifest that lists them.  Chunk keys hash to different
+servers, so a large value is read from several servers in parallel.
+Use it together with a larger L</max_size>, which still limits the
+whole value, to store values over the B<memcached> item size limit.
+
+L</get>, L</gets>, L</gat>, L</gats> and their I<_multi> variants read
+the manifests first, then fetch the chunks of all of them with one
+request, and return the value reassembled.  Only clients with
+I<chunk_size> read chunked values, as other clients use the same flag
+bit for their own formats: without it, and for a manifest that is
+malformed or longer than L</max_size>, the stored text is returned as
+is.  A value with a missing chunk is returned as missing.
+
+A value is stored only if all its chunks are; when a chunk fails, the
+key gets the result of that chunk.  L</add>, L</replace> and L</cas>
+store the manifest first, and the chunks only once it is stored, so
+these commands wait for the reply even in a void context.  I<cas>
+applies to the manifest, and works as usual.  L</append> and
+L</prepend> never split values.  L</touch> applies only to the
+manifest.
+
+Chunk N of a value is stored under the key preceded by
+I<"{N:hash}">, where I<hash> is computed from the key.  Thus a new
+value replaces the chunks of the old one, and with L</hash_tags> the
+chunks of a tagged key still spread over the servers.  The chunks of a
+value that had more chunks than its replacement are left to be
+evicted.  A value whose chunk keys, with the namespace, would exceed
+the 250 byte B<memcached> key length limit is stored whole, as without
+I<chunk_size>, so it still has to fit the item size limit.  L</delete> and L</delete_multi> read the
+manifests of the keys with an extra request, and delete their chunks
+too.
+
+=item I<near_cache_size>
+
+  near_cache_size => 4 * 1024 * 1024
+  (default: disabled)
+
+The value is a maximum size in bytes of the in-process cache of
+L</get> and L</get_multi> results.  When set, values fetched with
+these methods are remembered in the client, and repeated fetches of
+the same keys are answered locally, without a round trip to the
+server, until the entry expires after L</near_cache_ttl>.  When the
+cache is full, least recently used entries are evicted.  Values are
+cached as received from the server, so they are still decompressed
+and deserialized on every fetch.
+
+Local L</set>, L</cas>, L</incr>, L</delete> and other updating
+methods drop the key from the cache, and L</flush_all> clears it.
+Updates made by other clients are not seen until the entry expires,
+so only enable the cache for data that may be slightly stale.
+L</gets> and L</gat> methods always go to the server.
+
+=item I<near_cache_ttl>
+
+  near_cache_ttl => 0.5
+  (default: 1)
+
+The value is a maximum time in seconds (fractional) an entry stays in
+the cache enabled with L</near_cache_size> or L</shared_cache_size>,
+i.e. the maximum staleness of the returned values.  B<get> replies
+don't carry the expiration time of the item, so every entry stays for
+the full I<near_cache_ttl>, even if the item expires on the server
+earlier.  Keep I<near_cache_ttl> below the shortest expiration time of
+the cached keys, or a value may be returned for up to
+I<near_cache_ttl> after it has expired.
+
+=item I<shared_cache_size>
+
+  shared_cache_size => 64 * 1024 * 1024
+  (default: disabled)
+
+The value is a size in bytes of the cache of L</get> and
+L</get_multi> results kept in anonymous shared memory.  The memory is
+mapped by L</new>, and is shared with all processes forked afterwards,
+so preforked workers created from one parent share a single copy of
+the hot values.  The cache is checked after the one enabled with
+L</near_cache_size>, and before going to the server.  Entries expire
+after L</near_cache_ttl>, and are invalidated and cleared the same way
+as in near cache, except that updates from the sibling processes are
+seen immediately.
+
+Readers never lock the memory, so a crashed or stopped process can't
+block others.  Only available on POSIX systems, L</new> croaks
+elsewhere.  Threads created with L<threads> get a new cache.
+
+=item I<shared_cache_item_size>
+
+  shared_cache_item_size => 8 * 1024
+  (default: 4096)
+
+The value is a maximum size in bytes of the value, the key and the
+L</namespace> together, that may be stored in the cache enabled with
+L</shared_cache_size>.  Every entry occupies this much memory, so
+larger values mean fewer entries.
+
+=item I<negative_cache_ttl>
+
+  negative_cache_ttl => 2
+  (default: disabled)
+
+The value is a time in seconds (fractional) to remember that a key was
+missing on the server.  When set, keys not found by L</get> and
+L</get_multi> are remembered, and are reported missing again without
+a round trip to the server until the time passes.  This helps when
+the same nonexistent keys are asked for over and over.
+
+Local L</set>, L</add>, L</cas> and other updating methods forget the
+key immediately, but keys stored by other clients are only seen after
+I<negative_cache_ttl>.  L</gets> and L</gat> methods always go to the
+server.
+
+=item I<negative_cache_size>
+
+  negative_cache_size => 1024 * 1024
+  (default: 65536)
+
+The value is a number of missing keys remembered by the cache enabled
+with L</negative_cache_ttl>.  Each key takes 16 bytes.  When the
+cache is full, the keys that expire first are forgotten.
+
+=item I<hot_keys>
+
+  hot_keys => 100
+  (default: disabled)
+
+The value is a number of the most frequent keys to track.  When set,
+the client samples keys sent to the servers by all methods, and
+maintains a fixed size summary of the most frequent ones, available
+with L</hot_keys> method.  Keys answered by the local caches (see
+L</near_cache_size>) are not counted, as they never reach a server.
+
+Tracking uses the I<SpaceSaving> algorithm: any key that makes more
+than 1/I<hot_keys> of the sampled traffic is guaranteed to be
+reported.  Counts are halved every minute, so the summary follows the
+recent traffic.
+
+=item I<hot_keys_sample>
+
+  hot_keys_sample => 10
+  (default: 100)
+
+The value is an average number of keys per one sampled key for
+L</hot_keys> tracking.  Keys are sampled at random intervals, so that
+regular access patterns do not bias the result.  Lower values give
+more precise counts at a higher cost, I<1> samples every key.
+
+=item I<replicated_keys>
+
+  replicated_keys => ['front_page', 'config']
+  (default: none)
+
+The value is a reference to an array of keys (without L</namespace>)
+that are stored on several servers, see L</replicas>.  Writes of such
+keys (including L</delete>, L</incr>, L</decr> and L</touch>) go to
+every replica, and L</get> reads from a random one, which spreads the
+load of a very hot key.  L</gets>, L</gat> and L</cas> always use the
+first replica, the server the key would map to without replication.
+As the outcome of L</cas> isn't known when the request is sent, it
+deletes the key on the other replicas, so that L</get> never reads the
+value it replaced.
+Use L</replicate_keys> to change the set at run time.
+
+The set of replicated keys is not promoted automatically from
+L</hot_keys>: all clients that write a key have to agree that it is
+replicated, or the replicas they don't update will serve stale
+values.
+
+=item I<replicas>
+
+  replicas => 3
+  (default: 2)
+
+The value is a number of servers that L</replicated_keys> are stored
+on, from I<1> to I<16>.  Replicas are the servers that follow the
+key's server on the continuum (see L</ketama_points>), so adding or
+removing a server moves few replicas.  When there are fewer servers,
+the keys are stored on all of them.
+
+=item I<bounded_load>
+
+  bounded_load => 0.25
+  (default: disabled)
+
+The value is a non-negative rational number.  When set, L</get> and
+L</get_multi> of a key in L</replicated_keys> skip a replica that got
+more than S<(1 + I<bounded_load>)> times its weighted share of the
+recent requests of this client in favour of another replica of the
+key.  This is consistent hashing with bounded loads: a skewed key
+distribution does not overload one server, and a small value spreads
+the load more evenly.  The loads are local to the client and decay
+over the last thousand or so requests.
+
+Reads are only moved between the replicas, which all hold the value,
+so bounded loads never turn a hit into a miss.  Keys that are not
+replicated are always read from their own server, and writes,
+L</gets>, L</gat> and L</cas> are never moved.  When all replicas
+are full, the key is read from a random one as without this option.
+
+=item I<counter_buffer_size>
+
+  counter_buffer_size => 1000
+  (default: disabled)
+
+The value is a number of keys.  When set, L</incr> and L</decr> (and
+their I<_multi> variants) called B<I<in a void context>> don't send
+anything, but add the delta to a per-key sum in the client.  The sums
+are sent as one batch of I<incr>/I<decr> commands with the next
+request after this number of different keys has accumulated, or after
+L</counter_flush_interval>, and also by L</flush_counters>,
+L</nowait_push> and the destructor.  A high-rate counter then costs
+one command per flush instead of one per call.
+
+Until they are flushed, buffered deltas are not visible to other
+clients, and to L</get> of this client.  Calling L</incr> or
+L</decr> in a non-void context sends the buffered delta of the key
+along with the command, so the returned value accounts for it.  An
+increment and a decrement of the same key are summed, so a decrement
+that memcached would have stopped at zero may be applied differently.
+Deltas are lost if the process exits without destroying the client,
+or if the flush fails.
+
+Each delta is sent with the L</namespace> it was buffered under, and
+changing the namespace flushes the buffer.  A child process started
+with L<fork|perlfunc/fork> drops the deltas buffered by its parent,
+which are left for the parent to flush.
+
+=item I<counter_flush_interval>
+
+  counter_flush_interval => 0.5
+  (default: 1 second)
+
+The value is a non-negative rational number of seconds that the first
+buffered delta may wait before the buffer is flushed, see
+L</counter_buffer_size>.  The buffer is checked when the client
+executes a request, there are no background timers.
+
 =item I<check_args>
 
   check_args => 'skip'
@@ -549,7 +1062,19 @@ argument set the namespace prefix to I<$string>, and return the old
 prefix.
 
 I<Return:> scalar, the namespace prefix that was in effect before the
-call.
+call.  The prefix doesn't include the L</namespace_generation_key>
+generation.
+
+=item C<invalidate_namespace>
+
+  $memd->invalidate_namespace;
+
+Increment the namespace generation stored under
+L</namespace_generation_key>, so that all keys of the current
+L</namespace> are no longer found.
+
+I<Return:> boolean, true for success, false for failure (including
+when I<namespace_generation_key> is not set).
 
 =item C<set>
 
@@ -789,7 +1314,8 @@ I<Return:> value associated with the I<$key>, or nothing.
   $memd->get_multi(@keys);
 
 Retrieve several values associated with I<@keys>.  I<@keys> should be
-an array of scalars.
+an array of scalars.  A key repeated in I<@keys> is requested from the
+server only once.
 
 I<Return:> reference to hash, where I<$href-E<gt>{$key}> holds
 corresponding value.
@@ -916,7 +1442,10 @@ Alias for L</delete>, for compatibility with B<Cache::Memcached>.
   $memd->delete_multi(@keys);
 
 Like L</delete>, but operates on more than one key.  Takes the list of
-keys.
+keys.  A repeated key is deleted once, and its result is returned for
+every occurrence: a key that existed reports true for all of its
+occurrences.  Version 0.28 and earlier deleted each occurrence in
+turn, so only the first one reported true.
 
 Note that multi commands are not all-or-nothing, some operations may
 succeed, while others may fail.
@@ -952,6 +1481,8 @@ B<touch> command first appeared in B<memcached> 1.4.8.
 
 Like L</touch>, but operates on more than one key.  Takes the list of
 references to arrays each holding I<$key> and optional I<$expiration_time>.
+A repeated key is touched once, with the first I<$expiration_time>
+given for it, and its result is returned for every occurrence.
 
 Note that multi commands are not all-or-nothing, some operations may
 succeed, while others may fail.
@@ -1054,11 +1585,34 @@ time.  This method ensures that they are delivered to the server(s),
 processed there, and the replies have arrived (or some error has
 happened that caused some connection(s) to be closed).
 
+Buffered counters (see L</counter_buffer_size>) are flushed first.
+
 Destructor will call this method to ensure that all requests are
 processed before the connection is closed.
 
 I<Return:> nothing.
 
+=item C<flush_counters>
+
+  $memd->flush_counters;
+
+Send the deltas buffered with L</counter_buffer_size> to the servers
+now.
+
+I<Return:> nothing.
+
+=item C<update_slab_classes>
+
+  $memd->update_slab_classes;
+
+Fetch C<stats settings> from all servers, and compute chunk sizes of
+their slab classes for L</compress_slab_aware>.  Call it after the
+client is created, and again when the server settings or the server
+list change; L</set> and friends never fetch the settings themselves.
+
+I<Return:> boolean, true when the classes are known.  False without
+L</compress_slab_aware>, or when no server reported the settings.
+
 =item C<server_versions>
 
   $memd->server_versions;
@@ -1069,6 +1623,147 @@ I<Return:> reference to hash, where I<$href-E<gt>{$server}> holds
 corresponding server version.  I<$server> is either I<host:port> or
 F</path/to/unix.sock>, as described in L</servers>.
 
+=item C<servers_for_keys>
+
+  my $indexes = $memd->servers_for_keys(\@keys);
+
+Find the servers the keys are dispatched to, without sending any
+request.  The result accounts for L</dispatch_mode>,
+L</hash_function>, L</hash_namespace> and L</hash_tags>, and is the
+server that L</set> would write the key to: reads spread over
+L</replicas>, with or without L</bounded_load>, may go elsewhere.
+
+I<Return:> reference to array, where I<$aref-E<gt>[$i]> is the
+position in L</servers> of the server for I<$keys[$i]>, or I<undef>
+if there are no servers.
+
+=item C<keys_by_server>
+
+  my $groups = $memd->keys_by_server(\@keys);
+  while (my ($server, $keys) = each %$groups) {
+      ...
+  }
+
+Group the keys by the server they are dispatched to, the same as
+L</servers_for_keys>, for instance to schedule the work of a batch
+job per server.
+
+I<Return:> reference to hash, where I<$href-E<gt>{$server}> holds a
+reference to the array of keys that are dispatched to I<$server>, in
+their original order.  I<$server> is either I<host:port> or
+F</path/to/unix.sock>, as described in L</servers>.
+
+=item C<set_servers>
+
+  $memd->set_servers([ 'host1:11211', { address => 'host2:11211',
+                                        weight => 2 } ]);
+
+Replace the list of servers without creating a new client.  The
+argument is the same as for L</servers>.  Connections to the servers
+that stay in the list with the same address, weight and I<noreply> are
+kept, so that changing one server doesn't make every process
+reconnect to all of them.  Keys are dispatched the same as by a new
+client with this list, so all processes that apply the same change
+agree on where the keys are.  Threads created afterwards start with
+the new list.
+
+I<Return:> nothing.
+
+=item C<add_server>
+
+  $memd->add_server('host3:11211');
+  $memd->add_server({ address => 'host3:11211', weight => 2 });
+
+Add a server to the end of the list, the same as L</set_servers> with
+the server appended.
+
+I<Return:> nothing.
+
+=item C<remove_server>
+
+  $memd->remove_server('host3:11211');
+
+Remove all servers with the address from the list, the same as
+L</set_servers> without them.
+
+I<Return:> boolean, true if the server was in the list.
+
+=item C<prepare_keys>
+
+  my $prepared = $memd->prepare_keys(\@keys);
+  while (...) {
+      my $href = $prepared->get_multi;
+      ...
+  }
+
+Prepare a set of keys that is fetched over and over again.  The keys
+are dispatched and the B<get> requests for every server, with the
+L</namespace> applied, are built once, so I<$prepared-E<gt>get_multi>
+only sends the prebuilt requests and parses the replies.  It returns
+the same as L</get_multi> with I<@keys>.  The keys are prepared again
+when the servers or the namespace generation (see
+L</namespace_generation_key>) change, and in a new thread.  With
+L</near_cache_size>, L</shared_cache_size>, L</negative_cache_ttl>,
+L</hot_keys>, L</replicated_keys> or L</bounded_load> the keys are
+requested one by one as with L</get_multi>.
+
+The prepared object holds a reference to I<$memd>.
+
+I<Return:> the prepared object.
+
+=item C<near_cache_stats>
+
+  my $stats = $memd->near_cache_stats;
+
+Get statistics of the cache enabled with L</near_cache_size>.
+
+I<Return:> reference to hash with the keys I<hits>, I<misses>,
+I<evictions> (counted since the client was created), and I<entries>
+and I<bytes> (current number and size of cached entries).  Statistics
+of the cache enabled with L</shared_cache_size> are returned under
+the keys I<shared_hits>, I<shared_misses>, I<shared_stores> and
+I<shared_evictions>, and are counted by the calling process only.
+Statistics of the cache enabled with L</negative_cache_ttl> are
+returned under the keys I<negative_hits> (keys reported missing
+locally) and I<negative_stores> (keys remembered).  All values are
+zero when the respective cache is disabled.
+
+=item C<hot_keys>
+
+  my $top = $memd->hot_keys;
+  my $top10 = $memd->hot_keys(10);
+
+Get the most frequent keys tracked with L</hot_keys> constructor
+parameter.  The optional argument limits the number of returned keys.
+
+I<Return:> reference to array of hashes in the order of decreasing
+I<count>, every hash having the keys I<key> (without L</namespace>),
+I<count> (estimated number of requests), I<error> (upper bound of the
+overestimation of I<count>), I<rate> (estimated requests per second)
+and I<server> (the server the key maps to, as described in
+L</servers>, or C<undef> when it was removed since).  The array is
+empty when tracking is disabled.
+
+=item C<replicate_keys>
+
+  $memd->replicate_keys('front_page', 'config');
+
+Add keys to the set of L</replicated_keys>.  This affects only the
+current client object, see the note in L</replicated_keys>.
+
+I<Return:> nothing.
+
+=item C<unreplicate_keys>
+
+  $memd->unreplicate_keys('config');
+
+Remove keys from the set of L</replicated_keys>, so that they are
+stored on and read from their single server again.  The copies on the
+other replicas are left in place until they expire.  Like
+L</replicate_keys>, this affects only the current client object.
+
+I<Return:> nothing.
+
 =item C<disconnect_all>
 
   $memd->disconnect_all;
@@ -33,6 +33,13 @@ weight 1.
 B<Two or more.>  Specifies a server.  May be given multiple
 times.  Default I<WEIGHT> is 1.
 
+=item C<--keys, -n NUM>
+
+Also dispatch I<NUM> keys with Cache::Memcached::Fast in every
+I<dispatch_mode>, and report the spread of key shares relative to
+server weights, the share of keys moved when the last server is
+removed, and the lookup rate.
+
 =back
 
 =cut
@@ -40,9 +47,10 @@ times.  Default I<WEIGHT> is 1.
 use Getopt::Long qw(:config gnu_getopt);
 use Pod::Usage;
 use String::CRC32;
+use Time::HiRes qw(time);
 
 my %options;
-if (   !GetOptions( \%options, qw(ketama_points|k=i server|s=s@) )
+if (   !GetOptions( \%options, qw(ketama_points|k=i server|s=s@ keys|n=i) )
     || @ARGV
     || grep( { not defined } @options{qw(ketama_points server)} )
     || $options{ketama_points} <= 0
@@ -125,3 +133,59 @@ my $total_points = compute( \&compute_new );
 say '';
 my $int_size = 4;
 say 'Continuum array size = ', $total_points * $int_size * 2, ' bytes';
+
+exit unless $options{keys};
+
+require Cache::Memcached::Fast;
+
+my @servers = map {
+    my ( $address, $weight ) = /^([^:]+:[^:]+)(?::(.+))?$/;
+    { address => $address, weight => $weight // 1 }
+} @{ $options{server} };
+my @keys = map {"key$_"} 1 .. $options{keys};
+
+sub dispatch {
+    my ( $mode, @servers ) = @_;
+
+    my $memd = Cache::Memcached::Fast->new(
+        {   servers       => \@servers,
+            ketama_points => $options{ketama_points},
+            dispatch_mode => $mode,
+        }
+    );
+
+    # The first lookup builds the tables, don't count it.
+    $memd->servers_for_keys( [''] );
+
+    my $start   = time;
+    my @indexes = @{ $memd->servers_for_keys(\@keys) };
+    my $elapsed = time - $start;
+
+    return ( $elapsed, @indexes );
+}
+
+say '';
+say "Dispatch of $options{keys} keys:";
+my $total_weight = 0;
+$total_weight += $_->{weight} foreach @servers;
+foreach my $mode (qw(ketama jump rendezvous maglev ketama_md5)) {
+    my ( $elapsed, @indexes ) = dispatch( $mode, @servers );
+    my ( undef, @shrunk ) = dispatch( $mode, @servers[ 0 .. $#servers - 1 ] );
+
+    my @count = (0) x @servers;
+    ++$count[$_] foreach @indexes;
+
+    my ( $min, $max ) = ( 9**9**9, 0 );
+    for my $i ( 0 .. $#servers ) {
+        my $share = @keys * $servers[$i]{weight} / $total_weight;
+        my $ratio = $count[$i] / $share;
+        $min = $ratio if $ratio < $min;
+        $max = $ratio if $ratio > $max;
+    }
+
+    my $moved = grep { $indexes[$_] != $shrunk[$_] } 0 .. $#keys;
+
+    printf(
+        "%-10s  share/weight = %.3f .. %.3f  moved = %.2f%%  %.0f keys/s\n",
+        $mode, $min, $max, $moved * 100 / @keys, @keys / $elapsed );
+}
@@ -0,0 +1,88 @@
+#! /usr/bin/perl
+# -*- cperl -*-
+#
+# Copyright (C) 2009 Tomash Brechko.  All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the same terms as Perl itself, either Perl version 5.8.8
+# or, at your option, any later version of Perl 5 you may have
+# available.
+#
+use v5.12;
+use warnings;
+
+=head1 NAME
+
+startup-benchmark.pl - measure client creation time for large server
+lists.
+
+=head1 SYNOPSIS
+
+  startup-benchmark.pl [OPTIONS]
+
+=head1 OPTIONS
+
+=over
+
+=item C<--servers, -n NUM>
+
+Number of servers, default is 500.  The servers don't have to exist,
+addresses are 127.0.0.1 with ports starting at 20000, so that the
+first request fails fast with "connection refused".
+
+=item C<--ketama_points, -k NUM>
+
+Number of ketama points per server of weight 1, default is 150.  Zero
+selects Cache::Memcached compatible dispatch.
+
+=item C<--count, -c NUM>
+
+Number of clients to create, default is 20.
+
+=back
+
+Both new() and the first key lookup are timed, because the continuum
+is finished lazily on the first lookup.
+
+=cut
+
+use Getopt::Long qw(:config gnu_getopt);
+use Pod::Usage;
+use Time::HiRes qw(time);
+use Cache::Memcached::Fast;
+
+my %options = ( servers => 500, ketama_points => 150, count => 20 );
+if (   !GetOptions( \%options, qw(servers|n=i ketama_points|k=i count|c=i) )
+    || @ARGV
+    || $options{servers} <= 0
+    || $options{ketama_points} < 0
+    || $options{count} <= 0 )
+{
+    pod2usage(1);
+}
+
+my @servers = map {
+    { address => '127.0.0.1:' . ( 20000 + $_ ), weight => 1 + $_ % 3 }
+} 0 .. $options{servers} - 1;
+
+my ( $new_time, $lookup_time ) = ( 0, 0 );
+for ( 1 .. $options{count} ) {
+    my $start = time;
+    my $memd  = Cache::Memcached::Fast->new(
+        {   servers         => \@servers,
+            ketama_points   => $options{ketama_points},
+            connect_timeout => 0.01,
+        }
+    );
+    my $created = time;
+    $memd->get('key');
+    my $done = time;
+
+    $new_time    += $created - $start;
+    $lookup_time += $done - $created;
+}
+
+printf "%d servers, %d ketama points, %d clients\n",
+    @options{qw(servers ketama_points count)};
+printf "new():        %8.3f ms\n", $new_time * 1000 / $options{count};
+printf "first lookup: %8.3f ms\n", $lookup_time * 1000 / $options{count};
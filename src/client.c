@@ -26,10 +26,22 @@
 #include "connect.h"
 #include "parse_keyword.h"
 #include "dispatch_key.h"
+#include "near_cache.h"
+#include "shm_cache.h"
+#include "negative_cache.h"
+#include "hot_keys.h"
+#include "key_set.h"
+#include "key_dedup.h"
+#include "counter_buffer.h"
+#include "time_ms.h"
+#include "xorshift.h"
+#include "fork_count.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
+#include <limits.h>
+#include <math.h>
 #ifndef WIN32
 #include "socket_posix.h"
 #include <sys/uio.h>
@@ -45,6 +57,18 @@
 #define REPLY_BUF_SIZE  1536
 
 
+#define MAX_REPLICAS  DISPATCH_MAX_REPLICAS
+
+/*
+  Server loads for bounded_load are counted over about this many
+  recent requests.
+*/
+#define LOAD_WINDOW  1024
+
+/* The memcached key length limit.  */
+#define KEY_LEN_MAX  250
+
+
 #define FLAGS_STUB  "4294967295"
 #define EXPTIME_STUB  "2147483647"
 #define DELAY_STUB  "4294967295"
@@ -66,6 +90,12 @@ struct value_state
   void *ptr;
   value_size_type size;
   struct meta_object meta;
+
+  int fill_cache;
+  int record_misses;
+  void *beg;
+  value_size_type total;
+  struct iovec *key;
 };
 
 
@@ -204,6 +234,8 @@ struct server
   char *port;
   int failure_count;
   time_t failure_expires;
+  double weight;
+  double load;                  /* Recent requests, see count_load().  */
   struct command_state cmd_state;
 };
 
@@ -212,7 +244,7 @@ static inline
 int
 server_init(struct server *s, struct client *c,
             const char *host, size_t host_len,
-            const char *port, size_t port_len, int noreply)
+            const char *port, size_t port_len, double weight, int noreply)
 {
   if (port)
     s->host = (char *) malloc(host_len + 1 + port_len + 1);
@@ -239,6 +271,8 @@ server_init(struct server *s, struct client *c,
 
   s->failure_count = 0;
   s->failure_expires = 0;
+  s->weight = weight;
+  s->load = 0.0;
 
   if (command_state_init(&s->cmd_state, c, noreply) != 0)
     return MEMCACHED_FAILURE;
@@ -278,11 +312,50 @@ struct client
 {
   struct array pollfds;
   struct array servers;
+  size_t servers_version;       /* Changes with the list of servers.  */
 
   struct dispatch_state dispatch;
 
-  char *prefix;
+  struct near_cache *near_cache;
+  struct shm_cache *shared_cache;
+  struct negative_cache *negative_cache;
+  struct hot_keys *hot_keys;
+  int hot_keys_skip;
+
+  struct key_set *replicated;
+  int replicas;
+  int dispatch_server;          /* Overrides dispatch_key() if not -1.  */
+  struct array dispatch_batch;  /* key_index -> server from dispatch_keys().  */
+  double bounded_load;          /* Allowed excess load, 0 is disabled.  */
+  double load_total;
+  double total_weight;
+  unsigned int rng;
+  unsigned int rng_fork;        /* See xorshift_reseed().  */
+
+  struct key_dedup *batch_keys;
+  int batch_key_count;          /* Keys passed to duplicate_key().  */
+  const char *batch_first_key;
+  size_t batch_first_key_len;
+  int batch_first_index;
+  struct array next_duplicate;  /* key_index -> next duplicate or -1.  */
+
+  struct counter_buffer *counters;
+  size_t counters_max_keys;
+  int counters_interval;        /* 1/1000 sec.  */
+  time_ms_type counters_since;
+  int counters_force;
+  unsigned int counters_fork;   /* fork_count() that queued the deltas.  */
+
+  char *prefix;                 /* " " namespace [ns_gen ":"]  */
   size_t prefix_len;
+  size_t ns_len;
+
+  char *ns_gen_key;
+  size_t ns_gen_key_len;
+  char ns_gen[24];
+  size_t ns_gen_len;
+  int ns_gen_ttl;               /* 1/1000 sec.  */
+  time_ms_type ns_gen_expires;
 
   int connect_timeout;          /* 1/1000 sec.  */
   int io_timeout;               /* 1/1000 sec.  */
@@ -373,6 +446,9 @@ client_init()
 {
   struct client *c;
 
+  if (fork_count_init() == -1)
+    return NULL;
+
 #ifdef WIN32
   if (win32_socket_library_acquire() != 0)
     return NULL;
@@ -384,15 +460,41 @@ client_init()
 
   array_init(&c->pollfds);
   array_init(&c->servers);
+  c->servers_version = 0;
   array_init(&c->index_list);
   array_init(&c->str_buf);
 
   dispatch_init(&c->dispatch);
 
+  c->near_cache = NULL;
+  c->shared_cache = NULL;
+  c->negative_cache = NULL;
+  c->hot_keys = NULL;
+
+  c->replicated = NULL;
+  c->replicas = 2;
+  c->dispatch_server = -1;
+  array_init(&c->dispatch_batch);
+  c->bounded_load = 0.0;
+  c->load_total = 0.0;
+  c->total_weight = 0.0;
+  c->rng = XORSHIFT_SEED;
+  c->rng_fork = 0;
+
+  c->batch_keys = NULL;
+  c->batch_key_count = 0;
+  array_init(&c->next_duplicate);
+
+  c->counters = NULL;
+  c->counters_fork = 0;
+
   c->connect_timeout = 250;
   c->io_timeout = 1000;
   c->prefix = " ";
   c->prefix_len = 1;
+  c->ns_len = 0;
+  c->ns_gen_key = NULL;
+  c->ns_gen_len = 0;
   c->max_failures = 0;
   c->failure_timeout = 10;
   c->close_on_error = 1;
@@ -420,6 +522,7 @@ client_destroy(struct client *c)
 {
   struct server *s;
 
+  client_flush_counters(c);
   client_nowait_push(c);
   client_noreply_push(c);
 
@@ -428,6 +531,23 @@ client_destroy(struct client *c)
 
   dispatch_destroy(&c->dispatch);
 
+  if (c->near_cache)
+    near_cache_destroy(c->near_cache);
+  if (c->shared_cache)
+    shm_cache_destroy(c->shared_cache);
+  if (c->negative_cache)
+    negative_cache_destroy(c->negative_cache);
+  if (c->hot_keys)
+    hot_keys_destroy(c->hot_keys);
+  if (c->replicated)
+    key_set_destroy(c->replicated);
+  if (c->batch_keys)
+    key_dedup_destroy(c->batch_keys);
+  if (c->counters)
+    counter_buffer_destroy(c->counters);
+  array_destroy(&c->next_duplicate);
+  array_destroy(&c->dispatch_batch);
+
   array_destroy(&c->servers);
   array_destroy(&c->pollfds);
   array_destroy(&c->index_list);
@@ -435,6 +555,7 @@ client_destroy(struct client *c)
 
   if (c->prefix_len > 1)
     free(c->prefix);
+  free(c->ns_gen_key);
   free(c);
 
 #ifdef WIN32
@@ -472,6 +593,33 @@ client_set_ketama_points(struct client *c, int ketama_points)
 }
 
 
+int
+client_set_dispatch_mode(struct client *c, enum dispatch_mode_e mode)
+{
+  /* Should be called before we added any server.  */
+  if (! array_empty(c->servers))
+    return MEMCACHED_FAILURE;
+
+  dispatch_set_mode(&c->dispatch, mode);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+int
+client_set_hash_function(struct client *c,
+                         enum dispatch_hash_e hash_function)
+{
+  /* Should be called before we added any server.  */
+  if (! array_empty(c->servers))
+    return MEMCACHED_FAILURE;
+
+  dispatch_set_hash_function(&c->dispatch, hash_function);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
 void
 client_set_connect_timeout(struct client *c, int to)
 {
@@ -514,6 +662,13 @@ client_set_nowait(struct client *c, int enable)
 }
 
 
+void
+client_set_hash_tags(struct client *c, int enable)
+{
+  dispatch_set_hash_tags(&c->dispatch, enable);
+}
+
+
 void
 client_set_hash_namespace(struct client *c, int enable)
 {
@@ -522,740 +677,2150 @@ client_set_hash_namespace(struct client *c, int enable)
 
 
 int
-client_add_server(struct client *c, const char *host, size_t host_len,
-                  const char *port, size_t port_len, double weight,
-                  int noreply)
+client_set_near_cache(struct client *c, size_t max_bytes, int ttl)
 {
-  int res;
-
-  if (weight <= 0.0)
-    return MEMCACHED_FAILURE;
+  if (c->near_cache)
+    {
+      near_cache_destroy(c->near_cache);
+      c->near_cache = NULL;
+    }
 
-  if (array_extend(c->pollfds, struct pollfd, 1, ARRAY_EXTEND_EXACT) == -1)
-    return MEMCACHED_FAILURE;
+  if (max_bytes == 0 || ttl <= 0)
+    return MEMCACHED_SUCCESS;
 
-  if (array_extend(c->servers, struct server, 1, ARRAY_EXTEND_EXACT) == -1)
+  c->near_cache = near_cache_init(max_bytes, ttl);
+  if (! c->near_cache)
     return MEMCACHED_FAILURE;
 
-  res = server_init(array_end(c->servers, struct server), c,
-                    host, host_len, port, port_len, noreply);
-  if (res != MEMCACHED_SUCCESS)
-    return res;
-
-  res = dispatch_add_server(&c->dispatch, host, host_len, port, port_len,
-                            weight, array_size(c->servers));
-  if (res == -1)
-    return MEMCACHED_FAILURE;
+  return MEMCACHED_SUCCESS;
+}
 
-  array_push(c->pollfds);
-  array_push(c->servers);
 
-  return MEMCACHED_SUCCESS;
+void
+client_get_near_cache_stats(struct client *c, struct near_cache_stats *stats)
+{
+  if (c->near_cache)
+    near_cache_get_stats(c->near_cache, stats);
+  else
+    memset(stats, 0, sizeof(*stats));
 }
 
 
 int
-client_set_prefix(struct client *c, const char *ns, size_t ns_len)
+client_set_shared_cache(struct client *c, size_t size, size_t item_size,
+                        int ttl)
 {
-  char *s;
-
-  if (ns_len == 0)
+  if (c->shared_cache)
     {
-      if (c->prefix_len > 1)
-        {
-          free(c->prefix);
-          c->prefix = " ";
-          c->prefix_len = 1;
-        }
-
-      if (c->hash_namespace)
-        dispatch_set_prefix(&c->dispatch, "", 0);
-
-      return MEMCACHED_SUCCESS;
+      shm_cache_destroy(c->shared_cache);
+      c->shared_cache = NULL;
     }
 
-  if (c->prefix_len == 1)
-    c->prefix = NULL;
-  s = (char *) realloc(c->prefix, 1 + ns_len + 1);
-  if (! s)
+  if (size == 0 || ttl <= 0)
+    return MEMCACHED_SUCCESS;
+
+  c->shared_cache = shm_cache_init(size, item_size, ttl);
+  if (! c->shared_cache)
     return MEMCACHED_FAILURE;
 
-  s[0] = ' ';
-  memcpy(s + 1, ns, ns_len);
-  s[ns_len + 1] = '\0';
+  return MEMCACHED_SUCCESS;
+}
 
-  c->prefix = s;
-  c->prefix_len = 1 + ns_len;
 
-  if (c->hash_namespace)
-    dispatch_set_prefix(&c->dispatch, ns, ns_len);
+void
+client_get_shared_cache_stats(struct client *c,
+                              struct shared_cache_stats *stats)
+{
+  if (c->shared_cache)
+    shm_cache_get_stats(c->shared_cache, stats);
+  else
+    memset(stats, 0, sizeof(*stats));
+}
+
+
+int
+client_set_negative_cache(struct client *c, size_t size, int ttl)
+{
+  if (c->negative_cache)
+    {
+      negative_cache_destroy(c->negative_cache);
+      c->negative_cache = NULL;
+    }
+
+  if (size == 0 || ttl <= 0)
+    return MEMCACHED_SUCCESS;
+
+  c->negative_cache = negative_cache_init(size, ttl);
+  if (! c->negative_cache)
+    return MEMCACHED_FAILURE;
 
   return MEMCACHED_SUCCESS;
 }
 
 
-const char *
-client_get_prefix(struct client *c, size_t *ns_len)
+void
+client_get_negative_cache_stats(struct client *c,
+                                struct negative_cache_stats *stats)
 {
-  *ns_len = c->prefix_len - 1;
-
-  return (c->prefix + 1);
+  if (c->negative_cache)
+    negative_cache_get_stats(c->negative_cache, stats);
+  else
+    memset(stats, 0, sizeof(*stats));
 }
 
 
-static inline
-ssize_t
-read_restart(int fd, void *buf, size_t size)
+int
+client_set_hot_keys(struct client *c, int capacity, int sample)
 {
-  ssize_t res;
+  if (c->hot_keys)
+    {
+      hot_keys_destroy(c->hot_keys);
+      c->hot_keys = NULL;
+    }
 
-  do
-    res = read(fd, buf, size);
-  while (res == -1 && errno == EINTR);
+  if (capacity <= 0)
+    return MEMCACHED_SUCCESS;
 
-  return res;
+  c->hot_keys = hot_keys_init(capacity, (sample > 0 ? sample : 1));
+  if (! c->hot_keys)
+    return MEMCACHED_FAILURE;
+
+  c->hot_keys_skip = 1;
+
+  return MEMCACHED_SUCCESS;
 }
 
 
-static inline
-ssize_t
-readv_restart(int fd, const struct iovec *iov, int count)
+int
+client_get_hot_keys(struct client *c, const struct hot_key_stat **stats)
 {
-  ssize_t res;
-
-  do
-    res = readv(fd, iov, count);
-  while (res == -1 && errno == EINTR);
+  if (! c->hot_keys)
+    return 0;
 
-  return res;
+  return hot_keys_get(c->hot_keys, stats);
 }
 
 
-#ifndef MSG_NOSIGNAL
-
-static inline
-ssize_t
-writev_restart(int fd, const struct iovec *iov, int count)
+int
+client_set_replicas(struct client *c, int replicas)
 {
-  ssize_t res;
+  if (replicas < 1 || replicas > MAX_REPLICAS)
+    return MEMCACHED_FAILURE;
 
-  do
-    res = writev(fd, iov, count);
-  while (res == -1 && errno == EINTR);
+  c->replicas = replicas;
 
-  return res;
+  return MEMCACHED_SUCCESS;
 }
 
-#else  /* MSG_NOSIGNAL */
 
-static inline
-ssize_t
-writev_restart(int fd, const struct iovec *iov, int count)
+int
+client_set_dispatch_snapshot(struct client *c, const char *path)
 {
-  struct msghdr msg;
-  ssize_t res;
-
-  memset(&msg, 0, sizeof(msg));
-  msg.msg_iov = (struct iovec *) iov;
-  msg.msg_iovlen = count;
+  if (dispatch_load_snapshot(&c->dispatch, path) == 0)
+    return MEMCACHED_SUCCESS;
 
-  do
-    res = sendmsg(fd, &msg, MSG_NOSIGNAL);
-  while (res == -1 && errno == EINTR);
+  /*
+    Map the file we've written too, so that processes forked later
+    share it with us.
+  */
+  if (dispatch_save_snapshot(&c->dispatch, path) == -1
+      || dispatch_load_snapshot(&c->dispatch, path) == -1)
+    return MEMCACHED_FAILURE;
 
-  return res;
+  return MEMCACHED_SUCCESS;
 }
 
-#endif /* MSG_NOSIGNAL */
-
 
-/*
-  parse_key() assumes that one key definitely matches.
-*/
-static
 int
-parse_key(struct command_state *state)
+client_set_bounded_load(struct client *c, double bounded_load)
 {
-  char *key_pos;
+  if (bounded_load < 0.0)
+    return MEMCACHED_FAILURE;
 
-  /* Skip over the prefix.  */
-  state->pos += state->client->prefix_len - 1;
+  c->bounded_load = bounded_load;
 
-  key_pos = (char *) state->key->iov_base;
-  while (state->key_count > 1)
+  return MEMCACHED_SUCCESS;
+}
+
+
+int
+client_set_counter_buffer(struct client *c, size_t max_keys, int interval_ms)
+{
+  if (! c->counters)
     {
-      char *key_end, *prefix_key;
-      size_t prefix_len;
+      c->counters = counter_buffer_init();
+      if (! c->counters)
+        return MEMCACHED_FAILURE;
+    }
 
-      key_end = (char *) state->key->iov_base + state->key->iov_len;
-      while (key_pos != key_end && *state->pos == *key_pos)
-        {
-          ++key_pos;
-          ++state->pos;
-        }
+  c->counters_max_keys = max_keys;
+  c->counters_interval = interval_ms;
+  c->counters_force = 0;
 
-      if (key_pos == key_end && *state->pos == ' ')
-        break;
+  return MEMCACHED_SUCCESS;
+}
 
-      prefix_key = (char *) state->key->iov_base;
-      prefix_len = key_pos - prefix_key;
-      /*
-        TODO: Below it might be faster to compare the tail of the key
-        before comparing the head.
-      */
-      do
-        {
-          next_index(state);
-          state->key += 2;
-        }
-      while (--state->key_count > 1
-             && (state->key->iov_len < prefix_len
-                 || memcmp(state->key->iov_base,
-                           prefix_key, prefix_len) != 0));
 
-      key_pos = (char *) state->key->iov_base + prefix_len;
+int
+client_replicate_key(struct client *c, const char *key, size_t key_len,
+                     int enable)
+{
+  if (! enable)
+    {
+      if (c->replicated)
+        key_set_remove(c->replicated, key, key_len);
+
+      return MEMCACHED_SUCCESS;
     }
 
-  if (state->key_count == 1)
+  if (! c->replicated)
     {
-      while (*state->pos != ' ')
-        ++state->pos;
+      c->replicated = key_set_init();
+      if (! c->replicated)
+        return MEMCACHED_FAILURE;
     }
 
-  --state->key_count;
-  state->key += 2;
-  state->index = get_index(state);
-  next_index(state);
+  if (key_set_insert(c->replicated, key, key_len) == -1)
+    return MEMCACHED_FAILURE;
 
   return MEMCACHED_SUCCESS;
 }
 
 
-static
 int
-read_value(struct command_state *state)
+client_dispatch_key(struct client *c, const char *key, size_t key_len)
 {
-  value_size_type size;
-  size_t remains;
+  return dispatch_key(&c->dispatch, key, key_len);
+}
 
-  size = state->end - state->pos;
-  if (size > state->u.value.size)
-    size = state->u.value.size;
-  if (size > 0)
-    {
-      memcpy(state->u.value.ptr, state->pos, size);
-      state->u.value.size -= size;
-      state->u.value.ptr = (char *) state->u.value.ptr + size;
-      state->pos += size;
-    }
 
-  remains = state->end - state->pos;
-  if (remains < sizeof(eol))
-    {
-      struct iovec iov[2], *piov;
+void
+client_dispatch_keys(struct client *c, const char *const *keys,
+                     const size_t *key_lens, int count, int *servers)
+{
+  dispatch_keys(&c->dispatch, keys, key_lens, count, servers);
+}
 
-      state->pos = memmove(state->buf, state->pos, remains);
-      state->end = state->buf + remains;
 
-      iov[0].iov_base = state->u.value.ptr;
-      iov[0].iov_len = state->u.value.size;
-      iov[1].iov_base = state->end;
-      iov[1].iov_len = REPLY_BUF_SIZE - remains;
-      piov = &iov[state->u.value.size > 0 ? 0 : 1];
+int
+client_dispatch_batch(struct client *c, const char *const *keys,
+                      const size_t *key_lens, int count)
+{
+  array_clear(c->dispatch_batch);
 
-      do
-        {
-          ssize_t res;
+  if (count <= 0)
+    return MEMCACHED_SUCCESS;
 
-          res = readv_restart(state->fd, piov, iov + 2 - piov);
-          if (res <= 0)
-            {
-              state->u.value.ptr = iov[0].iov_base;
-              state->u.value.size = iov[0].iov_len;
-              state->end = iov[1].iov_base;
+  if (array_extend(c->dispatch_batch, int, count, ARRAY_EXTEND_TWICE) == -1)
+    return MEMCACHED_FAILURE;
 
-              if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
-                return MEMCACHED_EAGAIN;
+  client_dispatch_keys(c, keys, key_lens, count,
+                       array_beg(c->dispatch_batch, int));
+  array_append(c->dispatch_batch, count);
 
-              state->object->free(state->u.value.opaque);
-              return MEMCACHED_CLOSED;
-            }
+  return MEMCACHED_SUCCESS;
+}
 
-          if ((size_t) res >= piov->iov_len)
-            {
-              piov->iov_base = (char *) piov->iov_base + piov->iov_len;
-              res -= piov->iov_len;
-              piov->iov_len = 0;
-              ++piov;
-            }
 
-          piov->iov_len -= res;
-          piov->iov_base = (char *) piov->iov_base + res;
-        }
-      while ((size_t) ((char *) iov[1].iov_base - state->pos) < sizeof(eol));
+int
+client_add_server(struct client *c, const char *host, size_t host_len,
+                  const char *port, size_t port_len, double weight,
+                  int noreply)
+{
+  int res;
 
-      state->end = iov[1].iov_base;
-    }
+  if (weight <= 0.0)
+    return MEMCACHED_FAILURE;
 
-  if (memcmp(state->pos, eol, sizeof(eol)) != 0)
-    {
-      state->object->free(state->u.value.opaque);
-      return MEMCACHED_UNKNOWN;
-    }
-  state->pos += sizeof(eol);
-  state->eol = state->pos;
+  if (array_extend(c->pollfds, struct pollfd, 1, ARRAY_EXTEND_EXACT) == -1)
+    return MEMCACHED_FAILURE;
 
-  state->object->store(state->object->arg, state->u.value.opaque,
-                       state->index, &state->u.value.meta);
+  if (array_extend(c->servers, struct server, 1, ARRAY_EXTEND_EXACT) == -1)
+    return MEMCACHED_FAILURE;
+
+  res = server_init(array_end(c->servers, struct server), c,
+                    host, host_len, port, port_len, weight, noreply);
+  if (res != MEMCACHED_SUCCESS)
+    return res;
+
+  res = dispatch_add_server(&c->dispatch, host, host_len, port, port_len,
+                            weight, array_size(c->servers));
+  if (res == -1)
+    return MEMCACHED_FAILURE;
+
+  c->total_weight += weight;
+  ++c->servers_version;
+
+  array_push(c->pollfds);
+  array_push(c->servers);
 
   return MEMCACHED_SUCCESS;
 }
 
 
-static inline
 int
-swallow_eol(struct command_state *state, int skip, int done)
+client_find_server(struct client *c, int from,
+                   const char *host, size_t host_len,
+                   const char *port, size_t port_len, double weight,
+                   int noreply)
 {
-  if (! skip && state->eol - state->pos != sizeof(eol))
-    return MEMCACHED_UNKNOWN;
-
-  state->pos = state->eol;
+  int i;
 
-  if (done)
-    state->phase = PHASE_DONE;
+  for (i = from; i < (int) array_size(c->servers); ++i)
+    {
+      struct server *s = array_elem(c->servers, struct server, i);
+
+      if (s->host_len == host_len && memcmp(s->host, host, host_len) == 0
+          && (port ? (s->port && strlen(s->port) == port_len
+                      && memcmp(s->port, port, port_len) == 0)
+              : ! s->port)
+          && s->weight == weight && s->cmd_state.noreply == noreply)
+        return i;
+    }
 
-  return MEMCACHED_SUCCESS;
+  return -1;
 }
 
 
+/*
+  renumber_hot_keys() updates the servers of the tracked hot keys after
+  the server at index was removed, or the servers were reordered when
+  order isn't NULL.  When out of memory the servers are forgotten
+  rather than left wrong.
+*/
 static
-int
-parse_ull(struct command_state *state, unsigned long long *result)
+void
+renumber_hot_keys(struct client *c, int index, const int *order)
 {
-  unsigned long long res = 0;
-  const char *beg;
-
-  while (*state->pos == ' ')
-    ++state->pos;
+  int *new_index, count = array_size(c->servers), i;
 
-  beg = state->pos;
+  if (! c->hot_keys)
+    return;
 
-  while (1)
+  new_index = malloc(count * sizeof(*new_index));
+  if (new_index)
     {
-      switch (*state->pos)
+      if (order)
         {
-        case '0': case '1': case '2': case '3': case '4':
-        case '5': case '6': case '7': case '8': case '9':
-          res = res * 10 + (*state->pos - '0');
-          ++state->pos;
-          break;
-
-        default:
-          *result = res;
-          return (beg != state->pos ? MEMCACHED_SUCCESS : MEMCACHED_UNKNOWN);
+          for (i = 0; i < count; ++i)
+            new_index[order[i]] = i;
+        }
+      else
+        {
+          for (i = 0; i < count; ++i)
+            new_index[i] = (i < index ? i : i > index ? i - 1 : -1);
         }
     }
+
+  hot_keys_renumber(c->hot_keys, new_index);
+  free(new_index);
 }
 
 
-static
 int
-parse_get_reply(struct command_state *state)
+client_remove_server(struct client *c, int index)
 {
-  unsigned long long num;
-  int res;
+  struct server *s;
 
-  switch (state->match)
-    {
-    case MATCH_END:
-      return swallow_eol(state, 0, 1);
+  if (index < 0 || index >= (int) array_size(c->servers))
+    return MEMCACHED_FAILURE;
 
-    default:
-      return MEMCACHED_UNKNOWN;
+  /* Wait for the replies the server still owes, as on destruction.  */
+  client_nowait_push(c);
+  client_noreply_push(c);
 
-    case MATCH_VALUE:
-      break;
-    }
+  if (dispatch_remove_server(&c->dispatch, index) == -1)
+    return MEMCACHED_FAILURE;
 
-  while (*state->pos == ' ')
-    ++state->pos;
+  renumber_hot_keys(c, index, NULL);
 
-  res = parse_key(state);
-  if (res != MEMCACHED_SUCCESS)
-    return res;
+  s = array_elem(c->servers, struct server, index);
+  c->total_weight -= s->weight;
+  c->load_total -= s->load;
+  server_destroy(s);
 
-  res = parse_ull(state, &num);
-  if (res != MEMCACHED_SUCCESS)
-    return res;
-  state->u.value.meta.flags = num;
+  memmove(s, s + 1, (array_size(c->servers) - index - 1) * sizeof(*s));
+  array_pop(c->servers);
+  array_pop(c->pollfds);
+  ++c->servers_version;
 
-  res = parse_ull(state, &num);
-  if (res != MEMCACHED_SUCCESS)
-    return res;
-  state->u.value.size = num;
+  return MEMCACHED_SUCCESS;
+}
 
-  if (state->u.value.meta.use_cas)
-    {
-      res = parse_ull(state, &num);
-      if (res != MEMCACHED_SUCCESS)
-        return res;
-      state->u.value.meta.cas = num;
-    }
 
-  res = swallow_eol(state, 0, 0);
-  if (res != MEMCACHED_SUCCESS)
-    return res;
+int
+client_reorder_servers(struct client *c, const int *order)
+{
+  struct server *servers;
+  int count = array_size(c->servers), i;
 
-  state->u.value.ptr = state->object->alloc(state->u.value.size,
-                                            &state->u.value.opaque);
-  if (! state->u.value.ptr)
+  if (count == 0)
+    return MEMCACHED_SUCCESS;
+
+  servers = malloc(count * sizeof(*servers));
+  if (! servers)
     return MEMCACHED_FAILURE;
 
-  state->phase = PHASE_VALUE;
+  if (dispatch_reorder_servers(&c->dispatch, order) == -1)
+    {
+      free(servers);
+      return MEMCACHED_FAILURE;
+    }
 
-  return MEMCACHED_SUCCESS;
-}
+  renumber_hot_keys(c, -1, order);
 
+  for (i = 0; i < count; ++i)
+    servers[i] = *array_elem(c->servers, struct server, order[i]);
+  memcpy(array_beg(c->servers, struct server), servers,
+         count * sizeof(*servers));
+  free(servers);
 
-static inline
-void
-store_result(struct command_state *state, int res)
-{
-  int index = get_index(state);
-  next_index(state);
-  state->object->store(state->object->arg, (void *) (ptrdiff_t) res,
-                       index, NULL);
+  ++c->servers_version;
+
+  return MEMCACHED_SUCCESS;
 }
 
 
+/*
+  build_prefix() sets the prefix from the namespace and the namespace
+  generation.  ns may point into the current prefix.
+*/
 static
 int
-parse_set_reply(struct command_state *state)
+build_prefix(struct client *c, const char *ns, size_t ns_len)
 {
-  switch (state->match)
+  size_t len = 1 + ns_len + (c->ns_gen_len ? c->ns_gen_len + 1 : 0);
+  char *s;
+
+  if (len == 1)
     {
-    case MATCH_STORED:
-      store_result(state, 1);
-      break;
+      if (c->prefix_len > 1)
+        free(c->prefix);
 
-    case MATCH_NOT_STORED:
-    case MATCH_NOT_FOUND:
-    case MATCH_EXISTS:
-      store_result(state, 0);
-      break;
+      c->prefix = " ";
+      c->prefix_len = 1;
+      c->ns_len = 0;
 
-    default:
-      return MEMCACHED_UNKNOWN;
+      return MEMCACHED_SUCCESS;
     }
 
-  return swallow_eol(state, 0, 1);
-}
-
+  s = (char *) malloc(len + 1);
+  if (! s)
+    return MEMCACHED_FAILURE;
 
-static
-int
-parse_delete_reply(struct command_state *state)
-{
-  switch (state->match)
+  s[0] = ' ';
+  memcpy(s + 1, ns, ns_len);
+  if (c->ns_gen_len)
     {
-    case MATCH_DELETED:
-      store_result(state, 1);
-      break;
+      memcpy(s + 1 + ns_len, c->ns_gen, c->ns_gen_len);
+      s[len - 1] = ':';
+    }
+  s[len] = '\0';
 
-    case MATCH_NOT_FOUND:
-      store_result(state, 0);
-      break;
+  if (c->prefix_len > 1)
+    free(c->prefix);
 
-    default:
-      return MEMCACHED_UNKNOWN;
-    }
+  c->prefix = s;
+  c->prefix_len = len;
+  c->ns_len = ns_len;
 
-  return swallow_eol(state, 0, 1);
+  return MEMCACHED_SUCCESS;
 }
 
 
-static
 int
-parse_touch_reply(struct command_state *state)
+client_set_prefix(struct client *c, const char *ns, size_t ns_len)
 {
-  switch (state->match)
-    {
-    case MATCH_TOUCHED:
-      store_result(state, 1);
-      break;
+  /*
+    Buffered deltas keep their prefix, but the namespace may also
+    change where their keys are dispatched.
+  */
+  client_flush_counters(c);
 
-    case MATCH_NOT_FOUND:
-      store_result(state, 0);
-      break;
+  /* The generation is not hashed, so that keys stay on their servers.  */
+  if (c->hash_namespace)
+    dispatch_set_prefix(&c->dispatch, ns, ns_len);
 
-    default:
-      return MEMCACHED_UNKNOWN;
-    }
+  /* The new namespace has its own generation.  */
+  c->ns_gen_expires = 0;
 
-  return swallow_eol(state, 0, 1);
+  return build_prefix(c, ns, ns_len);
 }
 
 
+const char *
+client_get_prefix(struct client *c, size_t *ns_len)
+{
+  *ns_len = c->ns_len;
+
+  return (c->prefix + 1);
+}
+
 
-static
-int
-parse_arith_reply(struct command_state *state)
+size_t
+client_get_key_len_max(struct client *c)
 {
-  char *beg;
-  size_t len;
-  int zero;
+  if (c->prefix_len - 1 >= KEY_LEN_MAX)
+    return 0;
 
-  state->index = get_index(state);
-  next_index(state);
+  return KEY_LEN_MAX - (c->prefix_len - 1);
+}
 
-  switch (state->match)
-    {
-    case MATCH_NOT_FOUND:
+
+static inline
+ssize_t
+read_restart(int fd, void *buf, size_t size)
+{
+  ssize_t res;
+
+  do
+    res = read(fd, buf, size);
+  while (res == -1 && errno == EINTR);
+
+  return res;
+}
+
+
+static inline
+ssize_t
+readv_restart(int fd, const struct iovec *iov, int count)
+{
+  ssize_t res;
+
+  do
+    res = readv(fd, iov, count);
+  while (res == -1 && errno == EINTR);
+
+  return res;
+}
+
+
+#ifndef MSG_NOSIGNAL
+
+static inline
+ssize_t
+writev_restart(int fd, const struct iovec *iov, int count)
+{
+  ssize_t res;
+
+  do
+    res = writev(fd, iov, count);
+  while (res == -1 && errno == EINTR);
+
+  return res;
+}
+
+#else  /* MSG_NOSIGNAL */
+
+static inline
+ssize_t
+writev_restart(int fd, const struct iovec *iov, int count)
+{
+  struct msghdr msg;
+  ssize_t res;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec *) iov;
+  msg.msg_iovlen = count;
+
+  do
+    res = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  while (res == -1 && errno == EINTR);
+
+  return res;
+}
+
+#endif /* MSG_NOSIGNAL */
+
+
+static inline
+void
+record_miss(struct command_state *state)
+{
+  struct client *c = state->client;
+
+  negative_cache_insert(c->negative_cache, c->prefix, c->prefix_len,
+                        (char *) state->key->iov_base, state->key->iov_len);
+}
+
+
+/*
+  parse_key() assumes that one key definitely matches.
+*/
+static
+int
+parse_key(struct command_state *state)
+{
+  char *key_pos;
+
+  /* Skip over the prefix.  */
+  state->pos += state->client->prefix_len - 1;
+
+  key_pos = (char *) state->key->iov_base;
+  while (state->key_count > 1)
+    {
+      char *key_end, *prefix_key;
+      size_t prefix_len;
+
+      key_end = (char *) state->key->iov_base + state->key->iov_len;
+      while (key_pos != key_end && *state->pos == *key_pos)
+        {
+          ++key_pos;
+          ++state->pos;
+        }
+
+      if (key_pos == key_end && *state->pos == ' ')
+        break;
+
+      prefix_key = (char *) state->key->iov_base;
+      prefix_len = key_pos - prefix_key;
+      /*
+        TODO: Below it might be faster to compare the tail of the key
+        before comparing the head.
+      */
+      do
+        {
+          /* The server skips missing keys.  */
+          if (state->u.value.record_misses)
+            record_miss(state);
+
+          next_index(state);
+          state->key += 2;
+        }
+      while (--state->key_count > 1
+             && (state->key->iov_len < prefix_len
+                 || memcmp(state->key->iov_base,
+                           prefix_key, prefix_len) != 0));
+
+      key_pos = (char *) state->key->iov_base + prefix_len;
+    }
+
+  if (state->key_count == 1)
+    {
+      while (*state->pos != ' ')
+        ++state->pos;
+    }
+
+  --state->key_count;
+  state->key += 2;
+  state->index = get_index(state);
+  next_index(state);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static
+int
+read_value(struct command_state *state)
+{
+  value_size_type size;
+  size_t remains;
+
+  size = state->end - state->pos;
+  if (size > state->u.value.size)
+    size = state->u.value.size;
+  if (size > 0)
+    {
+      memcpy(state->u.value.ptr, state->pos, size);
+      state->u.value.size -= size;
+      state->u.value.ptr = (char *) state->u.value.ptr + size;
+      state->pos += size;
+    }
+
+  remains = state->end - state->pos;
+  if (remains < sizeof(eol))
+    {
+      struct iovec iov[2], *piov;
+
+      state->pos = memmove(state->buf, state->pos, remains);
+      state->end = state->buf + remains;
+
+      iov[0].iov_base = state->u.value.ptr;
+      iov[0].iov_len = state->u.value.size;
+      iov[1].iov_base = state->end;
+      iov[1].iov_len = REPLY_BUF_SIZE - remains;
+      piov = &iov[state->u.value.size > 0 ? 0 : 1];
+
+      do
+        {
+          ssize_t res;
+
+          res = readv_restart(state->fd, piov, iov + 2 - piov);
+          if (res <= 0)
+            {
+              state->u.value.ptr = iov[0].iov_base;
+              state->u.value.size = iov[0].iov_len;
+              state->end = iov[1].iov_base;
+
+              if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return MEMCACHED_EAGAIN;
+
+              state->object->free(state->u.value.opaque);
+              return MEMCACHED_CLOSED;
+            }
+
+          if ((size_t) res >= piov->iov_len)
+            {
+              piov->iov_base = (char *) piov->iov_base + piov->iov_len;
+              res -= piov->iov_len;
+              piov->iov_len = 0;
+              ++piov;
+            }
+
+          piov->iov_len -= res;
+          piov->iov_base = (char *) piov->iov_base + res;
+        }
+      while ((size_t) ((char *) iov[1].iov_base - state->pos) < sizeof(eol));
+
+      state->end = iov[1].iov_base;
+    }
+
+  if (memcmp(state->pos, eol, sizeof(eol)) != 0)
+    {
+      state->object->free(state->u.value.opaque);
+      return MEMCACHED_UNKNOWN;
+    }
+  state->pos += sizeof(eol);
+  state->eol = state->pos;
+
+  /*
+    get replies don't tell when the item expires, so the entries live
+    for the whole max_ttl, as documented for near_cache_ttl.
+  */
+  if (state->u.value.fill_cache)
+    {
+      struct client *c = state->client;
+      const char *key = (char *) state->u.value.key->iov_base;
+      size_t key_len = state->u.value.key->iov_len;
+
+      if (c->near_cache)
+        near_cache_insert(c->near_cache, c->prefix, c->prefix_len,
+                          key, key_len, state->u.value.meta.flags,
+                          state->u.value.beg, state->u.value.total, 0);
+      if (c->shared_cache)
+        shm_cache_insert(c->shared_cache, c->prefix, c->prefix_len,
+                         key, key_len, state->u.value.meta.flags,
+                         state->u.value.beg, state->u.value.total);
+    }
+
+  state->object->store(state->object->arg, state->u.value.opaque,
+                       state->index, &state->u.value.meta);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static inline
+int
+swallow_eol(struct command_state *state, int skip, int done)
+{
+  if (! skip && state->eol - state->pos != sizeof(eol))
+    return MEMCACHED_UNKNOWN;
+
+  state->pos = state->eol;
+
+  if (done)
+    state->phase = PHASE_DONE;
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static
+int
+parse_ull(struct command_state *state, unsigned long long *result)
+{
+  unsigned long long res = 0;
+  const char *beg;
+
+  while (*state->pos == ' ')
+    ++state->pos;
+
+  beg = state->pos;
+
+  while (1)
+    {
+      switch (*state->pos)
+        {
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+          res = res * 10 + (*state->pos - '0');
+          ++state->pos;
+          break;
+
+        default:
+          *result = res;
+          return (beg != state->pos ? MEMCACHED_SUCCESS : MEMCACHED_UNKNOWN);
+        }
+    }
+}
+
+
+static
+int
+parse_get_reply(struct command_state *state)
+{
+  unsigned long long num;
+  int res;
+
+  switch (state->match)
+    {
+    case MATCH_END:
+      if (state->u.value.record_misses)
+        {
+          /* Keys after the last returned value are missing.  */
+          while (state->key_count > 0)
+            {
+              record_miss(state);
+              state->key += 2;
+              --state->key_count;
+            }
+        }
+
+      return swallow_eol(state, 0, 1);
+
+    default:
+      return MEMCACHED_UNKNOWN;
+
+    case MATCH_VALUE:
+      break;
+    }
+
+  while (*state->pos == ' ')
+    ++state->pos;
+
+  res = parse_key(state);
+  if (res != MEMCACHED_SUCCESS)
+    return res;
+
+  res = parse_ull(state, &num);
+  if (res != MEMCACHED_SUCCESS)
+    return res;
+  state->u.value.meta.flags = num;
+
+  res = parse_ull(state, &num);
+  if (res != MEMCACHED_SUCCESS)
+    return res;
+  state->u.value.size = num;
+
+  if (state->u.value.meta.use_cas)
+    {
+      res = parse_ull(state, &num);
+      if (res != MEMCACHED_SUCCESS)
+        return res;
+      state->u.value.meta.cas = num;
+    }
+
+  res = swallow_eol(state, 0, 0);
+  if (res != MEMCACHED_SUCCESS)
+    return res;
+
+  state->u.value.ptr = state->object->alloc(state->u.value.size,
+                                            &state->u.value.opaque);
+  if (! state->u.value.ptr)
+    return MEMCACHED_FAILURE;
+
+  if (state->u.value.fill_cache)
+    {
+      /* parse_key() has advanced past the matched key.  */
+      state->u.value.key = state->key - 2;
+      state->u.value.beg = state->u.value.ptr;
+      state->u.value.total = state->u.value.size;
+    }
+
+  state->phase = PHASE_VALUE;
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static inline
+int
+next_duplicate(struct client *c, int key_index)
+{
+  if (key_index >= array_size(c->next_duplicate))
+    return -1;
+
+  return *array_elem(c->next_duplicate, int, key_index);
+}
+
+
+static inline
+void
+store_result(struct command_state *state, int res)
+{
+  int index = get_index(state);
+  next_index(state);
+
+  /* Results of the commands sent to replicas are discarded.  */
+  if (index == -1)
+    return;
+
+  /* The result of a coalesced key is stored for all its duplicates.  */
+  do
+    {
+      state->object->store(state->object->arg, (void *) (ptrdiff_t) res,
+                           index, NULL);
+      index = next_duplicate(state->client, index);
+    }
+  while (index != -1);
+}
+
+
+static
+int
+parse_set_reply(struct command_state *state)
+{
+  switch (state->match)
+    {
+    case MATCH_STORED:
+      store_result(state, 1);
+      break;
+
+    case MATCH_NOT_STORED:
+    case MATCH_NOT_FOUND:
+    case MATCH_EXISTS:
+      store_result(state, 0);
+      break;
+
+    default:
+      return MEMCACHED_UNKNOWN;
+    }
+
+  return swallow_eol(state, 0, 1);
+}
+
+
+static
+int
+parse_delete_reply(struct command_state *state)
+{
+  switch (state->match)
+    {
+    case MATCH_DELETED:
+      store_result(state, 1);
+      break;
+
+    case MATCH_NOT_FOUND:
+      store_result(state, 0);
+      break;
+
+    default:
+      return MEMCACHED_UNKNOWN;
+    }
+
+  return swallow_eol(state, 0, 1);
+}
+
+
+static
+int
+parse_touch_reply(struct command_state *state)
+{
+  switch (state->match)
+    {
+    case MATCH_TOUCHED:
+      store_result(state, 1);
+      break;
+
+    case MATCH_NOT_FOUND:
+      store_result(state, 0);
+      break;
+
+    default:
+      return MEMCACHED_UNKNOWN;
+    }
+
+  return swallow_eol(state, 0, 1);
+}
+
+
+
+static
+int
+parse_arith_reply(struct command_state *state)
+{
+  char *beg;
+  size_t len;
+  int zero;
+
+  state->index = get_index(state);
+  next_index(state);
+
+  /* Results of the commands sent to replicas are discarded.  */
+  if (state->index == -1)
+    {
+      switch (state->match)
+        {
+        case MATCH_NOT_FOUND:
+          return swallow_eol(state, 0, 1);
+
+        case MATCH_0: case MATCH_1: case MATCH_2: case MATCH_3: case MATCH_4:
+        case MATCH_5: case MATCH_6: case MATCH_7: case MATCH_8: case MATCH_9:
+          return swallow_eol(state, 1, 1);
+
+        default:
+          return MEMCACHED_UNKNOWN;
+        }
+    }
+
+  switch (state->match)
+    {
+    case MATCH_NOT_FOUND:
       /* On NOT_FOUND we store the defined empty string.  */
       state->u.embedded.ptr =
         state->object->alloc(0, &state->u.embedded.opaque);
       if (! state->u.embedded.ptr)
         return MEMCACHED_FAILURE;
 
-      state->object->store(state->object->arg, state->u.embedded.opaque,
-                           state->index, NULL);
+      state->object->store(state->object->arg, state->u.embedded.opaque,
+                           state->index, NULL);
+
+      return swallow_eol(state, 0, 1);
+
+    default:
+      return MEMCACHED_UNKNOWN;
+
+    case MATCH_0: case MATCH_1: case MATCH_2: case MATCH_3: case MATCH_4:
+    case MATCH_5: case MATCH_6: case MATCH_7: case MATCH_8: case MATCH_9:
+      break;
+    }
+
+  beg = state->pos - 1;
+  len = 0;
+  while (len == 0)
+    {
+      switch (*state->pos)
+        {
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+          ++state->pos;
+          break;
+
+        default:
+          len = state->pos - beg;
+          break;
+        }
+    }
+
+  zero = (*beg == '0' && len == 1);
+  if (zero)
+    len = 3;
+
+  state->u.embedded.ptr = state->object->alloc(len, &state->u.embedded.opaque);
+  if (! state->u.embedded.ptr)
+    return MEMCACHED_FAILURE;
+
+  if (! zero)
+    memcpy(state->u.embedded.ptr, beg, len);
+  else
+    memcpy(state->u.embedded.ptr, "0E0", 3);
+
+  state->object->store(state->object->arg, state->u.embedded.opaque,
+                       state->index, NULL);
+
+  /* Value may be space padded.  */
+  return swallow_eol(state, 1, 1);
+}
+
+
+static
+int
+parse_ok_reply(struct command_state *state)
+{
+  switch (state->match)
+    {
+    case MATCH_OK:
+      store_result(state, 1);
+      return swallow_eol(state, 0, 1);
+
+    default:
+      return MEMCACHED_UNKNOWN;
+    }
+}
+
+
+static
+int
+parse_version_reply(struct command_state *state)
+{
+  const char *beg;
+  size_t len;
+  int res;
+
+  state->index = get_index(state);
+  next_index(state);
+
+  switch (state->match)
+    {
+    default:
+      return MEMCACHED_UNKNOWN;
+
+    case MATCH_VERSION:
+      break;
+    }
+
+  while (*state->pos == ' ')
+    ++state->pos;
+
+  beg = state->pos;
+
+  res = swallow_eol(state, 1, 1);
+  if (res != MEMCACHED_SUCCESS)
+    return res;
+
+  len = state->pos - sizeof(eol) - beg;
+
+  state->u.embedded.ptr = state->object->alloc(len, &state->u.embedded.opaque);
+  if (! state->u.embedded.ptr)
+    return MEMCACHED_FAILURE;
+
+  memcpy(state->u.embedded.ptr, beg, len);
+
+  state->object->store(state->object->arg, state->u.embedded.opaque,
+                       state->index, NULL);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static
+int
+parse_stats_reply(struct command_state *state)
+{
+  const char *beg;
+  size_t len;
+  int res;
+
+  switch (state->match)
+    {
+    default:
+      return MEMCACHED_UNKNOWN;
+
+    case MATCH_END:
+      next_index(state);
+      return swallow_eol(state, 0, 1);
+
+    case MATCH_STAT:
+      break;
+    }
+
+  while (*state->pos == ' ')
+    ++state->pos;
+
+  beg = state->pos;
+
+  /* There are more STAT lines until END.  */
+  res = swallow_eol(state, 1, 0);
+  if (res != MEMCACHED_SUCCESS)
+    return res;
+
+  state->phase = PHASE_RECEIVE;
+
+  len = state->pos - sizeof(eol) - beg;
+
+  state->u.embedded.ptr = state->object->alloc(len, &state->u.embedded.opaque);
+  if (! state->u.embedded.ptr)
+    return MEMCACHED_FAILURE;
+
+  memcpy(state->u.embedded.ptr, beg, len);
+
+  state->object->store(state->object->arg, state->u.embedded.opaque,
+                       get_index(state), NULL);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static
+int
+parse_nowait_reply(struct command_state *state)
+{
+  int res;
+
+  /*
+    Cast to enum parse_keyword_e to get compiler warning when some
+    match result is not handled.
+  */
+  switch ((enum parse_keyword_e) state->match)
+    {
+    case MATCH_DELETED:
+    case MATCH_OK:
+    case MATCH_STORED:
+    case MATCH_EXISTS:
+    case MATCH_NOT_FOUND:
+    case MATCH_NOT_STORED:
+    case MATCH_TOUCHED:
+      return swallow_eol(state, 0, 1);
+
+    case MATCH_0: case MATCH_1: case MATCH_2: case MATCH_3: case MATCH_4:
+    case MATCH_5: case MATCH_6: case MATCH_7: case MATCH_8: case MATCH_9:
+    case MATCH_VERSION: /* see client_noreply_push().  */
+      return swallow_eol(state, 1, 1);
+
+    case MATCH_ERROR:
+      res = swallow_eol(state, 0, 1);
+      return (res == MEMCACHED_SUCCESS ? MEMCACHED_ERROR : res);
+
+    case MATCH_CLIENT_ERROR:
+    case MATCH_SERVER_ERROR:
+      res = swallow_eol(state, 1, 1);
+      return (res == MEMCACHED_SUCCESS ? MEMCACHED_ERROR : res);
+
+    case NO_MATCH:
+    case MATCH_VALUE:
+    case MATCH_END:
+    case MATCH_STAT:
+      return MEMCACHED_UNKNOWN;
+    }
+
+  /* Never reach here.  */
+  return MEMCACHED_UNKNOWN;
+}
+
+
+static
+void
+client_mark_failed(struct client *c, struct server *s)
+{
+  if (s->cmd_state.fd != -1)
+    {
+      close(s->cmd_state.fd);
+      s->cmd_state.fd = -1;
+      s->cmd_state.nowait_count = 0;
+      s->cmd_state.pos = s->cmd_state.end = s->cmd_state.eol =
+        s->cmd_state.buf;
+    }
+
+  if (c->max_failures > 0)
+    {
+      time_t now = time(NULL);
+      if (s->failure_expires < now)
+        s->failure_count = 0;
+      ++s->failure_count;
+      /*
+        Set timeout on first failure, and on max_failures.  The idea
+        is that if max_failures had happened during failure_timeout,
+        we do not retry in another failure_timeout seconds.  This is
+        not entirely true: we remember the time of the first failure,
+        but for exact accounting we would have to keep time of each
+        failure.  However such exact measurement is not necessary.
+      */
+      if (s->failure_count == 1 || s->failure_count == c->max_failures)
+        s->failure_expires = now + c->failure_timeout;
+    }
+}
+
+
+static
+int
+send_request(struct command_state *state, struct server *s)
+{
+  while (state->iov_count > 0)
+    {
+      int count;
+      ssize_t res;
+      size_t len;
+
+      count = (state->iov_count < state->client->iov_max
+               ? state->iov_count : state->client->iov_max);
+
+      state->iov->iov_base =
+        (char *) state->iov->iov_base + state->write_offset;
+      state->iov->iov_len -= state->write_offset;
+      len = state->iov->iov_len;
+
+      res = writev_restart(state->fd, state->iov, count);
+
+      state->iov->iov_base =
+        (char *) state->iov->iov_base - state->write_offset;
+      state->iov->iov_len += state->write_offset;
+
+      if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return MEMCACHED_EAGAIN;
+      if (res <= 0)
+        {
+          deactivate(state);
+          client_mark_failed(state->client, s);
+
+          return MEMCACHED_CLOSED;
+        }
+
+      while ((size_t) res >= len)
+        {
+          res -= len;
+          ++state->iov;
+          if (--state->iov_count == 0)
+            break;
+          len = state->iov->iov_len;
+          state->write_offset = 0;
+        }
+      state->write_offset += res;
+    }
+
+  if (state->reply_count == 0)
+    deactivate(state);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static
+int
+receive_reply(struct command_state *state)
+{
+  while (state->eol != state->end && *state->eol != eol[sizeof(eol) - 1])
+    ++state->eol;
+
+  /*
+    When buffer is empty, move to the beginning of it for better CPU
+    cache utilization.
+  */
+  if (state->pos == state->end)
+    state->pos = state->end = state->eol = state->buf;
+
+  while (state->eol == state->end)
+    {
+      size_t size;
+      ssize_t res;
+
+      size = REPLY_BUF_SIZE - (state->end - state->buf);
+      if (size == 0)
+        {
+          if (state->pos != state->buf)
+            {
+              size_t len = state->end - state->pos;
+              state->pos = memmove(state->buf, state->pos, len);
+              state->end -= REPLY_BUF_SIZE - len;
+              state->eol -= REPLY_BUF_SIZE - len;
+              size = REPLY_BUF_SIZE - len;
+            }
+          else
+            {
+              return MEMCACHED_UNKNOWN;
+            }
+        }
+
+      res = read_restart(state->fd, state->end, size);
+      if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return MEMCACHED_EAGAIN;
+      if (res <= 0)
+        return MEMCACHED_CLOSED;
+
+      state->end += res;
+
+      while (state->eol != state->end && *state->eol != eol[sizeof(eol) - 1])
+        ++state->eol;
+    }
+
+  if ((size_t) (state->eol - state->buf) < sizeof(eol) - 1
+      || memcmp(state->eol - (sizeof(eol) - 1), eol, sizeof(eol) - 1) != 0)
+    return MEMCACHED_UNKNOWN;
+
+  ++state->eol;
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static
+int
+parse_reply(struct command_state *state)
+{
+  int res, skip;
+
+  switch (state->match)
+    {
+    case MATCH_ERROR:
+    case MATCH_CLIENT_ERROR:
+    case MATCH_SERVER_ERROR:
+      skip = (state->match != MATCH_ERROR);
+      res = swallow_eol(state, skip, 1);
+
+      return (res == MEMCACHED_SUCCESS ? MEMCACHED_ERROR : res);
+
+    default:
+      if (state->nowait_count)
+        return parse_nowait_reply(state);
+      else
+        return state->parse_reply(state);
+
+    case NO_MATCH:
+      return MEMCACHED_UNKNOWN;
+    }
+}
+
+
+static
+int
+process_reply(struct command_state *state, struct server *s)
+{
+  int res = 0;
+
+  while (1)
+    {
+      switch (state->phase)
+        {
+        case PHASE_RECEIVE:
+          res = receive_reply(state);
+          if (res != MEMCACHED_SUCCESS)
+            break;
+
+          state->match = parse_keyword(&state->pos);
+
+          state->phase = PHASE_PARSE;
+
+          /* FALLTHROUGH */
+
+        case PHASE_PARSE:
+          res = parse_reply(state);
+          if (res != MEMCACHED_SUCCESS)
+            break;
+
+          if (state->phase != PHASE_DONE)
+            continue;
+
+          /* FALLTHROUGH */
+
+        case PHASE_DONE:
+          res = MEMCACHED_SUCCESS;
+
+          break;
+
+        case PHASE_VALUE:
+          res = read_value(state);
+          if (res != MEMCACHED_SUCCESS)
+            break;
+
+          state->phase = PHASE_RECEIVE;
+          continue;
+        }
+
+      switch (res)
+        {
+        case MEMCACHED_ERROR:
+          if (! (state->client->close_on_error || state->noreply))
+            break;
+
+          /* FALLTHROUGH */
+
+        case MEMCACHED_UNKNOWN:
+        case MEMCACHED_CLOSED:
+          deactivate(state);
+          client_mark_failed(state->client, s);
+
+          /* FALLTHROUGH */
+
+        case MEMCACHED_EAGAIN:
+          return res;
+        }
+
+      if (state->nowait_count > 0)
+        {
+          --state->nowait_count;
+        }
+      else if (--state->reply_count == 0)
+        {
+          if (state->iov_count == 0)
+            deactivate(state);
+
+          return res;
+        }
+
+      state->phase = PHASE_RECEIVE;
+    }
+}
+
+
+static inline
+void
+state_prepare(struct command_state *state, int key_index)
+{
+  state->last_cmd_noreply = state->prepared_last_cmd_noreply;
+  state->nowait_count += state->prepared_nowait_count;
+
+  state->key = array_elem(state->iov_buf, struct iovec, key_index);
+  state->iov = array_beg(state->iov_buf, struct iovec);
+  state->iov_count = array_size(state->iov_buf);
+
+  if (state->str_step > 0)
+    {
+      struct iovec *iov = state->iov;
+      char *buf = array_beg(state->client->str_buf, char);
+      int count = state->iov_count, step = state->str_step;
+
+      if (state->key_count > 0)
+        {
+          iov += 3;
+          count -= 3;
+        }
+
+      while (count > 0)
+        {
+          iov->iov_base = (void *) (buf + (ptrdiff_t) (iov->iov_base));
+          iov += step;
+          count -= step;
+        }
+    }
+}
+
+
+static
+int
+execute(struct client *c, int key_index)
+{
+  int first_iter = 1;
+
+#if ! defined(MSG_NOSIGNAL) && ! defined(WIN32)
+  struct sigaction orig, ignore;
+  int res;
+
+  ignore.sa_handler = SIG_IGN;
+  sigemptyset(&ignore.sa_mask);
+  ignore.sa_flags = 0;
+  res = sigaction(SIGPIPE, &ignore, &orig);
+  if (res == -1)
+    return MEMCACHED_FAILURE;
+#endif /* ! defined(MSG_NOSIGNAL) && ! defined(WIN32) */
+
+  while (1)
+    {
+      struct server *s;
+      struct pollfd *pollfd_beg, *pollfd;
+      int res;
+
+      pollfd_beg = array_beg(c->pollfds, struct pollfd);
+      pollfd = pollfd_beg;
+
+      for (array_each(c->servers, struct server, s))
+        {
+          int may_write, may_read;
+          struct command_state *state = &s->cmd_state;
+
+          if (! is_active(state))
+            continue;
+
+          if (first_iter)
+            {
+              state_prepare(state, key_index);
+
+              may_write = 1;
+              may_read = (state->reply_count > 0
+                          || state->nowait_count > 0);
+            }
+          else
+            {
+              const short revents = state->pollfd->revents;
+
+              may_write = revents & (POLLOUT | POLLERR | POLLHUP);
+              may_read = revents & (POLLIN | POLLERR | POLLHUP);
+            }
+
+          if (may_read || may_write)
+            {
+              if (may_write)
+                {
+                  int res;
+
+                  res = send_request(state, s);
+                  if (res == MEMCACHED_CLOSED)
+                    may_read = 0;
+                }
+
+              if (may_read)
+                process_reply(state, s);
+
+              if (! is_active(state))
+                continue;
+            }
+
+          pollfd->events = 0;
+
+          if (state->iov_count > 0)
+            pollfd->events |= POLLOUT;
+          if (state->reply_count > 0 || state->nowait_count > 0)
+            pollfd->events |= POLLIN;
+
+          if (pollfd->events != 0)
+            {
+              pollfd->fd = state->fd;
+              state->pollfd = pollfd;
+              ++pollfd;
+            }
+        }
+
+      if (pollfd == pollfd_beg)
+        break;
+
+      do
+        res = poll(pollfd_beg, pollfd - pollfd_beg, c->io_timeout);
+      while (res == -1 && errno == EINTR);
+
+      /*
+        On error or timeout close all active connections.  Otherwise
+        we might receive garbage on them later.
+      */
+      if (res <= 0)
+        {
+          for (array_each(c->servers, struct server, s))
+            {
+              struct command_state *state = &s->cmd_state;
 
-      return swallow_eol(state, 0, 1);
+              if (is_active(state))
+                {
+                  /*
+                    Ugly fix for possible memory leak.  FIXME:
+                    requires redesign.
+                  */
+                  if (state->phase == PHASE_VALUE)
+                    state->object->free(state->u.value.opaque);
 
-    default:
-      return MEMCACHED_UNKNOWN;
+                  client_mark_failed(c, s);
+                }
+            }
 
-    case MATCH_0: case MATCH_1: case MATCH_2: case MATCH_3: case MATCH_4:
-    case MATCH_5: case MATCH_6: case MATCH_7: case MATCH_8: case MATCH_9:
-      break;
+          break;
+        }
+
+      first_iter = 0;
     }
 
-  beg = state->pos - 1;
-  len = 0;
-  while (len == 0)
+#if ! defined(MSG_NOSIGNAL) && ! defined(WIN32)
+  /*
+    Ignore return value of sigaction(), there's nothing we can do in
+    the case of error.
+  */
+  sigaction(SIGPIPE, &orig, NULL);
+#endif /* ! defined(MSG_NOSIGNAL) && ! defined(WIN32) */
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+/* Is the following required for any platform?  */
+#if (! defined(IPPROTO_TCP) && defined(SOL_TCP))
+#define IPPROTO_TCP  SOL_TCP
+#endif
+
+
+static inline
+void
+tcp_optimize_latency(struct command_state *state)
+{
+#ifdef TCP_NODELAY
+  if (state->socket_mode == TCP_THROUGHPUT)
     {
-      switch (*state->pos)
-        {
-        case '0': case '1': case '2': case '3': case '4':
-        case '5': case '6': case '7': case '8': case '9':
-          ++state->pos;
-          break;
+      static const int enable = 1;
+      setsockopt(state->fd, IPPROTO_TCP, TCP_NODELAY,
+                 (void *) &enable, sizeof(enable));
+      state->socket_mode = TCP_LATENCY;
+    }
+#endif /* TCP_NODELAY */
+}
 
-        default:
-          len = state->pos - beg;
-          break;
+
+static inline
+void
+tcp_optimize_throughput(struct command_state *state)
+{
+#ifdef TCP_NODELAY
+  if (state->socket_mode == TCP_LATENCY)
+    {
+      static const int disable = 0;
+      setsockopt(state->fd, IPPROTO_TCP, TCP_NODELAY,
+                 (void *) &disable, sizeof(disable));
+      state->socket_mode = TCP_THROUGHPUT;
+    }
+#endif /* TCP_NODELAY */
+}
+
+
+static
+int
+get_server_fd(struct client *c, struct server *s)
+{
+  struct command_state *state;
+
+  /*
+    Do not try to try reconnect if had max_failures and
+    failure_expires time is not reached yet.
+  */
+  if (c->max_failures > 0 && s->failure_count >= c->max_failures)
+    {
+      if (time(NULL) <= s->failure_expires)
+        return -1;
+      else
+        s->failure_count = 0;
+    }
+
+  state = &s->cmd_state;
+  if (state->fd == -1)
+    {
+      if (s->port)
+        {
+          state->fd = client_connect_inet(s->host, s->port,
+                                          c->connect_timeout);
+          /* This is to trigger actual reset.  */
+          state->socket_mode = TCP_THROUGHPUT;
+          if (state->fd != -1)
+            tcp_optimize_latency(state);
+        }
+      else
+        {
+          state->fd = client_connect_unix(s->host, s->host_len);
+          state->socket_mode = NOT_TCP;
         }
     }
 
-  zero = (*beg == '0' && len == 1);
-  if (zero)
-    len = 3;
+  if (state->fd == -1)
+    client_mark_failed(c, s);
 
-  state->u.embedded.ptr = state->object->alloc(len, &state->u.embedded.opaque);
-  if (! state->u.embedded.ptr)
+  return state->fd;
+}
+
+
+static inline
+void
+iov_push(struct command_state *state, const void *buf, size_t buf_size)
+{
+  struct iovec *iov = array_end(state->iov_buf, struct iovec);
+  iov->iov_base = (void *) buf;
+  iov->iov_len = buf_size;
+  array_push(state->iov_buf);
+}
+
+
+static
+int
+push_index(struct command_state *state, int index)
+{
+  struct index_node *node;
+  struct client *c;
+
+  c = state->client;
+  if (array_extend(c->index_list, struct index_node,
+                   1, ARRAY_EXTEND_TWICE) == -1)
     return MEMCACHED_FAILURE;
 
-  if (! zero)
-    memcpy(state->u.embedded.ptr, beg, len);
+  if (state->index_tail != -1)
+    array_elem(c->index_list, struct index_node, state->index_tail)->next =
+      array_size(c->index_list);
   else
-    memcpy(state->u.embedded.ptr, "0E0", 3);
+    state->index_head = array_size(c->index_list);
+
+  state->index_tail = array_size(c->index_list);
+
+  node = array_elem(c->index_list, struct index_node, state->index_tail);
+  node->index = index;
+  node->next = -1;
+
+  array_push(c->index_list);
+
+  return MEMCACHED_SUCCESS;
+}
+
+
+static
+struct command_state *
+init_state(struct command_state *state, int index, size_t request_size,
+           size_t str_size, parse_reply_func parse_reply)
+{
+  if (! is_active(state))
+    {
+      if (state->client->noreply)
+        {
+          if (state->client->nowait || state->noreply)
+            {
+              parse_reply = NULL;
+              tcp_optimize_throughput(state);
+            }
+
+          state->prepared_last_cmd_noreply = state->noreply;
+        }
+      else
+        {
+          state->prepared_last_cmd_noreply = 0;
+          tcp_optimize_latency(state);
+        }
+
+      state->object = state->client->object;
+      command_state_reset(state, (str_size > 0 ? request_size : 0),
+                          parse_reply);
+    }
+
+  if (array_extend(state->iov_buf, struct iovec,
+                   request_size, ARRAY_EXTEND_EXACT) == -1)
+    {
+      deactivate(state);
+      return NULL;
+    }
+
+  if (str_size > 0
+      && array_extend(state->client->str_buf, char,
+                      str_size, ARRAY_EXTEND_TWICE) == -1)
+    {
+      deactivate(state);
+      return NULL;
+    }
+
+  if (push_index(state, index) != MEMCACHED_SUCCESS)
+    {
+      deactivate(state);
+      return NULL;
+    }
+
+  if (state->parse_reply)
+    ++state->reply_count;
+  else if (! state->prepared_last_cmd_noreply)
+    ++state->prepared_nowait_count;
+
+  return state;
+}
+
+
+static inline
+int
+key_server(struct client *c, int index, const char *key, size_t key_len)
+{
+  if (index >= 0 && index < array_size(c->dispatch_batch))
+    return *array_elem(c->dispatch_batch, int, index);
+  else
+    return dispatch_key(&c->dispatch, key, key_len);
+}
+
+
+/*
+  Loads decay by half every LOAD_WINDOW requests, so they reflect the
+  current batch and the recent ones.
+*/
+static inline
+void
+count_load(struct client *c, struct server *s)
+{
+  s->load += 1.0;
+  c->load_total += 1.0;
+
+  if (c->load_total >= LOAD_WINDOW)
+    {
+      struct server *t;
+
+      for (t = array_beg(c->servers, struct server);
+           t != array_end(c->servers, struct server); ++t)
+        t->load /= 2;
+      c->load_total /= 2;
+    }
+}
 
-  state->object->store(state->object->arg, state->u.embedded.opaque,
-                       state->index, NULL);
 
-  /* Value may be space padded.  */
-  return swallow_eol(state, 1, 1);
+/*
+  Consistent hashing with bounded loads (Mirrokni, Thorup and
+  Zadimoghaddam, https://arxiv.org/abs/1608.01350): a server may take
+  up to (1 + bounded_load) times its weighted share of the requests.
+  The share is rounded up, so that early requests are not moved.
+*/
+static inline
+int
+server_full(struct client *c, int server_index)
+{
+  struct server *s = array_elem(c->servers, struct server, server_index);
+  double share = ((1.0 + c->bounded_load) * (c->load_total + 1.0)
+                  * s->weight / c->total_weight);
+
+  return (s->load + 1.0 > ceil(share));
 }
 
 
+/*
+  Only the replicas hold the value, so the read goes to a random
+  replica, or to the next one that is not full when that one is.
+*/
 static
 int
-parse_ok_reply(struct command_state *state)
+bounded_replica(struct client *c, const int *servers, int count)
 {
-  switch (state->match)
+  int first = xorshift32(&c->rng) % count, i;
+
+  for (i = 0; i < count; ++i)
     {
-    case MATCH_OK:
-      store_result(state, 1);
-      return swallow_eol(state, 0, 1);
+      int server_index = servers[(first + i) % count];
 
-    default:
-      return MEMCACHED_UNKNOWN;
+      if (! server_full(c, server_index))
+        return server_index;
     }
+
+  /* Everybody is full, keep the random choice.  */
+  return servers[first];
 }
 
 
 static
-int
-parse_version_reply(struct command_state *state)
+struct command_state *
+get_state(struct client *c, int index, const char *key, size_t key_len,
+          size_t request_size, size_t str_size,
+          parse_reply_func parse_reply)
 {
-  const char *beg;
-  size_t len;
-  int res;
+  struct server *s;
+  int server_index, fd;
 
-  state->index = get_index(state);
-  next_index(state);
+  if (c->dispatch_server != -1)
+    server_index = c->dispatch_server;
+  else
+    server_index = key_server(c, index, key, key_len);
+  if (server_index == -1)
+    return NULL;
 
-  switch (state->match)
-    {
-    default:
-      return MEMCACHED_UNKNOWN;
+  if (c->hot_keys && --c->hot_keys_skip == 0)
+    c->hot_keys_skip = hot_keys_add(c->hot_keys, key, key_len, server_index);
 
-    case MATCH_VERSION:
-      break;
-    }
+  s = array_elem(c->servers, struct server, server_index);
 
-  while (*state->pos == ' ')
-    ++state->pos;
+  if (c->bounded_load > 0.0)
+    count_load(c, s);
 
-  beg = state->pos;
+  fd = get_server_fd(c, s);
+  if (fd == -1)
+    return NULL;
 
-  res = swallow_eol(state, 1, 1);
-  if (res != MEMCACHED_SUCCESS)
-    return res;
+  return init_state(&s->cmd_state, index, request_size, str_size,
+                    parse_reply);
+}
 
-  len = state->pos - sizeof(eol) - beg;
 
-  state->u.embedded.ptr = state->object->alloc(len, &state->u.embedded.opaque);
-  if (! state->u.embedded.ptr)
-    return MEMCACHED_FAILURE;
+static inline
+const char *
+get_noreply(struct command_state *state)
+{
+  if (state->noreply && state->client->noreply)
+    return " " NOREPLY;
+  else
+    return "";
+}
 
-  memcpy(state->u.embedded.ptr, beg, len);
 
-  state->object->store(state->object->arg, state->u.embedded.opaque,
-                       state->index, NULL);
+static
+void
+refresh_ns_gen(struct client *c);
 
-  return MEMCACHED_SUCCESS;
+
+static inline
+void
+reset(struct client *c, struct result_object *o, int noreply)
+{
+  array_clear(c->index_list);
+  array_clear(c->str_buf);
+
+  if (c->batch_keys && c->batch_key_count > 1)
+    key_dedup_clear(c->batch_keys);
+  c->batch_key_count = 0;
+  array_clear(c->next_duplicate);
+  array_clear(c->dispatch_batch);
+
+  ++c->generation;
+  c->object = o;
+  c->noreply = noreply;
+}
+
+
+void
+client_reset(struct client *c, struct result_object *o, int noreply)
+{
+  if (c->ns_gen_key && time_ms() >= c->ns_gen_expires)
+    refresh_ns_gen(c);
+
+  reset(c, o, noreply);
 }
 
 
+#define STR_WITH_LEN(str) (str), (sizeof(str) - 1)
+
+
+/*
+  Keys repeated within one batch are sent only once.  Duplicates are
+  chained after the first index in next_duplicate, and store_result()
+  copies the result to all of them.  Value results are not copied,
+  because get_multi() and friends return them by key anyway.  The
+  first key is only remembered, so single key commands don't pay for
+  hashing.
+*/
 static
 int
-parse_nowait_reply(struct command_state *state)
+duplicate_key(struct client *c, int key_index,
+              const char *key, size_t key_len)
 {
-  int res;
+  int first, size, i;
 
-  /*
-    Cast to enum parse_keyword_e to get compiler warning when some
-    match result is not handled.
-  */
-  switch ((enum parse_keyword_e) state->match)
+  /* Commands without a result are never merged.  */
+  if (key_index < 0)
+    return 0;
+
+  if (++c->batch_key_count == 1)
     {
-    case MATCH_DELETED:
-    case MATCH_OK:
-    case MATCH_STORED:
-    case MATCH_EXISTS:
-    case MATCH_NOT_FOUND:
-    case MATCH_NOT_STORED:
-    case MATCH_TOUCHED:
-      return swallow_eol(state, 0, 1);
+      c->batch_first_key = key;
+      c->batch_first_key_len = key_len;
+      c->batch_first_index = key_index;
+      return 0;
+    }
 
-    case MATCH_0: case MATCH_1: case MATCH_2: case MATCH_3: case MATCH_4:
-    case MATCH_5: case MATCH_6: case MATCH_7: case MATCH_8: case MATCH_9:
-    case MATCH_VERSION: /* see client_noreply_push().  */
-      return swallow_eol(state, 1, 1);
+  if (! c->batch_keys)
+    {
+      c->batch_keys = key_dedup_init();
+      if (! c->batch_keys)
+        return 0;
+    }
 
-    case MATCH_ERROR:
-      res = swallow_eol(state, 0, 1);
-      return (res == MEMCACHED_SUCCESS ? MEMCACHED_ERROR : res);
+  if (c->batch_key_count == 2)
+    key_dedup_insert(c->batch_keys, c->batch_first_key,
+                     c->batch_first_key_len, c->batch_first_index);
 
-    case MATCH_CLIENT_ERROR:
-    case MATCH_SERVER_ERROR:
-      res = swallow_eol(state, 1, 1);
-      return (res == MEMCACHED_SUCCESS ? MEMCACHED_ERROR : res);
+  first = key_dedup_insert(c->batch_keys, key, key_len, key_index);
+  if (first == key_index)
+    return 0;
 
-    case NO_MATCH:
-    case MATCH_VALUE:
-    case MATCH_END:
-    case MATCH_STAT:
-      return MEMCACHED_UNKNOWN;
+  size = array_size(c->next_duplicate);
+  if (size <= key_index)
+    {
+      if (array_extend(c->next_duplicate, int, key_index + 1 - size,
+                       ARRAY_EXTEND_TWICE) == -1)
+        return 0;
+
+      for (i = size; i <= key_index; ++i)
+        *array_elem(c->next_duplicate, int, i) = -1;
+      array_append(c->next_duplicate, key_index + 1 - size);
     }
 
-  /* Never reach here.  */
-  return MEMCACHED_UNKNOWN;
+  /* first < key_index, so it is within the array now.  */
+  *array_elem(c->next_duplicate, int, key_index) =
+    *array_elem(c->next_duplicate, int, first);
+  *array_elem(c->next_duplicate, int, first) = key_index;
+
+  return 1;
 }
 
 
-static
+static inline
 void
-client_mark_failed(struct client *c, struct server *s)
+local_cache_invalidate(struct client *c, const char *key, size_t key_len)
 {
-  if (s->cmd_state.fd != -1)
-    {
-      close(s->cmd_state.fd);
-      s->cmd_state.fd = -1;
-      s->cmd_state.nowait_count = 0;
-      s->cmd_state.pos = s->cmd_state.end = s->cmd_state.eol =
-        s->cmd_state.buf;
-    }
+  if (c->near_cache)
+    near_cache_remove(c->near_cache, c->prefix, c->prefix_len, key, key_len);
+  if (c->shared_cache)
+    shm_cache_remove(c->shared_cache, c->prefix, c->prefix_len, key, key_len);
+  if (c->negative_cache)
+    negative_cache_remove(c->negative_cache, c->prefix, c->prefix_len,
+                          key, key_len);
+}
 
-  if (c->max_failures > 0)
+
+/*
+  Look the key up in the near cache, then in the shared cache, and
+  store the value on hit.  Shared hits are copied to the near cache
+  for the time they have left, so the staleness is still bounded by
+  the shared entry.
+*/
+static
+int
+local_cache_fetch(struct client *c, int key_index,
+                  const char *key, size_t key_len)
+{
+  const void *value;
+  value_size_type value_size;
+  struct meta_object meta;
+  void *opaque, *ptr;
+  int ttl;
+
+  if (! (c->near_cache
+         && near_cache_lookup(c->near_cache, c->prefix, c->prefix_len,
+                              key, key_len, &value, &value_size,
+                              &meta.flags)))
     {
-      time_t now = time(NULL);
-      if (s->failure_expires < now)
-        s->failure_count = 0;
-      ++s->failure_count;
-      /*
-        Set timeout on first failure, and on max_failures.  The idea
-        is that if max_failures had happened during failure_timeout,
-        we do not retry in another failure_timeout seconds.  This is
-        not entirely true: we remember the time of the first failure,
-        but for exact accounting we would have to keep time of each
-        failure.  However such exact measurement is not necessary.
-      */
-      if (s->failure_count == 1 || s->failure_count == c->max_failures)
-        s->failure_expires = now + c->failure_timeout;
+      if (! (c->shared_cache
+             && shm_cache_lookup(c->shared_cache, c->prefix, c->prefix_len,
+                                 key, key_len, &value, &value_size,
+                                 &meta.flags, &ttl)))
+        return 0;
+
+      if (c->near_cache)
+        near_cache_insert(c->near_cache, c->prefix, c->prefix_len,
+                          key, key_len, meta.flags, value, value_size, ttl);
     }
+
+  ptr = c->object->alloc(value_size, &opaque);
+  if (! ptr)
+    return 0;
+
+  memcpy(ptr, value, value_size);
+  meta.use_cas = 0;
+  meta.cas = 0;
+  c->object->store(c->object->arg, opaque, key_index, &meta);
+
+  return 1;
 }
 
 
 static
 int
-send_request(struct command_state *state, struct server *s)
+prepare_set(struct client *c, enum set_cmd_e cmd, int key_index,
+            const char *key, size_t key_len,
+            flags_type flags, exptime_type exptime,
+            const void *value, value_size_type value_size)
 {
-  while (state->iov_count > 0)
-    {
-      int count;
-      ssize_t res;
-      size_t len;
+  static const size_t request_size = 6;
+  static const size_t str_size =
+    sizeof(" " FLAGS_STUB " " EXPTIME_STUB " " VALUE_SIZE_STUB
+           " " NOREPLY "\r\n");
 
-      count = (state->iov_count < state->client->iov_max
-               ? state->iov_count : state->client->iov_max);
+  struct command_state *state;
 
-      state->iov->iov_base =
-        (char *) state->iov->iov_base + state->write_offset;
-      state->iov->iov_len -= state->write_offset;
-      len = state->iov->iov_len;
+  local_cache_invalidate(c, key, key_len);
 
-      res = writev_restart(state->fd, state->iov, count);
+  state = get_state(c, key_index, key, key_len, request_size, str_size,
+                    parse_set_reply);
+  if (! state)
+    return MEMCACHED_FAILURE;
 
-      state->iov->iov_base =
-        (char *) state->iov->iov_base - state->write_offset;
-      state->iov->iov_len += state->write_offset;
+  ++state->key_count;
 
-      if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
-        return MEMCACHED_EAGAIN;
-      if (res <= 0)
-        {
-          deactivate(state);
-          client_mark_failed(state->client, s);
+  switch (cmd)
+    {
+    case CMD_SET:
+      iov_push(state, STR_WITH_LEN("set"));
+      break;
 
-          return MEMCACHED_CLOSED;
-        }
+    case CMD_ADD:
+      iov_push(state, STR_WITH_LEN("add"));
+      break;
 
-      while ((size_t) res >= len)
-        {
-          res -= len;
-          ++state->iov;
-          if (--state->iov_count == 0)
-            break;
-          len = state->iov->iov_len;
-          state->write_offset = 0;
-        }
-      state->write_offset += res;
+    case CMD_REPLACE:
+      iov_push(state, STR_WITH_LEN("replace"));
+      break;
+
+    case CMD_APPEND:
+      iov_push(state, STR_WITH_LEN("append"));
+      break;
+
+    case CMD_PREPEND:
+      iov_push(state, STR_WITH_LEN("prepend"));
+      break;
+
+    case CMD_CAS:
+      /* This can't happen.  */
+      return MEMCACHED_FAILURE;
     }
+  iov_push(state, c->prefix, c->prefix_len);
+  iov_push(state, key, key_len);
 
-  if (state->reply_count == 0)
-    deactivate(state);
+  {
+    char *buf = array_end(c->str_buf, char);
+    size_t str_size =
+      sprintf(buf, " " FMT_FLAGS " " FMT_EXPTIME " " FMT_VALUE_SIZE "%s\r\n",
+              flags, exptime, value_size, get_noreply(state));
+    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
+    array_append(c->str_buf, str_size);
+  }
+
+  iov_push(state, value, value_size);
+  iov_push(state, STR_WITH_LEN("\r\n"));
 
   return MEMCACHED_SUCCESS;
 }
@@ -1263,57 +2828,43 @@ send_request(struct command_state *state, struct server *s)
 
 static
 int
-receive_reply(struct command_state *state)
+prepare_cas(struct client *c, int key_index,
+            const char *key, size_t key_len,
+            cas_type cas, flags_type flags, exptime_type exptime,
+            const void *value, value_size_type value_size)
 {
-  while (state->eol != state->end && *state->eol != eol[sizeof(eol) - 1])
-    ++state->eol;
-
-  /*
-    When buffer is empty, move to the beginning of it for better CPU
-    cache utilization.
-  */
-  if (state->pos == state->end)
-    state->pos = state->end = state->eol = state->buf;
+  static const size_t request_size = 6;
+  static const size_t str_size =
+    sizeof(" " FLAGS_STUB " " EXPTIME_STUB " " VALUE_SIZE_STUB
+           " " CAS_STUB " " NOREPLY "\r\n");
 
-  while (state->eol == state->end)
-    {
-      size_t size;
-      ssize_t res;
+  struct command_state *state;
 
-      size = REPLY_BUF_SIZE - (state->end - state->buf);
-      if (size == 0)
-        {
-          if (state->pos != state->buf)
-            {
-              size_t len = state->end - state->pos;
-              state->pos = memmove(state->buf, state->pos, len);
-              state->end -= REPLY_BUF_SIZE - len;
-              state->eol -= REPLY_BUF_SIZE - len;
-              size = REPLY_BUF_SIZE - len;
-            }
-          else
-            {
-              return MEMCACHED_UNKNOWN;
-            }
-        }
+  local_cache_invalidate(c, key, key_len);
 
-      res = read_restart(state->fd, state->end, size);
-      if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
-        return MEMCACHED_EAGAIN;
-      if (res <= 0)
-        return MEMCACHED_CLOSED;
+  state = get_state(c, key_index, key, key_len, request_size, str_size,
+                    parse_set_reply);
+  if (! state)
+    return MEMCACHED_FAILURE;
 
-      state->end += res;
+  ++state->key_count;
 
-      while (state->eol != state->end && *state->eol != eol[sizeof(eol) - 1])
-        ++state->eol;
-    }
+  iov_push(state, STR_WITH_LEN("cas"));
+  iov_push(state, c->prefix, c->prefix_len);
+  iov_push(state, key, key_len);
 
-  if ((size_t) (state->eol - state->buf) < sizeof(eol) - 1
-      || memcmp(state->eol - (sizeof(eol) - 1), eol, sizeof(eol) - 1) != 0)
-    return MEMCACHED_UNKNOWN;
+  {
+    char *buf = array_end(c->str_buf, char);
+    size_t str_size =
+      sprintf(buf, " " FMT_FLAGS " " FMT_EXPTIME " " FMT_VALUE_SIZE
+              " " FMT_CAS "%s\r\n", flags, exptime, value_size, cas,
+              get_noreply(state));
+    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
+    array_append(c->str_buf, str_size);
+  }
 
-  ++state->eol;
+  iov_push(state, value, value_size);
+  iov_push(state, STR_WITH_LEN("\r\n"));
 
   return MEMCACHED_SUCCESS;
 }
@@ -1321,813 +2872,1044 @@ receive_reply(struct command_state *state)
 
 static
 int
-parse_reply(struct command_state *state)
+prepare_get(struct client *c, enum get_cmd_e cmd, int key_index,
+            const char *key, size_t key_len)
 {
-  int res, skip;
+  static const size_t request_size = 4;
 
-  switch (state->match)
+  struct command_state *state;
+
+  /* gets wants current cas, so it always goes to the server.  */
+  if (cmd == CMD_GET)
     {
-    case MATCH_ERROR:
-    case MATCH_CLIENT_ERROR:
-    case MATCH_SERVER_ERROR:
-      skip = (state->match != MATCH_ERROR);
-      res = swallow_eol(state, skip, 1);
+      if (c->negative_cache
+          && negative_cache_lookup(c->negative_cache, c->prefix,
+                                   c->prefix_len, key, key_len))
+        return MEMCACHED_SUCCESS;
+
+      if ((c->near_cache || c->shared_cache)
+          && local_cache_fetch(c, key_index, key, key_len))
+        return MEMCACHED_SUCCESS;
+    }
 
-      return (res == MEMCACHED_SUCCESS ? MEMCACHED_ERROR : res);
+  state = get_state(c, key_index, key, key_len, request_size, 0,
+                    parse_get_reply);
+  if (! state)
+    return MEMCACHED_FAILURE;
 
-    default:
-      if (state->nowait_count)
-        return parse_nowait_reply(state);
-      else
-        return state->parse_reply(state);
+  ++state->key_count;
 
-    case NO_MATCH:
-      return MEMCACHED_UNKNOWN;
+  if (! array_empty(state->iov_buf))
+    {
+      /* Pop off trailing \r\n because we are about to add another key.  */
+      array_pop(state->iov_buf);
+
+      /* get can't be in noreply mode, so reply_count is positive.  */
+      --state->reply_count;
+    }
+  else
+    {
+      switch (cmd)
+        {
+        case CMD_GET:
+          state->u.value.meta.use_cas = 0;
+          state->u.value.fill_cache = (c->near_cache || c->shared_cache);
+          state->u.value.record_misses = (c->negative_cache != NULL);
+          iov_push(state, STR_WITH_LEN("get"));
+          break;
+
+        case CMD_GETS:
+          state->u.value.meta.use_cas = 1;
+          state->u.value.fill_cache = 0;
+          state->u.value.record_misses = 0;
+          iov_push(state, STR_WITH_LEN("gets"));
+          break;
+        }
     }
+
+  iov_push(state, c->prefix, c->prefix_len);
+  iov_push(state, key, key_len);
+  iov_push(state, STR_WITH_LEN("\r\n"));
+
+  return MEMCACHED_SUCCESS;
 }
 
 
-static
 int
-process_reply(struct command_state *state, struct server *s)
+client_prepare_gat(struct client *c, enum gat_cmd_e cmd,
+                   int key_index, const char *key, size_t key_len, const char *exptime, size_t exptime_len)
 {
-  int res = 0;
-
-  while (1)
-    {
-      switch (state->phase)
-        {
-        case PHASE_RECEIVE:
-          res = receive_reply(state);
-          if (res != MEMCACHED_SUCCESS)
-            break;
-
-          state->match = parse_keyword(&state->pos);
+  static const size_t request_size = 6;
 
-          state->phase = PHASE_PARSE;
+  struct command_state *state;
 
-          /* FALLTHROUGH */
+  if (duplicate_key(c, key_index, key, key_len))
+    return MEMCACHED_SUCCESS;
 
-        case PHASE_PARSE:
-          res = parse_reply(state);
-          if (res != MEMCACHED_SUCCESS)
-            break;
+  state = get_state(c, key_index, key, key_len, request_size, 0,
+                    parse_get_reply);
+  if (! state)
+    return MEMCACHED_FAILURE;
 
-          if (state->phase != PHASE_DONE)
-            continue;
+  ++state->key_count;
 
-          /* FALLTHROUGH */
+  if (! array_empty(state->iov_buf))
+    {
+      /* Pop off trailing \r\n because we are about to add another key.  */
+      array_pop(state->iov_buf);
 
-        case PHASE_DONE:
-          res = MEMCACHED_SUCCESS;
+      /* get can't be in noreply mode, so reply_count is positive.  */
+      --state->reply_count;
+    }
+  else
+    {
+      switch (cmd)
+        {
+        case CMD_GAT:
+          state->u.value.meta.use_cas = 0;
+          state->u.value.fill_cache = 0;
+          state->u.value.record_misses = 0;
+          iov_push(state, STR_WITH_LEN("gat"));
+          break;
 
+        case CMD_GATS:
+          state->u.value.meta.use_cas = 1;
+          state->u.value.fill_cache = 0;
+          state->u.value.record_misses = 0;
+          iov_push(state, STR_WITH_LEN("gats"));
           break;
+        }
 
-        case PHASE_VALUE:
-          res = read_value(state);
-          if (res != MEMCACHED_SUCCESS)
-            break;
+      iov_push(state, STR_WITH_LEN(" "));
+      iov_push(state, exptime, exptime_len);
+    }
 
-          state->phase = PHASE_RECEIVE;
-          continue;
-        }
+  iov_push(state, c->prefix, c->prefix_len);
+  iov_push(state, key, key_len);
+  iov_push(state, STR_WITH_LEN("\r\n"));
 
-      switch (res)
-        {
-        case MEMCACHED_ERROR:
-          if (! (state->client->close_on_error || state->noreply))
-            break;
+  return MEMCACHED_SUCCESS;
+}
 
-          /* FALLTHROUGH */
 
-        case MEMCACHED_UNKNOWN:
-        case MEMCACHED_CLOSED:
-          deactivate(state);
-          client_mark_failed(state->client, s);
+static
+int
+prepare_incr(struct client *c, enum arith_cmd_e cmd, int key_index,
+             const char *key, size_t key_len, arith_type arg)
+{
+  static const size_t request_size = 4;
+  static const size_t str_size = sizeof(" " ARITH_STUB " " NOREPLY "\r\n");
 
-          /* FALLTHROUGH */
+  struct command_state *state;
 
-        case MEMCACHED_EAGAIN:
-          return res;
-        }
+  local_cache_invalidate(c, key, key_len);
 
-      if (state->nowait_count > 0)
-        {
-          --state->nowait_count;
-        }
-      else if (--state->reply_count == 0)
-        {
-          if (state->iov_count == 0)
-            deactivate(state);
+  state = get_state(c, key_index, key, key_len, request_size, str_size,
+                    parse_arith_reply);
+  if (! state)
+    return MEMCACHED_FAILURE;
 
-          return res;
-        }
+  ++state->key_count;
 
-      state->phase = PHASE_RECEIVE;
+  switch (cmd)
+    {
+    case CMD_INCR:
+      iov_push(state, STR_WITH_LEN("incr"));
+      break;
+
+    case CMD_DECR:
+      iov_push(state, STR_WITH_LEN("decr"));
+      break;
     }
+  iov_push(state, c->prefix, c->prefix_len);
+  iov_push(state, key, key_len);
+
+  {
+    char *buf = array_end(c->str_buf, char);
+    size_t str_size =
+      sprintf(buf, " " FMT_ARITH "%s\r\n", arg, get_noreply(state));
+    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
+    array_append(c->str_buf, str_size);
+  }
+
+  return MEMCACHED_SUCCESS;
 }
 
 
-static inline
-void
-state_prepare(struct command_state *state, int key_index)
-{
-  state->last_cmd_noreply = state->prepared_last_cmd_noreply;
-  state->nowait_count += state->prepared_nowait_count;
+static
+int
+prepare_delete(struct client *c, int key_index,
+               const char *key, size_t key_len)
+{
+  static const size_t request_size = 4;
+  static const size_t str_size = sizeof(" " NOREPLY "\r\n");
+
+  struct command_state *state;
+
+  local_cache_invalidate(c, key, key_len);
+
+  state = get_state(c, key_index, key, key_len, request_size, str_size,
+                    parse_delete_reply);
+  if (! state)
+    return MEMCACHED_FAILURE;
 
-  state->key = array_elem(state->iov_buf, struct iovec, key_index);
-  state->iov = array_beg(state->iov_buf, struct iovec);
-  state->iov_count = array_size(state->iov_buf);
+  ++state->key_count;
 
-  if (state->str_step > 0)
-    {
-      struct iovec *iov = state->iov;
-      char *buf = array_beg(state->client->str_buf, char);
-      int count = state->iov_count, step = state->str_step;
+  iov_push(state, STR_WITH_LEN("delete"));
+  iov_push(state, c->prefix, c->prefix_len);
+  iov_push(state, key, key_len);
 
-      if (state->key_count > 0)
-        {
-          iov += 3;
-          count -= 3;
-        }
+  {
+    char *buf = array_end(c->str_buf, char);
+    size_t str_size = sprintf(buf, "%s\r\n", get_noreply(state));
+    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
+    array_append(c->str_buf, str_size);
+  }
 
-      while (count > 0)
-        {
-          iov->iov_base = (void *) (buf + (ptrdiff_t) (iov->iov_base));
-          iov += step;
-          count -= step;
-        }
-    }
+  return MEMCACHED_SUCCESS;
 }
 
 
+static
 int
-client_execute(struct client *c, int key_index)
+prepare_touch(struct client *c, int key_index,
+               const char *key, size_t key_len,
+               exptime_type exptime)
 {
-  int first_iter = 1;
+  static const size_t request_size = 4;
+  static const size_t str_size = sizeof(" " EXPTIME_STUB " " NOREPLY "\r\n");
 
-#if ! defined(MSG_NOSIGNAL) && ! defined(WIN32)
-  struct sigaction orig, ignore;
-  int res;
+  struct command_state *state;
 
-  ignore.sa_handler = SIG_IGN;
-  sigemptyset(&ignore.sa_mask);
-  ignore.sa_flags = 0;
-  res = sigaction(SIGPIPE, &ignore, &orig);
-  if (res == -1)
+  state = get_state(c, key_index, key, key_len, request_size, str_size,
+                    parse_touch_reply);
+  if (! state)
     return MEMCACHED_FAILURE;
-#endif /* ! defined(MSG_NOSIGNAL) && ! defined(WIN32) */
-
-  while (1)
-    {
-      struct server *s;
-      struct pollfd *pollfd_beg, *pollfd;
-      int res;
 
-      pollfd_beg = array_beg(c->pollfds, struct pollfd);
-      pollfd = pollfd_beg;
+  ++state->key_count;
 
-      for (array_each(c->servers, struct server, s))
-        {
-          int may_write, may_read;
-          struct command_state *state = &s->cmd_state;
+  iov_push(state, STR_WITH_LEN("touch"));
+  iov_push(state, c->prefix, c->prefix_len);
+  iov_push(state, key, key_len);
 
-          if (! is_active(state))
-            continue;
+  {
+    char *buf = array_end(c->str_buf, char);
+    size_t str_size = sprintf(buf, " " FMT_EXPTIME "%s\r\n", exptime, get_noreply(state));
+    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
+    array_append(c->str_buf, str_size);
+  }
 
-          if (first_iter)
-            {
-              state_prepare(state, key_index);
+  return MEMCACHED_SUCCESS;
+}
 
-              may_write = 1;
-              may_read = (state->reply_count > 0
-                          || state->nowait_count > 0);
-            }
-          else
-            {
-              const short revents = state->pollfd->revents;
 
-              may_write = revents & (POLLOUT | POLLERR | POLLHUP);
-              may_read = revents & (POLLIN | POLLERR | POLLHUP);
-            }
+/*
+  Replicated keys are written to all their replicas: the primary server
+  gets the real key index, and the others get -1, so their replies are
+  discarded.  get reads from a random replica.  gets, gat and cas
+  always use the primary server, because cas values differ between
+  the servers.  cas deletes the key on the other replicas, as the
+  reply isn't known when they are sent a request, so get never reads
+  a value the cas replaced.
+*/
+static inline
+int
+get_replicas(struct client *c, const char *key, size_t key_len, int *servers)
+{
+  if (c->replicas <= 1 || ! c->replicated
+      || ! key_set_contains(c->replicated, key, key_len))
+    return 0;
 
-          if (may_read || may_write)
-            {
-              if (may_write)
-                {
-                  int res;
+  return dispatch_key_replicas(&c->dispatch, key, key_len,
+                               servers, c->replicas);
+}
 
-                  res = send_request(state, s);
-                  if (res == MEMCACHED_CLOSED)
-                    may_read = 0;
-                }
 
-              if (may_read)
-                process_reply(state, s);
+int
+client_prepare_set(struct client *c, enum set_cmd_e cmd, int key_index,
+                   const char *key, size_t key_len,
+                   flags_type flags, exptime_type exptime,
+                   const void *value, value_size_type value_size)
+{
+  int servers[MAX_REPLICAS], count, i;
 
-              if (! is_active(state))
-                continue;
-            }
+  count = get_replicas(c, key, key_len, servers);
+  for (i = 1; i < count; ++i)
+    {
+      c->dispatch_server = servers[i];
+      prepare_set(c, cmd, -1, key, key_len, flags, exptime,
+                  value, value_size);
+    }
+  c->dispatch_server = -1;
 
-          pollfd->events = 0;
+  return prepare_set(c, cmd, key_index, key, key_len, flags, exptime,
+                     value, value_size);
+}
 
-          if (state->iov_count > 0)
-            pollfd->events |= POLLOUT;
-          if (state->reply_count > 0 || state->nowait_count > 0)
-            pollfd->events |= POLLIN;
 
-          if (pollfd->events != 0)
-            {
-              pollfd->fd = state->fd;
-              state->pollfd = pollfd;
-              ++pollfd;
-            }
-        }
+int
+client_prepare_cas(struct client *c, int key_index,
+                   const char *key, size_t key_len,
+                   cas_type cas, flags_type flags, exptime_type exptime,
+                   const void *value, value_size_type value_size)
+{
+  int servers[MAX_REPLICAS], count, i;
 
-      if (pollfd == pollfd_beg)
-        break;
+  count = get_replicas(c, key, key_len, servers);
+  for (i = 1; i < count; ++i)
+    {
+      c->dispatch_server = servers[i];
+      prepare_delete(c, -1, key, key_len);
+    }
+  c->dispatch_server = -1;
 
-      do
-        res = poll(pollfd_beg, pollfd - pollfd_beg, c->io_timeout);
-      while (res == -1 && errno == EINTR);
+  return prepare_cas(c, key_index, key, key_len, cas, flags, exptime,
+                     value, value_size);
+}
 
-      /*
-        On error or timeout close all active connections.  Otherwise
-        we might receive garbage on them later.
-      */
-      if (res <= 0)
-        {
-          for (array_each(c->servers, struct server, s))
-            {
-              struct command_state *state = &s->cmd_state;
 
-              if (is_active(state))
-                {
-                  /*
-                    Ugly fix for possible memory leak.  FIXME:
-                    requires redesign.
-                  */
-                  if (state->phase == PHASE_VALUE)
-                    state->object->free(state->u.value.opaque);
+int
+client_prepare_get(struct client *c, enum get_cmd_e cmd, int key_index,
+                   const char *key, size_t key_len)
+{
+  int servers[MAX_REPLICAS], count, res;
 
-                  client_mark_failed(c, s);
-                }
-            }
+  if (duplicate_key(c, key_index, key, key_len))
+    return MEMCACHED_SUCCESS;
 
-          break;
-        }
+  if (cmd != CMD_GET)
+    return prepare_get(c, cmd, key_index, key, key_len);
 
-      first_iter = 0;
+  count = get_replicas(c, key, key_len, servers);
+  if (count > 1)
+    {
+      xorshift_reseed(&c->rng, &c->rng_fork, c);
+      if (c->bounded_load > 0.0)
+        c->dispatch_server = bounded_replica(c, servers, count);
+      else
+        c->dispatch_server = servers[xorshift32(&c->rng) % count];
     }
 
-#if ! defined(MSG_NOSIGNAL) && ! defined(WIN32)
-  /*
-    Ignore return value of sigaction(), there's nothing we can do in
-    the case of error.
-  */
-  sigaction(SIGPIPE, &orig, NULL);
-#endif /* ! defined(MSG_NOSIGNAL) && ! defined(WIN32) */
+  res = prepare_get(c, cmd, key_index, key, key_len);
+  c->dispatch_server = -1;
 
-  return MEMCACHED_SUCCESS;
+  return res;
 }
 
 
-/* Is the following required for any platform?  */
-#if (! defined(IPPROTO_TCP) && defined(SOL_TCP))
-#define IPPROTO_TCP  SOL_TCP
-#endif
+/*
+  A prepared key set is a single block without pointers, so the caller
+  may keep it anywhere and copy it: a header, the per server groups,
+  the keys grouped by server, the prefix it was made with, and then
+  the text of every group, "get" (prefix key)... "\r\n".  The client
+  pointer is only compared with, and tells a block made for another
+  client.
+*/
+struct prepared_header
+{
+  const struct client *client;
+  size_t servers_version;
+  size_t prefix_len;
+  size_t key_count;
+  size_t group_count;
+  size_t text_len;
+};
+
+struct prepared_group
+{
+  size_t server;
+  size_t key_count;
+  size_t text_offset;
+  size_t text_len;
+};
+
+struct prepared_key
+{
+  size_t index;
+  size_t key_offset;            /* In text, right after the prefix.  */
+  size_t key_len;
+};
 
 
 static inline
-void
-tcp_optimize_latency(struct command_state *state)
+const struct prepared_group *
+prepared_groups(const struct prepared_header *h)
 {
-#ifdef TCP_NODELAY
-  if (state->socket_mode == TCP_THROUGHPUT)
-    {
-      static const int enable = 1;
-      setsockopt(state->fd, IPPROTO_TCP, TCP_NODELAY,
-                 (void *) &enable, sizeof(enable));
-      state->socket_mode = TCP_LATENCY;
-    }
-#endif /* TCP_NODELAY */
+  return (const struct prepared_group *) (h + 1);
 }
 
 
 static inline
-void
-tcp_optimize_throughput(struct command_state *state)
+const struct prepared_key *
+prepared_keys(const struct prepared_header *h)
 {
-#ifdef TCP_NODELAY
-  if (state->socket_mode == TCP_LATENCY)
-    {
-      static const int disable = 0;
-      setsockopt(state->fd, IPPROTO_TCP, TCP_NODELAY,
-                 (void *) &disable, sizeof(disable));
-      state->socket_mode = TCP_THROUGHPUT;
-    }
-#endif /* TCP_NODELAY */
+  return (const struct prepared_key *) (prepared_groups(h)
+                                        + h->group_count);
 }
 
 
-static
-int
-get_server_fd(struct client *c, struct server *s)
+static inline
+const char *
+prepared_prefix(const struct prepared_header *h)
 {
-  struct command_state *state;
+  return (const char *) (prepared_keys(h) + h->key_count);
+}
 
-  /*
-    Do not try to try reconnect if had max_failures and
-    failure_expires time is not reached yet.
-  */
-  if (c->max_failures > 0 && s->failure_count >= c->max_failures)
+
+static inline
+const char *
+prepared_text(const struct prepared_header *h)
+{
+  return prepared_prefix(h) + h->prefix_len;
+}
+
+
+void *
+client_prepare_keys(struct client *c, const char *const *keys,
+                    const size_t *key_lens, int count, size_t *size)
+{
+  struct prepared_header *h;
+  struct prepared_group *g;
+  struct prepared_key *k;
+  size_t *group_of, group_count, key_count, text_len, total;
+  int *servers, server_count, i;
+  char *text, *pos;
+
+  if (count < 0)
+    count = 0;
+
+  server_count = array_size(c->servers);
+  servers = malloc((count > 0 ? count : 1) * sizeof(*servers));
+  group_of = calloc(server_count + 1, sizeof(*group_of));
+  if (! servers || ! group_of)
     {
-      if (time(NULL) <= s->failure_expires)
-        return -1;
-      else
-        s->failure_count = 0;
+      free(servers);
+      free(group_of);
+      return NULL;
+    }
+
+  client_dispatch_keys(c, keys, key_lens, count, servers);
+
+  /* group_of[server] counts the keys first, and is 1 + group later.  */
+  key_count = 0;
+  text_len = 0;
+  for (i = 0; i < count; ++i)
+    {
+      if (servers[i] == -1)
+        continue;
+
+      ++group_of[servers[i]];
+      ++key_count;
+      text_len += c->prefix_len + key_lens[i];
     }
 
-  state = &s->cmd_state;
-  if (state->fd == -1)
+  group_count = 0;
+  for (i = 0; i < server_count; ++i)
     {
-      if (s->port)
+      if (group_of[i] > 0)
         {
-          state->fd = client_connect_inet(s->host, s->port,
-                                          c->connect_timeout);
-          /* This is to trigger actual reset.  */
-          state->socket_mode = TCP_THROUGHPUT;
-          if (state->fd != -1)
-            tcp_optimize_latency(state);
+          text_len += sizeof("get\r\n") - 1;
+          group_of[i] = ++group_count;
         }
-      else
+    }
+
+  total = (sizeof(*h) + group_count * sizeof(*g) + key_count * sizeof(*k)
+           + c->prefix_len + text_len);
+  h = malloc(total);
+  if (! h)
+    {
+      free(servers);
+      free(group_of);
+      return NULL;
+    }
+
+  h->client = c;
+  h->servers_version = c->servers_version;
+  h->prefix_len = c->prefix_len;
+  h->key_count = key_count;
+  h->group_count = group_count;
+  h->text_len = text_len;
+
+  g = (struct prepared_group *) prepared_groups(h);
+  k = (struct prepared_key *) prepared_keys(h);
+  memcpy((char *) prepared_prefix(h), c->prefix, c->prefix_len);
+  text = (char *) prepared_text(h);
+
+  pos = text;
+  for (i = 0; i < server_count; ++i)
+    {
+      int j;
+
+      if (group_of[i] == 0)
+        continue;
+
+      g->server = i;
+      g->key_count = 0;
+      g->text_offset = pos - text;
+
+      memcpy(pos, "get", 3);
+      pos += 3;
+      for (j = 0; j < count; ++j)
         {
-          state->fd = client_connect_unix(s->host, s->host_len);
-          state->socket_mode = NOT_TCP;
+          if (servers[j] != i)
+            continue;
+
+          memcpy(pos, c->prefix, c->prefix_len);
+          pos += c->prefix_len;
+          memcpy(pos, keys[j], key_lens[j]);
+
+          k->index = j;
+          k->key_offset = pos - text;
+          k->key_len = key_lens[j];
+          ++k;
+
+          pos += key_lens[j];
+          ++g->key_count;
         }
+      memcpy(pos, "\r\n", 2);
+      pos += 2;
+
+      g->text_len = pos - text - g->text_offset;
+      ++g;
     }
 
-  if (state->fd == -1)
-    client_mark_failed(c, s);
+  free(servers);
+  free(group_of);
 
-  return state->fd;
+  *size = total;
+
+  return h;
 }
 
 
-static inline
-void
-iov_push(struct command_state *state, const void *buf, size_t buf_size)
+int
+client_prepared_keys_valid(struct client *c, const void *prepared,
+                           size_t size)
 {
-  struct iovec *iov = array_end(state->iov_buf, struct iovec);
-  iov->iov_base = (void *) buf;
-  iov->iov_len = buf_size;
-  array_push(state->iov_buf);
+  const struct prepared_header *h = prepared;
+
+  if (size < sizeof(*h))
+    return 0;
+
+  return (h->client == c
+          && h->servers_version == c->servers_version
+          && h->prefix_len == c->prefix_len
+          && memcmp(prepared_prefix(h), c->prefix, c->prefix_len) == 0);
 }
 
 
 static
 int
-push_index(struct command_state *state, int index)
+prepare_get_group(struct client *c, const struct prepared_group *g,
+                  const struct prepared_key *k, const char *text,
+                  size_t prefix_len)
 {
-  struct index_node *node;
-  struct client *c;
+  struct command_state *state;
+  struct server *s;
+  size_t i;
 
-  c = state->client;
-  if (array_extend(c->index_list, struct index_node,
-                   1, ARRAY_EXTEND_TWICE) == -1)
+  s = array_elem(c->servers, struct server, g->server);
+  if (get_server_fd(c, s) == -1)
     return MEMCACHED_FAILURE;
 
-  if (state->index_tail != -1)
-    array_elem(c->index_list, struct index_node, state->index_tail)->next =
-      array_size(c->index_list);
-  else
-    state->index_head = array_size(c->index_list);
+  state = init_state(&s->cmd_state, k[0].index, g->key_count * 2 + 2, 0,
+                     parse_get_reply);
+  if (! state)
+    return MEMCACHED_FAILURE;
 
-  state->index_tail = array_size(c->index_list);
+  state->key_count += g->key_count;
+  state->u.value.meta.use_cas = 0;
+  state->u.value.fill_cache = 0;
+  state->u.value.record_misses = 0;
 
-  node = array_elem(c->index_list, struct index_node, state->index_tail);
-  node->index = index;
-  node->next = -1;
+  iov_push(state, text + g->text_offset, 3);
+  for (i = 0; i < g->key_count; ++i)
+    {
+      if (i > 0 && push_index(state, k[i].index) != MEMCACHED_SUCCESS)
+        {
+          deactivate(state);
+          return MEMCACHED_FAILURE;
+        }
 
-  array_push(c->index_list);
+      iov_push(state, text + k[i].key_offset - prefix_len, prefix_len);
+      iov_push(state, text + k[i].key_offset, k[i].key_len);
+    }
+  iov_push(state, text + g->text_offset + g->text_len - 2, 2);
 
   return MEMCACHED_SUCCESS;
 }
 
 
-static
-struct command_state *
-init_state(struct command_state *state, int index, size_t request_size,
-           size_t str_size, parse_reply_func parse_reply)
+int
+client_prepare_get_keys(struct client *c, const void *prepared)
 {
-  if (! is_active(state))
+  const struct prepared_header *h = prepared;
+  const struct prepared_group *g;
+  const struct prepared_key *k;
+  const char *text;
+  size_t i;
+
+  g = prepared_groups(h);
+  k = prepared_keys(h);
+  text = prepared_text(h);
+
+  for (i = 0; i < h->group_count; ++i)
     {
-      if (state->client->noreply)
-        {
-          if (state->client->nowait || state->noreply)
-            {
-              parse_reply = NULL;
-              tcp_optimize_throughput(state);
-            }
+      struct server *s;
+      size_t j;
 
-          state->prepared_last_cmd_noreply = state->noreply;
+      s = array_elem(c->servers, struct server, g[i].server);
+
+      /*
+        Local caches and the per key dispatch policies have to see
+        every key, and a server that already has gets in this batch
+        gets the rest of them appended, so such keys take the usual
+        path.
+      */
+      if (c->near_cache || c->shared_cache || c->negative_cache
+          || c->hot_keys || c->replicated || c->bounded_load > 0.0
+          || is_active(&s->cmd_state))
+        {
+          for (j = 0; j < g[i].key_count; ++j)
+            client_prepare_get(c, CMD_GET, k[j].index,
+                               text + k[j].key_offset, k[j].key_len);
         }
       else
         {
-          state->prepared_last_cmd_noreply = 0;
-          tcp_optimize_latency(state);
+          prepare_get_group(c, &g[i], k, text, h->prefix_len);
         }
 
-      state->object = state->client->object;
-      command_state_reset(state, (str_size > 0 ? request_size : 0),
-                          parse_reply);
+      k += g[i].key_count;
     }
 
-  if (array_extend(state->iov_buf, struct iovec,
-                   request_size, ARRAY_EXTEND_EXACT) == -1)
-    {
-      deactivate(state);
-      return NULL;
-    }
+  return MEMCACHED_SUCCESS;
+}
 
-  if (str_size > 0
-      && array_extend(state->client->str_buf, char,
-                      str_size, ARRAY_EXTEND_TWICE) == -1)
-    {
-      deactivate(state);
-      return NULL;
-    }
 
-  if (push_index(state, index) != MEMCACHED_SUCCESS)
+static
+int
+prepare_incr_replicas(struct client *c, enum arith_cmd_e cmd, int key_index,
+                      const char *key, size_t key_len, arith_type arg)
+{
+  int servers[MAX_REPLICAS], count, i;
+
+  count = get_replicas(c, key, key_len, servers);
+  for (i = 1; i < count; ++i)
     {
-      deactivate(state);
-      return NULL;
+      c->dispatch_server = servers[i];
+      prepare_incr(c, cmd, -1, key, key_len, arg);
     }
+  c->dispatch_server = -1;
 
-  if (state->parse_reply)
-    ++state->reply_count;
-  else if (! state->prepared_last_cmd_noreply)
-    ++state->prepared_nowait_count;
-
-  return state;
+  return prepare_incr(c, cmd, key_index, key, key_len, arg);
 }
 
 
+/*
+  counters_pending() returns the number of buffered deltas.  A forked
+  child drops the deltas inherited from its parent, as the parent
+  flushes them itself.
+*/
 static
-struct command_state *
-get_state(struct client *c, int index, const char *key, size_t key_len,
-          size_t request_size, size_t str_size,
-          parse_reply_func parse_reply)
+size_t
+counters_pending(struct client *c)
 {
-  struct server *s;
-  int server_index, fd;
+  if (! c->counters)
+    return 0;
 
-  server_index = dispatch_key(&c->dispatch, key, key_len);
-  if (server_index == -1)
-    return NULL;
+  if (c->counters_fork != fork_count())
+    counter_buffer_clear(c->counters);
 
-  s = array_elem(c->servers, struct server, server_index);
+  return counter_buffer_count(c->counters);
+}
 
-  fd = get_server_fd(c, s);
-  if (fd == -1)
-    return NULL;
 
-  return init_state(&s->cmd_state, index, request_size, str_size,
-                    parse_reply);
+int
+client_prepare_incr(struct client *c, enum arith_cmd_e cmd, int key_index,
+                    const char *key, size_t key_len, arith_type arg)
+{
+  /*
+    The reply has to account for the buffered delta, so the delta is
+    sent with this command.
+  */
+  if (counters_pending(c))
+    {
+      counter_delta_type delta;
+
+      delta = counter_buffer_take(c->counters, c->prefix, c->prefix_len,
+                                  key, key_len);
+      if (delta != 0)
+        {
+          delta += (cmd == CMD_INCR ? (counter_delta_type) arg
+                    : -(counter_delta_type) arg);
+          cmd = (delta >= 0 ? CMD_INCR : CMD_DECR);
+          arg = (delta >= 0 ? delta : -delta);
+        }
+    }
+
+  return prepare_incr_replicas(c, cmd, key_index, key, key_len, arg);
 }
 
 
-static inline
-const char *
-get_noreply(struct command_state *state)
+int
+client_buffer_incr(struct client *c, enum arith_cmd_e cmd,
+                   const char *key, size_t key_len, arith_type arg)
 {
-  if (state->noreply && state->client->noreply)
-    return " " NOREPLY;
-  else
-    return "";
+  counter_delta_type delta;
+
+  if (! c->counters || arg > LLONG_MAX / 2)
+    return MEMCACHED_FAILURE;
+
+  delta = (cmd == CMD_INCR ? (counter_delta_type) arg
+           : -(counter_delta_type) arg);
+
+  if (counters_pending(c) == 0)
+    {
+      c->counters_since = time_ms();
+      c->counters_fork = fork_count();
+    }
+
+  if (counter_buffer_add(c->counters, c->prefix, c->prefix_len,
+                         key, key_len, delta) == -1)
+    return MEMCACHED_FAILURE;
+
+  return MEMCACHED_SUCCESS;
 }
 
 
-inline
+/*
+  The delta is sent with the prefix it was queued with, which differs
+  from the current one when the namespace generation has changed
+  since.
+*/
+static
 void
-client_reset(struct client *c, struct result_object *o, int noreply)
+prepare_counter(void *arg, const char *prefix, size_t prefix_len,
+                const char *key, size_t key_len, counter_delta_type delta)
 {
-  array_clear(c->index_list);
-  array_clear(c->str_buf);
+  struct client *c = (struct client *) arg;
+  char *current = c->prefix;
+  size_t current_len = c->prefix_len;
 
-  ++c->generation;
-  c->object = o;
-  c->noreply = noreply;
-}
+  c->prefix = (char *) prefix;
+  c->prefix_len = prefix_len;
 
+  if (delta > 0)
+    prepare_incr_replicas(c, CMD_INCR, -1, key, key_len, delta);
+  else
+    prepare_incr_replicas(c, CMD_DECR, -1, key, key_len, -delta);
 
-#define STR_WITH_LEN(str) (str), (sizeof(str) - 1)
+  c->prefix = current;
+  c->prefix_len = current_len;
+}
 
 
+/*
+  Buffered counters are flushed with whatever request is executed
+  after they become due, and their replies are discarded.  The keys
+  are owned by the buffer, so it is cleared only after the request is
+  sent.
+*/
 int
-client_prepare_set(struct client *c, enum set_cmd_e cmd, int key_index,
-                   const char *key, size_t key_len,
-                   flags_type flags, exptime_type exptime,
-                   const void *value, value_size_type value_size)
+client_execute(struct client *c, int key_index)
 {
-  static const size_t request_size = 6;
-  static const size_t str_size =
-    sizeof(" " FLAGS_STUB " " EXPTIME_STUB " " VALUE_SIZE_STUB
-           " " NOREPLY "\r\n");
-
-  struct command_state *state;
+  int flush = 0, res;
 
-  state = get_state(c, key_index, key, key_len, request_size, str_size,
-                    parse_set_reply);
-  if (! state)
-    return MEMCACHED_FAILURE;
+  if (counters_pending(c) > 0)
+    {
+      flush = (c->counters_force
+               || counter_buffer_count(c->counters) >= c->counters_max_keys
+               || time_ms() - c->counters_since >= c->counters_interval);
+      if (flush)
+        counter_buffer_each(c->counters, prepare_counter, c);
+    }
 
-  ++state->key_count;
+  res = execute(c, key_index);
 
-  switch (cmd)
+  if (flush)
     {
-    case CMD_SET:
-      iov_push(state, STR_WITH_LEN("set"));
-      break;
+      counter_buffer_clear(c->counters);
+      c->counters_force = 0;
+    }
 
-    case CMD_ADD:
-      iov_push(state, STR_WITH_LEN("add"));
-      break;
+  return res;
+}
 
-    case CMD_REPLACE:
-      iov_push(state, STR_WITH_LEN("replace"));
-      break;
 
-    case CMD_APPEND:
-      iov_push(state, STR_WITH_LEN("append"));
-      break;
+int
+client_flush_counters(struct client *c)
+{
+  if (counters_pending(c) == 0)
+    return MEMCACHED_SUCCESS;
 
-    case CMD_PREPEND:
-      iov_push(state, STR_WITH_LEN("prepend"));
-      break;
+  client_reset(c, NULL, 1);
+  c->counters_force = 1;
 
-    case CMD_CAS:
-      /* This can't happen.  */
-      return MEMCACHED_FAILURE;
-    }
-  iov_push(state, c->prefix, c->prefix_len);
-  iov_push(state, key, key_len);
+  return client_execute(c, 2);
+}
 
-  {
-    char *buf = array_end(c->str_buf, char);
-    size_t str_size =
-      sprintf(buf, " " FMT_FLAGS " " FMT_EXPTIME " " FMT_VALUE_SIZE "%s\r\n",
-              flags, exptime, value_size, get_noreply(state));
-    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
-    array_append(c->str_buf, str_size);
-  }
 
-  iov_push(state, value, value_size);
-  iov_push(state, STR_WITH_LEN("\r\n"));
+int
+client_prepare_delete(struct client *c, int key_index,
+                      const char *key, size_t key_len)
+{
+  int servers[MAX_REPLICAS], count, i;
+
+  if (duplicate_key(c, key_index, key, key_len))
+    return MEMCACHED_SUCCESS;
+
+  count = get_replicas(c, key, key_len, servers);
+  for (i = 1; i < count; ++i)
+    {
+      c->dispatch_server = servers[i];
+      prepare_delete(c, -1, key, key_len);
+    }
+  c->dispatch_server = -1;
 
-  return MEMCACHED_SUCCESS;
+  return prepare_delete(c, key_index, key, key_len);
 }
 
 
 int
-client_prepare_cas(struct client *c, int key_index,
-                   const char *key, size_t key_len,
-                   cas_type cas, flags_type flags, exptime_type exptime,
-                   const void *value, value_size_type value_size)
+client_prepare_touch(struct client *c, int key_index,
+                     const char *key, size_t key_len,
+                     exptime_type exptime)
 {
-  static const size_t request_size = 6;
-  static const size_t str_size =
-    sizeof(" " FLAGS_STUB " " EXPTIME_STUB " " VALUE_SIZE_STUB
-           " " CAS_STUB " " NOREPLY "\r\n");
-
-  struct command_state *state;
+  int servers[MAX_REPLICAS], count, i;
 
-  state = get_state(c, key_index, key, key_len, request_size, str_size,
-                    parse_set_reply);
-  if (! state)
-    return MEMCACHED_FAILURE;
+  if (duplicate_key(c, key_index, key, key_len))
+    return MEMCACHED_SUCCESS;
 
-  ++state->key_count;
+  count = get_replicas(c, key, key_len, servers);
+  for (i = 1; i < count; ++i)
+    {
+      c->dispatch_server = servers[i];
+      prepare_touch(c, -1, key, key_len, exptime);
+    }
+  c->dispatch_server = -1;
 
-  iov_push(state, STR_WITH_LEN("cas"));
-  iov_push(state, c->prefix, c->prefix_len);
-  iov_push(state, key, key_len);
+  return prepare_touch(c, key_index, key, key_len, exptime);
+}
 
-  {
-    char *buf = array_end(c->str_buf, char);
-    size_t str_size =
-      sprintf(buf, " " FMT_FLAGS " " FMT_EXPTIME " " FMT_VALUE_SIZE
-              " " FMT_CAS "%s\r\n", flags, exptime, value_size, cas,
-              get_noreply(state));
-    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
-    array_append(c->str_buf, str_size);
-  }
 
-  iov_push(state, value, value_size);
-  iov_push(state, STR_WITH_LEN("\r\n"));
+/*
+  Namespace generation is a number stored under ns_gen_key in the
+  namespace (but not in the generation), and appended to the key
+  prefix.  Incrementing it makes all keys of the namespace
+  unreachable at once.  The value is cached for ns_gen_ttl.
+*/
 
-  return MEMCACHED_SUCCESS;
-}
+struct ns_gen_value
+{
+  size_t size;
+  char data[1];
+};
 
 
-int
-client_prepare_get(struct client *c, enum get_cmd_e cmd, int key_index,
-                   const char *key, size_t key_len)
+static
+void *
+alloc_ns_gen(value_size_type value_size, void **opaque)
 {
-  static const size_t request_size = 4;
-
-  struct command_state *state;
+  struct ns_gen_value *v;
 
-  state = get_state(c, key_index, key, key_len, request_size, 0,
-                    parse_get_reply);
-  if (! state)
-    return MEMCACHED_FAILURE;
+  v = (struct ns_gen_value *) malloc(sizeof(struct ns_gen_value)
+                                     + value_size);
+  if (! v)
+    return NULL;
 
-  ++state->key_count;
+  v->size = value_size;
+  *opaque = v;
 
-  if (! array_empty(state->iov_buf))
-    {
-      /* Pop off trailing \r\n because we are about to add another key.  */
-      array_pop(state->iov_buf);
+  return v->data;
+}
 
-      /* get can't be in noreply mode, so reply_count is positive.  */
-      --state->reply_count;
-    }
-  else
-    {
-      switch (cmd)
-        {
-        case CMD_GET:
-          state->u.value.meta.use_cas = 0;
-          iov_push(state, STR_WITH_LEN("get"));
-          break;
 
-        case CMD_GETS:
-          state->u.value.meta.use_cas = 1;
-          iov_push(state, STR_WITH_LEN("gets"));
-          break;
-        }
-    }
+static
+void
+store_ns_gen(void *arg, void *opaque, int key_index, void *meta)
+{
+  struct ns_gen_value **res = (struct ns_gen_value **) arg;
 
-  iov_push(state, c->prefix, c->prefix_len);
-  iov_push(state, key, key_len);
-  iov_push(state, STR_WITH_LEN("\r\n"));
+  (void) key_index;
+  (void) meta;
 
-  return MEMCACHED_SUCCESS;
+  free(*res);
+  *res = (struct ns_gen_value *) opaque;
 }
 
 
-int
-client_prepare_gat(struct client *c, enum gat_cmd_e cmd,
-                   int key_index, const char *key, size_t key_len, const char *exptime, size_t exptime_len)
+static
+void
+free_ns_gen(void *opaque)
 {
-  static const size_t request_size = 6;
+  free(opaque);
+}
 
-  struct command_state *state;
 
-  state = get_state(c, key_index, key, key_len, request_size, 0,
-                    parse_get_reply);
-  if (! state)
-    return MEMCACHED_FAILURE;
+static
+int
+use_ns_gen(struct client *c, struct ns_gen_value *v)
+{
+  size_t i;
 
-  ++state->key_count;
+  /* incr returns "0E0" for zero.  */
+  if (v->size == 0 || v->size >= sizeof(c->ns_gen)
+      || (v->size == 3 && memcmp(v->data, "0E0", 3) == 0))
+    return -1;
 
-  if (! array_empty(state->iov_buf))
+  for (i = 0; i < v->size; ++i)
     {
-      /* Pop off trailing \r\n because we are about to add another key.  */
-      array_pop(state->iov_buf);
-
-      /* get can't be in noreply mode, so reply_count is positive.  */
-      --state->reply_count;
+      if (v->data[i] < '0' || v->data[i] > '9')
+        return -1;
     }
-  else
-    {
-      switch (cmd)
-        {
-        case CMD_GAT:
-          state->u.value.meta.use_cas = 0;
-          iov_push(state, STR_WITH_LEN("gat"));
-          break;
 
-        case CMD_GATS:
-          state->u.value.meta.use_cas = 1;
-          iov_push(state, STR_WITH_LEN("gats"));
-          break;
-        }
+  memcpy(c->ns_gen, v->data, v->size);
+  c->ns_gen_len = v->size;
 
-      iov_push(state, STR_WITH_LEN(" "));
-      iov_push(state, exptime, exptime_len);
-    }
+  return 0;
+}
 
-  iov_push(state, c->prefix, c->prefix_len);
-  iov_push(state, key, key_len);
-  iov_push(state, STR_WITH_LEN("\r\n"));
 
-  return MEMCACHED_SUCCESS;
+static
+unsigned long long
+cached_ns_gen(struct client *c)
+{
+  unsigned long long res = 0;
+  size_t i;
+
+  for (i = 0; i < c->ns_gen_len; ++i)
+    res = res * 10 + (c->ns_gen[i] - '0');
+
+  return res;
 }
 
 
-int
-client_prepare_incr(struct client *c, enum arith_cmd_e cmd, int key_index,
-                    const char *key, size_t key_len, arith_type arg)
-{
-  static const size_t request_size = 4;
-  static const size_t str_size = sizeof(" " ARITH_STUB " " NOREPLY "\r\n");
+enum ns_gen_cmd_e { NS_GEN_GET, NS_GEN_INCR, NS_GEN_ADD };
 
-  struct command_state *state;
 
-  state = get_state(c, key_index, key, key_len, request_size, str_size,
-                    parse_arith_reply);
-  if (! state)
-    return MEMCACHED_FAILURE;
+/*
+  Run one command on the generation key, with the prefix cut down to
+  the namespace.
+*/
+static
+struct ns_gen_value *
+ns_gen_command(struct client *c, enum ns_gen_cmd_e cmd,
+               unsigned long long min)
+{
+  struct ns_gen_value *v = NULL;
+  struct result_object o = { alloc_ns_gen, store_ns_gen, free_ns_gen, &v };
+  size_t prefix_len = c->prefix_len;
+  char buf[sizeof(c->ns_gen)];
 
-  ++state->key_count;
+  c->prefix_len = 1 + c->ns_len;
 
   switch (cmd)
     {
-    case CMD_INCR:
-      iov_push(state, STR_WITH_LEN("incr"));
+    case NS_GEN_GET:
+      reset(c, &o, 0);
+      prepare_get(c, CMD_GETS, 0, c->ns_gen_key, c->ns_gen_key_len);
       break;
 
-    case CMD_DECR:
-      iov_push(state, STR_WITH_LEN("decr"));
+    case NS_GEN_INCR:
+      reset(c, &o, 0);
+      prepare_incr(c, CMD_INCR, 0, c->ns_gen_key, c->ns_gen_key_len, 1);
+      break;
+
+    case NS_GEN_ADD:
+      /*
+        A missing generation starts from the current time (or min if
+        that is greater), so that keys of an evicted generation are not
+        reused.
+      */
+      if (min < (unsigned long long) time(NULL))
+        min = time(NULL);
+      reset(c, NULL, 1);
+      prepare_set(c, CMD_ADD, 0, c->ns_gen_key, c->ns_gen_key_len, 0, 0,
+                  buf, sprintf(buf, "%llu", min));
       break;
     }
-  iov_push(state, c->prefix, c->prefix_len);
-  iov_push(state, key, key_len);
 
-  {
-    char *buf = array_end(c->str_buf, char);
-    size_t str_size =
-      sprintf(buf, " " FMT_ARITH "%s\r\n", arg, get_noreply(state));
-    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
-    array_append(c->str_buf, str_size);
-  }
+  execute(c, 2);
 
-  return MEMCACHED_SUCCESS;
+  c->prefix_len = prefix_len;
+
+  return v;
 }
 
 
-int
-client_prepare_delete(struct client *c, int key_index,
-                      const char *key, size_t key_len)
+static
+void
+refresh_ns_gen(struct client *c)
 {
-  static const size_t request_size = 4;
-  static const size_t str_size = sizeof(" " NOREPLY "\r\n");
+  struct ns_gen_value *v;
 
-  struct command_state *state;
+  v = ns_gen_command(c, NS_GEN_GET, 0);
+  if (! v)
+    {
+      ns_gen_command(c, NS_GEN_ADD, cached_ns_gen(c));
+      v = ns_gen_command(c, NS_GEN_GET, 0);
+    }
 
-  state = get_state(c, key_index, key, key_len, request_size, str_size,
-                    parse_delete_reply);
-  if (! state)
-    return MEMCACHED_FAILURE;
+  /* On failure keep the old generation and retry after the ttl.  */
+  if (v && use_ns_gen(c, v) == 0)
+    build_prefix(c, c->prefix + 1, c->ns_len);
 
-  ++state->key_count;
+  free(v);
 
-  iov_push(state, STR_WITH_LEN("delete"));
-  iov_push(state, c->prefix, c->prefix_len);
-  iov_push(state, key, key_len);
+  c->ns_gen_expires = time_ms() + c->ns_gen_ttl;
+}
 
-  {
-    char *buf = array_end(c->str_buf, char);
-    size_t str_size = sprintf(buf, "%s\r\n", get_noreply(state));
-    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
-    array_append(c->str_buf, str_size);
-  }
+
+int
+client_set_namespace_generation(struct client *c,
+                                const char *key, size_t key_len, int ttl)
+{
+  char *s;
+
+  s = (char *) malloc(key_len);
+  if (! s)
+    return MEMCACHED_FAILURE;
+
+  memcpy(s, key, key_len);
+
+  free(c->ns_gen_key);
+  c->ns_gen_key = s;
+  c->ns_gen_key_len = key_len;
+  c->ns_gen_ttl = ttl;
+  c->ns_gen_expires = 0;
 
   return MEMCACHED_SUCCESS;
 }
 
 
 int
-client_prepare_touch(struct client *c, int key_index,
-                      const char *key, size_t key_len,
-                      exptime_type exptime)
+client_bump_namespace_generation(struct client *c)
 {
-  static const size_t request_size = 4;
-  static const size_t str_size = sizeof(" " EXPTIME_STUB " " NOREPLY "\r\n");
-
-  struct command_state *state;
+  struct ns_gen_value *v;
+  int res = MEMCACHED_FAILURE;
 
-  state = get_state(c, key_index, key, key_len, request_size, str_size,
-                    parse_touch_reply);
-  if (! state)
+  if (! c->ns_gen_key)
     return MEMCACHED_FAILURE;
 
-  ++state->key_count;
+  v = ns_gen_command(c, NS_GEN_INCR, 0);
+  if (v && v->size == 0)
+    {
+      /* NOT_FOUND.  */
+      free(v);
+      ns_gen_command(c, NS_GEN_ADD, cached_ns_gen(c) + 1);
+      v = ns_gen_command(c, NS_GEN_GET, 0);
+    }
 
-  iov_push(state, STR_WITH_LEN("touch"));
-  iov_push(state, c->prefix, c->prefix_len);
-  iov_push(state, key, key_len);
+  if (v && use_ns_gen(c, v) == 0
+      && build_prefix(c, c->prefix + 1, c->ns_len) == MEMCACHED_SUCCESS)
+    {
+      c->ns_gen_expires = time_ms() + c->ns_gen_ttl;
+      res = MEMCACHED_SUCCESS;
+    }
 
-  {
-    char *buf = array_end(c->str_buf, char);
-    size_t str_size = sprintf(buf, " " FMT_EXPTIME "%s\r\n", exptime, get_noreply(state));
-    iov_push(state, (void *) (ptrdiff_t) array_size(c->str_buf), str_size);
-    array_append(c->str_buf, str_size);
-  }
+  free(v);
 
-  return MEMCACHED_SUCCESS;
+  return res;
 }
 
 
@@ -2145,6 +3927,11 @@ client_flush_all(struct client *c, delay_type delay,
 
   client_reset(c, o, noreply);
 
+  if (c->near_cache)
+    near_cache_clear(c->near_cache);
+  if (c->shared_cache)
+    shm_cache_clear(c->shared_cache);
+
   if (array_size(c->servers) > 1)
     delay_step = ddelay / (array_size(c->servers) - 1);
   ddelay += delay_step;
@@ -2248,6 +4035,40 @@ client_server_versions(struct client *c, struct result_object *o)
 }
 
 
+int
+client_server_stats(struct client *c, const char *arg, size_t arg_len,
+                    struct result_object *o)
+{
+  static const size_t request_size = 3;
+
+  struct server *s;
+  int i;
+
+  client_reset(c, o, 0);
+
+  for (i = 0, array_each(c->servers, struct server, s), ++i)
+    {
+      struct command_state *state;
+      int fd;
+
+      fd = get_server_fd(c, s);
+      if (fd == -1)
+        continue;
+
+      state = init_state(&s->cmd_state, i, request_size, 0,
+                         parse_stats_reply);
+      if (! state)
+        continue;
+
+      iov_push(state, STR_WITH_LEN("stats "));
+      iov_push(state, arg, arg_len);
+      iov_push(state, STR_WITH_LEN("\r\n"));
+    }
+
+  return client_execute(c, 2);
+}
+
+
 /*
   When noreply mode is enabled the client may send the last noreply
   request and close the connection.  The server will see that the
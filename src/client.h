@@ -24,6 +24,7 @@
 #ifndef CLIENT_H
 #define CLIENT_H 1
 
+#include "dispatch_key.h"
 #include <stddef.h>
 
 
@@ -90,6 +91,39 @@ struct meta_object
   cas_type cas;
 };
 
+struct near_cache_stats
+{
+  unsigned long long hits;
+  unsigned long long misses;
+  unsigned long long evictions;
+  size_t entries;
+  size_t bytes;
+};
+
+struct shared_cache_stats
+{
+  unsigned long long hits;
+  unsigned long long misses;
+  unsigned long long stores;
+  unsigned long long evictions;
+};
+
+struct negative_cache_stats
+{
+  unsigned long long hits;
+  unsigned long long stores;
+};
+
+struct hot_key_stat
+{
+  const char *key;
+  size_t key_len;
+  unsigned long long count;
+  unsigned long long error;
+  double rate;                  /* Per second.  */
+  int server;                   /* -1 if the server was removed.  */
+};
+
 
 extern
 struct client *
@@ -110,6 +144,26 @@ extern
 int
 client_set_ketama_points(struct client *c, int ketama_points);
 
+/*
+  client_set_dispatch_mode() should be called before adding any server.
+*/
+extern
+int
+client_set_dispatch_mode(struct client *c, enum dispatch_mode_e mode);
+
+/*
+  client_set_hash_function() should be called before adding any
+  server.
+*/
+extern
+int
+client_set_hash_function(struct client *c,
+                         enum dispatch_hash_e hash_function);
+
+extern
+void
+client_set_hash_tags(struct client *c, int enable);
+
 /*
   client_set_hash_namespace() should be called before setting the
   namespace.
@@ -124,6 +178,33 @@ client_add_server(struct client *c, const char *host, size_t host_len,
                   const char *port, size_t port_len, double weight,
                   int noreply);
 
+/*
+  client_find_server() returns the index of the first server at from
+  or after it that was added with the same address, weight and
+  noreply, or -1 if there's none.
+*/
+extern
+int
+client_find_server(struct client *c, int from,
+                   const char *host, size_t host_len,
+                   const char *port, size_t port_len, double weight,
+                   int noreply);
+
+/*
+  client_remove_server() closes the connection to the server at index
+  and removes it, the servers after it move down by one.
+  client_reorder_servers() moves the server at order[i] to i, order
+  being a permutation of all indexes.  The connections to the servers
+  are kept.  Both renumber the servers of the tracked hot keys.
+*/
+extern
+int
+client_remove_server(struct client *c, int index);
+
+extern
+int
+client_reorder_servers(struct client *c, const int *order);
+
 extern
 int
 client_set_prefix(struct client *c, const char *ns, size_t ns_len);
@@ -132,6 +213,15 @@ extern
 const char *
 client_get_prefix(struct client *c, size_t *ns_len);
 
+/*
+  client_get_key_len_max() returns the length of the longest key that
+  fits the memcached key length limit together with the current
+  namespace and its generation.
+*/
+extern
+size_t
+client_get_key_len_max(struct client *c);
+
 extern
 void
 client_set_connect_timeout(struct client *c, int to);
@@ -156,6 +246,191 @@ extern
 void
 client_set_nowait(struct client *c, int enable);
 
+/*
+  client_set_near_cache() enables in-process cache of get results
+  bounded by max_bytes, with entries expiring after ttl (1/1000 sec).
+  Zero max_bytes or ttl disables the cache.
+*/
+extern
+int
+client_set_near_cache(struct client *c, size_t max_bytes, int ttl);
+
+extern
+void
+client_get_near_cache_stats(struct client *c, struct near_cache_stats *stats);
+
+/*
+  client_set_shared_cache() enables the cache of get results in
+  shared memory, which is then shared with the processes forked
+  afterwards.  size is the total size of the segment, and item_size is
+  the maximum size of the key with the namespace and the value.  Zero
+  size or ttl disables the cache.
+*/
+extern
+int
+client_set_shared_cache(struct client *c, size_t size, size_t item_size,
+                        int ttl);
+
+extern
+void
+client_get_shared_cache_stats(struct client *c,
+                              struct shared_cache_stats *stats);
+
+/*
+  client_set_negative_cache() enables remembering keys that get found
+  missing for ttl (1/1000 sec), so that repeated gets of such keys do
+  not go to the server.  size is the number of remembered keys.  Zero
+  size or ttl disables the cache.
+*/
+extern
+int
+client_set_negative_cache(struct client *c, size_t size, int ttl);
+
+extern
+void
+client_get_negative_cache_stats(struct client *c,
+                                struct negative_cache_stats *stats);
+
+/*
+  client_set_hot_keys() enables tracking of capacity most frequent
+  keys dispatched to the servers, sampling one in sample keys on
+  average.  Zero capacity disables tracking.
+*/
+extern
+int
+client_set_hot_keys(struct client *c, int capacity, int sample);
+
+/*
+  client_get_hot_keys() returns the number of tracked keys, and sets
+  stats to them in the order of decreasing count.  The array is valid
+  until the next call.
+*/
+extern
+int
+client_get_hot_keys(struct client *c, const struct hot_key_stat **stats);
+
+/*
+  client_set_replicas() sets the number of servers that keys marked
+  with client_replicate_key() are stored on.
+*/
+extern
+int
+client_set_replicas(struct client *c, int replicas);
+
+extern
+int
+client_replicate_key(struct client *c, const char *key, size_t key_len,
+                     int enable);
+
+/*
+  client_dispatch_key() returns the index of the server the key is
+  dispatched to, or -1 if there are no servers.  No request is made.
+*/
+extern
+int
+client_dispatch_key(struct client *c, const char *key, size_t key_len);
+
+/*
+  client_dispatch_keys() puts into servers what client_dispatch_key()
+  would return for each of count keys.
+*/
+extern
+void
+client_dispatch_keys(struct client *c, const char *const *keys,
+                     const size_t *key_lens, int count, int *servers);
+
+/*
+  client_dispatch_batch() dispatches count keys at once.  It should be
+  called after client_reset() with the keys that are then prepared
+  with key_index from 0 to count - 1.  On failure the keys are
+  dispatched one by one as usual.
+*/
+extern
+int
+client_dispatch_batch(struct client *c, const char *const *keys,
+                      const size_t *key_lens, int count);
+
+/*
+  client_set_dispatch_snapshot() maps the dispatch tables from the
+  file at path, or builds them and writes the file first if it is
+  missing or was made for different servers.  Should be called after
+  all servers are added.
+*/
+extern
+int
+client_set_dispatch_snapshot(struct client *c, const char *path);
+
+/*
+  client_prepare_keys() dispatches count keys and encodes the gets for
+  them once, and returns a malloc()ed block of *size bytes that holds
+  no pointers and may be copied, or NULL if out of memory.  The block
+  stays usable while client_prepared_keys_valid() says so, that is
+  until the servers or the namespace prefix change.
+*/
+extern
+void *
+client_prepare_keys(struct client *c, const char *const *keys,
+                    const size_t *key_lens, int count, size_t *size);
+
+extern
+int
+client_prepared_keys_valid(struct client *c, const void *prepared,
+                           size_t size);
+
+/*
+  client_prepare_get_keys() does client_prepare_get() with CMD_GET for
+  all keys of a valid prepared block, with key_index being the
+  position of the key as given to client_prepare_keys().  The
+  prebuilt requests are sent as is unless local caches or per key
+  dispatch are enabled.
+*/
+extern
+int
+client_prepare_get_keys(struct client *c, const void *prepared);
+
+/*
+  client_set_bounded_load() makes plain gets of replicated keys skip a
+  replica that got more than (1 + bounded_load) times its share of the
+  recent requests for another replica.  Zero disables this.
+*/
+extern
+int
+client_set_bounded_load(struct client *c, double bounded_load);
+
+/*
+  client_set_counter_buffer() enables buffering of incr and decr
+  deltas with client_buffer_incr().  The buffer is flushed with the
+  next executed request after max_keys keys or interval_ms have
+  accumulated, or with client_flush_counters().
+*/
+extern
+int
+client_set_counter_buffer(struct client *c, size_t max_keys, int interval_ms);
+
+extern
+int
+client_buffer_incr(struct client *c, enum arith_cmd_e cmd,
+                   const char *key, size_t key_len, arith_type arg);
+
+extern
+int
+client_flush_counters(struct client *c);
+
+/*
+  client_set_namespace_generation() enables the namespace generation
+  stored in memcached under key, cached for ttl 1/1000 sec.
+  client_bump_namespace_generation() increments it, invalidating all
+  keys in the namespace.
+*/
+extern
+int
+client_set_namespace_generation(struct client *c,
+                                const char *key, size_t key_len, int ttl);
+
+extern
+int
+client_bump_namespace_generation(struct client *c);
+
 extern
 void
 client_reset(struct client *c, struct result_object *o, int noreply);
@@ -217,5 +492,14 @@ extern
 int
 client_server_versions(struct client *c, struct result_object *o);
 
+/*
+  client_server_stats() sends "stats arg" to all servers, and stores
+  every "name value" line of the reply with the server index.
+*/
+extern
+int
+client_server_stats(struct client *c, const char *arg, size_t arg_len,
+                    struct result_object *o);
+
 
 #endif /* ! CLIENT_H */
@@ -0,0 +1,79 @@
+/*
+  This file was generated with gencrc32.pl.
+
+  Do not edit.
+*/
+
+#ifndef COMPUTE_CRC32_H
+#define COMPUTE_CRC32_H 1
+
+#include <stddef.h>
+
+
+extern const unsigned int crc32lookup[8][256];
+
+
+/*
+  Strings at least this long are passed to compute_crc32_bulk() from
+  crc32_bulk.c, shorter ones are hashed a byte at a time inline.
+*/
+#define COMPUTE_CRC32_BULK_MIN  16
+
+extern
+unsigned int
+compute_crc32_bulk(unsigned int crc32, const char *s, size_t len);
+
+
+#define compute_crc32(s, l)                                      \
+  compute_crc32_add(0x00000000U, (s), (l))
+
+static inline
+unsigned int
+compute_crc32_add(unsigned int crc32, const char *s, size_t len)
+{
+  const char *end = s + len;
+
+  if (len >= COMPUTE_CRC32_BULK_MIN)
+    return compute_crc32_bulk(crc32, s, len);
+
+  crc32 = ~crc32;
+
+  while (s < end)
+    {
+      unsigned int index = (crc32 ^ (unsigned char) *s) & 0x000000ffU;
+      crc32 = (crc32 >> 8) ^ crc32lookup[0][index];
+      ++s;
+    }
+
+  return (~crc32);
+}
+
+
+/*
+  compute_crc32_add4() adds the first len bytes of four strings to
+  four CRCs at once.  The streams are independent, so table lookups
+  of one overlap with those of the others.
+*/
+static inline
+void
+compute_crc32_add4(unsigned int *crc32, const char *const *s, size_t len)
+{
+  unsigned int c0 = ~crc32[0], c1 = ~crc32[1], c2 = ~crc32[2], c3 = ~crc32[3];
+  size_t i;
+
+  for (i = 0; i < len; ++i)
+    {
+      c0 = (c0 >> 8) ^ crc32lookup[0][(c0 ^ (unsigned char) s[0][i]) & 0xffU];
+      c1 = (c1 >> 8) ^ crc32lookup[0][(c1 ^ (unsigned char) s[1][i]) & 0xffU];
+      c2 = (c2 >> 8) ^ crc32lookup[0][(c2 ^ (unsigned char) s[2][i]) & 0xffU];
+      c3 = (c3 >> 8) ^ crc32lookup[0][(c3 ^ (unsigned char) s[3][i]) & 0xffU];
+    }
+
+  crc32[0] = ~c0;
+  crc32[1] = ~c1;
+  crc32[2] = ~c2;
+  crc32[3] = ~c3;
+}
+
+
+#endif /* ! COMPUTE_CRC32_H */
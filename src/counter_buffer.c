@@ -0,0 +1,254 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "counter_buffer.h"
+#include "key_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+  Pending counter deltas in an open addressing table with linear
+  probing.  Keys are never removed individually, only the whole
+  buffer is cleared after it is flushed.  Every slot holds its prefix
+  and key in one allocation.
+*/
+
+
+#define INITIAL_SLOTS  64
+
+
+struct counter_buffer_slot
+{
+  key_hash_type hash;
+  char *key;                    /* prefix key, NULL when empty.  */
+  size_t prefix_len;
+  size_t key_len;
+  counter_delta_type delta;
+};
+
+
+struct counter_buffer
+{
+  struct counter_buffer_slot *slots;
+  size_t mask;
+  size_t count;
+};
+
+
+static
+size_t
+find_slot(struct counter_buffer *cb, key_hash_type hash,
+          const char *prefix, size_t prefix_len,
+          const char *key, size_t key_len)
+{
+  size_t i = hash & cb->mask;
+
+  while (cb->slots[i].key)
+    {
+      struct counter_buffer_slot *slot = &cb->slots[i];
+
+      if (slot->hash == hash && slot->prefix_len == prefix_len
+          && slot->key_len == key_len
+          && memcmp(slot->key, prefix, prefix_len) == 0
+          && memcmp(slot->key + prefix_len, key, key_len) == 0)
+        break;
+
+      i = (i + 1) & cb->mask;
+    }
+
+  return i;
+}
+
+
+static
+int
+grow(struct counter_buffer *cb)
+{
+  struct counter_buffer_slot *slots, *old = cb->slots;
+  size_t size = (cb->mask + 1) * 2, i;
+
+  slots = (struct counter_buffer_slot *)
+    calloc(size, sizeof(struct counter_buffer_slot));
+  if (! slots)
+    return -1;
+
+  cb->slots = slots;
+  cb->mask = size - 1;
+
+  for (i = 0; i < size / 2; ++i)
+    {
+      size_t j;
+
+      if (! old[i].key)
+        continue;
+
+      j = old[i].hash & cb->mask;
+      while (slots[j].key)
+        j = (j + 1) & cb->mask;
+
+      slots[j] = old[i];
+    }
+
+  free(old);
+
+  return 0;
+}
+
+
+struct counter_buffer *
+counter_buffer_init()
+{
+  struct counter_buffer *cb;
+
+  cb = (struct counter_buffer *) malloc(sizeof(struct counter_buffer));
+  if (! cb)
+    return NULL;
+
+  cb->slots = (struct counter_buffer_slot *)
+    calloc(INITIAL_SLOTS, sizeof(struct counter_buffer_slot));
+  if (! cb->slots)
+    {
+      free(cb);
+      return NULL;
+    }
+
+  cb->mask = INITIAL_SLOTS - 1;
+  cb->count = 0;
+
+  return cb;
+}
+
+
+void
+counter_buffer_destroy(struct counter_buffer *cb)
+{
+  counter_buffer_clear(cb);
+  free(cb->slots);
+  free(cb);
+}
+
+
+int
+counter_buffer_add(struct counter_buffer *cb,
+                   const char *prefix, size_t prefix_len,
+                   const char *key, size_t key_len, counter_delta_type delta)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  size_t i;
+  char *s;
+
+  if ((cb->count + 1) * 2 > cb->mask + 1 && grow(cb) == -1)
+    return -1;
+
+  i = find_slot(cb, hash, prefix, prefix_len, key, key_len);
+  if (cb->slots[i].key)
+    {
+      cb->slots[i].delta += delta;
+      return 0;
+    }
+
+  s = (char *) malloc(prefix_len + key_len);
+  if (! s)
+    return -1;
+
+  memcpy(s, prefix, prefix_len);
+  memcpy(s + prefix_len, key, key_len);
+
+  cb->slots[i].hash = hash;
+  cb->slots[i].key = s;
+  cb->slots[i].prefix_len = prefix_len;
+  cb->slots[i].key_len = key_len;
+  cb->slots[i].delta = delta;
+  ++cb->count;
+
+  return 0;
+}
+
+
+counter_delta_type
+counter_buffer_take(struct counter_buffer *cb,
+                    const char *prefix, size_t prefix_len,
+                    const char *key, size_t key_len)
+{
+  counter_delta_type delta;
+  size_t i;
+
+  if (cb->count == 0)
+    return 0;
+
+  i = find_slot(cb, key_hash(prefix, prefix_len, key, key_len),
+                prefix, prefix_len, key, key_len);
+  if (! cb->slots[i].key)
+    return 0;
+
+  delta = cb->slots[i].delta;
+  cb->slots[i].delta = 0;
+
+  return delta;
+}
+
+
+size_t
+counter_buffer_count(struct counter_buffer *cb)
+{
+  return cb->count;
+}
+
+
+void
+counter_buffer_each(struct counter_buffer *cb,
+                    counter_buffer_func func, void *arg)
+{
+  size_t i;
+
+  if (cb->count == 0)
+    return;
+
+  for (i = 0; i <= cb->mask; ++i)
+    {
+      struct counter_buffer_slot *slot = &cb->slots[i];
+
+      if (slot->key && slot->delta != 0)
+        func(arg, slot->key, slot->prefix_len,
+             slot->key + slot->prefix_len, slot->key_len, slot->delta);
+    }
+}
+
+
+void
+counter_buffer_clear(struct counter_buffer *cb)
+{
+  size_t i;
+
+  if (cb->count == 0)
+    return;
+
+  for (i = 0; i <= cb->mask; ++i)
+    {
+      free(cb->slots[i].key);
+      cb->slots[i].key = NULL;
+    }
+
+  cb->count = 0;
+}
@@ -0,0 +1,92 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef COUNTER_BUFFER_H
+#define COUNTER_BUFFER_H 1
+
+#include <stddef.h>
+
+
+typedef long long counter_delta_type;
+
+
+struct counter_buffer;
+
+
+extern
+struct counter_buffer *
+counter_buffer_init();
+
+extern
+void
+counter_buffer_destroy(struct counter_buffer *cb);
+
+/*
+  counter_buffer_add() adds delta to the pending sum of the key under
+  the prefix.  The same key under different prefixes has separate
+  sums.  Returns 0 on success, or -1 when there's no memory for a new
+  key.
+*/
+extern
+int
+counter_buffer_add(struct counter_buffer *cb,
+                   const char *prefix, size_t prefix_len,
+                   const char *key, size_t key_len, counter_delta_type delta);
+
+/*
+  counter_buffer_take() returns the pending sum of the key and resets
+  it to zero.
+*/
+extern
+counter_delta_type
+counter_buffer_take(struct counter_buffer *cb,
+                    const char *prefix, size_t prefix_len,
+                    const char *key, size_t key_len);
+
+/*
+  counter_buffer_count() returns the number of keys in the buffer.
+*/
+extern
+size_t
+counter_buffer_count(struct counter_buffer *cb);
+
+typedef void (*counter_buffer_func)(void *arg,
+                                    const char *prefix, size_t prefix_len,
+                                    const char *key, size_t key_len,
+                                    counter_delta_type delta);
+
+/*
+  counter_buffer_each() calls func for every key with non-zero sum.
+  The prefix and the key stay valid until the buffer is cleared.
+*/
+extern
+void
+counter_buffer_each(struct counter_buffer *cb,
+                    counter_buffer_func func, void *arg);
+
+extern
+void
+counter_buffer_clear(struct counter_buffer *cb);
+
+
+#endif /* ! COUNTER_BUFFER_H */
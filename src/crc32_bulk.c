@@ -0,0 +1,205 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "compute_crc32.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_PCLMUL 1
+#include <immintrin.h>
+#endif
+
+
+static inline
+unsigned int
+read32(const unsigned char *p)
+{
+  return (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24));
+}
+
+
+/*
+  Slice-by-8: each table lookup advances the CRC over one of eight
+  bytes independently, so the loads overlap instead of forming one
+  dependency chain per byte.  Works on inverted CRC.
+*/
+static
+unsigned int
+crc32_slice8(unsigned int crc32, const unsigned char *p, size_t len)
+{
+  while (len >= 8)
+    {
+      unsigned int one = read32(p) ^ crc32;
+      unsigned int two = read32(p + 4);
+
+      crc32 = (crc32lookup[7][one & 0xff]
+               ^ crc32lookup[6][(one >> 8) & 0xff]
+               ^ crc32lookup[5][(one >> 16) & 0xff]
+               ^ crc32lookup[4][one >> 24]
+               ^ crc32lookup[3][two & 0xff]
+               ^ crc32lookup[2][(two >> 8) & 0xff]
+               ^ crc32lookup[1][(two >> 16) & 0xff]
+               ^ crc32lookup[0][two >> 24]);
+      p += 8;
+      len -= 8;
+    }
+
+  while (len-- > 0)
+    crc32 = (crc32 >> 8) ^ crc32lookup[0][(crc32 ^ *p++) & 0xff];
+
+  return crc32;
+}
+
+
+#ifdef HAVE_PCLMUL
+
+/*
+  Folding with carry-less multiplication, see "Fast CRC Computation
+  for Generic Polynomials Using PCLMULQDQ Instruction" by Intel.  The
+  constants are for the reflected IEEE polynomial.  Processes len
+  bytes, which should be at least 64 and a multiple of 16, and works
+  on inverted CRC.
+*/
+__attribute__((target("pclmul,sse4.1")))
+static
+unsigned int
+crc32_pclmul(unsigned int crc32, const unsigned char *p, size_t len)
+{
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+  const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128((const __m128i *) p);
+  x2 = _mm_loadu_si128((const __m128i *) (p + 16));
+  x3 = _mm_loadu_si128((const __m128i *) (p + 32));
+  x4 = _mm_loadu_si128((const __m128i *) (p + 48));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc32));
+  p += 64;
+  len -= 64;
+
+  /* Fold four 128-bit lanes in parallel.  */
+  while (len >= 64)
+    {
+      x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                         _mm_loadu_si128((const __m128i *) p));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                         _mm_loadu_si128((const __m128i *) (p + 16)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                         _mm_loadu_si128((const __m128i *) (p + 32)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                         _mm_loadu_si128((const __m128i *) (p + 48)));
+      p += 64;
+      len -= 64;
+    }
+
+  /* Fold the lanes into one, then the remaining 16-byte blocks.  */
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  while (len >= 16)
+    {
+      x2 = _mm_loadu_si128((const __m128i *) p);
+      x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+      p += 16;
+      len -= 16;
+    }
+
+  /* Fold 128 bits to 64.  */
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduction to 32 bits.  */
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return _mm_extract_epi32(x1, 1);
+}
+
+
+static
+int
+have_pclmul(void)
+{
+  /* Races are harmless, every thread computes the same value.  */
+  static int have = -1;
+
+  if (have == -1)
+    {
+      __builtin_cpu_init();
+      have = (__builtin_cpu_supports("pclmul")
+              && __builtin_cpu_supports("sse4.1"));
+    }
+
+  return have;
+}
+
+#endif /* HAVE_PCLMUL */
+
+
+unsigned int
+compute_crc32_bulk(unsigned int crc32, const char *s, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) s;
+
+  crc32 = ~crc32;
+
+#ifdef HAVE_PCLMUL
+  if (len >= 64 && have_pclmul())
+    {
+      size_t fold_len = len & ~(size_t) 15;
+
+      crc32 = crc32_pclmul(crc32, p, fold_len);
+      p += fold_len;
+      len -= fold_len;
+    }
+#endif
+
+  return ~crc32_slice8(crc32, p, len);
+}
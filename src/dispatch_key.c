@@ -23,8 +23,22 @@
 
 #include "dispatch_key.h"
 #include "compute_crc32.h"
+#include "xxhash.h"
+#include "md5.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifndef WIN32
+#define HAVE_DISPATCH_SNAPSHOT 1
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 
 /*
   Note on rounding: C89 (which we are trying to be compatible with)
@@ -36,49 +50,511 @@
 
 #define DISPATCH_MAX_POINT  0xffffffffU
 
+/*
+  The jump table has a slot per (1 << JUMP_MIN_BITS) or more points,
+  but is never larger than (1 << JUMP_MAX_BITS) slots.
+*/
+#define JUMP_MIN_BITS  4
+#define JUMP_MAX_BITS  24
+
+/*
+  Maglev table has at least MAGLEV_MIN_SIZE entries, and at least
+  MAGLEV_SCALE entries per server.  The size is a prime.
+*/
+#define MAGLEV_MIN_SIZE  65537
+#define MAGLEV_SCALE  100
+
+/*
+  MEMCACHED_POINTS_PER_SERVER_KETAMA and MEMCACHED_DEFAULT_PORT of
+  libmemcached.
+*/
+#define MD5_POINTS_PER_SERVER  160
+#define MD5_DEFAULT_PORT  11211
+
+
+/*
+  Keys hashed and resolved together by dispatch_keys().
+*/
+#define DISPATCH_BATCH  16
+
+/*
+  Snapshot files are in the native byte order, so the header size and
+  SNAPSHOT_VERSION also guard against files from another platform or
+  an incompatible build.
+*/
+#define SNAPSHOT_MAGIC  "CMFDISP"
+#define SNAPSHOT_VERSION  1
+
+
+struct dispatch_server
+{
+  unsigned long long hash;
+  unsigned long long digest;    /* Of the address and weight.  */
+  double weight;
+  int index;
+  char *name;                   /* libmemcached host name for MD5 mode.  */
+  size_t name_len;
+};
+
+
+struct snapshot_header
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int header_size;
+  unsigned long long digest;
+  int points;                   /* Also the number of indexes.  */
+  int jump;
+  int jump_shift;
+  int table;
+};
+
 
 struct continuum_point
 {
   unsigned int point;
   int index;
+  int seq;
 };
 
 
+#define dispatch_point(state, i)                                        \
+  (*array_elem((state)->points, unsigned int, (i)))
+
+#define dispatch_index(state, i)                                        \
+  (*array_elem((state)->indexes, int, (i)))
+
+
+/*
+  Return the position of the first point that is not less than point,
+  or the number of points if there's none.
+*/
 static
-struct continuum_point *
-dispatch_find_bucket(struct dispatch_state *state, unsigned int point)
+int
+dispatch_lower_bound(struct dispatch_state *state, unsigned int point)
 {
-  struct continuum_point *beg, *end, *left, *right;
-
-  beg = left = array_beg(state->buckets, struct continuum_point);
-  end = right = array_end(state->buckets, struct continuum_point);
+  int left = 0, right = array_size(state->points);
 
   while (left < right)
     {
-      struct continuum_point *middle = left + (right - left) / 2;
-      if (middle->point < point)
+      int middle = left + (right - left) / 2;
+      if (dispatch_point(state, middle) < point)
+        left = middle + 1;
+      else
+        right = middle;
+    }
+
+  return left;
+}
+
+
+/*
+  Jump table slot s holds the position of the first point with the top
+  bits not less than s, and the last slot holds the number of points.
+  Thus the lookup is a table read followed by a short scan of the
+  points that share the top bits with the key, instead of a binary
+  search with a cache miss on almost every probe.
+*/
+static
+void
+dispatch_build_jump(struct dispatch_state *state)
+{
+  int count = array_size(state->points);
+  int bits = JUMP_MIN_BITS, slots, pos, i;
+
+  while (bits < JUMP_MAX_BITS && (1 << bits) < count)
+    ++bits;
+  slots = 1 << bits;
+
+  array_clear(state->jump);
+  if (array_extend(state->jump, int, slots + 1, ARRAY_EXTEND_EXACT) == -1)
+    return;
+
+  state->jump_shift = 32 - bits;
+  pos = 0;
+  for (i = 0; i < slots; ++i)
+    {
+      unsigned int point = (unsigned int) i << state->jump_shift;
+
+      while (pos < count && dispatch_point(state, pos) < point)
+        ++pos;
+
+      *array_elem(state->jump, int, i) = pos;
+    }
+  *array_elem(state->jump, int, slots) = count;
+  array_append(state->jump, slots + 1);
+
+  state->jump_valid = 1;
+}
+
+
+static
+int
+compare_points(const void *a, const void *b)
+{
+  const struct continuum_point *x = a, *y = b;
+
+  if (x->point != y->point)
+    return (x->point > y->point ? 1 : -1);
+
+  /* Keep the order of addition for equal points.  */
+  return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+
+/*
+  Sort pending points and merge them into the continuum.  The space
+  for them was reserved in dispatch_extend().  Equal points end up in
+  the order of addition, the same as with one by one insertion, so the
+  key distribution doesn't depend on how the ring was built.
+*/
+static
+void
+dispatch_merge(struct dispatch_state *state)
+{
+  struct continuum_point *beg, *p;
+  int i, out;
+
+  if (array_empty(state->pending))
+    return;
+
+  beg = array_beg(state->pending, struct continuum_point);
+  i = 0;
+  for (array_each(state->pending, struct continuum_point, p))
+    p->seq = i++;
+
+  qsort(beg, array_size(state->pending), sizeof(*beg), compare_points);
+
+  /* Merge from the back, pending points go after the old equal ones.  */
+  i = array_size(state->points) - 1;
+  p = array_end(state->pending, struct continuum_point) - 1;
+  out = i + array_size(state->pending);
+  while (p >= beg)
+    {
+      if (i >= 0 && dispatch_point(state, i) > p->point)
         {
-          left = middle + 1;
+          dispatch_point(state, out) = dispatch_point(state, i);
+          dispatch_index(state, out) = dispatch_index(state, i);
+          --i;
         }
-      else if (middle->point > point)
+      else
         {
-          right = middle;
+          dispatch_point(state, out) = p->point;
+          dispatch_index(state, out) = p->index;
+          --p;
         }
-      else
+      --out;
+    }
+
+  array_append(state->points, array_size(state->pending));
+  array_append(state->indexes, array_size(state->pending));
+
+  /* The ring is built all at once, so release the memory.  */
+  array_destroy(&state->pending);
+  array_init(&state->pending);
+
+  state->jump_valid = 0;
+}
+
+
+static
+int
+dispatch_find_bucket(struct dispatch_state *state, unsigned int point)
+{
+  int pos;
+
+  if (state->jump_valid)
+    {
+      int *slot = array_elem(state->jump, int, (point >> state->jump_shift));
+      int end = slot[1];
+
+      pos = slot[0];
+      while (pos < end && dispatch_point(state, pos) < point)
+        ++pos;
+    }
+  else
+    {
+      /* Out of memory for the table, binary search still works.  */
+      pos = dispatch_lower_bound(state, point);
+    }
+
+  /* Wrap around.  */
+  if (pos == array_size(state->points))
+    pos = 0;
+
+  return pos;
+}
+
+
+static inline
+unsigned long long
+mix64(unsigned long long x)
+{
+  /* Finalizer of SplitMix64.  */
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+
+  return x;
+}
+
+
+/*
+  The namespace is hashed as the beginning of the key, so that with
+  any hash function the key maps like the namespace and key joined.
+*/
+static inline
+unsigned long long
+key_xxh64(struct dispatch_state *state, const char *key, size_t key_len)
+{
+  struct xxh64_ctx ctx;
+
+  if (state->prefix_xxh64.total_len == 0)
+    return xxh64(key, key_len, 0);
+
+  ctx = state->prefix_xxh64;
+  xxh64_update(&ctx, key, key_len);
+
+  return xxh64_final(&ctx);
+}
+
+
+static inline
+unsigned long long
+key_hash64(struct dispatch_state *state, const char *key, size_t key_len)
+{
+  if (state->hash_function == DISPATCH_HASH_XXH64)
+    return key_xxh64(state, key, key_len);
+  else
+    return mix64(compute_crc32_add(state->prefix_hash, key, key_len));
+}
+
+
+static inline
+unsigned int
+key_hash32(struct dispatch_state *state, const char *key, size_t key_len)
+{
+  if (state->hash_function == DISPATCH_HASH_XXH64)
+    return key_xxh64(state, key, key_len) >> 32;
+  else
+    return compute_crc32_add(state->prefix_hash, key, key_len);
+}
+
+
+/*
+  Jump consistent hash by John Lamping and Eric Veach,
+  http://arxiv.org/abs/1406.2294.  Returns a bucket in [0, buckets).
+*/
+static inline
+int
+jump_hash(unsigned long long key, int buckets)
+{
+  long long b = -1, j = 0;
+
+  while (j < buckets)
+    {
+      b = j;
+      key = key * 2862933555777941757ULL + 1;
+      j = (b + 1) * ((double) (1LL << 31) / (double) ((key >> 33) + 1));
+    }
+
+  return b;
+}
+
+
+/*
+  Jump hash has no notion of weight, so a server of weight W takes W
+  (rounded, at least one) consecutive buckets.  Buckets are only ever
+  appended, which is what keeps the mapping consistent.
+*/
+static
+int
+jump_build_table(struct dispatch_state *state)
+{
+  struct dispatch_server *s;
+
+  array_clear(state->table);
+  for (array_each(state->servers, struct dispatch_server, s))
+    {
+      int count = s->weight + 0.5, i;
+
+      if (count < 1)
+        count = 1;
+
+      if (array_extend(state->table, int, count, ARRAY_EXTEND_TWICE) == -1)
+        return -1;
+
+      for (i = 0; i < count; ++i)
+        {
+          *array_end(state->table, int) = s->index;
+          array_push(state->table);
+        }
+    }
+
+  return 0;
+}
+
+
+static
+int
+is_prime(int n)
+{
+  int d;
+
+  for (d = 3; d <= n / d; d += 2)
+    {
+      if (n % d == 0)
+        return 0;
+    }
+
+  return (n % 2 != 0);
+}
+
+
+/*
+  Maglev lookup table, see "Maglev: A Fast and Reliable Software
+  Network Load Balancer", section 3.4.  Every server walks its own
+  permutation of the table and claims free entries in turns, a server
+  of weight W getting W / max_weight turns per round.
+*/
+static
+int
+maglev_build_table(struct dispatch_state *state)
+{
+  struct dispatch_server *s;
+  struct maglev_cursor { unsigned int pos, skip; double credit; } *cursors;
+  int size, filled, n = array_size(state->servers), i;
+  double max_weight = 0.0;
+
+  size = n * MAGLEV_SCALE;
+  if (size < MAGLEV_MIN_SIZE)
+    size = MAGLEV_MIN_SIZE;
+  while (! is_prime(size))
+    ++size;
+
+  cursors = malloc(n * sizeof(*cursors));
+  array_clear(state->table);
+  if (! cursors
+      || array_extend(state->table, int, size, ARRAY_EXTEND_EXACT) == -1)
+    {
+      free(cursors);
+      return -1;
+    }
+
+  i = 0;
+  for (array_each(state->servers, struct dispatch_server, s))
+    {
+      cursors[i].pos = (s->hash >> 32) % size;
+      cursors[i].skip = (s->hash & 0xffffffffU) % (size - 1) + 1;
+      cursors[i].credit = 0.0;
+      if (max_weight < s->weight)
+        max_weight = s->weight;
+      ++i;
+    }
+
+  for (i = 0; i < size; ++i)
+    *array_elem(state->table, int, i) = -1;
+
+  filled = 0;
+  while (filled < size)
+    {
+      i = 0;
+      for (array_each(state->servers, struct dispatch_server, s))
         {
-          /* Find the first point for this value.  */
-          while (middle != beg && (middle - 1)->point == point)
-            --middle;
+          struct maglev_cursor *c = &cursors[i++];
 
-          return middle;
+          c->credit += s->weight / max_weight;
+          while (c->credit >= 1.0 && filled < size)
+            {
+              int *entry;
+
+              while (*(entry = array_elem(state->table, int, c->pos)) != -1)
+                c->pos = (c->pos + c->skip) % size;
+
+              *entry = s->index;
+              ++filled;
+              c->credit -= 1.0;
+            }
         }
     }
+  array_append(state->table, size);
 
-  /* Wrap around.  */
-  if (left == end)
-    left = beg;
+  free(cursors);
 
-  return left;
+  return 0;
+}
+
+
+/*
+  Weighted rendezvous hashing: every server scores the key as
+  -weight / ln(u), where u is uniform in (0, 1) and derived from both
+  hashes, and the server with the highest score wins.  This gives each
+  server the share proportional to its weight, and changing one server
+  only moves the keys it wins or loses.
+*/
+static inline
+double
+rendezvous_score(unsigned long long key_hash, struct dispatch_server *s)
+{
+  unsigned long long h = mix64(key_hash ^ s->hash);
+  double u = ((h >> 11) + 0.5) / 9007199254740992.0;  /* 2^53 */
+
+  return -s->weight / log(u);
+}
+
+
+static
+int
+rendezvous_top(struct dispatch_state *state, unsigned long long key_hash,
+               int *servers, int count)
+{
+  double scores[DISPATCH_MAX_REPLICAS];
+  struct dispatch_server *s;
+  int found = 0;
+
+  if (count > DISPATCH_MAX_REPLICAS)
+    count = DISPATCH_MAX_REPLICAS;
+
+  /* Insertion into the short sorted list of the best scores.  */
+  for (array_each(state->servers, struct dispatch_server, s))
+    {
+      double score = rendezvous_score(key_hash, s);
+      int i;
+
+      if (found == count && score <= scores[found - 1])
+        continue;
+
+      if (found < count)
+        ++found;
+      for (i = found - 1; i > 0 && scores[i - 1] < score; --i)
+        {
+          scores[i] = scores[i - 1];
+          servers[i] = servers[i - 1];
+        }
+      scores[i] = score;
+      servers[i] = s->index;
+    }
+
+  return found;
+}
+
+
+static
+int
+dispatch_extend(struct dispatch_state *state, int count)
+{
+  count += array_size(state->pending);
+
+  if (array_extend(state->points, unsigned int,
+                   count, ARRAY_EXTEND_TWICE) == -1
+      || array_extend(state->indexes, int, count, ARRAY_EXTEND_TWICE) == -1)
+    return -1;
+
+  state->jump_valid = 0;
+
+  return 0;
 }
 
 
@@ -92,10 +568,9 @@ compatible_add_server(struct dispatch_state *state, double weight, int index)
     weight.  See the comment in compatible_get_server().
   */
   double scale;
-  struct continuum_point *p;
+  unsigned int *p;
 
-  if (array_extend(state->buckets, struct continuum_point,
-                   1, ARRAY_EXTEND_EXACT) == -1)
+  if (dispatch_extend(state, 1) == -1)
     return -1;
 
   state->total_weight += weight;
@@ -107,13 +582,14 @@ compatible_add_server(struct dispatch_state *state, double weight, int index)
     enough for sane number of servers (thousands) and relative weight
     ratios.
   */
-  for (array_each(state->buckets, struct continuum_point, p))
-    p->point -= (double) p->point * scale;
+  for (array_each(state->points, unsigned int, p))
+    *p -= (double) *p * scale;
 
   /* Here p points to array_end().  */
-  p->point = DISPATCH_MAX_POINT;
-  p->index = index;
-  array_push(state->buckets);
+  *p = DISPATCH_MAX_POINT;
+  *array_end(state->indexes, int) = index;
+  array_push(state->points);
+  array_push(state->indexes);
 
   ++state->server_count;
 
@@ -122,9 +598,8 @@ compatible_add_server(struct dispatch_state *state, double weight, int index)
 
 
 static inline
-int
-compatible_get_server(struct dispatch_state *state,
-                      const char *key, size_t key_len)
+unsigned int
+compatible_point(struct dispatch_state *state, unsigned int crc32)
 {
   /*
     For compatibility with Cache::Memcached we do the following: first
@@ -136,8 +611,6 @@ compatible_get_server(struct dispatch_state *state,
     occupies the space proportional to its weight, we get the same
     server index.
   */
-  struct continuum_point *p;
-  unsigned int crc32 = compute_crc32_add(state->prefix_hash, key, key_len);
   unsigned int hash = (crc32 >> 16) & 0x00007fffU;
   unsigned int point = hash % (unsigned int) (state->total_weight + 0.5);
 
@@ -148,8 +621,7 @@ compatible_get_server(struct dispatch_state *state,
   */
   point += 1;
 
-  p = dispatch_find_bucket(state, point);
-  return p->index;
+  return point;
 }
 
 
@@ -166,8 +638,9 @@ ketama_crc32_add_server(struct dispatch_state *state,
 
   count = state->ketama_points * weight + 0.5;
 
-  if (array_extend(state->buckets, struct continuum_point,
-                   count, ARRAY_EXTEND_EXACT) == -1)
+  if (dispatch_extend(state, count) == -1
+      || array_extend(state->pending, struct continuum_point,
+                      count, ARRAY_EXTEND_TWICE) == -1)
     return -1;
 
   crc32 = compute_crc32(host, host_len);
@@ -191,43 +664,16 @@ ketama_crc32_add_server(struct dispatch_state *state,
 
       point = compute_crc32_add(crc32, buf, 4);
 
-      if (! array_empty(state->buckets))
-        {
-          struct continuum_point *end =
-            array_end(state->buckets, struct continuum_point);
-
-          p = dispatch_find_bucket(state, point);
-
-          /* Check if we wrapped around but actually have new max point.  */
-          if (p == array_beg(state->buckets, struct continuum_point)
-              && point > p->point)
-            {
-              p = end;
-            }
-          else
-            {
-              /*
-                Even if there's a server for the same point already,
-                we have to add ours, because the first one may be
-                removed later.  But we add ours after the old servers
-                for not to change key distribution.
-              */
-              while (p != end && p->point == point)
-                ++p;
-
-              /* Move the tail one position forward.  */
-              if (p != end)
-                memmove(p + 1, p, (end - p) * sizeof(*p));
-            }
-        }
-      else
-        {
-          p = array_beg(state->buckets, struct continuum_point);
-        }
-
+      /*
+        Even if there's a server for the same point already, we have
+        to add ours, because the first one may be removed later.  But
+        we add ours after the old servers for not to change key
+        distribution.  dispatch_merge() takes care of that.
+      */
+      p = array_end(state->pending, struct continuum_point);
       p->point = point;
       p->index = index;
-      array_push(state->buckets);
+      array_push(state->pending);
     }
 
   ++state->server_count;
@@ -236,32 +682,390 @@ ketama_crc32_add_server(struct dispatch_state *state,
 }
 
 
-static inline
+/*
+  libmemcached compatible continuum (MEMCACHED_BEHAVIOR_KETAMA_WEIGHTED,
+  see update_continuum() in libmemcached/hosts.cc).  The number of
+  points of every server depends on the total weight, so the whole
+  continuum is rebuilt when a server is added.  Each MD5 digest of
+  "host[:port]-N" gives four points.  The float arithmetic is
+  reproduced as is, because it affects point counts.
+*/
+static
 int
-ketama_crc32_get_server(struct dispatch_state *state,
-                        const char *key, size_t key_len)
+ketama_md5_build(struct dispatch_state *state)
 {
-  unsigned int point = compute_crc32_add(state->prefix_hash, key, key_len);
-  struct continuum_point *p = dispatch_find_bucket(state, point);
-  return p->index;
-}
+  struct dispatch_server *s;
+  double total_weight = 0.0;
+  float live_servers = array_size(state->servers);
+  int total = 0;
 
+  for (array_each(state->servers, struct dispatch_server, s))
+    total_weight += s->weight;
 
-void
-dispatch_init(struct dispatch_state *state)
-{
-  array_init(&state->buckets);
-  state->total_weight = 0.0;
-  state->ketama_points = 0;
-  state->prefix_hash = 0x0U;
-  state->server_count = 0;
-}
+  for (array_each(state->servers, struct dispatch_server, s))
+    {
+      float pct = (float) s->weight / (float) total_weight;
+      total += (int) floor((float) (pct * MD5_POINTS_PER_SERVER / 4
+                                    * live_servers)
+                           + 0.0000000001) * 4;
+    }
+
+  array_clear(state->points);
+  array_clear(state->indexes);
+  array_clear(state->pending);
+  if (dispatch_extend(state, total) == -1
+      || array_extend(state->pending, struct continuum_point,
+                      total, ARRAY_EXTEND_EXACT) == -1)
+    return -1;
+
+  for (array_each(state->servers, struct dispatch_server, s))
+    {
+      float pct = (float) s->weight / (float) total_weight;
+      int count = (int) floor((float) (pct * MD5_POINTS_PER_SERVER / 4
+                                       * live_servers)
+                              + 0.0000000001);
+      int i;
+
+      for (i = 0; i < count; ++i)
+        {
+          char buf[32];
+          unsigned char digest[16];
+          struct md5_ctx ctx;
+          int x;
+
+          md5_init(&ctx);
+          md5_update(&ctx, s->name, s->name_len);
+          md5_update(&ctx, buf, sprintf(buf, "-%d", i));
+          md5_final(&ctx, digest);
+
+          for (x = 0; x < 4; ++x)
+            {
+              struct continuum_point *p =
+                array_end(state->pending, struct continuum_point);
+
+              p->point = ((unsigned int) digest[3 + x * 4] << 24
+                          | (unsigned int) digest[2 + x * 4] << 16
+                          | (unsigned int) digest[1 + x * 4] << 8
+                          | (unsigned int) digest[x * 4]);
+              p->index = s->index;
+              array_push(state->pending);
+            }
+        }
+    }
+
+  dispatch_merge(state);
+  dispatch_build_jump(state);
+
+  return 0;
+}
+
+
+static inline
+unsigned int
+key_hash_md5(struct dispatch_state *state, const char *key, size_t key_len)
+{
+  struct md5_ctx ctx = state->prefix_md5;
+  unsigned char digest[16];
+  unsigned int point;
+
+  md5_update(&ctx, key, key_len);
+  md5_final(&ctx, digest);
+
+  point = ((unsigned int) digest[3] << 24 | (unsigned int) digest[2] << 16
+           | (unsigned int) digest[1] << 8 | (unsigned int) digest[0]);
+
+  return point;
+}
+
+
+/*
+  Make the continuum ready for lookups after servers were added.
+*/
+static inline
+void
+dispatch_update(struct dispatch_state *state)
+{
+  switch (state->mode)
+    {
+    case DISPATCH_KETAMA:
+      dispatch_merge(state);
+      if (! state->jump_valid)
+        dispatch_build_jump(state);
+      break;
+
+    case DISPATCH_JUMP:
+      if (! state->table_valid)
+        state->table_valid = (jump_build_table(state) == 0);
+      break;
+
+    case DISPATCH_MAGLEV:
+      if (! state->table_valid)
+        state->table_valid = (maglev_build_table(state) == 0);
+      break;
+
+    case DISPATCH_KETAMA_MD5:
+      if (! state->table_valid)
+        state->table_valid = (ketama_md5_build(state) == 0);
+      break;
+
+    case DISPATCH_RENDEZVOUS:
+      break;
+    }
+}
+
+
+/*
+  Narrow the key to its hash tag, the same as Redis Cluster does.
+*/
+static inline
+void
+hash_tag(const char **key, size_t *key_len)
+{
+  const char *beg, *end;
+
+  beg = memchr(*key, '{', *key_len);
+  if (! beg)
+    return;
+
+  ++beg;
+  end = memchr(beg, '}', *key + *key_len - beg);
+  if (! end || end == beg)
+    return;
+
+  *key = beg;
+  *key_len = end - beg;
+}
+
+
+/*
+  Hash of the key as the mode uses it: the continuum point for Ketama
+  (before the compatible mode transform), the MD5 point for the
+  libmemcached continuum, and the 64-bit hash otherwise.
+*/
+static inline
+unsigned long long
+dispatch_key_hash(struct dispatch_state *state,
+                  const char *key, size_t key_len)
+{
+  switch (state->mode)
+    {
+    case DISPATCH_KETAMA:
+      return key_hash32(state, key, key_len);
+
+    case DISPATCH_KETAMA_MD5:
+      return key_hash_md5(state, key, key_len);
+
+    default:
+      return key_hash64(state, key, key_len);
+    }
+}
+
+
+/*
+  Return the position in ring of the size entries where the key with
+  the hash from dispatch_key_hash() starts, or -1 if the mode has no
+  ring or it couldn't be built.
+*/
+static
+int
+dispatch_ring(struct dispatch_state *state, unsigned long long hash,
+              const int **ring, int *size)
+{
+  switch (state->mode)
+    {
+    case DISPATCH_KETAMA:
+      *ring = array_beg(state->indexes, int);
+      *size = array_size(state->indexes);
+      if (state->ketama_points > 0)
+        return dispatch_find_bucket(state, hash);
+      else
+        return dispatch_find_bucket(state, compatible_point(state, hash));
+
+    case DISPATCH_KETAMA_MD5:
+      if (! state->table_valid)
+        break;
+
+      *ring = array_beg(state->indexes, int);
+      *size = array_size(state->indexes);
+      return dispatch_find_bucket(state, hash);
+
+    case DISPATCH_JUMP:
+    case DISPATCH_MAGLEV:
+      if (! state->table_valid)
+        break;
+
+      *ring = array_beg(state->table, int);
+      *size = array_size(state->table);
+      if (state->mode == DISPATCH_JUMP)
+        return jump_hash(hash, *size);
+      else
+        return hash % *size;
+
+    case DISPATCH_RENDEZVOUS:
+      break;
+    }
+
+  return -1;
+}
+
+
+/*
+  Return the server for the key with the hash from
+  dispatch_key_hash().  There should be more than one server.
+*/
+static inline
+int
+dispatch_hash_server(struct dispatch_state *state, unsigned long long hash,
+                     const char *key, size_t key_len)
+{
+  const int *ring;
+  int size, pos, index;
+
+  pos = dispatch_ring(state, hash, &ring, &size);
+  if (pos != -1)
+    return ring[pos];
+
+  /* Rendezvous, or out of memory for the table.  */
+  if (state->mode != DISPATCH_RENDEZVOUS)
+    hash = key_hash64(state, key, key_len);
+  rendezvous_top(state, hash, &index, 1);
+
+  return index;
+}
+
+
+/*
+  Tables of a snapshot point into the mapping, the rest of the arrays
+  are allocated as usual.
+*/
+static inline
+int
+snapshot_owns(struct dispatch_state *state, const struct array *a)
+{
+  return ((char *) a->buf >= state->snapshot
+          && (char *) a->buf < state->snapshot + state->snapshot_size);
+}
+
+
+static
+void
+snapshot_unmap(struct dispatch_state *state)
+{
+  struct array *arrays[4];
+  int i;
+
+  arrays[0] = &state->points;
+  arrays[1] = &state->indexes;
+  arrays[2] = &state->jump;
+  arrays[3] = &state->table;
+  for (i = 0; i < 4; ++i)
+    {
+      if (snapshot_owns(state, arrays[i]))
+        array_init(arrays[i]);
+    }
+
+#ifdef HAVE_DISPATCH_SNAPSHOT
+  munmap(state->snapshot, state->snapshot_size);
+#endif
+  state->snapshot = NULL;
+  state->snapshot_size = 0;
+}
+
+
+/*
+  Copy the tables out of the snapshot before they are modified.  All
+  of them are arrays of ints.
+*/
+static
+int
+snapshot_detach(struct dispatch_state *state)
+{
+  struct array *arrays[4], copies[4];
+  int i;
+
+  arrays[0] = &state->points;
+  arrays[1] = &state->indexes;
+  arrays[2] = &state->jump;
+  arrays[3] = &state->table;
+  for (i = 0; i < 4; ++i)
+    {
+      int elems = array_size(*arrays[i]);
+
+      array_init(&copies[i]);
+      if (! snapshot_owns(state, arrays[i]) || elems == 0)
+        continue;
+
+      if (array_extend(copies[i], int, elems, ARRAY_EXTEND_EXACT) == -1)
+        {
+          while (i >= 0)
+            array_destroy(&copies[i--]);
+          return -1;
+        }
+
+      memcpy(array_beg(copies[i], int), arrays[i]->buf, elems * sizeof(int));
+      array_append(copies[i], elems);
+    }
+
+  for (i = 0; i < 4; ++i)
+    {
+      if (snapshot_owns(state, arrays[i]))
+        *arrays[i] = copies[i];
+    }
+  snapshot_unmap(state);
+
+  return 0;
+}
+
+
+void
+dispatch_init(struct dispatch_state *state)
+{
+  state->mode = DISPATCH_KETAMA;
+  array_init(&state->servers);
+  array_init(&state->table);
+  state->table_valid = 0;
+  array_init(&state->points);
+  array_init(&state->indexes);
+  array_init(&state->pending);
+  array_init(&state->jump);
+  state->jump_shift = 0;
+  state->jump_valid = 0;
+  state->total_weight = 0.0;
+  state->ketama_points = 0;
+  state->prefix_hash = 0x0U;
+  xxh64_init(&state->prefix_xxh64, 0);
+  md5_init(&state->prefix_md5);
+  state->hash_function = DISPATCH_HASH_CRC32;
+  state->hash_tags = 0;
+  state->server_count = 0;
+  state->snapshot = NULL;
+  state->snapshot_size = 0;
+}
 
 
 void
 dispatch_destroy(struct dispatch_state *state)
 {
-  array_destroy(&state->buckets);
+  struct dispatch_server *s;
+
+  for (array_each(state->servers, struct dispatch_server, s))
+    free(s->name);
+
+  array_destroy(&state->servers);
+  array_destroy(&state->pending);
+  if (state->snapshot)
+    snapshot_unmap(state);
+  array_destroy(&state->table);
+  array_destroy(&state->points);
+  array_destroy(&state->indexes);
+  array_destroy(&state->jump);
+}
+
+
+void
+dispatch_set_mode(struct dispatch_state *state, enum dispatch_mode_e mode)
+{
+  state->mode = mode;
 }
 
 
@@ -277,6 +1081,25 @@ dispatch_set_prefix(struct dispatch_state *state,
                     const char *prefix, size_t prefix_len)
 {
   state->prefix_hash = compute_crc32(prefix, prefix_len);
+  xxh64_init(&state->prefix_xxh64, 0);
+  xxh64_update(&state->prefix_xxh64, prefix, prefix_len);
+  md5_init(&state->prefix_md5);
+  md5_update(&state->prefix_md5, prefix, prefix_len);
+}
+
+
+void
+dispatch_set_hash_function(struct dispatch_state *state,
+                           enum dispatch_hash_e hash_function)
+{
+  state->hash_function = hash_function;
+}
+
+
+void
+dispatch_set_hash_tags(struct dispatch_state *state, int enable)
+{
+  state->hash_tags = enable;
 }
 
 
@@ -286,11 +1109,251 @@ dispatch_add_server(struct dispatch_state *state,
                     const char *port, size_t port_len,
                     double weight, int index)
 {
-  if (state->ketama_points > 0)
-    return ketama_crc32_add_server(state, host, host_len, port, port_len,
-                                   weight, index);
+  static const char delim = '\0';
+  struct dispatch_server *s;
+  unsigned int crc32;
+  char *name = NULL;
+  size_t name_len = 0;
+
+  if (state->snapshot && snapshot_detach(state) == -1)
+    return -1;
+
+  if (array_extend(state->servers, struct dispatch_server,
+                   1, ARRAY_EXTEND_TWICE) == -1)
+    return -1;
+
+  if (state->mode == DISPATCH_KETAMA_MD5)
+    {
+      char buf[16];
+      unsigned long port_num = 0;
+      size_t i;
+
+      /* Same as "%s:%u" or "%s" for the default port in libmemcached.  */
+      for (i = 0; i < port_len && port[i] >= '0' && port[i] <= '9'; ++i)
+        port_num = port_num * 10 + (port[i] - '0');
+
+      name = malloc(host_len + sizeof(buf));
+      if (! name)
+        return -1;
+
+      memcpy(name, host, host_len);
+      name_len = host_len;
+      if (port_num != MD5_DEFAULT_PORT)
+        {
+          sprintf(buf, ":%lu", port_num & 0xffffffffUL);
+          strcpy(name + name_len, buf);
+          name_len += strlen(buf);
+        }
+    }
+
+  if (state->mode == DISPATCH_KETAMA)
+    {
+      int res;
+
+      if (state->ketama_points > 0)
+        res = ketama_crc32_add_server(state, host, host_len, port, port_len,
+                                      weight, index);
+      else
+        res = compatible_add_server(state, weight, index);
+
+      if (res == -1)
+        return -1;
+    }
   else
-    return compatible_add_server(state, weight, index);
+    {
+      ++state->server_count;
+      state->table_valid = 0;
+    }
+
+  crc32 = compute_crc32(host, host_len);
+  crc32 = compute_crc32_add(crc32, &delim, 1);
+  crc32 = compute_crc32_add(crc32, port, port_len);
+
+  s = array_end(state->servers, struct dispatch_server);
+  s->hash = mix64(crc32);
+  s->digest = xxh64(host, host_len, 0);
+  s->digest = xxh64(port, port_len, s->digest);
+  s->digest = xxh64((const char *) &weight, sizeof(weight), s->digest);
+  s->weight = weight;
+  s->index = index;
+  s->name = name;
+  s->name_len = name_len;
+  array_push(state->servers);
+
+  return 0;
+}
+
+
+static
+int
+compare_servers(const void *a, const void *b)
+{
+  const struct dispatch_server *x = a, *y = b;
+
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+
+/*
+  Drop the points of removed servers and renumber the rest.  Equal
+  points are put in the order of the new indexes, which is the order
+  they would be added in.
+*/
+static
+void
+ketama_renumber(struct dispatch_state *state, const int *new_index)
+{
+  int count, out, i;
+
+  dispatch_merge(state);
+
+  count = array_size(state->points);
+  out = 0;
+  for (i = 0; i < count; ++i)
+    {
+      int index = new_index[dispatch_index(state, i)], pos;
+      unsigned int point = dispatch_point(state, i);
+
+      if (index == -1)
+        continue;
+
+      for (pos = out;
+           pos > 0 && dispatch_point(state, pos - 1) == point
+             && dispatch_index(state, pos - 1) > index;
+           --pos)
+        dispatch_index(state, pos) = dispatch_index(state, pos - 1);
+
+      dispatch_point(state, out) = point;
+      dispatch_index(state, pos) = index;
+      ++out;
+    }
+
+  array_clear(state->points);
+  array_append(state->points, out);
+  array_clear(state->indexes);
+  array_append(state->indexes, out);
+
+  state->jump_valid = 0;
+}
+
+
+/*
+  The compatible continuum depends on the order of servers, so it is
+  built again.  It only gets smaller, so no memory is allocated.
+*/
+static
+int
+compatible_rebuild(struct dispatch_state *state)
+{
+  struct dispatch_server *s;
+
+  array_clear(state->points);
+  array_clear(state->indexes);
+  state->total_weight = 0.0;
+  state->server_count = 0;
+
+  for (array_each(state->servers, struct dispatch_server, s))
+    {
+      if (compatible_add_server(state, s->weight, s->index) == -1)
+        return -1;
+    }
+
+  return 0;
+}
+
+
+/*
+  new_index[i] is the new index of the server with index i, or -1 if
+  the server is removed.  Keys are dispatched the same as if the
+  servers were added in the new order, so clients that arrive at the
+  same list in different ways agree.
+*/
+static
+int
+dispatch_renumber(struct dispatch_state *state, const int *new_index)
+{
+  struct dispatch_server *s, *out;
+
+  if (state->snapshot && snapshot_detach(state) == -1)
+    return -1;
+
+  out = array_beg(state->servers, struct dispatch_server);
+  for (array_each(state->servers, struct dispatch_server, s))
+    {
+      if (new_index[s->index] == -1)
+        {
+          free(s->name);
+          continue;
+        }
+
+      *out = *s;
+      out->index = new_index[s->index];
+      ++out;
+    }
+  array_clear(state->servers);
+  array_append(state->servers,
+               out - array_beg(state->servers, struct dispatch_server));
+  qsort(array_beg(state->servers, struct dispatch_server),
+        array_size(state->servers), sizeof(struct dispatch_server),
+        compare_servers);
+
+  state->server_count = array_size(state->servers);
+  state->table_valid = 0;
+
+  if (state->mode == DISPATCH_KETAMA)
+    {
+      if (state->ketama_points > 0)
+        ketama_renumber(state, new_index);
+      else
+        return compatible_rebuild(state);
+    }
+
+  return 0;
+}
+
+
+int
+dispatch_remove_server(struct dispatch_state *state, int index)
+{
+  int *new_index, count = array_size(state->servers), res, i;
+
+  if (index < 0 || index >= count)
+    return -1;
+
+  new_index = malloc(count * sizeof(*new_index));
+  if (! new_index)
+    return -1;
+
+  for (i = 0; i < count; ++i)
+    new_index[i] = (i < index ? i : i - 1);
+  new_index[index] = -1;
+
+  res = dispatch_renumber(state, new_index);
+  free(new_index);
+
+  return res;
+}
+
+
+int
+dispatch_reorder_servers(struct dispatch_state *state, const int *order)
+{
+  int *new_index, count = array_size(state->servers), res, i;
+
+  if (count == 0)
+    return 0;
+
+  new_index = malloc(count * sizeof(*new_index));
+  if (! new_index)
+    return -1;
+
+  for (i = 0; i < count; ++i)
+    new_index[order[i]] = i;
+
+  res = dispatch_renumber(state, new_index);
+  free(new_index);
+
+  return res;
 }
 
 
@@ -301,16 +1364,479 @@ dispatch_key(struct dispatch_state *state, const char *key, size_t key_len)
     return -1;
 
   if (state->server_count == 1)
+    return array_beg(state->servers, struct dispatch_server)->index;
+
+  if (state->hash_tags)
+    hash_tag(&key, &key_len);
+
+  dispatch_update(state);
+
+  return dispatch_hash_server(state, dispatch_key_hash(state, key, key_len),
+                              key, key_len);
+}
+
+
+#if defined(__GNUC__)
+#define dispatch_prefetch(addr)  __builtin_prefetch(addr)
+#else
+#define dispatch_prefetch(addr)  ((void) 0)
+#endif
+
+
+/*
+  Hash count keys, at most DISPATCH_BATCH.  CRC32 of short keys is
+  computed four keys at a time over their common length.  Long keys
+  are better served by compute_crc32_bulk(), and XXH64 and MD5 are
+  computed one key at a time.
+*/
+static
+void
+dispatch_hash_batch(struct dispatch_state *state,
+                    const char *const *keys, const size_t *key_lens,
+                    int count, unsigned long long *hashes)
+{
+  int i = 0;
+
+  if (state->hash_function == DISPATCH_HASH_CRC32
+      && state->mode != DISPATCH_KETAMA_MD5)
     {
-      struct continuum_point *p =
-        array_beg(state->buckets, struct continuum_point);
-      return p->index;
+      for (; i + 4 <= count; i += 4)
+        {
+          unsigned int crc32[4];
+          size_t common = key_lens[i];
+          int j;
+
+          for (j = 1; j < 4; ++j)
+            {
+              if (key_lens[i + j] < common)
+                common = key_lens[i + j];
+            }
+          if (common >= COMPUTE_CRC32_BULK_MIN)
+            common = 0;
+
+          for (j = 0; j < 4; ++j)
+            crc32[j] = state->prefix_hash;
+          compute_crc32_add4(crc32, keys + i, common);
+
+          for (j = 0; j < 4; ++j)
+            {
+              unsigned int crc = compute_crc32_add(crc32[j],
+                                                   keys[i + j] + common,
+                                                   key_lens[i + j] - common);
+              if (state->mode == DISPATCH_KETAMA)
+                hashes[i + j] = crc;
+              else
+                hashes[i + j] = mix64(crc);
+            }
+        }
+    }
+
+  for (; i < count; ++i)
+    hashes[i] = dispatch_key_hash(state, keys[i], key_lens[i]);
+}
+
+
+/*
+  Resolve count hashes, at most DISPATCH_BATCH, to servers.  The
+  continuum lookups are done in passes so that the memory of every
+  pass is prefetched for all keys before it is read.
+*/
+static
+void
+dispatch_resolve_batch(struct dispatch_state *state,
+                       const char *const *keys, const size_t *key_lens,
+                       int count, unsigned long long *hashes, int *servers)
+{
+  int i;
+
+  if ((state->mode == DISPATCH_KETAMA
+       || (state->mode == DISPATCH_KETAMA_MD5 && state->table_valid))
+      && state->jump_valid)
+    {
+      const int *ring = array_beg(state->indexes, int);
+      const int *jump = array_beg(state->jump, int);
+      unsigned int points[DISPATCH_BATCH];
+
+      for (i = 0; i < count; ++i)
+        {
+          if (state->mode == DISPATCH_KETAMA && state->ketama_points == 0)
+            points[i] = compatible_point(state, hashes[i]);
+          else
+            points[i] = hashes[i];
+          dispatch_prefetch(&jump[points[i] >> state->jump_shift]);
+        }
+
+      for (i = 0; i < count; ++i)
+        {
+          int pos = jump[points[i] >> state->jump_shift];
+          dispatch_prefetch(&dispatch_point(state, pos));
+        }
+
+      for (i = 0; i < count; ++i)
+        servers[i] = ring[dispatch_find_bucket(state, points[i])];
+    }
+  else if (state->mode == DISPATCH_MAGLEV && state->table_valid)
+    {
+      const int *table = array_beg(state->table, int);
+      int size = array_size(state->table);
+
+      for (i = 0; i < count; ++i)
+        dispatch_prefetch(&table[hashes[i] % size]);
+
+      for (i = 0; i < count; ++i)
+        servers[i] = table[hashes[i] % size];
     }
   else
     {
-      if (state->ketama_points > 0)
-        return ketama_crc32_get_server(state, key, key_len);
-      else
-        return compatible_get_server(state, key, key_len);
+      for (i = 0; i < count; ++i)
+        servers[i] = dispatch_hash_server(state, hashes[i],
+                                          keys[i], key_lens[i]);
+    }
+}
+
+
+void
+dispatch_keys(struct dispatch_state *state,
+              const char *const *keys, const size_t *key_lens,
+              int count, int *servers)
+{
+  unsigned long long hashes[DISPATCH_BATCH];
+  const char *tagged_keys[DISPATCH_BATCH];
+  size_t tagged_lens[DISPATCH_BATCH];
+  int i;
+
+  if (state->server_count <= 1)
+    {
+      int index = dispatch_key(state, NULL, 0);
+
+      for (i = 0; i < count; ++i)
+        servers[i] = index;
+
+      return;
+    }
+
+  dispatch_update(state);
+
+  for (i = 0; i < count; i += DISPATCH_BATCH)
+    {
+      int n = (count - i < DISPATCH_BATCH ? count - i : DISPATCH_BATCH);
+      const char *const *k = keys + i;
+      const size_t *l = key_lens + i;
+
+      if (state->hash_tags)
+        {
+          int j;
+
+          for (j = 0; j < n; ++j)
+            {
+              tagged_keys[j] = k[j];
+              tagged_lens[j] = l[j];
+              hash_tag(&tagged_keys[j], &tagged_lens[j]);
+            }
+          k = tagged_keys;
+          l = tagged_lens;
+        }
+
+      dispatch_hash_batch(state, k, l, n, hashes);
+      dispatch_resolve_batch(state, k, l, n, hashes, servers + i);
+    }
+}
+
+
+int
+dispatch_key_replicas(struct dispatch_state *state,
+                      const char *key, size_t key_len,
+                      int *servers, int count)
+{
+  const int *ring;
+  int found = 0, steps, pos, size;
+
+  if (state->server_count == 0 || count <= 0)
+    return 0;
+
+  if (state->hash_tags)
+    hash_tag(&key, &key_len);
+
+  dispatch_update(state);
+
+  pos = dispatch_ring(state, dispatch_key_hash(state, key, key_len),
+                      &ring, &size);
+  if (pos == -1)
+    return rendezvous_top(state, key_hash64(state, key, key_len),
+                          servers, count);
+
+  /*
+    Walk the ring clockwise collecting distinct servers.  The first
+    one is what dispatch_key() returns.
+  */
+  for (steps = size; steps > 0 && found < count; --steps)
+    {
+      int index = ring[pos], i;
+
+      for (i = 0; i < found; ++i)
+        {
+          if (servers[i] == index)
+            break;
+        }
+      if (i == found)
+        servers[found++] = index;
+
+      if (++pos == size)
+        pos = 0;
     }
+
+  return found;
+}
+
+
+static
+unsigned long long
+snapshot_digest(struct dispatch_state *state)
+{
+  struct dispatch_server *s;
+  unsigned long long digest;
+  int params[4];
+
+  params[0] = SNAPSHOT_VERSION;
+  params[1] = state->mode;
+  params[2] = state->ketama_points;
+  params[3] = state->server_count;
+
+  digest = xxh64((const char *) params, sizeof(params), 0);
+  for (array_each(state->servers, struct dispatch_server, s))
+    digest = xxh64((const char *) &s->digest, sizeof(s->digest), digest);
+
+  return digest;
 }
+
+
+#ifdef HAVE_DISPATCH_SNAPSHOT
+
+static
+int
+write_all(int fd, const void *buf, size_t size)
+{
+  const char *p = buf;
+
+  while (size > 0)
+    {
+      ssize_t res = write(fd, p, size);
+      if (res <= 0)
+        return -1;
+
+      p += res;
+      size -= res;
+    }
+
+  return 0;
+}
+
+
+int
+dispatch_save_snapshot(struct dispatch_state *state, const char *path)
+{
+  struct snapshot_header h;
+  char *tmp;
+  int fd, res;
+
+  if (state->server_count == 0)
+    return -1;
+
+  dispatch_update(state);
+  if ((state->mode == DISPATCH_JUMP || state->mode == DISPATCH_MAGLEV
+       || state->mode == DISPATCH_KETAMA_MD5) && ! state->table_valid)
+    return -1;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+  h.version = SNAPSHOT_VERSION;
+  h.header_size = sizeof(h);
+  h.digest = snapshot_digest(state);
+  h.points = array_size(state->points);
+  h.jump = (state->jump_valid ? array_size(state->jump) : 0);
+  h.jump_shift = state->jump_shift;
+  h.table = array_size(state->table);
+
+  /*
+    Write a temporary file next to the snapshot and rename it, so
+    readers never see a part.  mkstemp() creates the file exclusively,
+    so a planted file or symlink is never written through.
+  */
+  tmp = malloc(strlen(path) + sizeof(".XXXXXX"));
+  if (! tmp)
+    return -1;
+  sprintf(tmp, "%s.XXXXXX", path);
+
+  fd = mkstemp(tmp);
+  if (fd == -1)
+    {
+      free(tmp);
+      return -1;
+    }
+
+  res = fchmod(fd, 0644);
+  if (res == 0)
+    res = write_all(fd, &h, sizeof(h));
+  if (res == 0)
+    res = write_all(fd, state->points.buf, h.points * sizeof(int));
+  if (res == 0)
+    res = write_all(fd, state->indexes.buf, h.points * sizeof(int));
+  if (res == 0)
+    res = write_all(fd, state->jump.buf, h.jump * sizeof(int));
+  if (res == 0)
+    res = write_all(fd, state->table.buf, h.table * sizeof(int));
+  if (close(fd) == -1)
+    res = -1;
+  if (res == 0)
+    res = rename(tmp, path);
+  if (res == -1)
+    unlink(tmp);
+
+  free(tmp);
+
+  return res;
+}
+
+
+/*
+  The body comes from a file other processes may write, so check that
+  it is a mapping lookups may follow: every ring and table entry names
+  one of the servers, the points are sorted, and the jump table has the
+  size its shift implies and positions within the ring.
+*/
+static
+int
+snapshot_body_valid(const struct snapshot_header *h, int server_count)
+{
+  const int *points = (const int *) (h + 1);
+  const int *indexes = points + h->points;
+  const int *jump = indexes + h->points;
+  const int *table = jump + h->jump;
+  int i;
+
+  for (i = 0; i < h->points; ++i)
+    {
+      if (indexes[i] < 0 || indexes[i] >= server_count)
+        return 0;
+      if (i > 0 && (unsigned int) points[i - 1] > (unsigned int) points[i])
+        return 0;
+    }
+
+  for (i = 0; i < h->table; ++i)
+    if (table[i] < 0 || table[i] >= server_count)
+      return 0;
+
+  if (h->jump > 0)
+    {
+      if (h->jump_shift < 32 - JUMP_MAX_BITS
+          || h->jump_shift > 32 - JUMP_MIN_BITS
+          || h->jump != (1 << (32 - h->jump_shift)) + 1
+          || jump[h->jump - 1] != h->points)
+        return 0;
+
+      for (i = 0; i < h->jump; ++i)
+        if (jump[i] < 0 || jump[i] > h->points
+            || (i > 0 && jump[i - 1] > jump[i]))
+          return 0;
+    }
+
+  return 1;
+}
+
+
+/*
+  Empty arrays don't point into the mapping, see snapshot_owns().
+*/
+static
+void
+snapshot_array(struct array *a, int **data, int elems)
+{
+  array_destroy(a);
+  array_init(a);
+  if (elems == 0)
+    return;
+
+  a->buf = *data;
+  a->capacity = a->elems = elems;
+  *data += elems;
+}
+
+
+int
+dispatch_load_snapshot(struct dispatch_state *state, const char *path)
+{
+  const struct snapshot_header *h;
+  struct stat st;
+  void *map;
+  int *data;
+  int fd;
+
+  if (state->server_count == 0)
+    return -1;
+
+  fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return -1;
+
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(*h))
+    {
+      close(fd);
+      return -1;
+    }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  h = map;
+  if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0
+      || h->version != SNAPSHOT_VERSION || h->header_size != sizeof(*h)
+      || h->digest != snapshot_digest(state)
+      || h->points < 0 || h->jump < 0 || h->table < 0
+      || ((size_t) st.st_size
+          != sizeof(*h) + ((size_t) h->points * 2 + h->jump + h->table)
+                          * sizeof(int))
+      || ! snapshot_body_valid(h, state->server_count))
+    {
+      munmap(map, st.st_size);
+      return -1;
+    }
+
+  if (state->snapshot)
+    snapshot_unmap(state);
+
+  array_destroy(&state->pending);
+  array_init(&state->pending);
+
+  state->snapshot = map;
+  state->snapshot_size = st.st_size;
+
+  data = (int *) (h + 1);
+  snapshot_array(&state->points, &data, h->points);
+  snapshot_array(&state->indexes, &data, h->points);
+  snapshot_array(&state->jump, &data, h->jump);
+  snapshot_array(&state->table, &data, h->table);
+  state->jump_shift = h->jump_shift;
+  state->jump_valid = (h->jump > 0);
+  state->table_valid = 1;
+
+  return 0;
+}
+
+#else  /* ! HAVE_DISPATCH_SNAPSHOT */
+
+int
+dispatch_save_snapshot(struct dispatch_state *state, const char *path)
+{
+  return -1;
+}
+
+
+int
+dispatch_load_snapshot(struct dispatch_state *state, const char *path)
+{
+  return -1;
+}
+
+#endif /* ! HAVE_DISPATCH_SNAPSHOT */
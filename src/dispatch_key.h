@@ -25,16 +25,53 @@
 #define DISPATCH_KEY_H 1
 
 #include "array.h"
+#include "md5.h"
+#include "xxhash.h"
 #include <stddef.h>
 
 
+#define DISPATCH_MAX_REPLICAS  16
+
+
+/*
+  DISPATCH_KETAMA is the CRC32 Ketama continuum, or the Cache::Memcached
+  compatible one when ketama_points is zero.  DISPATCH_KETAMA_MD5 is the
+  weighted MD5 continuum of libmemcached, and always hashes keys with
+  MD5.
+*/
+enum dispatch_mode_e { DISPATCH_KETAMA, DISPATCH_JUMP, DISPATCH_RENDEZVOUS,
+                       DISPATCH_MAGLEV, DISPATCH_KETAMA_MD5 };
+
+
+/*
+  Hash function for keys.  Server points are always computed with
+  CRC32.
+*/
+enum dispatch_hash_e { DISPATCH_HASH_CRC32, DISPATCH_HASH_XXH64 };
+
+
 struct dispatch_state
 {
-  struct array buckets;
+  enum dispatch_mode_e mode;
+  struct array servers;         /* struct dispatch_server, in add order.  */
+  struct array table;           /* Server indexes for jump and Maglev.  */
+  int table_valid;
+  struct array points;          /* Sorted continuum points.  */
+  struct array indexes;         /* Server index for each point.  */
+  struct array pending;         /* Points not yet merged, unsorted.  */
+  struct array jump;            /* See dispatch_find_bucket().  */
+  int jump_shift;
+  int jump_valid;
   double total_weight;
   int ketama_points;
   unsigned int prefix_hash;
+  struct xxh64_ctx prefix_xxh64;
+  struct md5_ctx prefix_md5;
+  enum dispatch_hash_e hash_function;
+  int hash_tags;
   int server_count;
+  char *snapshot;               /* See dispatch_load_snapshot().  */
+  size_t snapshot_size;
 };
 
 
@@ -50,6 +87,30 @@ extern
 void
 dispatch_set_ketama_points(struct dispatch_state *state, int ketama_points);
 
+/*
+  dispatch_set_mode() should be called before adding any server.
+*/
+extern
+void
+dispatch_set_mode(struct dispatch_state *state, enum dispatch_mode_e mode);
+
+/*
+  dispatch_set_hash_function() should be called before adding any
+  server.
+*/
+extern
+void
+dispatch_set_hash_function(struct dispatch_state *state,
+                           enum dispatch_hash_e hash_function);
+
+/*
+  With hash tags enabled only the part of the key between the first
+  '{' and the first '}' after it is hashed, if it is not empty.
+*/
+extern
+void
+dispatch_set_hash_tags(struct dispatch_state *state, int enable);
+
 extern
 void
 dispatch_set_prefix(struct dispatch_state *state,
@@ -62,9 +123,64 @@ dispatch_add_server(struct dispatch_state *state,
                     const char *port, size_t port_len,
                     double weight, int index);
 
+/*
+  dispatch_remove_server() removes the server with index, and the
+  servers after it move down by one.  dispatch_reorder_servers() gives
+  index i to the server with index order[i].  Keys are then dispatched
+  the same as if the servers were added in their new order.  Both
+  return 0 on success, or -1 on error.
+*/
+extern
+int
+dispatch_remove_server(struct dispatch_state *state, int index);
+
+extern
+int
+dispatch_reorder_servers(struct dispatch_state *state, const int *order);
+
+/*
+  dispatch_save_snapshot() builds the continuum and the tables of the
+  current mode and writes them to the file at path, replacing it
+  atomically.  dispatch_load_snapshot() maps such a file read-only
+  and uses the tables from it instead of building them, if the file
+  was made for the same servers, mode and ketama_points.  Servers
+  added or removed later make a private copy.  Both return 0 on
+  success, or -1 on error or mismatch.
+*/
+extern
+int
+dispatch_save_snapshot(struct dispatch_state *state, const char *path);
+
+extern
+int
+dispatch_load_snapshot(struct dispatch_state *state, const char *path);
+
 extern
 int
 dispatch_key(struct dispatch_state *state, const char *key, size_t key_len);
 
+/*
+  dispatch_keys() puts into servers what dispatch_key() would return
+  for each of count keys.  Hashing and continuum lookups of several
+  keys are overlapped, which is faster for large batches.
+*/
+extern
+void
+dispatch_keys(struct dispatch_state *state,
+              const char *const *keys, const size_t *key_lens,
+              int count, int *servers);
+
+/*
+  dispatch_key_replicas() puts up to count distinct servers for the
+  key into servers, starting with the one dispatch_key() returns, and
+  returns the number of servers found.  count should not exceed
+  DISPATCH_MAX_REPLICAS.
+*/
+extern
+int
+dispatch_key_replicas(struct dispatch_state *state,
+                      const char *key, size_t key_len,
+                      int *servers, int count);
+
 
 #endif /* ! DISPATCH_KEY_H */
@@ -0,0 +1,63 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "fork_count.h"
+#ifndef WIN32
+#include <pthread.h>
+#endif  /* ! WIN32 */
+
+
+volatile unsigned int fork_count_value = 1;
+
+
+#ifndef WIN32
+
+static int registered = 0;
+
+
+static
+void
+fork_count_child()
+{
+  if (++fork_count_value == 0)
+    ++fork_count_value;
+}
+
+#endif  /* ! WIN32 */
+
+
+int
+fork_count_init()
+{
+#ifndef WIN32
+  if (registered)
+    return 0;
+
+  if (pthread_atfork(NULL, NULL, fork_count_child) != 0)
+    return -1;
+
+  registered = 1;
+#endif  /* ! WIN32 */
+
+  return 0;
+}
@@ -0,0 +1,54 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef FORK_COUNT_H
+#define FORK_COUNT_H 1
+
+
+extern volatile unsigned int fork_count_value;
+
+
+/*
+  fork_count_init() arranges for fork_count() to change in every
+  child forked after the call.  It may be called any number of times,
+  and returns -1 if the handler can't be registered.
+*/
+extern
+int
+fork_count_init();
+
+
+/*
+  fork_count() returns a non-zero number that differs between a
+  process and the children it forks, so state inherited from the
+  parent is told without a getpid() system call on every request.
+*/
+static inline
+unsigned int
+fork_count()
+{
+  return fork_count_value;
+}
+
+
+#endif /* ! FORK_COUNT_H */
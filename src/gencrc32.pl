@@ -41,15 +41,28 @@ sub gen_lookup {
     return \@lookup;
 }
 
-my $lookup = gen_lookup($poly);
+# Slice-by-8 tables: $lookup[$k][$i] is the CRC of byte $i followed
+# by $k zero bytes.
+my @lookup = ( gen_lookup($poly) );
+for my $k ( 1 .. 7 ) {
+    my $prev = $lookup[ $k - 1 ];
+    push @lookup,
+        [ map { ( $_ >> 8 ) ^ $lookup[0][ $_ & 0xff ] } @$prev ];
+}
 
-my $table;
-while (@$lookup) {
-    $table .= join( ', ',
-        map { sprintf( "0x%08xU", $_ ) } splice( @$lookup, 0, 6 ) );
-    $table .= ",\n  ";
+my @tables;
+foreach my $lookup (@lookup) {
+    my @values = @$lookup;
+    my $table;
+    while (@values) {
+        $table .= join( ', ',
+            map { sprintf( "0x%08xU", $_ ) } splice( @values, 0, 6 ) );
+        $table .= ",\n    ";
+    }
+    $table =~ s/,\n    \Z//;
+    push @tables, "{\n    $table\n  }";
 }
-$table =~ s/,\n  \Z//;
+my $table = join ",\n  ", @tables;
 
 my $gen_comment = <<"EOF";
 /*
@@ -67,7 +80,7 @@ $gen_comment
 #include "$file_h"
 
 
-const unsigned int crc32lookup[256] = {
+const unsigned int crc32lookup[8][256] = {
   $table
 };
 EOF
@@ -89,7 +102,18 @@ $gen_comment
 #include <stddef.h>
 
 
-extern const unsigned int crc32lookup[];
+extern const unsigned int crc32lookup[8][256];
+
+
+/*
+  Strings at least this long are passed to compute_crc32_bulk() from
+  crc32_bulk.c, shorter ones are hashed a byte at a time inline.
+*/
+#define COMPUTE_CRC32_BULK_MIN  16
+
+extern
+unsigned int
+compute_crc32_bulk(unsigned int crc32, const char *s, size_t len);
 
 
 #define compute_crc32(s, l)                                      \\
@@ -101,12 +125,15 @@ compute_crc32_add(unsigned int crc32, const char *s, size_t len)
 {
   const char *end = s + len;
 
+  if (len >= COMPUTE_CRC32_BULK_MIN)
+    return compute_crc32_bulk(crc32, s, len);
+
   crc32 = ~crc32;
 
   while (s < end)
     {
       unsigned int index = (crc32 ^ (unsigned char) *s) & 0x000000ffU;
-      crc32 = (crc32 >> 8) ^ crc32lookup[index];
+      crc32 = (crc32 >> 8) ^ crc32lookup[0][index];
       ++s;
     }
 
@@ -114,6 +141,33 @@ compute_crc32_add(unsigned int crc32, const char *s, size_t len)
 }
 
 
+/*
+  compute_crc32_add4() adds the first len bytes of four strings to
+  four CRCs at once.  The streams are independent, so table lookups
+  of one overlap with those of the others.
+*/
+static inline
+void
+compute_crc32_add4(unsigned int *crc32, const char *const *s, size_t len)
+{
+  unsigned int c0 = ~crc32[0], c1 = ~crc32[1], c2 = ~crc32[2], c3 = ~crc32[3];
+  size_t i;
+
+  for (i = 0; i < len; ++i)
+    {
+      c0 = (c0 >> 8) ^ crc32lookup[0][(c0 ^ (unsigned char) s[0][i]) & 0xffU];
+      c1 = (c1 >> 8) ^ crc32lookup[0][(c1 ^ (unsigned char) s[1][i]) & 0xffU];
+      c2 = (c2 >> 8) ^ crc32lookup[0][(c2 ^ (unsigned char) s[2][i]) & 0xffU];
+      c3 = (c3 >> 8) ^ crc32lookup[0][(c3 ^ (unsigned char) s[3][i]) & 0xffU];
+    }
+
+  crc32[0] = ~c0;
+  crc32[1] = ~c1;
+  crc32[2] = ~c2;
+  crc32[3] = ~c3;
+}
+
+
 #endif /* ! $guard */
 EOF
 
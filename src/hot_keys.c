@@ -0,0 +1,398 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "hot_keys.h"
+#include "time_ms.h"
+#include "key_hash.h"
+#include "xorshift.h"
+#include "fork_count.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+  Heavy hitters are found with the SpaceSaving algorithm: capacity
+  counters are kept for the keys seen so far, and a key that is not
+  tracked replaces the key with the minimal count, inheriting that
+  count as its error.  Every key with frequency above 1/capacity of
+  the sampled stream is guaranteed to be tracked.
+
+  Counters are ordered in a binary min-heap by count, so both the
+  increment and the replacement of the minimum are O(log capacity),
+  and are found by key through an open addressing index.
+
+  To follow the current traffic rather than the lifetime totals, all
+  counts are halved every HALF_LIFE.  The rate is then the count
+  divided by the equally decayed observation time.
+*/
+
+
+#define MAX_KEY_LEN  250
+#define HALF_LIFE  60000        /* 1/1000 sec.  */
+
+
+struct hot_counter
+{
+  key_hash_type hash;
+  unsigned long long count;
+  unsigned long long error;
+  int server;
+  int heap_pos;
+  size_t key_len;
+  char key[MAX_KEY_LEN];
+};
+
+
+struct hot_keys
+{
+  struct hot_counter *counters;
+  int size;
+  int capacity;
+
+  int *heap;                    /* Counter indexes.  */
+
+  int *index;                   /* Counter indexes, or -1.  */
+  size_t index_mask;
+
+  int sample;
+  unsigned int rng;
+  unsigned int rng_fork;
+
+  time_ms_type last_decay;
+  time_ms_type window;          /* Decayed time before last_decay.  */
+
+  struct hot_key_stat *stats;
+};
+
+
+static inline
+unsigned long long
+heap_count(struct hot_keys *hk, int pos)
+{
+  return hk->counters[hk->heap[pos]].count;
+}
+
+
+static inline
+void
+heap_swap(struct hot_keys *hk, int a, int b)
+{
+  int tmp = hk->heap[a];
+
+  hk->heap[a] = hk->heap[b];
+  hk->heap[b] = tmp;
+  hk->counters[hk->heap[a]].heap_pos = a;
+  hk->counters[hk->heap[b]].heap_pos = b;
+}
+
+
+static
+void
+sift_up(struct hot_keys *hk, int pos)
+{
+  while (pos > 0)
+    {
+      int parent = (pos - 1) / 2;
+
+      if (heap_count(hk, parent) <= heap_count(hk, pos))
+        break;
+
+      heap_swap(hk, parent, pos);
+      pos = parent;
+    }
+}
+
+
+static
+void
+sift_down(struct hot_keys *hk, int pos)
+{
+  while (1)
+    {
+      int child = pos * 2 + 1, min = pos;
+
+      if (child < hk->size && heap_count(hk, child) < heap_count(hk, min))
+        min = child;
+      ++child;
+      if (child < hk->size && heap_count(hk, child) < heap_count(hk, min))
+        min = child;
+
+      if (min == pos)
+        break;
+
+      heap_swap(hk, pos, min);
+      pos = min;
+    }
+}
+
+
+static
+size_t
+index_find(struct hot_keys *hk, key_hash_type hash,
+           const char *key, size_t key_len)
+{
+  size_t i = hash & hk->index_mask;
+
+  while (hk->index[i] != -1)
+    {
+      struct hot_counter *hc = &hk->counters[hk->index[i]];
+
+      if (hc->hash == hash && hc->key_len == key_len
+          && memcmp(hc->key, key, key_len) == 0)
+        break;
+
+      i = (i + 1) & hk->index_mask;
+    }
+
+  return i;
+}
+
+
+static
+void
+index_remove(struct hot_keys *hk, size_t i)
+{
+  size_t j = i;
+
+  while (1)
+    {
+      size_t home;
+
+      j = (j + 1) & hk->index_mask;
+      if (hk->index[j] == -1)
+        break;
+
+      /* Leave the entry alone if its home is cyclically in (i, j].  */
+      home = hk->counters[hk->index[j]].hash & hk->index_mask;
+      if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+        continue;
+
+      hk->index[i] = hk->index[j];
+      i = j;
+    }
+
+  hk->index[i] = -1;
+}
+
+
+static
+void
+decay(struct hot_keys *hk, time_ms_type now)
+{
+  int i;
+
+  /* Halving preserves the heap order.  */
+  for (i = 0; i < hk->size; ++i)
+    {
+      hk->counters[i].count /= 2;
+      hk->counters[i].error /= 2;
+    }
+
+  hk->window = (hk->window + (now - hk->last_decay)) / 2;
+  hk->last_decay = now;
+}
+
+
+struct hot_keys *
+hot_keys_init(int capacity, int sample)
+{
+  struct hot_keys *hk;
+  size_t index_size = 1;
+  size_t i;
+
+  if (capacity <= 0 || sample <= 0 || fork_count_init() == -1)
+    return NULL;
+
+  while (index_size < (size_t) capacity * 2)
+    index_size *= 2;
+
+  hk = (struct hot_keys *) calloc(1, sizeof(struct hot_keys));
+  if (! hk)
+    return NULL;
+
+  hk->counters = (struct hot_counter *)
+    malloc(capacity * sizeof(struct hot_counter));
+  hk->heap = (int *) malloc(capacity * sizeof(int));
+  hk->index = (int *) malloc(index_size * sizeof(int));
+  hk->stats = (struct hot_key_stat *)
+    malloc(capacity * sizeof(struct hot_key_stat));
+  if (! hk->counters || ! hk->heap || ! hk->index || ! hk->stats)
+    {
+      hot_keys_destroy(hk);
+      return NULL;
+    }
+
+  for (i = 0; i < index_size; ++i)
+    hk->index[i] = -1;
+
+  hk->index_mask = index_size - 1;
+  hk->size = 0;
+  hk->capacity = capacity;
+  hk->sample = sample;
+  hk->rng = XORSHIFT_SEED;
+  hk->rng_fork = 0;
+  hk->last_decay = time_ms();
+  hk->window = 0;
+
+  return hk;
+}
+
+
+void
+hot_keys_destroy(struct hot_keys *hk)
+{
+  free(hk->counters);
+  free(hk->heap);
+  free(hk->index);
+  free(hk->stats);
+  free(hk);
+}
+
+
+int
+hot_keys_add(struct hot_keys *hk, const char *key, size_t key_len,
+             int server)
+{
+  key_hash_type hash;
+  struct hot_counter *hc;
+  time_ms_type now;
+  size_t i;
+
+  if (key_len <= MAX_KEY_LEN)
+    {
+      now = time_ms();
+      if (now - hk->last_decay >= HALF_LIFE)
+        decay(hk, now);
+
+      hash = key_hash("", 0, key, key_len);
+      i = index_find(hk, hash, key, key_len);
+      if (hk->index[i] != -1)
+        {
+          hc = &hk->counters[hk->index[i]];
+          ++hc->count;
+          hc->server = server;
+          sift_down(hk, hc->heap_pos);
+        }
+      else
+        {
+          int fresh = (hk->size < hk->capacity);
+
+          if (fresh)
+            {
+              hc = &hk->counters[hk->size];
+              hc->count = 1;
+              hc->error = 0;
+              hc->heap_pos = hk->size;
+              hk->heap[hk->size] = hk->size;
+              ++hk->size;
+            }
+          else
+            {
+              /* Replace the key with the minimal count.  */
+              hc = &hk->counters[hk->heap[0]];
+              index_remove(hk, index_find(hk, hc->hash,
+                                          hc->key, hc->key_len));
+              i = index_find(hk, hash, key, key_len);
+              hc->error = hc->count;
+              ++hc->count;
+            }
+
+          hc->hash = hash;
+          hc->server = server;
+          hc->key_len = key_len;
+          memcpy(hc->key, key, key_len);
+          hk->index[i] = hc - hk->counters;
+
+          if (fresh)
+            sift_up(hk, hc->heap_pos);
+          else
+            sift_down(hk, hc->heap_pos);
+        }
+    }
+
+  if (hk->sample == 1)
+    return 1;
+
+  /* Random gap with the mean of sample avoids aliasing with patterns.  */
+  xorshift_reseed(&hk->rng, &hk->rng_fork, hk);
+  return 1 + xorshift32(&hk->rng) % (2 * hk->sample - 1);
+}
+
+
+static
+int
+compare_stats(const void *a, const void *b)
+{
+  const struct hot_key_stat *sa = (const struct hot_key_stat *) a;
+  const struct hot_key_stat *sb = (const struct hot_key_stat *) b;
+
+  if (sa->count != sb->count)
+    return (sa->count < sb->count ? 1 : -1);
+
+  return 0;
+}
+
+
+void
+hot_keys_renumber(struct hot_keys *hk, const int *new_index)
+{
+  int i;
+
+  for (i = 0; i < hk->size; ++i)
+    {
+      struct hot_counter *hc = &hk->counters[i];
+
+      if (hc->server != -1)
+        hc->server = (new_index ? new_index[hc->server] : -1);
+    }
+}
+
+
+int
+hot_keys_get(struct hot_keys *hk, const struct hot_key_stat **stats)
+{
+  time_ms_type window = hk->window + (time_ms() - hk->last_decay);
+  int i;
+
+  if (window <= 0)
+    window = 1;
+
+  for (i = 0; i < hk->size; ++i)
+    {
+      struct hot_counter *hc = &hk->counters[i];
+      struct hot_key_stat *s = &hk->stats[i];
+
+      s->key = hc->key;
+      s->key_len = hc->key_len;
+      s->count = hc->count * hk->sample;
+      s->error = hc->error * hk->sample;
+      s->rate = (double) s->count * 1000.0 / window;
+      s->server = hc->server;
+    }
+
+  qsort(hk->stats, hk->size, sizeof(struct hot_key_stat), compare_stats);
+
+  *stats = hk->stats;
+
+  return hk->size;
+}
@@ -0,0 +1,74 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef HOT_KEYS_H
+#define HOT_KEYS_H 1
+
+#include "client.h"
+#include <stddef.h>
+
+
+struct hot_keys;
+
+
+/*
+  hot_keys_init() creates a tracker of capacity most frequent keys,
+  which are fed one in sample keys on average.
+*/
+extern
+struct hot_keys *
+hot_keys_init(int capacity, int sample);
+
+extern
+void
+hot_keys_destroy(struct hot_keys *hk);
+
+/*
+  hot_keys_add() accounts the key, and returns the number of keys to
+  skip before the next call.
+*/
+extern
+int
+hot_keys_add(struct hot_keys *hk, const char *key, size_t key_len,
+             int server);
+
+/*
+  hot_keys_renumber() moves the keys of server i to new_index[i],
+  which is -1 for a removed server.  When new_index is NULL all
+  servers are forgotten.
+*/
+extern
+void
+hot_keys_renumber(struct hot_keys *hk, const int *new_index);
+
+/*
+  hot_keys_get() sets stats to the array of tracked keys in the order
+  of decreasing count, and returns its size.  The array stays valid
+  until the next call to hot_keys_get() or hot_keys_destroy().
+*/
+extern
+int
+hot_keys_get(struct hot_keys *hk, const struct hot_key_stat **stats);
+
+
+#endif /* ! HOT_KEYS_H */
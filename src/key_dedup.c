@@ -0,0 +1,172 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "key_dedup.h"
+#include "key_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+  Keys of one request batch, mapped to their first index.  Slots are
+  tagged with a generation, so that clearing the table between batches
+  doesn't have to touch it.
+*/
+
+
+#define INITIAL_SLOTS  64
+
+
+struct key_dedup_slot
+{
+  key_hash_type hash;
+  const char *key;
+  size_t key_len;
+  int index;
+  unsigned int generation;      /* Empty unless equal to current.  */
+};
+
+
+struct key_dedup
+{
+  struct key_dedup_slot *slots;
+  size_t mask;
+  size_t count;
+  unsigned int generation;
+};
+
+
+static
+int
+grow(struct key_dedup *kd)
+{
+  struct key_dedup_slot *slots, *old = kd->slots;
+  size_t size = (kd->mask + 1) * 2, i;
+
+  slots = (struct key_dedup_slot *) calloc(size,
+                                           sizeof(struct key_dedup_slot));
+  if (! slots)
+    return -1;
+
+  kd->slots = slots;
+  kd->mask = size - 1;
+
+  for (i = 0; i < size / 2; ++i)
+    {
+      size_t j;
+
+      if (old[i].generation != kd->generation)
+        continue;
+
+      j = old[i].hash & kd->mask;
+      while (slots[j].generation == kd->generation)
+        j = (j + 1) & kd->mask;
+
+      slots[j] = old[i];
+    }
+
+  free(old);
+
+  return 0;
+}
+
+
+struct key_dedup *
+key_dedup_init()
+{
+  struct key_dedup *kd;
+
+  kd = (struct key_dedup *) malloc(sizeof(struct key_dedup));
+  if (! kd)
+    return NULL;
+
+  kd->slots = (struct key_dedup_slot *) calloc(INITIAL_SLOTS,
+                                               sizeof(struct key_dedup_slot));
+  if (! kd->slots)
+    {
+      free(kd);
+      return NULL;
+    }
+
+  kd->mask = INITIAL_SLOTS - 1;
+  kd->count = 0;
+  kd->generation = 1;
+
+  return kd;
+}
+
+
+void
+key_dedup_destroy(struct key_dedup *kd)
+{
+  free(kd->slots);
+  free(kd);
+}
+
+
+void
+key_dedup_clear(struct key_dedup *kd)
+{
+  if (kd->count == 0)
+    return;
+
+  kd->count = 0;
+  if (++kd->generation == 0)
+    {
+      /* On wrap around old tags could look current again.  */
+      memset(kd->slots, 0, (kd->mask + 1) * sizeof(struct key_dedup_slot));
+      kd->generation = 1;
+    }
+}
+
+
+int
+key_dedup_insert(struct key_dedup *kd, const char *key, size_t key_len,
+                 int index)
+{
+  key_hash_type hash;
+  size_t i;
+
+  if ((kd->count + 1) * 2 > kd->mask + 1 && grow(kd) == -1)
+    return index;
+
+  hash = key_hash("", 0, key, key_len);
+  i = hash & kd->mask;
+  while (kd->slots[i].generation == kd->generation)
+    {
+      if (kd->slots[i].hash == hash && kd->slots[i].key_len == key_len
+          && memcmp(kd->slots[i].key, key, key_len) == 0)
+        return kd->slots[i].index;
+
+      i = (i + 1) & kd->mask;
+    }
+
+  kd->slots[i].hash = hash;
+  kd->slots[i].key = key;
+  kd->slots[i].key_len = key_len;
+  kd->slots[i].index = index;
+  kd->slots[i].generation = kd->generation;
+  ++kd->count;
+
+  return index;
+}
@@ -0,0 +1,60 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef KEY_DEDUP_H
+#define KEY_DEDUP_H 1
+
+#include <stddef.h>
+
+
+struct key_dedup;
+
+
+extern
+struct key_dedup *
+key_dedup_init();
+
+extern
+void
+key_dedup_destroy(struct key_dedup *kd);
+
+/*
+  key_dedup_clear() forgets all keys in O(1).
+*/
+extern
+void
+key_dedup_clear(struct key_dedup *kd);
+
+/*
+  key_dedup_insert() returns the index the key was first inserted
+  with, or the given index if the key is new (or there's no memory to
+  remember it).  The key is not copied, and should stay valid until
+  key_dedup_clear().
+*/
+extern
+int
+key_dedup_insert(struct key_dedup *kd, const char *key, size_t key_len,
+                 int index);
+
+
+#endif /* ! KEY_DEDUP_H */
@@ -0,0 +1,54 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef KEY_HASH_H
+#define KEY_HASH_H 1
+
+#include <stddef.h>
+
+
+typedef unsigned long long key_hash_type;
+
+
+/*
+  key_hash() is 64-bit FNV-1a of the prefix followed by the key.  It
+  is used by local caches, and is unrelated to the hashing used for
+  server selection.
+*/
+static inline
+key_hash_type
+key_hash(const char *prefix, size_t prefix_len,
+         const char *key, size_t key_len)
+{
+  key_hash_type h = 14695981039346656037ULL;
+
+  while (prefix_len--)
+    h = (h ^ (unsigned char) *prefix++) * 1099511628211ULL;
+  while (key_len--)
+    h = (h ^ (unsigned char) *key++) * 1099511628211ULL;
+
+  return h;
+}
+
+
+#endif /* ! KEY_HASH_H */
@@ -0,0 +1,221 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "key_set.h"
+#include "key_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+  A set of strings in an open addressing table with linear probing.
+  Empty set is checked without hashing the key, so the set costs
+  nothing when unused.
+*/
+
+
+#define INITIAL_SLOTS  16
+
+
+struct key_set_slot
+{
+  key_hash_type hash;
+  char *key;                    /* NULL when empty.  */
+  size_t key_len;
+};
+
+
+struct key_set
+{
+  struct key_set_slot *slots;
+  size_t mask;
+  size_t count;
+};
+
+
+static
+size_t
+find_slot(struct key_set *ks, key_hash_type hash,
+          const char *key, size_t key_len)
+{
+  size_t i = hash & ks->mask;
+
+  while (ks->slots[i].key)
+    {
+      if (ks->slots[i].hash == hash && ks->slots[i].key_len == key_len
+          && memcmp(ks->slots[i].key, key, key_len) == 0)
+        break;
+
+      i = (i + 1) & ks->mask;
+    }
+
+  return i;
+}
+
+
+static
+int
+grow(struct key_set *ks)
+{
+  struct key_set_slot *slots, *old = ks->slots;
+  size_t size = (ks->mask + 1) * 2, i;
+
+  slots = (struct key_set_slot *) calloc(size, sizeof(struct key_set_slot));
+  if (! slots)
+    return -1;
+
+  ks->slots = slots;
+  ks->mask = size - 1;
+
+  for (i = 0; i < size / 2; ++i)
+    {
+      size_t j;
+
+      if (! old[i].key)
+        continue;
+
+      j = old[i].hash & ks->mask;
+      while (slots[j].key)
+        j = (j + 1) & ks->mask;
+
+      slots[j] = old[i];
+    }
+
+  free(old);
+
+  return 0;
+}
+
+
+struct key_set *
+key_set_init()
+{
+  struct key_set *ks;
+
+  ks = (struct key_set *) malloc(sizeof(struct key_set));
+  if (! ks)
+    return NULL;
+
+  ks->slots = (struct key_set_slot *) calloc(INITIAL_SLOTS,
+                                             sizeof(struct key_set_slot));
+  if (! ks->slots)
+    {
+      free(ks);
+      return NULL;
+    }
+
+  ks->mask = INITIAL_SLOTS - 1;
+  ks->count = 0;
+
+  return ks;
+}
+
+
+void
+key_set_destroy(struct key_set *ks)
+{
+  size_t i;
+
+  for (i = 0; i <= ks->mask; ++i)
+    free(ks->slots[i].key);
+
+  free(ks->slots);
+  free(ks);
+}
+
+
+int
+key_set_insert(struct key_set *ks, const char *key, size_t key_len)
+{
+  key_hash_type hash = key_hash("", 0, key, key_len);
+  size_t i;
+  char *s;
+
+  if ((ks->count + 1) * 2 > ks->mask + 1 && grow(ks) == -1)
+    return -1;
+
+  i = find_slot(ks, hash, key, key_len);
+  if (ks->slots[i].key)
+    return 0;
+
+  s = (char *) malloc(key_len + 1);
+  if (! s)
+    return -1;
+
+  memcpy(s, key, key_len);
+  s[key_len] = '\0';
+
+  ks->slots[i].hash = hash;
+  ks->slots[i].key = s;
+  ks->slots[i].key_len = key_len;
+  ++ks->count;
+
+  return 0;
+}
+
+
+void
+key_set_remove(struct key_set *ks, const char *key, size_t key_len)
+{
+  key_hash_type hash = key_hash("", 0, key, key_len);
+  size_t i = find_slot(ks, hash, key, key_len), j = i;
+
+  if (! ks->slots[i].key)
+    return;
+
+  free(ks->slots[i].key);
+  --ks->count;
+
+  while (1)
+    {
+      size_t home;
+
+      j = (j + 1) & ks->mask;
+      if (! ks->slots[j].key)
+        break;
+
+      /* Leave the entry alone if its home is cyclically in (i, j].  */
+      home = ks->slots[j].hash & ks->mask;
+      if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+        continue;
+
+      ks->slots[i] = ks->slots[j];
+      i = j;
+    }
+
+  ks->slots[i].key = NULL;
+}
+
+
+int
+key_set_contains(struct key_set *ks, const char *key, size_t key_len)
+{
+  key_hash_type hash;
+
+  if (ks->count == 0)
+    return 0;
+
+  hash = key_hash("", 0, key, key_len);
+
+  return (ks->slots[find_slot(ks, hash, key, key_len)].key != NULL);
+}
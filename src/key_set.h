@@ -0,0 +1,54 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef KEY_SET_H
+#define KEY_SET_H 1
+
+#include <stddef.h>
+
+
+struct key_set;
+
+
+extern
+struct key_set *
+key_set_init();
+
+extern
+void
+key_set_destroy(struct key_set *ks);
+
+extern
+int
+key_set_insert(struct key_set *ks, const char *key, size_t key_len);
+
+extern
+void
+key_set_remove(struct key_set *ks, const char *key, size_t key_len);
+
+extern
+int
+key_set_contains(struct key_set *ks, const char *key, size_t key_len);
+
+
+#endif /* ! KEY_SET_H */
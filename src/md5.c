@@ -0,0 +1,239 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+/*
+  MD5 message digest as described in RFC 1321.  Only used to place
+  servers and keys on libmemcached compatible continuum, so the speed
+  is not critical.
+*/
+
+#include "md5.h"
+#include <string.h>
+
+
+#define F(x, y, z)  ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z)  ((y) ^ ((z) & ((x) ^ (y))))
+#define H(x, y, z)  ((x) ^ (y) ^ (z))
+#define I(x, y, z)  ((y) ^ ((x) | ~(z)))
+
+#define STEP(f, a, b, c, d, x, t, s)                                    \
+  (a) += f((b), (c), (d)) + (x) + (t);                                  \
+  (a) = (((a) << (s)) | (((a) & 0xffffffffU) >> (32 - (s))));           \
+  (a) += (b);
+
+#define GET(i)                                                          \
+  ((unsigned int) p[(i) * 4]                                            \
+   | ((unsigned int) p[(i) * 4 + 1] << 8)                               \
+   | ((unsigned int) p[(i) * 4 + 2] << 16)                              \
+   | ((unsigned int) p[(i) * 4 + 3] << 24))
+
+
+static
+const unsigned char *
+md5_body(struct md5_ctx *ctx, const unsigned char *p, size_t len)
+{
+  unsigned int a = ctx->a, b = ctx->b, c = ctx->c, d = ctx->d;
+
+  do
+    {
+      unsigned int x[16];
+      unsigned int saved_a = a, saved_b = b, saved_c = c, saved_d = d;
+      int i;
+
+      for (i = 0; i < 16; ++i)
+        x[i] = GET(i);
+
+      STEP(F, a, b, c, d, x[0], 0xd76aa478, 7)
+      STEP(F, d, a, b, c, x[1], 0xe8c7b756, 12)
+      STEP(F, c, d, a, b, x[2], 0x242070db, 17)
+      STEP(F, b, c, d, a, x[3], 0xc1bdceee, 22)
+      STEP(F, a, b, c, d, x[4], 0xf57c0faf, 7)
+      STEP(F, d, a, b, c, x[5], 0x4787c62a, 12)
+      STEP(F, c, d, a, b, x[6], 0xa8304613, 17)
+      STEP(F, b, c, d, a, x[7], 0xfd469501, 22)
+      STEP(F, a, b, c, d, x[8], 0x698098d8, 7)
+      STEP(F, d, a, b, c, x[9], 0x8b44f7af, 12)
+      STEP(F, c, d, a, b, x[10], 0xffff5bb1, 17)
+      STEP(F, b, c, d, a, x[11], 0x895cd7be, 22)
+      STEP(F, a, b, c, d, x[12], 0x6b901122, 7)
+      STEP(F, d, a, b, c, x[13], 0xfd987193, 12)
+      STEP(F, c, d, a, b, x[14], 0xa679438e, 17)
+      STEP(F, b, c, d, a, x[15], 0x49b40821, 22)
+
+      STEP(G, a, b, c, d, x[1], 0xf61e2562, 5)
+      STEP(G, d, a, b, c, x[6], 0xc040b340, 9)
+      STEP(G, c, d, a, b, x[11], 0x265e5a51, 14)
+      STEP(G, b, c, d, a, x[0], 0xe9b6c7aa, 20)
+      STEP(G, a, b, c, d, x[5], 0xd62f105d, 5)
+      STEP(G, d, a, b, c, x[10], 0x02441453, 9)
+      STEP(G, c, d, a, b, x[15], 0xd8a1e681, 14)
+      STEP(G, b, c, d, a, x[4], 0xe7d3fbc8, 20)
+      STEP(G, a, b, c, d, x[9], 0x21e1cde6, 5)
+      STEP(G, d, a, b, c, x[14], 0xc33707d6, 9)
+      STEP(G, c, d, a, b, x[3], 0xf4d50d87, 14)
+      STEP(G, b, c, d, a, x[8], 0x455a14ed, 20)
+      STEP(G, a, b, c, d, x[13], 0xa9e3e905, 5)
+      STEP(G, d, a, b, c, x[2], 0xfcefa3f8, 9)
+      STEP(G, c, d, a, b, x[7], 0x676f02d9, 14)
+      STEP(G, b, c, d, a, x[12], 0x8d2a4c8a, 20)
+
+      STEP(H, a, b, c, d, x[5], 0xfffa3942, 4)
+      STEP(H, d, a, b, c, x[8], 0x8771f681, 11)
+      STEP(H, c, d, a, b, x[11], 0x6d9d6122, 16)
+      STEP(H, b, c, d, a, x[14], 0xfde5380c, 23)
+      STEP(H, a, b, c, d, x[1], 0xa4beea44, 4)
+      STEP(H, d, a, b, c, x[4], 0x4bdecfa9, 11)
+      STEP(H, c, d, a, b, x[7], 0xf6bb4b60, 16)
+      STEP(H, b, c, d, a, x[10], 0xbebfbc70, 23)
+      STEP(H, a, b, c, d, x[13], 0x289b7ec6, 4)
+      STEP(H, d, a, b, c, x[0], 0xeaa127fa, 11)
+      STEP(H, c, d, a, b, x[3], 0xd4ef3085, 16)
+      STEP(H, b, c, d, a, x[6], 0x04881d05, 23)
+      STEP(H, a, b, c, d, x[9], 0xd9d4d039, 4)
+      STEP(H, d, a, b, c, x[12], 0xe6db99e5, 11)
+      STEP(H, c, d, a, b, x[15], 0x1fa27cf8, 16)
+      STEP(H, b, c, d, a, x[2], 0xc4ac5665, 23)
+
+      STEP(I, a, b, c, d, x[0], 0xf4292244, 6)
+      STEP(I, d, a, b, c, x[7], 0x432aff97, 10)
+      STEP(I, c, d, a, b, x[14], 0xab9423a7, 15)
+      STEP(I, b, c, d, a, x[5], 0xfc93a039, 21)
+      STEP(I, a, b, c, d, x[12], 0x655b59c3, 6)
+      STEP(I, d, a, b, c, x[3], 0x8f0ccc92, 10)
+      STEP(I, c, d, a, b, x[10], 0xffeff47d, 15)
+      STEP(I, b, c, d, a, x[1], 0x85845dd1, 21)
+      STEP(I, a, b, c, d, x[8], 0x6fa87e4f, 6)
+      STEP(I, d, a, b, c, x[15], 0xfe2ce6e0, 10)
+      STEP(I, c, d, a, b, x[6], 0xa3014314, 15)
+      STEP(I, b, c, d, a, x[13], 0x4e0811a1, 21)
+      STEP(I, a, b, c, d, x[4], 0xf7537e82, 6)
+      STEP(I, d, a, b, c, x[11], 0xbd3af235, 10)
+      STEP(I, c, d, a, b, x[2], 0x2ad7d2bb, 15)
+      STEP(I, b, c, d, a, x[9], 0xeb86d391, 21)
+
+      a = (a + saved_a) & 0xffffffffU;
+      b = (b + saved_b) & 0xffffffffU;
+      c = (c + saved_c) & 0xffffffffU;
+      d = (d + saved_d) & 0xffffffffU;
+
+      p += 64;
+    }
+  while (len -= 64);
+
+  ctx->a = a;
+  ctx->b = b;
+  ctx->c = c;
+  ctx->d = d;
+
+  return p;
+}
+
+
+void
+md5_init(struct md5_ctx *ctx)
+{
+  ctx->a = 0x67452301;
+  ctx->b = 0xefcdab89;
+  ctx->c = 0x98badcfe;
+  ctx->d = 0x10325476;
+  ctx->lo = 0;
+  ctx->hi = 0;
+}
+
+
+void
+md5_update(struct md5_ctx *ctx, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  unsigned int saved_lo = ctx->lo;
+  size_t used, available;
+
+  if ((ctx->lo = (saved_lo + len) & 0x1fffffff) < saved_lo)
+    ++ctx->hi;
+  ctx->hi += (unsigned int) (len >> 29);
+
+  used = saved_lo & 0x3f;
+  if (used)
+    {
+      available = 64 - used;
+      if (len < available)
+        {
+          memcpy(&ctx->buffer[used], p, len);
+          return;
+        }
+
+      memcpy(&ctx->buffer[used], p, available);
+      p += available;
+      len -= available;
+      md5_body(ctx, ctx->buffer, 64);
+    }
+
+  if (len >= 64)
+    {
+      p = md5_body(ctx, p, len & ~(size_t) 0x3f);
+      len &= 0x3f;
+    }
+
+  memcpy(ctx->buffer, p, len);
+}
+
+
+static inline
+void
+put32(unsigned char *p, unsigned int x)
+{
+  p[0] = x & 0xff;
+  p[1] = (x >> 8) & 0xff;
+  p[2] = (x >> 16) & 0xff;
+  p[3] = (x >> 24) & 0xff;
+}
+
+
+void
+md5_final(struct md5_ctx *ctx, unsigned char digest[16])
+{
+  size_t used = ctx->lo & 0x3f, available;
+
+  ctx->buffer[used++] = 0x80;
+
+  available = 64 - used;
+  if (available < 8)
+    {
+      memset(&ctx->buffer[used], 0, available);
+      md5_body(ctx, ctx->buffer, 64);
+      used = 0;
+      available = 64;
+    }
+  memset(&ctx->buffer[used], 0, available - 8);
+
+  ctx->lo <<= 3;
+  put32(&ctx->buffer[56], ctx->lo);
+  put32(&ctx->buffer[60], ctx->hi);
+
+  md5_body(ctx, ctx->buffer, 64);
+
+  put32(&digest[0], ctx->a);
+  put32(&digest[4], ctx->b);
+  put32(&digest[8], ctx->c);
+  put32(&digest[12], ctx->d);
+}
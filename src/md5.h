@@ -0,0 +1,51 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef MD5_H
+#define MD5_H 1
+
+#include <stddef.h>
+
+
+struct md5_ctx
+{
+  unsigned int a, b, c, d;
+  unsigned int lo, hi;
+  unsigned char buffer[64];
+};
+
+
+extern
+void
+md5_init(struct md5_ctx *ctx);
+
+extern
+void
+md5_update(struct md5_ctx *ctx, const void *data, size_t len);
+
+extern
+void
+md5_final(struct md5_ctx *ctx, unsigned char digest[16]);
+
+
+#endif /* ! MD5_H */
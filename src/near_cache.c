@@ -0,0 +1,380 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "near_cache.h"
+#include "time_ms.h"
+#include "key_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+  Entries are kept in an open addressing table with linear probing.
+  A slot holds the full hash of the key and a pointer to the entry, so
+  probing touches only the slot array, and the entry itself is
+  dereferenced only when the hashes match.  Deletion shifts following
+  entries back instead of leaving tombstones.
+
+  When the byte limit is reached entries are evicted with the CLOCK
+  algorithm: the hand sweeps the slot array, clearing the referenced
+  bit of recently used entries, and evicts the first entry that has
+  not been used since the last sweep.
+*/
+
+
+#define INITIAL_SLOTS  64
+
+
+struct near_entry
+{
+  time_ms_type expires;
+  value_size_type value_size;
+  flags_type flags;
+  size_t key_len;               /* Prefix and key.  */
+  int referenced;
+  char data[1];                 /* Prefix, key, then value.  */
+};
+
+
+struct near_slot
+{
+  key_hash_type hash;
+  struct near_entry *entry;
+};
+
+
+struct near_cache
+{
+  struct near_slot *slots;
+  size_t mask;
+  size_t hand;
+
+  size_t max_bytes;
+  int max_ttl;                  /* 1/1000 sec.  */
+
+  struct near_cache_stats stats;
+};
+
+
+static inline
+size_t
+entry_bytes(size_t key_len, value_size_type value_size)
+{
+  return (offsetof(struct near_entry, data) + key_len + value_size);
+}
+
+
+static inline
+int
+entry_matches(const struct near_entry *e,
+              const char *prefix, size_t prefix_len,
+              const char *key, size_t key_len)
+{
+  return (e->key_len == prefix_len + key_len
+          && memcmp(e->data, prefix, prefix_len) == 0
+          && memcmp(e->data + prefix_len, key, key_len) == 0);
+}
+
+
+static
+size_t
+find_slot(struct near_cache *nc, key_hash_type hash,
+          const char *prefix, size_t prefix_len,
+          const char *key, size_t key_len)
+{
+  size_t i = hash & nc->mask;
+
+  while (nc->slots[i].entry)
+    {
+      if (nc->slots[i].hash == hash
+          && entry_matches(nc->slots[i].entry, prefix, prefix_len,
+                           key, key_len))
+        break;
+
+      i = (i + 1) & nc->mask;
+    }
+
+  return i;
+}
+
+
+static
+void
+remove_slot(struct near_cache *nc, size_t i)
+{
+  struct near_entry *e = nc->slots[i].entry;
+  size_t j = i;
+
+  --nc->stats.entries;
+  nc->stats.bytes -= entry_bytes(e->key_len, e->value_size);
+  free(e);
+
+  while (1)
+    {
+      size_t home;
+
+      j = (j + 1) & nc->mask;
+      if (! nc->slots[j].entry)
+        break;
+
+      /* Leave the entry alone if its home is cyclically in (i, j].  */
+      home = nc->slots[j].hash & nc->mask;
+      if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+        continue;
+
+      nc->slots[i] = nc->slots[j];
+      i = j;
+    }
+
+  nc->slots[i].entry = NULL;
+}
+
+
+static
+void
+evict_one(struct near_cache *nc)
+{
+  time_ms_type now = time_ms();
+
+  while (1)
+    {
+      struct near_entry *e = nc->slots[nc->hand].entry;
+
+      if (! e)
+        {
+          nc->hand = (nc->hand + 1) & nc->mask;
+        }
+      else if (e->referenced && e->expires > now)
+        {
+          e->referenced = 0;
+          nc->hand = (nc->hand + 1) & nc->mask;
+        }
+      else
+        {
+          /*
+            remove_slot() may shift another entry under the hand, so
+            do not advance it.
+          */
+          remove_slot(nc, nc->hand);
+          ++nc->stats.evictions;
+          return;
+        }
+    }
+}
+
+
+static
+int
+grow(struct near_cache *nc)
+{
+  struct near_slot *slots, *old = nc->slots;
+  size_t size = (nc->mask + 1) * 2, i;
+
+  slots = (struct near_slot *) calloc(size, sizeof(struct near_slot));
+  if (! slots)
+    return -1;
+
+  nc->slots = slots;
+  nc->mask = size - 1;
+  nc->hand = 0;
+
+  for (i = 0; i < size / 2; ++i)
+    {
+      size_t j;
+
+      if (! old[i].entry)
+        continue;
+
+      j = old[i].hash & nc->mask;
+      while (slots[j].entry)
+        j = (j + 1) & nc->mask;
+
+      slots[j] = old[i];
+    }
+
+  free(old);
+
+  return 0;
+}
+
+
+struct near_cache *
+near_cache_init(size_t max_bytes, int max_ttl)
+{
+  struct near_cache *nc;
+
+  nc = (struct near_cache *) malloc(sizeof(struct near_cache));
+  if (! nc)
+    return NULL;
+
+  nc->slots = (struct near_slot *) calloc(INITIAL_SLOTS,
+                                          sizeof(struct near_slot));
+  if (! nc->slots)
+    {
+      free(nc);
+      return NULL;
+    }
+
+  nc->mask = INITIAL_SLOTS - 1;
+  nc->hand = 0;
+  nc->max_bytes = max_bytes;
+  nc->max_ttl = max_ttl;
+  memset(&nc->stats, 0, sizeof(nc->stats));
+
+  return nc;
+}
+
+
+void
+near_cache_destroy(struct near_cache *nc)
+{
+  near_cache_clear(nc);
+  free(nc->slots);
+  free(nc);
+}
+
+
+void
+near_cache_clear(struct near_cache *nc)
+{
+  size_t i;
+
+  for (i = 0; i <= nc->mask; ++i)
+    {
+      free(nc->slots[i].entry);
+      nc->slots[i].entry = NULL;
+    }
+
+  nc->hand = 0;
+  nc->stats.entries = 0;
+  nc->stats.bytes = 0;
+}
+
+
+int
+near_cache_lookup(struct near_cache *nc,
+                  const char *prefix, size_t prefix_len,
+                  const char *key, size_t key_len,
+                  const void **value, value_size_type *value_size,
+                  flags_type *flags)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  size_t i = find_slot(nc, hash, prefix, prefix_len, key, key_len);
+  struct near_entry *e = nc->slots[i].entry;
+
+  if (e && e->expires <= time_ms())
+    {
+      remove_slot(nc, i);
+      e = NULL;
+    }
+
+  if (! e)
+    {
+      ++nc->stats.misses;
+      return 0;
+    }
+
+  e->referenced = 1;
+  ++nc->stats.hits;
+
+  *value = e->data + e->key_len;
+  *value_size = e->value_size;
+  *flags = e->flags;
+
+  return 1;
+}
+
+
+void
+near_cache_insert(struct near_cache *nc,
+                  const char *prefix, size_t prefix_len,
+                  const char *key, size_t key_len,
+                  flags_type flags,
+                  const void *value, value_size_type value_size,
+                  int ttl)
+{
+  size_t bytes = entry_bytes(prefix_len + key_len, value_size);
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  struct near_entry *e;
+  size_t i;
+
+  i = find_slot(nc, hash, prefix, prefix_len, key, key_len);
+  if (nc->slots[i].entry)
+    remove_slot(nc, i);
+
+  /* Do not let a single value flush the whole cache.  */
+  if (bytes > nc->max_bytes / 4)
+    return;
+
+  while (nc->stats.bytes + bytes > nc->max_bytes)
+    evict_one(nc);
+
+  if ((nc->stats.entries + 1) * 2 > nc->mask + 1 && grow(nc) == -1)
+    return;
+
+  e = (struct near_entry *) malloc(bytes);
+  if (! e)
+    return;
+
+  if (ttl <= 0 || ttl > nc->max_ttl)
+    ttl = nc->max_ttl;
+
+  e->expires = time_ms() + ttl;
+  e->value_size = value_size;
+  e->flags = flags;
+  e->key_len = prefix_len + key_len;
+  e->referenced = 0;
+  memcpy(e->data, prefix, prefix_len);
+  memcpy(e->data + prefix_len, key, key_len);
+  memcpy(e->data + e->key_len, value, value_size);
+
+  i = hash & nc->mask;
+  while (nc->slots[i].entry)
+    i = (i + 1) & nc->mask;
+
+  nc->slots[i].hash = hash;
+  nc->slots[i].entry = e;
+
+  ++nc->stats.entries;
+  nc->stats.bytes += bytes;
+}
+
+
+void
+near_cache_remove(struct near_cache *nc,
+                  const char *prefix, size_t prefix_len,
+                  const char *key, size_t key_len)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  size_t i = find_slot(nc, hash, prefix, prefix_len, key, key_len);
+
+  if (nc->slots[i].entry)
+    remove_slot(nc, i);
+}
+
+
+void
+near_cache_get_stats(struct near_cache *nc, struct near_cache_stats *stats)
+{
+  *stats = nc->stats;
+}
@@ -0,0 +1,83 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef NEAR_CACHE_H
+#define NEAR_CACHE_H 1
+
+#include "client.h"
+#include <stddef.h>
+
+
+struct near_cache;
+
+
+extern
+struct near_cache *
+near_cache_init(size_t max_bytes, int max_ttl);
+
+extern
+void
+near_cache_destroy(struct near_cache *nc);
+
+extern
+void
+near_cache_clear(struct near_cache *nc);
+
+/*
+  near_cache_lookup() returns 1 and sets value, value_size and flags
+  on hit, or returns 0 on miss.  The value stays valid until the next
+  call that modifies the cache.
+*/
+extern
+int
+near_cache_lookup(struct near_cache *nc,
+                  const char *prefix, size_t prefix_len,
+                  const char *key, size_t key_len,
+                  const void **value, value_size_type *value_size,
+                  flags_type *flags);
+
+/*
+  ttl is in 1/1000 sec.  Zero or negative ttl, or ttl larger than
+  max_ttl given to near_cache_init(), means max_ttl.
+*/
+extern
+void
+near_cache_insert(struct near_cache *nc,
+                  const char *prefix, size_t prefix_len,
+                  const char *key, size_t key_len,
+                  flags_type flags,
+                  const void *value, value_size_type value_size,
+                  int ttl);
+
+extern
+void
+near_cache_remove(struct near_cache *nc,
+                  const char *prefix, size_t prefix_len,
+                  const char *key, size_t key_len);
+
+extern
+void
+near_cache_get_stats(struct near_cache *nc, struct near_cache_stats *stats);
+
+
+#endif /* ! NEAR_CACHE_H */
@@ -0,0 +1,176 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "negative_cache.h"
+#include "time_ms.h"
+#include "key_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+  Missing keys are remembered by their 64-bit hash only, so the cache
+  doesn't depend on key length, and a false positive requires a full
+  hash collision.  The table is split into sets of WAYS entries, and
+  when a set is full the entry that expires first is replaced.
+*/
+
+
+#define WAYS  4
+
+
+struct negative_entry
+{
+  key_hash_type hash;
+  time_ms_type expires;
+};
+
+
+struct negative_cache
+{
+  struct negative_entry *entries;
+  size_t set_mask;
+  int ttl;                      /* 1/1000 sec.  */
+
+  struct negative_cache_stats stats;
+};
+
+
+static inline
+struct negative_entry *
+get_set(struct negative_cache *nc, key_hash_type hash)
+{
+  return &nc->entries[(hash & nc->set_mask) * WAYS];
+}
+
+
+struct negative_cache *
+negative_cache_init(size_t size, int ttl)
+{
+  struct negative_cache *nc;
+  size_t sets = 1;
+
+  nc = (struct negative_cache *) malloc(sizeof(struct negative_cache));
+  if (! nc)
+    return NULL;
+
+  while (sets * 2 * WAYS <= size)
+    sets *= 2;
+
+  nc->entries = (struct negative_entry *)
+    calloc(sets * WAYS, sizeof(struct negative_entry));
+  if (! nc->entries)
+    {
+      free(nc);
+      return NULL;
+    }
+
+  nc->set_mask = sets - 1;
+  nc->ttl = ttl;
+  memset(&nc->stats, 0, sizeof(nc->stats));
+
+  return nc;
+}
+
+
+void
+negative_cache_destroy(struct negative_cache *nc)
+{
+  free(nc->entries);
+  free(nc);
+}
+
+
+int
+negative_cache_lookup(struct negative_cache *nc,
+                      const char *prefix, size_t prefix_len,
+                      const char *key, size_t key_len)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  struct negative_entry *set = get_set(nc, hash);
+  int way;
+
+  for (way = 0; way < WAYS; ++way)
+    {
+      if (set[way].hash == hash && set[way].expires > time_ms())
+        {
+          ++nc->stats.hits;
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+
+void
+negative_cache_insert(struct negative_cache *nc,
+                      const char *prefix, size_t prefix_len,
+                      const char *key, size_t key_len)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  struct negative_entry *set = get_set(nc, hash), *victim = set;
+  int way;
+
+  for (way = 0; way < WAYS; ++way)
+    {
+      if (set[way].hash == hash)
+        {
+          victim = &set[way];
+          break;
+        }
+
+      if (set[way].expires < victim->expires)
+        victim = &set[way];
+    }
+
+  victim->hash = hash;
+  victim->expires = time_ms() + nc->ttl;
+
+  ++nc->stats.stores;
+}
+
+
+void
+negative_cache_remove(struct negative_cache *nc,
+                      const char *prefix, size_t prefix_len,
+                      const char *key, size_t key_len)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  struct negative_entry *set = get_set(nc, hash);
+  int way;
+
+  for (way = 0; way < WAYS; ++way)
+    {
+      if (set[way].hash == hash)
+        set[way].expires = 0;
+    }
+}
+
+
+void
+negative_cache_get_stats(struct negative_cache *nc,
+                         struct negative_cache_stats *stats)
+{
+  *stats = nc->stats;
+}
@@ -0,0 +1,70 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef NEGATIVE_CACHE_H
+#define NEGATIVE_CACHE_H 1
+
+#include "client.h"
+#include <stddef.h>
+
+
+struct negative_cache;
+
+
+extern
+struct negative_cache *
+negative_cache_init(size_t size, int ttl);
+
+extern
+void
+negative_cache_destroy(struct negative_cache *nc);
+
+/*
+  negative_cache_lookup() returns 1 if the key was recently found
+  missing, and 0 otherwise.
+*/
+extern
+int
+negative_cache_lookup(struct negative_cache *nc,
+                      const char *prefix, size_t prefix_len,
+                      const char *key, size_t key_len);
+
+extern
+void
+negative_cache_insert(struct negative_cache *nc,
+                      const char *prefix, size_t prefix_len,
+                      const char *key, size_t key_len);
+
+extern
+void
+negative_cache_remove(struct negative_cache *nc,
+                      const char *prefix, size_t prefix_len,
+                      const char *key, size_t key_len);
+
+extern
+void
+negative_cache_get_stats(struct negative_cache *nc,
+                         struct negative_cache_stats *stats);
+
+
+#endif /* ! NEGATIVE_CACHE_H */
@@ -0,0 +1,423 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "shm_cache.h"
+#include "time_ms.h"
+#include "key_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if ! defined(WIN32) && defined(__GNUC__)
+#define HAVE_SHM_CACHE 1
+#include <sys/mman.h>
+#if ! defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS  MAP_ANON
+#endif
+#endif
+
+
+#ifdef HAVE_SHM_CACHE
+
+/*
+  The segment is an array of sets, each of WAYS fixed size slots.  A
+  key may live in any slot of the set selected by its hash.
+
+  Every slot is protected by a sequence lock: a writer makes the
+  sequence odd with compare-and-swap, updates the slot, and makes it
+  even again.  Readers never write to the segment: they copy the value
+  out and retry nothing, treating a sequence that was odd or has
+  changed during the copy as a miss.  A writer that fails to take the
+  lock gives up too, since the cache is only an optimization.
+*/
+
+
+#define WAYS  4
+#define SLOT_ALIGN  64
+#define LOCK_SPINS  1000
+
+
+struct shm_slot
+{
+  volatile unsigned int seq;
+  unsigned int key_len;         /* Prefix and key.  */
+  flags_type flags;
+  value_size_type value_size;
+  key_hash_type hash;
+  time_ms_type expires;
+  char data[1];                 /* Prefix, key, then value.  */
+};
+
+
+struct shm_cache
+{
+  char *segment;
+  size_t segment_size;
+  size_t slot_size;
+  size_t item_size;
+  size_t set_mask;
+  int max_ttl;                  /* 1/1000 sec.  */
+
+  char *buf;                    /* Private copy of the last hit.  */
+
+  struct shared_cache_stats stats;
+};
+
+
+static inline
+struct shm_slot *
+get_slot(struct shm_cache *sc, key_hash_type hash, int way)
+{
+  size_t index = (hash & sc->set_mask) * WAYS + way;
+
+  return (struct shm_slot *) (sc->segment + index * sc->slot_size);
+}
+
+
+static inline
+int
+slot_lock(struct shm_slot *s, int spins)
+{
+  do
+    {
+      unsigned int seq = s->seq;
+
+      /* __sync_bool_compare_and_swap() is a full barrier.  */
+      if (! (seq & 1) && __sync_bool_compare_and_swap(&s->seq, seq, seq + 1))
+        return 0;
+    }
+  while (spins-- > 0);
+
+  return -1;
+}
+
+
+static inline
+void
+slot_unlock(struct shm_slot *s)
+{
+  __sync_synchronize();
+  ++s->seq;
+}
+
+
+static inline
+int
+slot_matches(struct shm_cache *sc, struct shm_slot *s, key_hash_type hash,
+             const char *prefix, size_t prefix_len,
+             const char *key, size_t key_len)
+{
+  return (s->hash == hash
+          && s->key_len == prefix_len + key_len
+          && s->key_len <= sc->item_size
+          && memcmp(s->data, prefix, prefix_len) == 0
+          && memcmp(s->data + prefix_len, key, key_len) == 0);
+}
+
+
+struct shm_cache *
+shm_cache_init(size_t size, size_t item_size, int max_ttl)
+{
+  struct shm_cache *sc;
+  size_t sets;
+  void *segment;
+
+  sc = (struct shm_cache *) malloc(sizeof(struct shm_cache));
+  if (! sc)
+    return NULL;
+
+  sc->slot_size = ((offsetof(struct shm_slot, data) + item_size
+                    + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN);
+
+  /* Round the number of sets down to a power of two.  */
+  sets = 1;
+  while (sets * 2 * WAYS * sc->slot_size <= size)
+    sets *= 2;
+
+  sc->segment_size = sets * WAYS * sc->slot_size;
+  sc->item_size = item_size;
+  sc->set_mask = sets - 1;
+  sc->max_ttl = max_ttl;
+  memset(&sc->stats, 0, sizeof(sc->stats));
+
+  sc->buf = (char *) malloc(item_size);
+  if (! sc->buf)
+    {
+      free(sc);
+      return NULL;
+    }
+
+  /* Anonymous mapping is zero filled, which is an empty cache.  */
+  segment = mmap(NULL, sc->segment_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (segment == MAP_FAILED)
+    {
+      free(sc->buf);
+      free(sc);
+      return NULL;
+    }
+
+  sc->segment = (char *) segment;
+
+  return sc;
+}
+
+
+void
+shm_cache_destroy(struct shm_cache *sc)
+{
+  munmap(sc->segment, sc->segment_size);
+  free(sc->buf);
+  free(sc);
+}
+
+
+void
+shm_cache_clear(struct shm_cache *sc)
+{
+  size_t i, count = (sc->set_mask + 1) * WAYS;
+
+  for (i = 0; i < count; ++i)
+    {
+      struct shm_slot *s =
+        (struct shm_slot *) (sc->segment + i * sc->slot_size);
+
+      if (s->key_len == 0 || slot_lock(s, LOCK_SPINS) != 0)
+        continue;
+
+      s->key_len = 0;
+      s->expires = 0;
+      slot_unlock(s);
+    }
+}
+
+
+int
+shm_cache_lookup(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len,
+                 const void **value, value_size_type *value_size,
+                 flags_type *flags, int *ttl)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  time_ms_type now = time_ms();
+  int way;
+
+  for (way = 0; way < WAYS; ++way)
+    {
+      struct shm_slot *s = get_slot(sc, hash, way);
+      unsigned int seq = s->seq;
+      value_size_type size;
+      time_ms_type expires;
+      flags_type f;
+
+      if (seq & 1)
+        continue;
+
+      __sync_synchronize();
+
+      if (! slot_matches(sc, s, hash, prefix, prefix_len, key, key_len))
+        continue;
+
+      expires = s->expires;
+      size = s->value_size;
+      f = s->flags;
+      if (expires <= now || size > sc->item_size - (prefix_len + key_len))
+        continue;
+
+      memcpy(sc->buf, s->data + prefix_len + key_len, size);
+
+      __sync_synchronize();
+
+      if (s->seq != seq)
+        continue;
+
+      ++sc->stats.hits;
+
+      *value = sc->buf;
+      *value_size = size;
+      *flags = f;
+      *ttl = expires - now;
+
+      return 1;
+    }
+
+  ++sc->stats.misses;
+
+  return 0;
+}
+
+
+void
+shm_cache_insert(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len,
+                 flags_type flags,
+                 const void *value, value_size_type value_size)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  size_t total_len = prefix_len + key_len;
+  time_ms_type now = time_ms();
+  struct shm_slot *victim = NULL;
+  int way;
+
+  if (value_size > sc->item_size || total_len > sc->item_size - value_size)
+    {
+      shm_cache_remove(sc, prefix, prefix_len, key, key_len);
+      return;
+    }
+
+  /*
+    Prefer the slot holding the same key, then an empty or expired
+    slot, then the slot that expires first.  The slots are inspected
+    without the lock, so the choice is only a hint.
+  */
+  for (way = 0; way < WAYS; ++way)
+    {
+      struct shm_slot *s = get_slot(sc, hash, way);
+
+      if (slot_matches(sc, s, hash, prefix, prefix_len, key, key_len))
+        {
+          victim = s;
+          break;
+        }
+
+      if (! victim
+          || (victim->key_len != 0 && victim->expires > now
+              && s->expires < victim->expires))
+        victim = s;
+    }
+
+  if (slot_lock(victim, 0) != 0)
+    return;
+
+  if (victim->key_len != 0 && victim->expires > now
+      && ! slot_matches(sc, victim, hash, prefix, prefix_len, key, key_len))
+    ++sc->stats.evictions;
+
+  victim->key_len = total_len;
+  victim->flags = flags;
+  victim->value_size = value_size;
+  victim->hash = hash;
+  victim->expires = now + sc->max_ttl;
+  memcpy(victim->data, prefix, prefix_len);
+  memcpy(victim->data + prefix_len, key, key_len);
+  memcpy(victim->data + total_len, value, value_size);
+
+  slot_unlock(victim);
+
+  ++sc->stats.stores;
+}
+
+
+void
+shm_cache_remove(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len)
+{
+  key_hash_type hash = key_hash(prefix, prefix_len, key, key_len);
+  int way;
+
+  for (way = 0; way < WAYS; ++way)
+    {
+      struct shm_slot *s = get_slot(sc, hash, way);
+
+      if (s->hash != hash || slot_lock(s, LOCK_SPINS) != 0)
+        continue;
+
+      if (slot_matches(sc, s, hash, prefix, prefix_len, key, key_len))
+        {
+          s->key_len = 0;
+          s->expires = 0;
+        }
+
+      slot_unlock(s);
+    }
+}
+
+
+void
+shm_cache_get_stats(struct shm_cache *sc, struct shared_cache_stats *stats)
+{
+  *stats = sc->stats;
+}
+
+
+#else  /* ! HAVE_SHM_CACHE */
+
+
+struct shm_cache *
+shm_cache_init(size_t size, size_t item_size, int max_ttl)
+{
+  return NULL;
+}
+
+
+void
+shm_cache_destroy(struct shm_cache *sc)
+{
+}
+
+
+void
+shm_cache_clear(struct shm_cache *sc)
+{
+}
+
+
+int
+shm_cache_lookup(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len,
+                 const void **value, value_size_type *value_size,
+                 flags_type *flags, int *ttl)
+{
+  return 0;
+}
+
+
+void
+shm_cache_insert(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len,
+                 flags_type flags,
+                 const void *value, value_size_type value_size)
+{
+}
+
+
+void
+shm_cache_remove(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len)
+{
+}
+
+
+void
+shm_cache_get_stats(struct shm_cache *sc, struct shared_cache_stats *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+
+#endif /* ! HAVE_SHM_CACHE */
@@ -0,0 +1,84 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef SHM_CACHE_H
+#define SHM_CACHE_H 1
+
+#include "client.h"
+#include <stddef.h>
+
+
+struct shm_cache;
+
+
+/*
+  shm_cache_init() maps anonymous shared memory of the given size, so
+  the cache is shared with the processes forked after the call.
+  Returns NULL when out of memory, or when shared cache is not
+  supported on the platform.
+*/
+extern
+struct shm_cache *
+shm_cache_init(size_t size, size_t item_size, int max_ttl);
+
+extern
+void
+shm_cache_destroy(struct shm_cache *sc);
+
+extern
+void
+shm_cache_clear(struct shm_cache *sc);
+
+/*
+  shm_cache_lookup() returns 1 and sets value, value_size, flags and
+  ttl (the time left, in 1/1000 sec) on hit, or returns 0 on miss.
+  The value is a private copy that stays valid until the next lookup.
+*/
+extern
+int
+shm_cache_lookup(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len,
+                 const void **value, value_size_type *value_size,
+                 flags_type *flags, int *ttl);
+
+extern
+void
+shm_cache_insert(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len,
+                 flags_type flags,
+                 const void *value, value_size_type value_size);
+
+extern
+void
+shm_cache_remove(struct shm_cache *sc,
+                 const char *prefix, size_t prefix_len,
+                 const char *key, size_t key_len);
+
+extern
+void
+shm_cache_get_stats(struct shm_cache *sc, struct shared_cache_stats *stats);
+
+
+#endif /* ! SHM_CACHE_H */
@@ -0,0 +1,57 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef TIME_MS_H
+#define TIME_MS_H 1
+
+#ifndef WIN32
+#include <time.h>
+#else  /* WIN32 */
+#include <windows.h>
+#endif  /* WIN32 */
+
+
+typedef long long time_ms_type;
+
+
+/*
+  time_ms() returns monotonic time in 1/1000 sec.  The origin is
+  unspecified, so only differences are meaningful.
+*/
+static inline
+time_ms_type
+time_ms()
+{
+#ifndef WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ((time_ms_type) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#else  /* WIN32 */
+  return GetTickCount64();
+#endif  /* WIN32 */
+}
+
+
+#endif /* ! TIME_MS_H */
@@ -0,0 +1,170 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "utf8_valid.h"
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+
+/*
+  ASCII runs are skipped a block at a time, either with SSE2, or with
+  a word-at-a-time test.  Once a block has a byte with the high bit
+  set, the rest of the block is checked byte by byte, so dense
+  non-ASCII text costs one block test per block, not per character.
+*/
+
+#ifdef HAVE_SSE2
+
+#define BLOCK_SIZE  16
+
+static inline
+int
+block_is_ascii(const unsigned char *p)
+{
+  __m128i v = _mm_loadu_si128((const __m128i *) p);
+  return (_mm_movemask_epi8(v) == 0);
+}
+
+#else  /* ! HAVE_SSE2 */
+
+#define BLOCK_SIZE  8
+
+static inline
+int
+block_is_ascii(const unsigned char *p)
+{
+  unsigned long long v;
+  memcpy(&v, p, sizeof(v));
+  return ((v & 0x8080808080808080ULL) == 0);
+}
+
+#endif /* ! HAVE_SSE2 */
+
+
+/*
+  Check one multibyte sequence that starts at p, and return its
+  length, or 0 if it is ill-formed (see Table 3-7 of the Unicode
+  Standard).
+*/
+static inline
+int
+sequence_length(const unsigned char *p, const unsigned char *end)
+{
+  unsigned char lo = 0x80, hi = 0xbf;
+  int len, i;
+
+  if (*p < 0xc2)
+    return 0;
+  else if (*p < 0xe0)
+    len = 2;
+  else if (*p < 0xf0)
+    len = 3;
+  else if (*p < 0xf5)
+    len = 4;
+  else
+    return 0;
+
+  if (end - p < len)
+    return 0;
+
+  switch (*p)
+    {
+    case 0xe0:
+      lo = 0xa0;
+      break;
+
+    case 0xed:
+      hi = 0x9f;
+      break;
+
+    case 0xf0:
+      lo = 0x90;
+      break;
+
+    case 0xf4:
+      hi = 0x8f;
+      break;
+    }
+
+  if (p[1] < lo || p[1] > hi)
+    return 0;
+
+  for (i = 2; i < len; ++i)
+    {
+      if ((p[i] & 0xc0) != 0x80)
+        return 0;
+    }
+
+  return len;
+}
+
+
+int
+utf8_valid(const char *s, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) s;
+  const unsigned char *end = p + len;
+  int res = 0;
+
+  while (p != end)
+    {
+      const unsigned char *block_end;
+
+      if (end - p >= BLOCK_SIZE)
+        {
+          if (block_is_ascii(p))
+            {
+              p += BLOCK_SIZE;
+              continue;
+            }
+
+          block_end = p + BLOCK_SIZE;
+        }
+      else
+        {
+          block_end = end;
+        }
+
+      while (p < block_end)
+        {
+          if (*p < 0x80)
+            {
+              ++p;
+            }
+          else
+            {
+              int seq_len = sequence_length(p, end);
+              if (seq_len == 0)
+                return -1;
+
+              p += seq_len;
+              res = 1;
+            }
+        }
+    }
+
+  return res;
+}
@@ -0,0 +1,44 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef UTF8_VALID_H
+#define UTF8_VALID_H 1
+
+#include <stddef.h>
+
+
+/*
+  utf8_valid() checks that the buffer is well-formed UTF-8.  Returns
+  0 if the buffer is pure ASCII, 1 if it is valid UTF-8 with some
+  multibyte characters, and -1 otherwise.
+
+  The check is strict: surrogates, overlong forms and code points
+  above U+10FFFF are rejected, so the caller may fall back to a more
+  permissive check when -1 is returned.
+*/
+extern
+int
+utf8_valid(const char *s, size_t len);
+
+
+#endif /* ! UTF8_VALID_H */
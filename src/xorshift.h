@@ -0,0 +1,87 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef XORSHIFT_H
+#define XORSHIFT_H 1
+
+#include "fork_count.h"
+#include "time_ms.h"
+#include <stddef.h>
+#ifndef WIN32
+#include <unistd.h>
+#define xorshift_getpid()  ((unsigned int) getpid())
+#else  /* WIN32 */
+#include <process.h>
+#define xorshift_getpid()  ((unsigned int) _getpid())
+#endif  /* WIN32 */
+
+
+#define XORSHIFT_SEED  2463534242U
+
+
+/*
+  Marsaglia's xorshift32, a fast generator for sampling decisions
+  (not for anything that needs good randomness).  The state should be
+  non-zero.
+*/
+static inline
+unsigned int
+xorshift32(unsigned int *state)
+{
+  unsigned int x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+
+  return (*state = x);
+}
+
+
+/*
+  xorshift_reseed() seeds the state anew when called first, and in a
+  process forked after the last call.  Processes preforked from one
+  parent would otherwise make the same choices in lockstep.  fork
+  should be zero initially, and salt tells apart generators of one
+  process.  Forks are told by fork_count(), so the process id is only
+  read when reseeding.
+*/
+static inline
+void
+xorshift_reseed(unsigned int *state, unsigned int *fork, const void *salt)
+{
+  unsigned int now = fork_count(), seed;
+
+  if (*fork == now)
+    return;
+
+  seed = xorshift_getpid() * 2654435761U;
+  seed ^= (unsigned int) time_ms();
+  seed ^= (unsigned int) ((size_t) salt >> 4) * 2246822519U;
+
+  *fork = now;
+  *state = (seed != 0 ? seed : XORSHIFT_SEED);
+}
+
+
+#endif /* ! XORSHIFT_H */
@@ -0,0 +1,254 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "xxhash.h"
+#include <string.h>
+
+
+#define PRIME64_1  0x9E3779B185EBCA87ULL
+#define PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3  0x165667B19E3779F9ULL
+#define PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define PRIME64_5  0x27D4EB2F165667C5ULL
+
+
+#define rotl64(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+
+/*
+  Compilers turn these into a single load on little-endian machines
+  that allow unaligned access.
+*/
+static inline
+unsigned long long
+read64(const unsigned char *p)
+{
+  return ((unsigned long long) p[0]
+          | ((unsigned long long) p[1] << 8)
+          | ((unsigned long long) p[2] << 16)
+          | ((unsigned long long) p[3] << 24)
+          | ((unsigned long long) p[4] << 32)
+          | ((unsigned long long) p[5] << 40)
+          | ((unsigned long long) p[6] << 48)
+          | ((unsigned long long) p[7] << 56));
+}
+
+
+static inline
+unsigned long long
+read32(const unsigned char *p)
+{
+  return ((unsigned long long) p[0]
+          | ((unsigned long long) p[1] << 8)
+          | ((unsigned long long) p[2] << 16)
+          | ((unsigned long long) p[3] << 24));
+}
+
+
+static inline
+unsigned long long
+round64(unsigned long long acc, unsigned long long input)
+{
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+
+  return acc * PRIME64_1;
+}
+
+
+static inline
+unsigned long long
+merge_round64(unsigned long long acc, unsigned long long val)
+{
+  acc ^= round64(0, val);
+
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+
+static inline
+unsigned long long
+converge64(unsigned long long v1, unsigned long long v2,
+           unsigned long long v3, unsigned long long v4)
+{
+  unsigned long long h;
+
+  h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+  h = merge_round64(h, v1);
+  h = merge_round64(h, v2);
+  h = merge_round64(h, v3);
+  h = merge_round64(h, v4);
+
+  return h;
+}
+
+
+/*
+  Hash the last len % 32 bytes, and mix the bits of the result.
+*/
+static inline
+unsigned long long
+finalize64(unsigned long long h,
+           const unsigned char *p, const unsigned char *end)
+{
+  while (p + 8 <= end)
+    {
+      h ^= round64(0, read64(p));
+      h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+      p += 8;
+    }
+
+  if (p + 4 <= end)
+    {
+      h ^= read32(p) * PRIME64_1;
+      h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+      p += 4;
+    }
+
+  while (p < end)
+    {
+      h ^= *p * PRIME64_5;
+      h = rotl64(h, 11) * PRIME64_1;
+      ++p;
+    }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+
+unsigned long long
+xxh64(const char *s, size_t len, unsigned long long seed)
+{
+  const unsigned char *p = (const unsigned char *) s;
+  const unsigned char *end = p + len;
+  unsigned long long h;
+
+  if (len >= 32)
+    {
+      const unsigned char *limit = end - 32;
+      unsigned long long v1 = seed + PRIME64_1 + PRIME64_2;
+      unsigned long long v2 = seed + PRIME64_2;
+      unsigned long long v3 = seed;
+      unsigned long long v4 = seed - PRIME64_1;
+
+      do
+        {
+          v1 = round64(v1, read64(p));
+          v2 = round64(v2, read64(p + 8));
+          v3 = round64(v3, read64(p + 16));
+          v4 = round64(v4, read64(p + 24));
+          p += 32;
+        }
+      while (p <= limit);
+
+      h = converge64(v1, v2, v3, v4);
+    }
+  else
+    {
+      h = seed + PRIME64_5;
+    }
+
+  h += len;
+
+  return finalize64(h, p, end);
+}
+
+
+static inline
+void
+stripe64(struct xxh64_ctx *ctx, const unsigned char *p)
+{
+  ctx->v1 = round64(ctx->v1, read64(p));
+  ctx->v2 = round64(ctx->v2, read64(p + 8));
+  ctx->v3 = round64(ctx->v3, read64(p + 16));
+  ctx->v4 = round64(ctx->v4, read64(p + 24));
+}
+
+
+void
+xxh64_init(struct xxh64_ctx *ctx, unsigned long long seed)
+{
+  ctx->v1 = seed + PRIME64_1 + PRIME64_2;
+  ctx->v2 = seed + PRIME64_2;
+  ctx->v3 = seed;
+  ctx->v4 = seed - PRIME64_1;
+  ctx->seed = seed;
+  ctx->total_len = 0;
+}
+
+
+/*
+  The buffer holds total_len % 32 bytes, the rest went to the stripes.
+*/
+void
+xxh64_update(struct xxh64_ctx *ctx, const char *s, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) s;
+  const unsigned char *end = p + len;
+  size_t used = ctx->total_len % 32;
+
+  ctx->total_len += len;
+
+  if (used + len < 32)
+    {
+      memcpy(ctx->buffer + used, p, len);
+      return;
+    }
+
+  if (used > 0)
+    {
+      memcpy(ctx->buffer + used, p, 32 - used);
+      p += 32 - used;
+      stripe64(ctx, ctx->buffer);
+    }
+
+  while (p + 32 <= end)
+    {
+      stripe64(ctx, p);
+      p += 32;
+    }
+
+  memcpy(ctx->buffer, p, end - p);
+}
+
+
+unsigned long long
+xxh64_final(const struct xxh64_ctx *ctx)
+{
+  unsigned long long h;
+
+  if (ctx->total_len >= 32)
+    h = converge64(ctx->v1, ctx->v2, ctx->v3, ctx->v4);
+  else
+    h = ctx->seed + PRIME64_5;
+
+  h += ctx->total_len;
+
+  return finalize64(h, ctx->buffer, ctx->buffer + ctx->total_len % 32);
+}
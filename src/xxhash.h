@@ -0,0 +1,66 @@
+/*
+  Copyright (C) 2007-2010 Tomash Brechko.  All rights reserved.
+
+  When used to build Perl module:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the same terms as Perl itself, either Perl version 5.8.8
+  or, at your option, any later version of Perl 5 you may have
+  available.
+
+  When used as a standalone library:
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#ifndef XXHASH_H
+#define XXHASH_H 1
+
+#include <stddef.h>
+
+
+/*
+  XXH64 by Yann Collet, http://cyan4973.github.io/xxHash/.  The result
+  is the same on all platforms.
+*/
+extern
+unsigned long long
+xxh64(const char *s, size_t len, unsigned long long seed);
+
+
+/*
+  Streaming XXH64, for data that comes in parts.  The result is the
+  same as of xxh64() of all the parts joined.  A context may be copied
+  to hash different data after a common beginning.
+*/
+struct xxh64_ctx
+{
+  unsigned long long v1, v2, v3, v4;
+  unsigned long long seed;
+  unsigned long long total_len;
+  unsigned char buffer[32];
+};
+
+
+extern
+void
+xxh64_init(struct xxh64_ctx *ctx, unsigned long long seed);
+
+extern
+void
+xxh64_update(struct xxh64_ctx *ctx, const char *s, size_t len);
+
+extern
+unsigned long long
+xxh64_final(const struct xxh64_ctx *ctx);
+
+
+#endif /* ! XXHASH_H */
@@ -0,0 +1,51 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+# The second server is down, so reads from it are misses.
+my %params = (
+    %Memd::params,
+    servers      => [ '127.0.0.1:11211', '127.0.0.1:1' ],
+    max_failures => 0,
+);
+
+my $plain = CLASS->new( \%params );
+
+my %keys;
+push @{ $keys{ $plain->servers_for_keys( [$_] )->[0] } }, $_
+    for map "bl$_", 1 .. 200;
+my ( $live, $dead ) = @keys{ 0, 1 };
+
+my $bounded = CLASS->new(
+    {   %params,
+        bounded_load    => 0.25,
+        replicated_keys => [ $live->[0] ],
+    }
+);
+
+ok $plain->set( $_ => 1 ), 'set' for @$live[ 0, 1 ];
+
+# Load the live server with reads of a key that is not replicated.
+is [ map { $bounded->get( $live->[1] ) } 1 .. 100 ], [ (1) x 100 ],
+    'not replicated keys stay on their server';
+
+# Now the dead server has the room, and the replicated key goes there.
+my $hits = grep {defined} map { $bounded->get( $live->[0] ) } 1 .. 20;
+ok $hits <= 5, 'replicated key moves to a free replica'
+    or diag "$hits hits";
+
+# Load the dead server, and the replicated key stays on the live one.
+$bounded->get_multi(@$dead) for 1 .. 3;
+is [ map { $bounded->get( $live->[0] ) } 1 .. 20 ], [ (1) x 20 ],
+    'full replicas are skipped';
+
+is [ map { $bounded->gets( $live->[0] )->[1] } 1 .. 10 ], [ (1) x 10 ],
+    'gets is not moved';
+
+like dies { CLASS->new( { %params, bounded_load => -1 } ) },
+    qr/^bounded_load should not be negative/;
+
+$plain->delete_multi( @$live[ 0, 1 ] );
+
+done_testing;
@@ -0,0 +1,131 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my $chunked = CLASS->new(
+    {   %Memd::params,
+        chunk_size         => 64 * 1024,
+        max_size           => 8 * 1024 * 1024,
+        compress_threshold => -1,
+    }
+);
+
+# Incompressible value over the 1MB item limit.
+my $big = join '', map chr( int rand 256 ), 1 .. 3 * 1024 * 1024 + 17;
+
+ok $chunked->set( chunk1 => $big ), 'set';
+ok $chunked->get('chunk1') eq $big, 'get';
+like $memd->get('chunk1'), qr/^[0-9a-f]+ 0 \d+ 65536 49\z/,
+    'clients without chunk_size return the manifest';
+
+ok $chunked->set( chunk2 => 'small' );
+my $res = $chunked->get_multi(qw/chunk1 chunk2 chunk3/);
+is [ sort keys %$res ], [qw/chunk1 chunk2/];
+ok $res->{chunk1} eq $big, 'get_multi';
+is $res->{chunk2}, 'small';
+
+my $ref = { list => [ ('x') x 100_000 ] };
+ok $chunked->set( chunk3 => $ref );
+is $chunked->get('chunk3'), $ref, 'serialized';
+
+subtest cas => sub {
+    my $cas_val = $chunked->gets('chunk1');
+    ok $cas_val->[1] eq $big;
+
+    my $rev = reverse $big;
+    ok $chunked->cas( chunk1 => $cas_val->[0], $rev );
+    ok !$chunked->cas( chunk1 => $cas_val->[0], $big ), 'stale cas';
+    ok $chunked->get('chunk1') eq $rev;
+};
+
+SKIP: {
+    skip 'memcached 1.5.3 is required for gat', 1 if $memd_version < v1.5.3;
+
+    ok $chunked->gat( 100, 'chunk3' ), 'gat';
+}
+
+ok !$chunked->add( chunk1 => $big ), 'add';
+ok $chunked->replace( chunk1 => $big ), 'replace';
+ok $chunked->get('chunk1') eq $big;
+
+ok !$chunked->set( chunk4 => 'x' x ( 8 * 1024 * 1024 + 1 ) ),
+    'max_size limits the whole value';
+
+# Key of chunk $n of $key, "{n:hash}key".
+sub chunk_key {
+    my ( $key, $n ) = @_;
+
+    use integer;
+    my $hash = -3750763034362895579;    # FNV-1a 64 offset basis.
+    $hash = ( $hash ^ ord ) * 1099511628211 for split //, $key;
+
+    return sprintf '{%d:%08x}%s', $n, $hash & 0xffffffff, $key;
+}
+
+subtest 'chunk keys' => sub {
+    ok $memd->touch( chunk_key( 'chunk1', 48 ) ), 'last chunk';
+    ok !$memd->touch( chunk_key( 'chunk1', 49 ) ), 'no more';
+
+    my $long = 'k' x ( 250 - length( $memd->namespace ) - 12 );
+    my $mid  = substr $big, 0, 700 * 1024;    # 11 chunks, under 1MB.
+    ok $chunked->set( $long => $mid ), 'chunk key over the limit';
+    ok $memd->get($long) eq $mid,      'stored whole';
+    ok $chunked->get($long) eq $mid;
+    ok $chunked->delete($long);
+    ok $chunked->set( substr( $long, 1 ) => $big ), 'chunk key at the limit';
+    like $memd->get( substr( $long, 1 ) ), qr/^[0-9a-f]+ 0 /, 'chunked';
+    ok $chunked->delete( substr( $long, 1 ) );
+};
+
+subtest delete => sub {
+    ok $chunked->delete('chunk1');
+    ok !$memd->touch( chunk_key( 'chunk1', $_ ) ), "chunk $_" for 0, 48;
+
+    ok $chunked->set( chunk1 => $big );
+    is $chunked->delete_multi(qw/chunk1 chunk4/),
+        { chunk1 => 1, chunk4 => '' };
+    ok !$memd->touch( chunk_key( 'chunk1', 0 ) ), 'delete_multi';
+};
+
+subtest 'failed chunk' => sub {
+    my $dead = CLASS->new(
+        {   %Memd::params,
+            servers    => [ '127.0.0.1:11211', '127.0.0.1:1' ],
+            chunk_size => 64 * 1024,
+            max_size   => 8 * 1024 * 1024,
+        }
+    );
+    my ($key) = @{ $dead->keys_by_server( [ map {"chunk_f$_"} 1 .. 20 ] )
+            ->{'127.0.0.1:11211'} };
+
+    ok !$dead->set( $key => $big ), 'set';
+    ok !$dead->set_multi( [ $key => $big ] )->{$key}, 'set_multi';
+    is [ $dead->set_multi( [ $key => $big ], [ chunk_f => 1 ] ) ],
+        [ undef, 1 ], 'results of the chunks are dropped';
+    $memd->delete($key);
+};
+
+subtest 'hash tags' => sub {
+    my $tagged = CLASS->new(
+        {   %Memd::params,
+            servers    => [ map {"127.0.0.1:$_"} 1 .. 4 ],
+            chunk_size => 64 * 1024,
+            hash_tags  => 1,
+        }
+    );
+    my @keys = map { chunk_key( 'user:{1}:data', $_ ) } 0 .. 20;
+
+    ok keys %{ $tagged->keys_by_server( \@keys ) } > 1, 'chunks spread';
+};
+
+subtest 'invalid manifest' => sub {
+    my $small = CLASS->new( { %Memd::params, chunk_size => 64 * 1024 } );
+
+    ok $chunked->set( chunk5 => $big );
+    is $small->get('chunk5'), $memd->get('chunk5'), 'over max_size';
+};
+
+$memd->delete_multi(qw/chunk2 chunk3 chunk5/);
+
+done_testing;
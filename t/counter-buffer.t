@@ -0,0 +1,92 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+use Time::HiRes 'sleep';
+
+my $cnt = CLASS->new(
+    {   %Memd::params,
+        counter_buffer_size    => 3,
+        counter_flush_interval => 0.5,
+    }
+);
+
+ok $memd->set_multi( [ cnt1 => 10 ], [ cnt2 => 10 ], [ cnt3 => 10 ] );
+
+$cnt->incr('cnt1') for 1 .. 5;
+$cnt->decr( 'cnt1', 2 );
+$cnt->incr( 'cnt2', 7 );
+
+is $memd->get_multi(qw/cnt1 cnt2/), { cnt1 => 10, cnt2 => 10 },
+    'deltas are buffered';
+
+is $cnt->incr('cnt2'), 18, 'non-void incr includes the buffered delta';
+
+$cnt->flush_counters;
+$cnt->server_versions;
+is $memd->get_multi(qw/cnt1 cnt2/), { cnt1 => 13, cnt2 => 18 },
+    'flush_counters';
+
+subtest 'size threshold' => sub {
+    $cnt->incr_multi(qw/cnt1 cnt2/);
+    is $memd->get('cnt1'), 13;
+
+    # The third key fills the buffer, and it is flushed with the call.
+    $cnt->incr('cnt3');
+    $cnt->server_versions;    # Wait for the void context flush.
+    is $memd->get_multi(qw/cnt1 cnt2 cnt3/),
+        { cnt1 => 14, cnt2 => 19, cnt3 => 11 };
+};
+
+subtest 'time threshold' => sub {
+    $cnt->decr('cnt3');
+    is $cnt->get('cnt3'), 11;
+
+    sleep 0.6;
+
+    # Any request flushes the due buffer.
+    is $cnt->get('cnt4'), undef;
+    is $memd->get('cnt3'), 10;
+};
+
+subtest destructor => sub {
+    my $tmp = CLASS->new( { %Memd::params, counter_buffer_size => 100 } );
+
+    $tmp->incr( 'cnt1', 6 );
+    undef $tmp;
+
+    is $memd->get('cnt1'), 20;
+};
+
+subtest namespace => sub {
+    my $ns = $cnt->namespace;
+
+    $cnt->incr( 'cnt1', 2 );
+    $cnt->namespace('other:');
+    $cnt->incr( 'cnt1', 100 );
+    $cnt->namespace($ns);
+    $cnt->flush_counters;
+    $cnt->server_versions;
+
+    is $memd->get('cnt1'), 22, 'queued with the old namespace';
+};
+
+subtest fork => sub {
+    my $tmp = CLASS->new( { %Memd::params, counter_buffer_size => 100 } );
+
+    $tmp->incr( 'cnt1', 3 );
+
+    my $pid = fork // die "fork: $!";
+    if ( $pid == 0 ) {
+        undef $tmp;
+        exit 0;
+    }
+    waitpid $pid, 0;
+    undef $tmp;
+
+    is $memd->get('cnt1'), 25, 'the child does not flush the deltas';
+};
+
+$memd->delete_multi(qw/cnt1 cnt2 cnt3/);
+
+done_testing;
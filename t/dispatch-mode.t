@@ -0,0 +1,126 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my @keys    = map {"key$_"} 1 .. 3000;
+my @servers = map { { address => "127.0.0.1:$_", weight => 1 } } 1 .. 10;
+$servers[3]{weight} = 2;
+
+like dies { CLASS->new( { servers => \@servers, dispatch_mode => 'none' } ) },
+    qr/Unknown dispatch_mode 'none'/, 'unknown mode';
+
+for my $mode (qw(ketama jump rendezvous maglev ketama_md5)) {
+    subtest $mode => sub {
+        my %params = ( dispatch_mode => $mode, ketama_points => 150 );
+
+        my $memd = CLASS->new( { servers => \@servers, %params } );
+        my @indexes = @{ $memd->servers_for_keys(\@keys) };
+
+        my @count = (0) x @servers;
+        ++$count[$_] foreach @indexes;
+        ok !( grep { $_ < 200 || $_ > 600 } @count[ 0 .. 2, 4 .. 9 ] ),
+            'balanced';
+        ok $count[3] > 450 && $count[3] < 900, 'weighted';
+
+        # A fresh client dispatches the same way.
+        my $again = CLASS->new( { servers => \@servers, %params } );
+        is $again->servers_for_keys(\@keys), \@indexes, 'stable';
+
+        # Adding a server at the end moves keys only to it, except
+        # for Maglev and libmemcached, which move a few others as well.
+        my $new   = { address => '127.0.0.1:11', weight => 1 };
+        my $grown = CLASS->new( { servers => [ @servers, $new ], %params } );
+        my @grown = @{ $grown->servers_for_keys(\@keys) };
+        my $moved = grep { $indexes[$_] != $grown[$_] } 0 .. $#keys;
+        my $lost  = grep { $indexes[$_] != $grown[$_] && $grown[$_] != 10 }
+            0 .. $#keys;
+        ok $moved > 100 && $moved < 500, 'consistent';
+        ok $lost <= ( $mode =~ /maglev|md5/ ? 60 : 0 ),
+            'moved to the new server';
+
+        my $single = CLASS->new(
+            { servers => [ $servers[0] ], dispatch_mode => $mode } );
+        is $single->servers_for_keys( [qw/a b c/] ), [ 0, 0, 0 ],
+            'one server';
+    };
+}
+
+# Computed with an independent implementation of update_continuum()
+# from libmemcached.
+subtest 'libmemcached compatibility' => sub {
+    my $memd = CLASS->new(
+        {   dispatch_mode => 'ketama_md5',
+            servers       => [
+                { address => '10.0.0.1:11211',           weight => 1 },
+                { address => '10.0.0.2:11211',           weight => 1 },
+                { address => '10.0.0.3:11212',           weight => 2 },
+                { address => 'cache4.example.com:11211', weight => 3 },
+                { address => '10.0.0.5:22122',           weight => 1 },
+            ],
+        }
+    );
+    is $memd->servers_for_keys( [ map {"key$_"} 0 .. 39 ] ),
+        [ qw(2 2 3 3 2 3 0 0 2 2 1 2 4 2 3 2 2 2 4 3),
+          qw(3 3 2 1 1 1 4 2 2 3 3 3 2 3 3 4 2 4 2 4) ];
+};
+
+like dies { CLASS->new( { servers => \@servers, hash_function => 'md4' } ) },
+    qr/Unknown hash_function 'md4'/, 'unknown hash function';
+
+subtest xxh64 => sub {
+    my %params = ( servers => \@servers, ketama_points => 150 );
+    my $crc32 = CLASS->new( \%params );
+    my $xxh64 = CLASS->new( { %params, hash_function => 'xxh64' } );
+
+    my @crc32 = @{ $crc32->servers_for_keys(\@keys) };
+    my @xxh64 = @{ $xxh64->servers_for_keys(\@keys) };
+    isnt \@xxh64, \@crc32, 'different mapping';
+
+    my @count = (0) x @servers;
+    ++$count[$_] foreach @xxh64;
+    ok !( grep { $_ < 200 || $_ > 600 } @count[ 0 .. 2, 4 .. 9 ] ),
+        'balanced';
+
+    my $memd = CLASS->new( { %Memd::params, hash_function => 'xxh64' } );
+    ok $memd->set( dispatch_xxh64 => 1 ), 'set';
+    is $memd->get('dispatch_xxh64'), 1, 'get';
+    ok $memd->delete('dispatch_xxh64'), 'delete';
+};
+
+# Keys of different lengths dispatched in a batch go where they go
+# one at a time.
+subtest batch => sub {
+    my @mixed = map { 'k' x ( $_ % 40 ) . $_ } 1 .. 500;
+
+    for my $mode (qw(ketama jump rendezvous maglev ketama_md5)) {
+        for my $hash (qw(crc32 xxh64)) {
+            for my $points ( 0, 150 ) {
+                my $memd = CLASS->new(
+                    {   servers        => \@servers,
+                        dispatch_mode  => $mode,
+                        hash_function  => $hash,
+                        ketama_points  => $points,
+                        namespace      => 'ns:',
+                        hash_namespace => 1,
+                    }
+                );
+                is $memd->servers_for_keys(\@mixed),
+                    [ map { $memd->servers_for_keys( [$_] )->[0] } @mixed ],
+                    "$mode $hash $points";
+            }
+        }
+    }
+};
+
+# Requests work in every mode.
+for my $mode (qw(jump rendezvous maglev ketama_md5)) {
+    my $memd = CLASS->new( { %Memd::params, dispatch_mode => $mode } );
+    ok $memd->set( "dispatch_$mode" => $mode ), "$mode: set";
+    is $memd->get("dispatch_$mode"), $mode, "$mode: get";
+    is $memd->get_multi( "dispatch_$mode", 'dispatch_none' ),
+        { "dispatch_$mode" => $mode }, "$mode: get_multi";
+    ok $memd->delete("dispatch_$mode"), "$mode: delete";
+}
+
+done_testing;
@@ -0,0 +1,98 @@
+use lib 't';
+
+use File::Temp 'tempdir';
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my $dir     = tempdir( CLEANUP => 1 );
+my @keys    = map {"key$_"} 1 .. 2000;
+my @servers = map { { address => "127.0.0.1:$_", weight => 1 } } 1 .. 20;
+$servers[3]{weight} = 2;
+
+for my $mode (qw(ketama compatible jump rendezvous maglev ketama_md5)) {
+    subtest $mode => sub {
+        my $path   = "$dir/$mode";
+        my %params = (
+            servers       => \@servers,
+            dispatch_mode => ( $mode eq 'compatible' ? 'ketama' : $mode ),
+            ketama_points => ( $mode eq 'compatible' ? 0        : 150 ),
+        );
+        my $expected = CLASS->new( \%params )->servers_for_keys(\@keys);
+
+        my $writer
+            = CLASS->new( { %params, dispatch_snapshot => $path } );
+        ok -s $path, 'written';
+        is $writer->servers_for_keys(\@keys), $expected, 'writer';
+
+        my $id     = join ':', ( stat $path )[ 0, 1, 9 ];
+        my $reader = CLASS->new( { %params, dispatch_snapshot => $path } );
+        is join( ':', ( stat $path )[ 0, 1, 9 ] ), $id, 'not rewritten';
+        is $reader->servers_for_keys(\@keys), $expected, 'reader';
+
+        # Different weights don't match the file.
+        my @heavy = map { {%$_} } @servers;
+        $heavy[0]{weight} = 3;
+        my $other = CLASS->new( { %params, servers => \@heavy } );
+        my $rewritten = CLASS->new(
+            { %params, servers => \@heavy, dispatch_snapshot => $path } );
+        is $rewritten->servers_for_keys(\@keys),
+            $other->servers_for_keys(\@keys), 'rewritten';
+        is $reader->servers_for_keys(\@keys), $expected,
+            'mapped file is not changed';
+    };
+}
+
+subtest 'bad file' => sub {
+    my $path = "$dir/bad";
+    open my $fh, '>', $path or die;
+    print $fh 'x' x 100;
+    close $fh;
+
+    my %params = ( servers => \@servers, ketama_points => 150 );
+    my $memd = CLASS->new( { %params, dispatch_snapshot => $path } );
+    is $memd->servers_for_keys(\@keys),
+        CLASS->new( \%params )->servers_for_keys(\@keys), 'rebuilt';
+    ok -s $path > 100, 'replaced';
+};
+
+# A header of the right digest with a body that doesn't fit the servers.
+for my $field (qw(index jump_shift)) {
+    subtest "bad $field" => sub {
+        my $path   = "$dir/$field";
+        my %params = ( servers => \@servers, ketama_points => 150 );
+        CLASS->new( { %params, dispatch_snapshot => $path } );
+
+        open my $fh, '+<:raw', $path or die;
+        read $fh, my $header, 40 or die;
+        my ( $points, undef, $shift ) = unpack 'x24 l3', $header;
+        if ( $field eq 'index' ) {
+            seek $fh, 40 + $points * 4, 0;
+            print $fh pack 'l', scalar @servers;
+        }
+        else {
+            seek $fh, 32, 0;
+            print $fh pack 'l', $shift - 1;
+        }
+        close $fh;
+
+        my $memd = CLASS->new( { %params, dispatch_snapshot => $path } );
+        is $memd->servers_for_keys(\@keys),
+            CLASS->new( \%params )->servers_for_keys(\@keys), 'rebuilt';
+    };
+}
+
+is [ grep { !/^\w+$/ } map { s{.*/}{}r } glob "$dir/*" ], [],
+    'no temporary files left';
+
+like dies {
+    CLASS->new(
+        { servers => \@servers, dispatch_snapshot => "$dir/none/file" } )
+}, qr/^Can't use dispatch snapshot/;
+
+my $memd = CLASS->new(
+    { %Memd::params, dispatch_snapshot => "$dir/requests" } );
+ok $memd->set( dispatch_snapshot => 1 ), 'set';
+is $memd->get('dispatch_snapshot'), 1, 'get';
+ok $memd->delete('dispatch_snapshot'), 'delete';
+
+done_testing;
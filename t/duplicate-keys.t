@@ -0,0 +1,30 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+# hot_keys counts every key sent to the servers.
+my $dup = CLASS->new( { %Memd::params, hot_keys => 10, hot_keys_sample => 1 } );
+
+ok $memd->set_multi( [ dup1 => 1 ], [ dup2 => 2 ] );
+$memd->delete('dup3');
+
+is $dup->get_multi(qw/dup1 dup2 dup1 dup3 dup1 dup3/), { dup1 => 1, dup2 => 2 };
+is $dup->gets_multi(qw/dup2 dup2/)->{dup2}[1], 2, 'gets_multi';
+
+my %count = map { $_->{key} => $_->{count} } @{ $dup->hot_keys };
+is [ @count{qw/dup1 dup2 dup3/} ], [ 1, 2, 1 ], 'duplicates are sent once';
+
+is [ $dup->touch_multi( [ dup1 => 100 ], [ dup3 => 100 ], [ dup1 => 100 ] ) ],
+    [ 1, '', 1 ], 'touch_multi results are fanned out';
+
+is [ $dup->delete_multi(qw/dup1 dup2 dup1 dup2 dup3/) ], [ 1, 1, 1, 1, '' ],
+    'delete_multi results are fanned out';
+is $dup->delete_multi(qw/dup1 dup1/), { dup1 => '' }, 'scalar context';
+
+%count = map { $_->{key} => $_->{count} } @{ $dup->hot_keys };
+is [ @count{qw/dup1 dup2 dup3/} ], [ 4, 3, 3 ];
+
+is $dup->get_multi( 'dup1', 'dup1' ), {}, 'next batch';
+
+done_testing;
@@ -0,0 +1,41 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my @servers = map {"127.0.0.1:$_"} 1 .. 10;
+
+for my $mode (qw(ketama jump rendezvous maglev ketama_md5)) {
+    subtest $mode => sub {
+        my %params = ( servers => \@servers, dispatch_mode => $mode );
+        my $plain  = CLASS->new( \%params );
+        my $tagged = CLASS->new( { %params, hash_tags => 1 } );
+
+        my @related = map {"user:{123}:$_"} 1 .. 50;
+        my @indexes = @{ $tagged->servers_for_keys(\@related) };
+        is \@indexes, [ ( $tagged->servers_for_keys( ['123'] )->[0] ) x 50 ],
+            'the tag is hashed';
+        is [ map { $tagged->servers_for_keys( [$_] )->[0] } @related ],
+            \@indexes, 'one at a time';
+
+        my %spread;
+        @spread{ @{ $plain->servers_for_keys(\@related) } } = ();
+        ok keys %spread > 1, 'spread without hash_tags';
+
+        my @untagged = ( map( "key$_", 1 .. 100 ), 'a{}b', 'a{b', 'a}{b' );
+        is $tagged->servers_for_keys(\@untagged),
+            $plain->servers_for_keys(\@untagged), 'no tag';
+
+        is $tagged->servers_for_keys( [ 'x{1}{2}', 'x{1}y}', '{{1}' ] ),
+            $plain->servers_for_keys( [ '1', '1', '{1' ] ), 'first tag';
+    };
+}
+
+my $memd = CLASS->new( { %Memd::params, hash_tags => 1 } );
+ok $memd->set( "tag:{1}:$_" => $_ ), 'set' for 1 .. 3;
+is $memd->get_multi( map "tag:{1}:$_", 1 .. 3 ),
+    { map { ( "tag:{1}:$_" => $_ ) } 1 .. 3 }, 'get_multi';
+is $memd->delete_multi( map "tag:{1}:$_", 1 .. 3 ),
+    { map { ( "tag:{1}:$_" => 1 ) } 1 .. 3 }, 'delete_multi';
+
+done_testing;
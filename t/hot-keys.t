@@ -0,0 +1,66 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+is $memd->hot_keys, [], 'disabled by default';
+
+my $hot = CLASS->new(
+    { %Memd::params, hot_keys => 4, hot_keys_sample => 1 } );
+
+# A zipf-like mix: hot1 dominates, then hot2, plus many cold keys.
+# Keys repeated within one get_multi are sent once, so use get.
+my @keys = ( ('hot1') x 50, ('hot2') x 20, map "cold$_", 1 .. 40 );
+$hot->get($_) for (@keys) x 3;
+
+my $top = $hot->hot_keys;
+
+is scalar @$top, 4;
+is [ map $_->{key}, @$top[ 0, 1 ] ], [qw/hot1 hot2/];
+
+is $top->[0]{count}, 150;
+is $top->[0]{error}, 0;
+ok $top->[0]{rate} > 0;
+ok grep $_ eq $top->[0]{server}, keys %{ $hot->server_versions };
+
+is scalar @{ $hot->hot_keys(1) }, 1, 'limit';
+
+subtest sampling => sub {
+    my $sampled = CLASS->new(
+        { %Memd::params, hot_keys => 10, hot_keys_sample => 10 } );
+
+    $sampled->get($_) for ( ('hot') x 100, map "cold$_", 1 .. 100 ) x 10;
+
+    my $top = $sampled->hot_keys;
+
+    is $top->[0]{key}, 'hot';
+    ok $top->[0]{count} > 500 && $top->[0]{count} < 2000,
+        'count is scaled by the sampling rate';
+};
+
+subtest 'server changes' => sub {
+    my @servers = map {"127.0.0.1:$_"} 1 .. 4;
+    my $moved   = CLASS->new(
+        {   servers         => \@servers,
+            hot_keys        => 20,
+            hot_keys_sample => 1,
+            connect_timeout => 0.1,
+        }
+    );
+    my @keys = map "moved$_", 1 .. 20;
+    $moved->get($_) for @keys;
+
+    my %server = map { ( $_->{key} => $_->{server} ) } @{ $moved->hot_keys };
+    is [ sort keys %server ], [ sort @keys ], 'tracked';
+
+    ok $moved->remove_server( $servers[1] ), 'remove_server';
+    $server{$_} = undef for grep { $server{$_} eq $servers[1] } @keys;
+    is { map { ( $_->{key} => $_->{server} ) } @{ $moved->hot_keys } },
+        \%server, 'removed server';
+
+    $moved->set_servers( [ @servers[ 3, 2, 0 ] ] );
+    is { map { ( $_->{key} => $_->{server} ) } @{ $moved->hot_keys } },
+        \%server, 'reordered servers';
+};
+
+done_testing;
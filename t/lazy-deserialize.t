@@ -0,0 +1,47 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my $memd = CLASS->new( { %Memd::params, lazy_deserialize => 1 } );
+
+my %hash   = ( a => 'a', b => [ 1, 2 ] );
+my $string = 'Кириллица в UTF-8 🐪';
+my $big    = 'x' x 2000;
+
+ok $memd->set_multi(
+    [ hash   => \%hash ],
+    [ string => $string ],
+    [ big    => $big ],
+    [ plain  => 'plain' ],
+);
+
+my $res = $memd->get_multi(qw/hash string big plain/);
+
+is [ sort keys %$res ], [qw/big hash plain string/], 'all keys present';
+
+is $res->{hash},   \%hash,  'deserialized on access';
+is $res->{string}, $string, 'decoded on access';
+is $res->{big},    $big,    'decompressed on access';
+is $res->{plain},  'plain', 'plain value';
+
+$res = $memd->get_multi('hash');
+$res->{hash} = 'overwritten';
+is $res->{hash}, 'overwritten', 'assignment before access';
+
+$res = $memd->gets_multi('hash');
+is $res->{hash}[1], \%hash, 'gets_multi()';
+
+subtest prepend => sub {
+    plan skip_all => 'memcached 1.2.4 is required' if $memd_version < v1.2.4;
+
+    ok $memd->prepend( hash => 'garbage' ), 'prepend()';
+
+    my $res = $memd->get_multi('hash');
+    ok exists $res->{hash}, 'undecodable value is present';
+    is $res->{hash}, undef, 'and reads as undef';
+};
+
+$memd->delete_multi(qw/hash string big plain/);
+
+done_testing;
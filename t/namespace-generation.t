@@ -0,0 +1,51 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+use Time::HiRes 'sleep';
+
+my $ns = $Memd::params{namespace};
+
+my %params = (
+    %Memd::params,
+    namespace_generation_key => 'gen',
+    namespace_generation_ttl => 0.3,
+);
+
+$memd->delete('gen');
+
+my $gen   = CLASS->new( \%params );
+my $other = CLASS->new( \%params );
+
+ok $gen->set( gkey => 'v1' );
+is $other->get('gkey'), 'v1', 'clients share the generation';
+
+my $g = $memd->get('gen');
+like $g, qr/^\d+$/, 'missing generation is created';
+is $memd->get("$g:gkey"), 'v1', 'generation is appended to the namespace';
+is $gen->namespace, $ns, 'namespace excludes the generation';
+
+ok $gen->invalidate_namespace;
+is $memd->get('gen'), $g + 1;
+is $gen->get('gkey'), undef, 'invalidated';
+
+is $other->get('gkey'), 'v1', 'cached generation';
+sleep 0.4;
+is $other->get('gkey'), undef, 'generation refreshed after the ttl';
+
+ok $gen->set( gkey => 'v2' );
+is $other->get('gkey'), 'v2';
+
+ok !$memd->invalidate_namespace, 'disabled';
+
+subtest 'evicted generation' => sub {
+    $memd->delete('gen');
+
+    ok $gen->invalidate_namespace;
+    ok $memd->get('gen') >= $g + 2, 'restarts after the cached generation';
+    is $gen->get('gkey'), undef;
+};
+
+$memd->delete('gen');
+
+done_testing;
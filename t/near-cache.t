@@ -0,0 +1,70 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+use Time::HiRes 'sleep';
+
+my $near = CLASS->new(
+    { %Memd::params, near_cache_size => 64 * 1024, near_cache_ttl => 0.5 } );
+
+is [ @{ $near->near_cache_stats }{qw/hits misses evictions entries bytes/} ],
+    [ 0, 0, 0, 0, 0 ];
+
+ok $memd->set( near => 'one' );
+ok $memd->set( hash => { a => 1 } );
+
+is $near->get('near'), 'one', 'miss goes to the server';
+
+# Changed behind the cache's back.
+ok $memd->set( near => 'two' );
+
+is $near->get('near'), 'one', 'hit is served locally';
+is $near->get_multi(qw/near hash/), { near => 'one', hash => { a => 1 } };
+is $near->get('hash'), { a => 1 }, 'deserialized on every hit';
+
+my $stats = $near->near_cache_stats;
+is [ @$stats{qw/hits misses entries evictions/} ], [ 3, 2, 2, 0 ];
+
+is $near->gets('near')->[1], 'two', 'gets goes to the server';
+
+sleep 0.6;
+
+is $near->get('near'), 'two', 'entry expires after near_cache_ttl';
+
+subtest invalidation => sub {
+    ok $near->set( near => 'three' );
+    is $near->get('near'), 'three', 'set';
+
+    ok $near->delete('near');
+    is $near->get('near'), undef, 'delete';
+
+    ok $near->set( near => 1 );
+    is $near->get('near'), 1;
+    is $near->incr('near'), 2;
+    is $near->get('near'), 2, 'incr';
+
+    $near->namespace( $near->namespace . 'other/' );
+    is $near->get('near'), undef, 'namespace is part of the key';
+    $near->namespace( $memd->namespace );
+};
+
+subtest eviction => sub {
+    my $small = CLASS->new(
+        { %Memd::params, near_cache_size => 16 * 1024, near_cache_ttl => 10 }
+    );
+
+    my @keys = map "evict$_", 1 .. 20;
+    ok $memd->set_multi( map [ $_ => 'x' x 900 ], @keys );
+
+    is [ values %{ $small->get_multi(@keys) } ], [ ('x' x 900) x @keys ];
+
+    my $stats = $small->near_cache_stats;
+    ok $stats->{evictions} > 0;
+    ok $stats->{bytes} <= 16 * 1024;
+
+    $memd->delete_multi(@keys);
+};
+
+$memd->delete_multi(qw/near hash/);
+
+done_testing;
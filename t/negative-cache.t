@@ -0,0 +1,46 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+use Time::HiRes 'sleep';
+
+my $neg = CLASS->new( { %Memd::params, negative_cache_ttl => 0.5 } );
+
+$memd->delete_multi(qw/neg1 neg2 neg3/);
+ok $memd->set( there => 'yes' );
+
+is $neg->get('neg1'), undef;
+is $neg->get_multi(qw/neg2 there neg3/), { there => 'yes' };
+
+# Created behind the cache's back.
+ok $memd->set_multi( [ neg1 => 1 ], [ neg2 => 2 ], [ neg3 => 3 ] );
+
+is $neg->get('neg1'), undef, 'missing key is remembered';
+is $neg->get_multi(qw/neg1 neg2 neg3 there/), { there => 'yes' };
+
+my $stats = $neg->near_cache_stats;
+is [ @$stats{qw/negative_hits negative_stores/} ], [ 4, 3 ];
+
+is $neg->gets('neg1')->[1], 1, 'gets goes to the server';
+
+subtest invalidation => sub {
+    $memd->delete('neg4');
+
+    is $neg->get('neg4'), undef;
+    ok $neg->add( neg4 => 4 );
+    is $neg->get('neg4'), 4, 'add';
+
+    ok $neg->delete('neg4');
+    is $neg->get('neg4'), undef;
+    ok $neg->set( neg4 => 5 );
+    is $neg->get('neg4'), 5, 'set';
+};
+
+sleep 0.6;
+
+is $neg->get_multi(qw/neg1 neg2 neg3/), { neg1 => 1, neg2 => 2, neg3 => 3 },
+    'entries expire after negative_cache_ttl';
+
+$memd->delete_multi(qw/neg1 neg2 neg3 neg4 there/);
+
+done_testing;
@@ -4,10 +4,14 @@ is [ keys %Cache::Memcached::Fast:: ] => bag {
     item $_ for qw(
         BEGIN CLONE DESTROY ISA VERSION __ANON__ bootstrap dl_load_flags
 
-        _destroy _new _weaken
+        PreparedKeys:: _destroy _get_prepared _new _prepare_keys _set_servers
+        _weaken
 
-        disconnect_all enable_compress flush_all namespace new nowait_push
-        retrieve server_versions store
+        add_server disconnect_all enable_compress flush_all flush_counters
+        hot_keys invalidate_namespace keys_by_server namespace
+        near_cache_stats new nowait_push prepare_keys remove_server
+        replicate_keys retrieve server_versions servers_for_keys set_servers
+        store unreplicate_keys update_slab_classes
 
         add         add_multi
         append   append_multi
@@ -0,0 +1,71 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my @keys = map {"pk$_"} 1 .. 50;
+my %data = map { ( $_ => "value of $_" ) } @keys;
+
+ok $memd->set_multi( map { [ $_ => $data{$_} ] } @keys[ 0 .. 39 ] ), 'set';
+
+my $prepared = $memd->prepare_keys( [ @keys, @keys[ 0 .. 9 ] ] );
+my %expected = map { ( $_ => $data{$_} ) } @keys[ 0 .. 39 ];
+
+is $prepared->get_multi, \%expected, 'get_multi';
+is $prepared->get_multi, $memd->get_multi(@keys), 'same as get_multi';
+
+ok $memd->set( pk1 => 'new' ), 'update';
+is $prepared->get_multi->{pk1}, 'new', 'values are not cached';
+
+is $memd->prepare_keys( [] )->get_multi, {}, 'no keys';
+
+subtest chunked => sub {
+    my %params = (
+        chunk_size         => 64 * 1024,
+        max_size           => 8 * 1024 * 1024,
+        compress_threshold => -1,
+    );
+    my $chunked = CLASS->new( { %Memd::params, %params } );
+
+    # Incompressible, so it is stored in chunks.
+    my $big = join '', map chr( int rand 256 ), 1 .. 3_000_000;
+    ok $chunked->set( pk_big => $big ), 'set big';
+    like $memd->get('pk_big'), qr/^[0-9a-f]+ 0 3000000 65536 46\z/,
+        'stored as a manifest';
+
+    my $res = $chunked->prepare_keys( [ 'pk_big', 'pk2' ] )->get_multi;
+    is [ sort keys %$res ], [ 'pk2', 'pk_big' ], 'keys';
+    ok $res->{pk_big} eq $big, 'chunked value';
+    is $res->{pk2}, $data{pk2}, 'small value';
+
+    ok $chunked->delete('pk_big'), 'delete';
+};
+
+subtest namespace_generation => sub {
+    my %params = ( %Memd::params, namespace_generation_key => 'pkgen' );
+    my $gen    = CLASS->new( \%params );
+
+    ok $gen->set( pkg => 1 ), 'set';
+    my $pkg = $gen->prepare_keys( ['pkg'] );
+    is $pkg->get_multi, { pkg => 1 }, 'get_multi';
+
+    ok $gen->invalidate_namespace, 'invalidate';
+    is $pkg->get_multi, {}, 'invalidated';
+    ok $gen->set( pkg => 2 ), 'set';
+    is $pkg->get_multi, { pkg => 2 }, 'rebuilt';
+};
+
+subtest near_cache => sub {
+    my %params = ( near_cache_size => 64 * 1024, near_cache_ttl => 5 );
+    my $near   = CLASS->new( { %Memd::params, %params } );
+    my $pk     = $near->prepare_keys( [ 'pk3', 'pk4', 'pk45' ] );
+
+    is $pk->get_multi, { pk3 => $data{pk3}, pk4 => $data{pk4} }, 'fetch';
+    is $pk->get_multi, { pk3 => $data{pk3}, pk4 => $data{pk4} }, 'cached';
+    is $near->near_cache_stats->{hits}, 2, 'goes through the cache';
+};
+
+is $memd->delete_multi( @keys[ 0 .. 39 ] ),
+    { map { ( $_ => 1 ) } @keys[ 0 .. 39 ] }, 'delete_multi';
+
+done_testing;
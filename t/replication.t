@@ -0,0 +1,65 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+# Both test servers are the same memcached, so a replicated write
+# is applied to it twice.
+my $rep = CLASS->new( { %Memd::params, replicated_keys => ['rep1'] } );
+
+ok $rep->set( rep1 => 0 );
+is $rep->get('rep1'), 0;
+
+my $r = $rep->incr('rep1');
+is $memd->get('rep1'), 2, 'incr goes to both replicas';
+
+$r = $rep->incr_multi( 'rep1', 'rep2' );
+is $memd->get('rep1'), 4, 'incr_multi';
+
+is $rep->gets('rep1')->[1], 4, 'gets';
+
+$rep->unreplicate_keys('rep1');
+$r = $rep->incr('rep1');
+is $memd->get('rep1'), 5, 'unreplicate_keys';
+
+$rep->replicate_keys(qw/rep1 rep2/);
+ok $rep->set( rep2 => 10 );
+$r = $rep->decr('rep2');
+is $memd->get('rep2'), 8, 'replicate_keys';
+
+is $rep->get_multi(qw/rep1 rep2 rep3/), { rep1 => 5, rep2 => 8 };
+
+ok $rep->touch( rep2 => 100 ), 'touch';
+
+# Either replica may delete the key first.
+$r = $rep->delete('rep2');
+is $memd->get('rep2'), undef, 'delete';
+
+# The test servers share one memcached, so the delete on the other
+# replica may come after the cas, but the old value is never left.
+subtest cas => sub {
+    my $cas_rep
+        = CLASS->new( { %Memd::params, replicated_keys => ['rep3'] } );
+    ok $cas_rep->set( rep3 => 'old' ), 'set';
+    my $cas = $cas_rep->gets('rep3')->[0];
+    ok $cas_rep->cas( rep3 => $cas, 'new' ), 'cas';
+
+    for my $server ( @{ $Memd::params{servers} } ) {
+        my $address = ref $server ? $server->{address} : $server;
+        my $one = CLASS->new( { %Memd::params, servers => [$address] } );
+        my $val = $one->get('rep3');
+        ok !defined $val || $val eq 'new', "no old value on $address";
+    }
+};
+
+my $single = CLASS->new(
+    { %Memd::params, replicas => 1, replicated_keys => ['rep1'] } );
+$r = $single->incr('rep1');
+is $memd->get('rep1'), 6, 'replicas => 1';
+
+like dies { CLASS->new( { %Memd::params, replicas => 17 } ) },
+    qr/^replicas should be between 1 and 16/;
+
+$memd->delete_multi(qw/rep1 rep2 rep3/);
+
+done_testing;
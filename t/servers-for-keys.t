@@ -0,0 +1,65 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my @keys    = map {"key$_"} 1 .. 500;
+my @servers = map {"127.0.0.1:$_"} 1 .. 5;
+
+my $memd    = CLASS->new( { servers => \@servers } );
+my $indexes = $memd->servers_for_keys( \@keys );
+
+is scalar @$indexes, scalar @keys, 'an index per key';
+is [ grep { $_ < 0 || $_ > 4 } @$indexes ], [], 'valid indexes';
+is $indexes, [ map { $memd->servers_for_keys( [$_] )->[0] } @keys ],
+    'batch is the same as one by one';
+is $memd->servers_for_keys( [] ), [], 'no keys';
+
+my %expected;
+push @{ $expected{ $servers[ $indexes->[$_] ] } }, $keys[$_] for 0 .. $#keys;
+is $memd->keys_by_server( \@keys ), \%expected, 'keys_by_server';
+
+subtest hash_namespace => sub {
+    my %params = ( servers => \@servers, namespace => 'ns:' );
+    my $hashed = CLASS->new( { %params, hash_namespace => 1 } );
+    my $plain  = CLASS->new( \%params );
+
+    is $hashed->servers_for_keys( \@keys ),
+        $memd->servers_for_keys( [ map {"ns:$_"} @keys ] ), 'hashed';
+    is $plain->servers_for_keys( \@keys ), $indexes, 'not hashed';
+
+    # Namespaces shorter and longer than an XXH64 stripe.
+    for my $mode (qw(ketama jump rendezvous maglev)) {
+        for my $ns ( 'ns:', 'a/long/namespace/over/thirty/two/bytes/' ) {
+            my %xxh64 = (
+                servers       => \@servers,
+                dispatch_mode => $mode,
+                hash_function => 'xxh64',
+            );
+            my $joined = CLASS->new( \%xxh64 );
+            my $prefixed = CLASS->new(
+                { %xxh64, namespace => $ns, hash_namespace => 1 } );
+            is $prefixed->servers_for_keys( \@keys ),
+                $joined->servers_for_keys( [ map {"$ns$_"} @keys ] ),
+                "xxh64 $mode, " . length($ns) . ' byte namespace';
+        }
+    }
+};
+
+subtest dispatch_mode => sub {
+    my $jump = CLASS->new( { servers => \@servers, dispatch_mode => 'jump' } );
+    isnt $jump->servers_for_keys( \@keys ), $indexes, 'different mapping';
+};
+
+my $none = CLASS->new( { servers => [] } );
+is $none->servers_for_keys( ['a'] ), [undef], 'no servers';
+is $none->keys_by_server( ['a'] ), {}, 'no servers';
+
+like dies { $memd->servers_for_keys('a') }, qr/^Not an array reference/;
+
+# Groups are keyed by the addresses server_versions() returns.
+my $versions = $main::memd->server_versions;
+my $groups = $main::memd->keys_by_server( [ map {"sfk$_"} 1 .. 20 ] );
+is [ grep { !exists $versions->{$_} } keys %$groups ], [], 'addresses';
+
+done_testing;
@@ -0,0 +1,67 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+my @keys    = map {"ss$_"} 1 .. 200;
+my @servers = map {"127.0.0.1:$_"} 1 .. 6;
+
+# Where a new client with the servers dispatches the keys.
+sub fresh {
+    my ( $params, $servers ) = @_;
+
+    my $memd = CLASS->new( { %$params, servers => $servers } );
+    return $memd->servers_for_keys( \@keys );
+}
+
+for my $mode (qw(ketama jump rendezvous maglev ketama_md5)) {
+    subtest $mode => sub {
+        my %params = ( dispatch_mode => $mode, ketama_points => 150 );
+        my @first  = @servers[ 0 .. 3 ];
+        my $memd   = CLASS->new( { %params, servers => \@first } );
+
+        $memd->add_server( $servers[4] );
+        $memd->add_server( { address => $servers[5], weight => 2 } );
+        ok $memd->remove_server( $servers[1] ), 'remove_server';
+        ok !$memd->remove_server( $servers[1] ), 'not found';
+
+        my @list = ( @servers[ 0, 2, 3, 4 ], [ $servers[5], 2 ] );
+        is $memd->servers_for_keys( \@keys ), fresh( \%params, \@list ),
+            'same as a new client';
+
+        @list = ( $list[4], @servers[ 3, 0, 4 ], '127.0.0.1:7' );
+        $memd->set_servers( \@list );
+        is $memd->servers_for_keys( \@keys ), fresh( \%params, \@list ),
+            'set_servers';
+
+        $memd->set_servers( [] );
+        is $memd->servers_for_keys( ['a'] ), [undef], 'no servers';
+    };
+}
+
+my $memd = CLASS->new( { %Memd::params, servers => ['127.0.0.1:1'] } );
+is $memd->set( ss => 1 ), undef, 'dead server';
+
+$memd->set_servers( $Memd::params{servers} );
+ok $memd->set( ss => 1 ), 'set';
+is $memd->get('ss'), 1, 'get';
+is [ sort keys %{ $memd->server_versions } ],
+    [ sort '127.0.0.1:11211', 'localhost:11211' ], 'server_versions';
+
+my $prepared = $memd->prepare_keys( ['ss'] );
+$memd->add_server('127.0.0.1:1');
+my $dead = $memd->keys_by_server( \@keys )->{'127.0.0.1:1'};
+is $memd->set( $dead->[0] => 2 ), undef, 'key moved to the dead server';
+is $prepared->get_multi, $memd->get_multi('ss'), 'prepared keys follow';
+
+ok $memd->remove_server('127.0.0.1:1'), 'remove_server';
+ok $memd->set( $dead->[0] => 2 ), 'key moved back';
+
+like dies { $memd->set_servers( [ { address => 'a:1', weight => 0 } ] ) },
+    qr/^Server weight should be positive/;
+is $memd->get('ss'), 1, 'unchanged on error';
+
+is $memd->delete_multi( 'ss', $dead->[0] ), { ss => 1, $dead->[0] => 1 },
+    'delete_multi';
+
+done_testing;
@@ -0,0 +1,70 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+use Time::HiRes 'sleep';
+
+my $shared = CLASS->new( {
+    %Memd::params,
+    shared_cache_size      => 1024 * 1024,
+    shared_cache_item_size => 1024,
+    near_cache_ttl         => 0.5,
+} );
+
+my $big = join '', map { sprintf '%08x', rand 2**32 } 1 .. 500;
+
+ok $memd->set( shared => 'one' );
+ok $memd->set( big    => $big );
+
+my $pid = fork // die "fork: $!";
+unless ($pid) {
+    # Populate the cache from the child.
+    $shared->get_multi(qw/shared big/);
+    exit;
+}
+waitpid $pid, 0;
+
+# Changed behind the cache's back.
+ok $memd->set( shared => 'two' );
+
+is $shared->get('shared'), 'one', 'value fetched by the child is shared';
+is $shared->get('big'), $big, 'too big for the cache';
+
+my $stats = $shared->near_cache_stats;
+is [ @$stats{qw/shared_hits shared_misses/} ], [ 1, 1 ];
+
+subtest 'invalidation by a sibling' => sub {
+    my $pid = fork // die "fork: $!";
+    unless ($pid) {
+        $shared->set( shared => 'three' );
+        exit;
+    }
+    waitpid $pid, 0;
+
+    is $shared->get('shared'), 'three';
+};
+
+subtest 'with near cache' => sub {
+    my $both = CLASS->new( {
+        %Memd::params,
+        shared_cache_size => 1024 * 1024,
+        near_cache_size   => 1024 * 1024,
+        near_cache_ttl    => 0.5,
+    } );
+
+    is $both->get('shared'), 'three';
+    is $both->get('shared'), 'three';
+
+    my $stats = $both->near_cache_stats;
+    is [ @$stats{qw/hits misses shared_misses shared_stores/} ],
+        [ 1, 1, 1, 1 ];
+};
+
+sleep 0.6;
+
+ok $memd->set( shared => 'four' );
+is $shared->get('shared'), 'four', 'entry expires after near_cache_ttl';
+
+$memd->delete_multi(qw/shared big/);
+
+done_testing;
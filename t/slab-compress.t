@@ -0,0 +1,77 @@
+use lib 't';
+
+use Memd;
+use Test2::V0 -target => 'Cache::Memcached::Fast';
+
+# The values are strings of 'a', "compressed" to their length padded
+# with spaces up to $csize bytes.
+my ( $csize, $calls );
+my @methods = (
+    sub { ++$calls; ${ $_[1] } = sprintf '%-*d', $csize, length ${ $_[0] } },
+    sub { ${ $_[1] } = 'a' x ${ $_[0] } },
+);
+
+my %params = (
+    %Memd::params,
+    namespace          => "sc$$:",
+    compress_threshold => 1,
+    compress_ratio     => 1,
+    compress_methods   => \@methods,
+);
+
+my $aware = CLASS->new( { %params, compress_slab_aware => 1 } );
+my $plain = CLASS->new( \%params );
+
+ok $aware->update_slab_classes, 'update_slab_classes';
+ok !$plain->update_slab_classes, 'not slab aware';
+
+# Reports whether the value was stored compressed.
+my $raw = CLASS->new(
+    {   %params,
+        compress_methods => [ $methods[0], sub { ${ $_[1] } = 'compressed' } ],
+    }
+);
+
+sub check {
+    my ( $memd, $len, $compressed, $name ) = @_;
+
+    ok $memd->set( k => 'a' x $len ), "$name: set";
+    is $raw->get('k'), $compressed ? 'compressed' : 'a' x $len,
+        "$name: stored " . ( $compressed ? 'compressed' : 'uncompressed' );
+    is $memd->get('k'), 'a' x $len, "$name: get";
+}
+
+# Without the option any size reduction passes compress_ratio => 1.
+$csize = 95;
+check $plain, 100, 1, 'plain';
+
+# Items already in the smallest class are not compressed at all.
+$calls = 0;
+check $aware, 20, 0, 'smallest class';
+is $calls, 0, 'compression skipped';
+
+# Compression that keeps the item in the same class is rejected...
+$calls = 0;
+check $aware, 100, 0, 'same class';
+is $calls, 1, 'compression tried';
+
+# ...and accepted when the item moves to a smaller class.
+$csize = 40;
+check $aware, 100, 1, 'smaller class';
+
+# The table covers classes the servers have no memory in yet.
+$csize = 200;
+check $aware, 1100, 1, 'distant class';
+
+# Items larger than all classes follow compress_ratio alone.
+$csize = 600_000 - 10;
+check $aware, 600_000, 1, 'large item';
+
+$csize = 40;
+ok $aware->set_multi( [ k1 => 'a' x 100 ], [ k2 => 'a' x 20 ] ), 'set_multi';
+is $raw->get_multi(qw/k1 k2/),
+    { k1 => 'compressed', k2 => 'a' x 20 }, 'set_multi decisions';
+
+$aware->delete_multi(qw/k k1 k2/);
+
+done_testing;
@@ -31,6 +31,32 @@ subtest string => sub {
         . ( __FILE__ . ' line ' . ( __LINE__ - 2 ) . ".\n" );
 };
 
-$memd->delete_multi(qw/bytes string/);
+subtest long => sub {
+    my $long = ( 'ASCII run ' x 10 ) . $string . ( '.' x 33 ) . $string;
+
+    ok $memd->set( long => $long );
+
+    is $memd->get('long'), $long;
+
+    # Perl allows surrogates in strings, strict UTF-8 does not.
+    my $surrogate = "abc\x{D800}";
+
+    ok $memd->set( surrogate => $surrogate );
+
+    is $memd->get('surrogate'), $surrogate;
+};
+
+subtest compressed => sub {
+    my $memd_compress = CLASS->new(
+        { %Memd::params, compress_threshold => 10, utf8 => 1 } );
+
+    my $long = $string x 100;
+
+    ok $memd_compress->set( compressed => $long );
+
+    is $memd_compress->get('compressed'), $long;
+};
+
+$memd->delete_multi(qw/bytes string long surrogate compressed/);
 
 done_testing;